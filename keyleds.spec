@@ -16,7 +16,7 @@ License: GPL-3.0+
 Group: Applications/System
 Source: https://github.com/spectras/keyleds/archive/v%{version}/%{name}-%{version}.tar.gz
 URL: https://github.com/spectras/keyleds
-BuildRequires: cmake, make, gcc, gcc-c++, libudev-devel, libuv-devel, libyaml-devel, libX11-devel, libXi-devel, systemd-devel
+BuildRequires: cmake, make, gcc, gcc-c++, libudev-devel, libuv-devel, libyaml-devel, libX11-devel, libxcb-devel, libXi-devel, systemd-devel
 %if 0%{?suse_version}
 BuildRequires: lua51-luajit-devel
 %else
@@ -75,3 +75,4 @@ install -m 644 -D build/keyledsctl.1.gz %{buildroot}/%{_mandir}/man1/keyledsctl.
 %config(noreplace) %{_sysconfdir}/keyledsd.conf
 %{_sysconfdir}/xdg/autostart/keyledsd.desktop
 %{_udevrulesdir}/70-logitech-hidpp.rules
+%{_userunitdir}/keyledsd.service
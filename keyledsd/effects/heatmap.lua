@@ -1,7 +1,8 @@
 
-cold = tocolor(keyleds.config.cold) or tocolor('blue')
-hot = tocolor(keyleds.config.hot) or tocolor('red')
-transparent = tocolor(0, 0, 0, 0)
+-- Colors are packed, so per-key color maths creates no garbage
+cold = rgba.pack(tocolor(keyleds.config.cold) or tocolor('blue'))
+hot = rgba.pack(tocolor(keyleds.config.hot) or tocolor('red'))
+transparent = rgba.pack(0, 0, 0, 0)
 
 function init()
     contexts = {}
@@ -13,18 +14,23 @@ function renderToBuffer(buffer, presses, maximum)
     buffer:fill(transparent)
     for key, count in pairs(presses) do
         local ratio = count / maximum
-        buffer[key] = hot * ratio + cold * (1 - ratio)
+        buffer[key] = rgba.lerp(cold, hot, ratio)
     end
 end
 
-function onKeyEvent(key, isPress)
-    if not isPress then return end
-
-    local count = (presses[key] or 0) + 1
-    presses[key] = count
-    if count > maximum then maximum = count end
+-- Invoked once per frame with all key events since last frame
+function onKeyEvents(events)
+    local changed = false
+    for _, event in ipairs(events) do
+        if event.pressed then
+            local count = (presses[event.key] or 0) + 1
+            presses[event.key] = count
+            if count > maximum then maximum = count end
+            changed = true
+        end
+    end
 
-    renderToBuffer(buffer, presses, maximum)
+    if changed then renderToBuffer(buffer, presses, maximum) end
 end
 
 function onContextChange(context)
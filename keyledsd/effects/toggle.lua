@@ -52,10 +52,8 @@ function onGenericEvent(data)
                                                 -- not mandatory, but a good practice to isolate events
 
     if data.command == "reset" then             -- when command=reset, clear all states
-        for key, value in pairs(keyStates) do
-            keyStates[key] = false
-            buffer[key] = transparent
-        end
+        keyStates = {}
+        buffer:fill(transparent)                -- bulk operations run natively, in one call
     end
 end
 
@@ -19,8 +19,12 @@
 
 #include "keyledsd/RenderTarget.h"
 #include <algorithm>
+#include <cassert>
+#include <cstddef>
+#include <cstdint>
 #include <iosfwd>
 #include <iterator>
+#include <new>
 #include <string>
 #include <utility>
 #include <vector>
@@ -34,6 +38,19 @@ namespace keyleds {
  * Holds compiled information about all recognised keys on an active device.
  * It guarantees iterators and pointers to individual keys will remain valid
  * throughout its lifetime.
+ *
+ * Lookup tables are built on construction, so finding a key by code or name
+ * takes constant time. They store key indices, so they remain valid in copies.
+ *
+ * Spatial queries use a uniform grid, also built on construction in linear time
+ * and memory. Keys are located by the center of their position rectangle.
+ *
+ * Key geometry is also available as a structure of arrays, for effects that
+ * compute something for every key and want the compiler to vectorize it.
+ *
+ * Keys can be grouped either as a KeyGroup, an ordered list of keys, or as a
+ * KeySet, a bitset with fast membership and set operations that also serves
+ * as the mask for masked rendering operations.
  */
 class KeyDatabase final
 {
@@ -49,18 +66,63 @@ public:
         int             keyCode;    ///< linux input event code
         std::string     name;       ///< user-readable name
         Rect            position;   ///< physical position on keyboard
+        unsigned        block = 0;  ///< index of the key's block on the device
     };
 
     class KeyGroup;
+    class KeySet;
 
-private:
-    struct Relation final
+    /// Allocator for SIMD-friendly buffers, 32 is enough for AVX2
+    template <typename T> struct simd_allocator
     {
-        position_type   distance;
+        using value_type = T;
+        static constexpr auto alignment = std::align_val_t(32);
+
+                simd_allocator() = default;
+        template <typename U> simd_allocator(const simd_allocator<U> &) noexcept {}
+
+        T *     allocate(std::size_t n)
+                    { return static_cast<T *>(::operator new(n * sizeof(T), alignment)); }
+        void    deallocate(T * ptr, std::size_t) noexcept { ::operator delete(ptr, alignment); }
+
+        friend bool operator==(const simd_allocator &, const simd_allocator &) { return true; }
+        friend bool operator!=(const simd_allocator &, const simd_allocator &) { return false; }
     };
+    template <typename T> using simd_vector = std::vector<T, simd_allocator<T>>;
+
+    /** Key geometry, as a structure of arrays
+     *
+     * Entries are in key index order. Each array starts on a 32-byte boundary
+     * and is zero-padded to a multiple of simdWidth entries, so loops can
+     * process whole vectors without a scalar tail. Coordinates are normalized
+     * to [0, 1] over the database's bounds, with y growing downwards like
+     * in layout files.
+     */
+    struct Geometry final
+    {
+        static constexpr std::size_t simdWidth = 8;
 
+        simd_vector<float>      x;      ///< horizontal position of key center
+        simd_vector<float>      y;      ///< vertical position of key center
+        simd_vector<float>      width;  ///< key width
+        simd_vector<float>      height; ///< key height
+        simd_vector<unsigned>   block;  ///< index of the key's block on the device
+    };
+
+private:
     using key_list = std::vector<Key>;
-    using relation_list = std::vector<Relation>;
+    using index_table = std::vector<Key::index_type>;
+
+    struct Grid final
+    {
+        position_type   cellWidth = 1;  ///< Size of a cell, in key position units
+        position_type   cellHeight = 1;
+        unsigned        columns = 0;    ///< Number of cells on each axis
+        unsigned        rows = 0;
+        position_type   margin = 0;     ///< Largest half-size of a key, for line queries
+        index_table     cellStart;      ///< Offset of each cell's first key in keys, plus end
+        index_table     keys;           ///< Key indices, sorted by cell
+    };
 public:
     using value_type = key_list::value_type;
     using const_reference = key_list::const_reference;
@@ -80,23 +142,43 @@ public:
     bool            empty() const noexcept { return m_keys.empty(); }
     size_type       size() const noexcept { return m_keys.size(); }
     const_reference operator[](size_type idx) const { return m_keys[idx]; }
+    std::size_t     memoryUsage() const noexcept;   ///< Heap memory held, in bytes
 
     Rect            bounds() const noexcept { return m_bounds; }
+    const Geometry& geometry() const noexcept { return m_geometry; }
     position_type   distance(const Key &, const Key &) const noexcept;
     double          angle(const Key &, const Key &) const noexcept;
 
+    /// Keys whose center lies within radius of a point, by index
+    KeyGroup        keysInRadius(position_type x, position_type y, position_type radius) const;
+    /// Up to count keys closest to a point, nearest first
+    KeyGroup        nearestKeys(position_type x, position_type y, size_type count) const;
+    /// Keys whose rectangle intersects a segment, in order along it
+    KeyGroup        keysOnLine(position_type x0, position_type y0,
+                               position_type x1, position_type y1) const;
+    /// Keys whose rectangle intersects a ray, in order along it. Angle follows
+    /// the same convention as angle()
+    KeyGroup        keysOnRay(position_type x, position_type y, double angle) const;
+
     /// Builds a KeyGroup with given name; first and last define a sequence of
     /// string defining key names for the group. Invalid names are ignored.
     template<typename It> KeyGroup makeGroup(std::string name, It first, It last) const;
     template<typename S, typename C> KeyGroup makeGroup(S && name, const C &) const;
 
 private:
-    static relation_list computeRelations(const key_list &);
+    KeyGroup            traceLine(double x0, double y0, double x1, double y1) const;
+    static Grid         computeGrid(const key_list &, Rect bounds);
+    static Geometry     computeGeometry(const key_list &, Rect bounds);
+    static index_table  computeKeyCodeTable(const key_list &);
+    static index_table  computeNameTable(const key_list &);
 
 private:
     key_list        m_keys;         ///< Vector of all keys known for a device
     Rect            m_bounds;       ///< Bounds of m_keys' positions
-    relation_list   m_relations;    ///< Pre-computed relation array
+    Grid            m_grid;         ///< Spatial index of m_keys
+    Geometry        m_geometry;     ///< Normalized positions of m_keys
+    index_table     m_keyCodes;     ///< Key index by key code, size() if none
+    index_table     m_names;        ///< Open-addressing hash table of key indices by name
 };
 
 /****************************************************************************/
@@ -187,6 +269,70 @@ private:
 
 /****************************************************************************/
 
+/** Key Set abstraction
+ *
+ * Bitset over the key indices of a KeyDatabase. Membership tests are constant
+ * time and set operations work on whole words. It does not reference the
+ * database, so it remains valid in copies, but all sets combined together
+ * must have the same size, normally that of the database.
+ *
+ * Bits past size() are always clear, so words can be fed directly to masked
+ * rendering operations on a RenderTarget of the same size.
+ */
+class KeyDatabase::KeySet final
+{
+    using word_list = std::vector<std::uint64_t>;
+public:
+    using word_type = word_list::value_type;
+    using size_type = std::size_t;
+    static constexpr size_type wordBits = 64;
+public:
+                    KeySet() = default;
+    explicit        KeySet(size_type size);
+                    KeySet(size_type size, const KeyGroup &);
+                    ~KeySet();
+
+    /// Number of keys the set can hold, not the number of keys it holds
+    size_type       size() const noexcept { return m_size; }
+    size_type       count() const noexcept;
+    bool            empty() const noexcept;
+
+    bool            contains(Key::index_type idx) const noexcept
+                        { return idx < m_size && (m_words[idx / wordBits] & bit(idx)) != 0; }
+    bool            contains(const Key & key) const noexcept { return contains(key.index); }
+    void            insert(Key::index_type idx) noexcept
+                        { assert(idx < m_size); m_words[idx / wordBits] |= bit(idx); }
+    void            insert(const Key & key) noexcept { insert(key.index); }
+    void            erase(Key::index_type idx) noexcept
+                        { assert(idx < m_size); m_words[idx / wordBits] &= ~bit(idx); }
+    void            erase(const Key & key) noexcept { erase(key.index); }
+    void            clear() noexcept { std::fill(m_words.begin(), m_words.end(), 0); }
+
+    const word_type * data() const noexcept { return m_words.data(); }
+    size_type       words() const noexcept { return m_words.size(); }
+
+    KeySet &        operator|=(const KeySet &) noexcept;
+    KeySet &        operator&=(const KeySet &) noexcept;
+    KeySet &        operator^=(const KeySet &) noexcept;
+    KeySet &        operator-=(const KeySet &) noexcept;
+    KeySet          operator~() const;
+
+    /// Invokes func with the index of every key in the set, in increasing order
+    template <typename F> void forEach(F && func) const;
+    /// Builds a KeyGroup of keys in the set, in index order
+    KeyGroup        group(const KeyDatabase &, std::string name = {}) const;
+
+private:
+    static word_type bit(Key::index_type idx) noexcept { return word_type(1) << (idx % wordBits); }
+private:
+    size_type       m_size = 0;     ///< Number of keys the set can hold
+    word_list       m_words;        ///< Bitset, one bit per key index
+
+    friend bool operator==(const KeySet &, const KeySet &) noexcept;
+};
+
+/****************************************************************************/
+
 inline bool operator==(const KeyDatabase::Rect & a, const KeyDatabase::Rect & b)
  { return a.x0 == b.x0 && a.y0 == b.y0 && a.x1 == b.x1 && a.y1 == b.y1; }
 inline bool operator!=(const KeyDatabase::Rect & a, const KeyDatabase::Rect & b)
@@ -210,6 +356,108 @@ inline void swap(KeyDatabase::KeyGroup & lhs, KeyDatabase::KeyGroup & rhs) noexc
     swap(lhs.m_keys, rhs.m_keys);
 }
 
+inline KeyDatabase::KeySet operator|(KeyDatabase::KeySet a, const KeyDatabase::KeySet & b)
+ { return a |= b; }
+inline KeyDatabase::KeySet operator&(KeyDatabase::KeySet a, const KeyDatabase::KeySet & b)
+ { return a &= b; }
+inline KeyDatabase::KeySet operator^(KeyDatabase::KeySet a, const KeyDatabase::KeySet & b)
+ { return a ^= b; }
+inline KeyDatabase::KeySet operator-(KeyDatabase::KeySet a, const KeyDatabase::KeySet & b)
+ { return a -= b; }
+inline bool operator==(const KeyDatabase::KeySet & a, const KeyDatabase::KeySet & b) noexcept
+ { return a.m_size == b.m_size && a.m_words == b.m_words; }
+inline bool operator!=(const KeyDatabase::KeySet & a, const KeyDatabase::KeySet & b) noexcept
+ { return !(a == b); }
+
+inline KeyDatabase::KeySet & KeyDatabase::KeySet::operator|=(const KeySet & other) noexcept
+{
+    assert(m_size == other.m_size);
+    for (size_type idx = 0; idx < m_words.size(); ++idx) { m_words[idx] |= other.m_words[idx]; }
+    return *this;
+}
+
+inline KeyDatabase::KeySet & KeyDatabase::KeySet::operator&=(const KeySet & other) noexcept
+{
+    assert(m_size == other.m_size);
+    for (size_type idx = 0; idx < m_words.size(); ++idx) { m_words[idx] &= other.m_words[idx]; }
+    return *this;
+}
+
+inline KeyDatabase::KeySet & KeyDatabase::KeySet::operator^=(const KeySet & other) noexcept
+{
+    assert(m_size == other.m_size);
+    for (size_type idx = 0; idx < m_words.size(); ++idx) { m_words[idx] ^= other.m_words[idx]; }
+    return *this;
+}
+
+inline KeyDatabase::KeySet & KeyDatabase::KeySet::operator-=(const KeySet & other) noexcept
+{
+    assert(m_size == other.m_size);
+    for (size_type idx = 0; idx < m_words.size(); ++idx) { m_words[idx] &= ~other.m_words[idx]; }
+    return *this;
+}
+
+template <typename F> inline void KeyDatabase::KeySet::forEach(F && func) const
+{
+    for (size_type idx = 0; idx < m_words.size(); ++idx) {
+        for (auto word = m_words[idx]; word != 0; word &= word - 1) {
+            func(Key::index_type(idx * wordBits + size_type(__builtin_ctzll(word))));
+        }
+    }
+}
+
+/****************************************************************************/
+// Masked rendering operations, only affecting keys in a KeySet
+
+inline void fill(RenderTarget & lhs, RGBAColor color, const KeyDatabase::KeySet & keys) noexcept
+{
+    assert(keys.words() * KeyDatabase::KeySet::wordBits >= lhs.capacity());
+    tools::fill_masked(reinterpret_cast<uint8_t*>(lhs.data()),
+                       reinterpret_cast<const uint8_t*>(&color), keys.data(), lhs.capacity());
+}
+
+template <typename A>
+inline void fill(RenderTarget & lhs, RGBAColor color, const KeyDatabase::KeySet & keys) noexcept
+{
+    assert(keys.words() * KeyDatabase::KeySet::wordBits >= lhs.capacity());
+    A::fill_masked(reinterpret_cast<uint8_t*>(lhs.data()),
+                   reinterpret_cast<const uint8_t*>(&color), keys.data(), lhs.capacity());
+}
+
+inline void copy(RenderTarget & lhs, const RenderTarget & rhs, const KeyDatabase::KeySet & keys) noexcept
+{
+    assert(lhs.capacity() == rhs.capacity());
+    assert(keys.words() * KeyDatabase::KeySet::wordBits >= lhs.capacity());
+    tools::copy_masked(reinterpret_cast<uint8_t*>(lhs.data()),
+                       reinterpret_cast<const uint8_t*>(rhs.data()), keys.data(), rhs.capacity());
+}
+
+template <typename A>
+inline void copy(RenderTarget & lhs, const RenderTarget & rhs, const KeyDatabase::KeySet & keys) noexcept
+{
+    assert(lhs.capacity() == rhs.capacity());
+    assert(keys.words() * KeyDatabase::KeySet::wordBits >= lhs.capacity());
+    A::copy_masked(reinterpret_cast<uint8_t*>(lhs.data()),
+                   reinterpret_cast<const uint8_t*>(rhs.data()), keys.data(), rhs.capacity());
+}
+
+inline void blend(RenderTarget & lhs, const RenderTarget & rhs, const KeyDatabase::KeySet & keys) noexcept
+{
+    assert(lhs.capacity() == rhs.capacity());
+    assert(keys.words() * KeyDatabase::KeySet::wordBits >= lhs.capacity());
+    tools::blend_masked(reinterpret_cast<uint8_t*>(lhs.data()),
+                        reinterpret_cast<const uint8_t*>(rhs.data()), keys.data(), rhs.capacity());
+}
+
+template <typename A>
+inline void blend(RenderTarget & lhs, const RenderTarget & rhs, const KeyDatabase::KeySet & keys) noexcept
+{
+    assert(lhs.capacity() == rhs.capacity());
+    assert(keys.words() * KeyDatabase::KeySet::wordBits >= lhs.capacity());
+    A::blend_masked(reinterpret_cast<uint8_t*>(lhs.data()),
+                    reinterpret_cast<const uint8_t*>(rhs.data()), keys.data(), rhs.capacity());
+}
+
 /****************************************************************************/
 
 template <typename It> inline
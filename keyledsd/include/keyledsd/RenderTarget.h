@@ -87,6 +87,7 @@ private:
 void swap(RenderTarget &, RenderTarget &) noexcept;
 void blend(RenderTarget &, const RenderTarget &) noexcept;
 void multiply(RenderTarget &, const RenderTarget &) noexcept;
+void scale(RenderTarget &, RGBAColor) noexcept;
 
 /****************************************************************************/
 
@@ -98,10 +99,16 @@ void multiply(RenderTarget &, const RenderTarget &) noexcept;
 class Renderer
 {
 protected:
+    using clock = std::chrono::steady_clock;
     using milliseconds = std::chrono::duration<unsigned, std::milli>;
 public:
     /// Modifies the target to reflect effect's display once the specified time has elapsed
     virtual void    render(milliseconds, RenderTarget & target) = 0;
+
+    /// Invoked once a frame is sent to the device, with the time next frame is due.
+    /// Lets the renderer do deferred work, such as garbage collection, out of render.
+    /// It is not invoked when no time is left, nor while the render loop is paused.
+    virtual void    idle(clock::time_point /* deadline */) {}
 protected:
     // Protect the destructor so we can leave it non-virtual
     ~Renderer() {}
@@ -147,6 +154,19 @@ inline void multiply(RenderTarget & lhs, const RenderTarget & rhs) noexcept
                 reinterpret_cast<const uint8_t*>(rhs.data()), rhs.capacity());
 }
 
+inline void scale(RenderTarget & lhs, RGBAColor factor) noexcept
+{
+    tools::scale(reinterpret_cast<uint8_t*>(lhs.data()),
+                 reinterpret_cast<const uint8_t*>(&factor), lhs.capacity());
+}
+
+template <typename A>
+inline void scale(RenderTarget & lhs, RGBAColor factor) noexcept
+{
+    A::scale(reinterpret_cast<uint8_t*>(lhs.data()),
+             reinterpret_cast<const uint8_t*>(&factor), lhs.capacity());
+}
+
 } // keyleds
 
 #endif
@@ -20,7 +20,10 @@
 #   error "Internal header - must not be pulled into plugins"
 #endif
 
+#include <cstddef>
+#include <cstdint>
 #include <iosfwd>
+#include <optional>
 #include <stdexcept>
 #include <string>
 #include <vector>
@@ -48,6 +51,11 @@ struct LayoutDescription final
 
     static LayoutDescription parse(std::istream &);
     static LayoutDescription loadFile(const std::string & path);
+    /// Loads layout file from the first data directory that has it, if any. The
+    /// directory shipped layouts are installed to is skipped, builtin() has those.
+    static std::optional<LayoutDescription> loadOverride(const std::string & path);
+    /// Looks up a layout compiled into keyledsd from shipped layout files
+    static std::optional<LayoutDescription> builtin(const std::string & path);
 
     std::string name;       ///< Layout name, indicating its country code
     key_list    keys;       ///< All keys from all blocks
@@ -66,6 +74,33 @@ struct LayoutDescription::Key final
 
 /****************************************************************************/
 
+namespace detail {
+    /// Compact form of a shipped layout file, generated at build time by keyledsd-layoutc
+    struct BuiltinLayout final
+    {
+        struct Key final
+        {
+            std::uint16_t   block, code;
+            std::uint16_t   x0, y0, x1, y1;
+            std::uint32_t   name;           ///< Offset of key name in layout's name pool
+        };
+        struct Position final { std::uint16_t block, code; };
+
+        const char *        file;           ///< Layout file name, table is sorted on it
+        const char *        name;
+        const char *        names;          ///< Pool of nul-terminated key names
+        const Key *         keys;
+        std::size_t         keyCount;
+        const Position *    spurious;
+        std::size_t         spuriousCount;
+    };
+
+    extern const BuiltinLayout  builtinLayouts[];
+    extern const std::size_t    builtinLayoutCount;
+}
+
+/****************************************************************************/
+
 } // namespace keyleds::device
 
 #endif
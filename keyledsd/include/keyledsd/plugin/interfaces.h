@@ -43,7 +43,9 @@ public:
 
     /// Invoked whenever the context of the service has changed while the plugin is active.
     /// Since plugins are loaded on context changes, this means this is always called
-    /// once before periodic calls to render start.
+    /// once before periodic calls to render start. Later changes are only delivered
+    /// if effect is subscribed, see EffectService::subscribeContext.
+    /// string_map holds the whole context, keys in the order they were first set.
     virtual void    handleContextChange(const string_map &) = 0;
 
     /// Invoked whenever the Service is sent a generic event while the plugin is active.
@@ -51,7 +53,9 @@ public:
     virtual void    handleGenericEvent(const string_map &) = 0;
 
     /// Invoked whenever the user presses or releases a key while the plugin is active.
-    virtual void    handleKeyEvent(const KeyDatabase::Key &, bool press) = 0;
+    /// Time is when the event happened, on the render clock. Delivery can lag behind
+    /// by a few milliseconds, animations should start from it rather than from now.
+    virtual void    handleKeyEvent(const KeyDatabase::Key &, bool press, clock::time_point) = 0;
 
 protected:
     Effect() = default;
@@ -103,10 +107,23 @@ public:
     virtual RenderTarget *      createRenderTarget() = 0;
     virtual void                destroyRenderTarget(RenderTarget *) = 0;
 
+    /// Reads a data file. Contents are cached by the service and only read again
+    /// once the file is modified or overridden in a higher priority directory.
     virtual const std::string & getFile(const std::string &) = 0;
 
+    /// Reads data previously stored with saveCache, or returns an empty string.
+    /// Cached data may disappear at any time and should be validated before use.
+    virtual const std::string & loadCache(const std::string &) = 0;
+    /// Stores data that may speed up later runs, errors are ignored
+    virtual void                saveCache(const std::string &, const std::string &) = 0;
+
     virtual void                log(logging::level_t, const char *) = 0;
 
+    /// Sets whether effect wants context changes that do not activate it, which
+    /// is the default. Unsubscribing lets frequent changes, such as window titles,
+    /// skip the effect entirely.
+    virtual void                subscribeContext(bool) = 0;
+
 protected:
     EffectService() = default;
 };
@@ -29,9 +29,18 @@ extern "C" {
 
 /****************************************************************************/
 
+/// Identifies keyleds modules and the layout of module_definition. Modules built
+/// before interface_version was added carry a different signature.
 #define KEYLEDSD_MODULE_SIGNATURE \
-    0xa7, 0x96, 0x85, 0xd4, 0xa9, 0x0c, 0x11, 0xe7, \
-    0x98, 0x22, 0x28, 0xb2, 0xbd, 0x4c, 0xbb, 0xe3
+    0x74, 0xef, 0x1d, 0x99, 0x2f, 0x75, 0x4d, 0x50, \
+    0x92, 0x5e, 0xcf, 0xb3, 0x15, 0x29, 0x5b, 0x30
+
+/// Version of the plugin interfaces in keyledsd/plugin/interfaces.h. It must be
+/// bumped on any change that breaks plugins built against the previous version,
+/// such as adding, removing, reordering or changing the signature of a virtual method.
+///  - 2: timestamped handleKeyEvent, Renderer::idle, EffectService::loadCache,
+///       EffectService::saveCache and EffectService::subscribeContext
+#define KEYLEDSD_PLUGIN_INTERFACE_VERSION 2
 
 /// Presents the module some details about the keyleds engine
 struct host_definition
@@ -46,6 +55,7 @@ struct module_definition
 {
     uint8_t     signature[16];          ///< A copy of KEYLEDSD_MODULE_SIGNATURE
     uint32_t    abi_version;            ///< A copy of KEYLEDSD_ABI_VERSION
+    uint32_t    interface_version;      ///< A copy of KEYLEDSD_PLUGIN_INTERFACE_VERSION
     uint16_t    major;                  ///< Keyleds engine version module was compiled against, major
     uint16_t    minor;                  ///< Keyleds engine version module was compiled against, minor
 
@@ -66,7 +76,8 @@ struct module_definition
 #define KEYLEDSD_DEFINE_MODULE(initialize_fn, shutdown_fn) \
     const struct module_definition keyledsd_module = { \
         { KEYLEDSD_MODULE_SIGNATURE }, \
-        KEYLEDSD_ABI_VERSION, KEYLEDSD_VERSION_MAJOR, KEYLEDSD_VERSION_MINOR, \
+        KEYLEDSD_ABI_VERSION, KEYLEDSD_PLUGIN_INTERFACE_VERSION, \
+        KEYLEDSD_VERSION_MAJOR, KEYLEDSD_VERSION_MINOR, \
         initialize_fn, shutdown_fn \
     }
 
@@ -22,6 +22,7 @@
 
 #include "keyledsd/colors.h"
 #include <iosfwd>
+#include <optional>
 #include <regex>
 #include <string>
 #include <utility>
@@ -69,6 +70,16 @@ struct Configuration final
 
 std::string getDeviceName(const Configuration & config, const std::string & serial);
 
+/// Tells whether effects see the same global settings under both configurations,
+/// that is, the same global key groups and custom colors
+bool sameEffectEnvironment(const Configuration &, const Configuration &);
+
+/// Pairs effects of two versions of an effect group. For each effect of the
+/// second, gives the index of an identical effect in the first that it can
+/// take over from. Nothing matches if group's key groups changed.
+std::vector<std::optional<std::size_t>>
+matchEffects(const Configuration::EffectGroup & from, const Configuration::EffectGroup & to);
+
 /****************************************************************************/
 
 /** EffectGroup configuration
@@ -110,9 +121,22 @@ public:
     /// Filters a context to determine whether a profile should be enabled
     class Lookup final
     {
-        struct Entry;
-        using entry_list = std::vector<Entry>;
         using string_map = std::vector<std::pair<std::string, std::string>>;
+    public:
+        struct Entry final
+        {
+            /// How value is matched. Simple patterns skip the regex engine
+            enum class Kind { Exact, Prefix, Suffix, Contains, Regex };
+
+            std::string key;        ///< context entry key
+            std::string value;      ///< string representation of the regex
+            std::regex  regex;      ///< regex to match context entry value against
+            Kind        kind;       ///< how to match, equivalent to using regex
+            std::string text;       ///< literal part of value, unless kind is Regex
+
+            bool        matches(const std::string &) const;
+        };
+        using entry_list = std::vector<Entry>;
     public:
                             Lookup() = default;
         explicit            Lookup(string_map filters);
@@ -121,6 +145,7 @@ public:
                             ~Lookup();
 
         bool                match(const string_map &) const;
+        const entry_list &  entries() const noexcept { return m_entries; }
     private:
         static entry_list   buildRegexps(string_map);
     private:
@@ -155,6 +180,18 @@ struct Configuration::Effect final
 
 /****************************************************************************/
 
+inline bool operator==(const Configuration::KeyGroup & a, const Configuration::KeyGroup & b)
+ { return a.name == b.name && a.keys == b.keys; }
+inline bool operator!=(const Configuration::KeyGroup & a, const Configuration::KeyGroup & b)
+ { return !(a == b); }
+
+inline bool operator==(const Configuration::Effect & a, const Configuration::Effect & b)
+ { return a.name == b.name && a.items == b.items; }
+inline bool operator!=(const Configuration::Effect & a, const Configuration::Effect & b)
+ { return !(a == b); }
+
+/****************************************************************************/
+
 } // namespace keyleds::service
 
 #endif
@@ -0,0 +1,112 @@
+/* Keyleds -- Gaming keyboard tool
+ * Copyright (C) 2017 Julien Hartmann, juli1.hartmann@gmail.com
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+#ifndef KEYLEDSD_SERVICE_CONTEXT_H_9B1E04C7
+#define KEYLEDSD_SERVICE_CONTEXT_H_9B1E04C7
+#ifndef KEYLEDSD_INTERNAL
+#   error "Internal header - must not be pulled into plugins"
+#endif
+
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <string_view>
+#include <utility>
+#include <vector>
+
+namespace keyleds::service {
+
+/****************************************************************************/
+
+/** Interned context
+ *
+ * Context keys are interned into small integer identifiers, shared by all
+ * contexts in the process. Values are stored along with their hash, and the
+ * hash of the whole context is maintained as it changes, so comparing and
+ * hashing contexts rarely touches string contents.
+ *
+ * Merging new values yields the list of keys whose value actually changed,
+ * letting consumers skip work when they do not depend on them.
+ *
+ * Entries are sorted on key identifier for lookups, but remember when they
+ * were added, so toMap lists them in insertion order, as plugins saw them
+ * before interning.
+ *
+ * Interning is not thread-safe. Contexts are built on the main thread.
+ */
+class Context final
+{
+public:
+    using key_type = std::uint32_t;
+    using key_list = std::vector<key_type>;     ///< Sorted list of keys
+    using string_map = std::vector<std::pair<std::string, std::string>>;
+
+    struct Entry final
+    {
+        key_type    key;
+        std::size_t hash;       ///< Hash of value
+        std::string value;
+        std::size_t order;      ///< Insertion sequence number, for toMap
+    };
+    using entry_list = std::vector<Entry>;      ///< Sorted on key
+
+public:
+    /// Returns the identifier of given key, allocating one if needed
+    static key_type             intern(std::string_view);
+    /// Returns the name of an interned key
+    static const std::string &  keyName(key_type);
+
+                        Context() = default;
+    explicit            Context(const string_map &);
+
+    /// Sets given values. Empty values remove their key. Returns changed keys.
+    key_list            merge(const string_map &);
+
+    /// Returns value for key, or nullptr if it is not set
+    const std::string * find(key_type) const;
+    /// Returns value for key, or an empty string if it is not set
+    const std::string & operator[](key_type) const;
+
+    const entry_list &  entries() const noexcept { return m_entries; }
+    bool                empty() const noexcept { return m_entries.empty(); }
+    std::size_t         size() const noexcept { return m_entries.size(); }
+    std::size_t         hash() const noexcept { return m_hash; }
+
+    /// Returns a list of all keys, for consumers that need to assume everything changed
+    key_list            keys() const;
+    /// Converts back to a list of string pairs, as passed to plugins, in insertion order
+    string_map          toMap() const;
+
+    bool                operator==(const Context &) const;
+    bool                operator!=(const Context & other) const { return !(*this == other); }
+
+private:
+    static std::size_t  entryHash(const Entry &) noexcept;
+
+private:
+    entry_list          m_entries;
+    std::size_t         m_hash = 0;     ///< Sum of entry hashes, independent of order
+    std::size_t         m_nextOrder = 0; ///< Sequence number of next inserted entry
+};
+
+/// Tells whether two sorted key lists have any key in common
+bool intersects(const Context::key_list &, const Context::key_list &);
+
+/****************************************************************************/
+
+} // namespace keyleds::service
+
+#endif
@@ -21,11 +21,15 @@
 #endif
 
 #include "keyledsd/service/Configuration.h"
+#include "keyledsd/service/Context.h"
 #include "keyledsd/service/EffectManager.h"
+#include "keyledsd/service/ProfileMatcher.h"
 #include "keyledsd/service/RenderLoop.h"
 #include "keyledsd/tools/FileWatcher.h"
 #include "keyledsd/KeyDatabase.h"
+#include <chrono>
 #include <memory>
+#include <optional>
 #include <string>
 #include <utility>
 #include <vector>
@@ -35,14 +39,24 @@ namespace keyleds::tools::device { class Description; }
 
 namespace keyleds::service {
 
+class EffectService;
+
 /****************************************************************************/
 
 namespace detail {
+    /// An effect instance, along with what is needed to carry it over to a new configuration
+    struct LoadedEffect final
+    {
+        std::size_t                 index;      ///< Position of effect's configuration in its group
+        EffectManager::effect_ptr   effect;
+        EffectService *             service;    ///< Effect's service, owned by effect's deleter
+    };
+
     /// An effect group, fully loaded with effects
     struct EffectGroup final
     {
-        std::string                             name;
-        std::vector<EffectManager::effect_ptr>  effects;
+        std::string                 name;
+        std::vector<LoadedEffect>   effects;
     };
 }
 
@@ -61,6 +75,7 @@ class DeviceManager final
     using string_map = std::vector<std::pair<std::string, std::string>>;
 public:
     using dev_list = std::vector<std::string>;
+    using time_point = std::chrono::steady_clock::time_point;
 public:
                             DeviceManager(EffectManager &, FileWatcher &,
                                           const tools::device::Description &,
@@ -79,23 +94,42 @@ public:
 
 public:
     void                    setConfiguration(const Configuration *);
-    void                    setContext(const string_map &);
+    /// Selects effects for context and notifies them
+    void                    setContext(const Context &);
+    /// Same as setContext, knowing only given keys changed since previous call
+    void                    updateContext(const Context &, const Context::key_list & changed);
     void                    handleFileEvent(FileWatcher::Event, uint32_t, const std::string &);
     void                    handleGenericEvent(const string_map &);
-    void                    handleKeyEvent(int, bool);
+    /// Passes key event to active effects. Time is when it happened, on steady_clock
+    void                    handleKeyEvent(int, bool, time_point);
     void                    setPaused(bool);
     void                    forceRefresh() { m_renderLoop.forceRefresh(); }
 
 private:
     /// Loads the list of effects to activate for the given context
-    std::vector<Effect *>   loadEffects(const string_map & context);
+    std::vector<Effect *>   loadEffects(const Context & context);
+
+    /// Lists active effects that want context changes while active
+    std::vector<Effect *>   contextSubscribers() const;
 
     /// Instanciates an effect, combining its configuration with this device's info
     const detail::EffectGroup & getEffectGroup(const Configuration::EffectGroup &);
 
+    /// Builds the list of key groups visible to effects of a group
+    std::vector<KeyDatabase::KeyGroup> makeKeyGroups(const Configuration::EffectGroup &) const;
+
+    /// Instanciates the effect at given position in its group
+    std::optional<detail::LoadedEffect> createEffect(const Configuration::EffectGroup &, std::size_t,
+                                                     const std::vector<KeyDatabase::KeyGroup> &);
+
+    /// Carries loaded effects of a group over to current configuration, from previous one
+    std::optional<detail::EffectGroup> updateEffectGroup(detail::EffectGroup &,
+                                                         const Configuration & previous);
+
 private:
     EffectManager &         m_effectManager;    ///< Manages the lifecycle of effects
     const Configuration *   m_configuration;    ///< Reference to service configuration
+    ProfileMatcher          m_profiles;         ///< Compiled profiles for this device
 
     const std::string       m_sysPath;          ///< Device path on sys filesystem
     const std::string       m_serial;           ///< Device serial number
@@ -109,6 +143,7 @@ private:
     std::vector<detail::EffectGroup> m_effectGroups;    ///< Loaded effect group instances
     RenderLoop              m_renderLoop;       ///< The RenderLoop in charge of the device
     std::vector<Effect *>   m_activeEffects;    ///< Effects currently active on m_renderLoop
+    const Configuration::Profile * m_activeProfile = nullptr; ///< Profile m_activeEffects come from
 };
 
 /****************************************************************************/
@@ -20,7 +20,10 @@
 #   error "Internal header - must not be pulled into plugins"
 #endif
 
+#include <cstddef>
+#include <optional>
 #include <string>
+#include <utility>
 #include <vector>
 
 namespace keyleds { class KeyDatabase; }
@@ -37,6 +40,47 @@ std::vector<std::string> findEventDevices(const tools::device::Description & des
 std::string getSerial(const tools::device::Description & description);
 KeyDatabase setupKeyDatabase(device::Device & device);
 
+/** Builds the effect list of a group for a new configuration
+ *
+ * For each new position, the entry of previous whose index is given in matches
+ * is moved to the result, re-indexed and passed to keep. Positions without a
+ * match, or whose entry is gone, get whatever create returns, if anything.
+ * Entries are located before any of them is moved or re-indexed, so that
+ * reordering never picks up a moved-from entry.
+ */
+template <typename T, typename Keep, typename Create>
+std::vector<T> carryOverEffects(std::vector<T> & previous,
+                                const std::vector<std::optional<std::size_t>> & matches,
+                                Keep && keep, Create && create)
+{
+    // Position of each live entry in previous, by its index in previous configuration
+    auto positions = std::vector<std::optional<std::size_t>>();
+    for (std::size_t pos = 0; pos < previous.size(); ++pos) {
+        if (!previous[pos].effect) { continue; }
+        const auto index = previous[pos].index;
+        if (index >= positions.size()) { positions.resize(index + 1); }
+        positions[index] = pos;
+    }
+
+    std::vector<T> result;
+    for (std::size_t idx = 0; idx < matches.size(); ++idx) {
+        std::optional<std::size_t> pos;
+        if (matches[idx] && *matches[idx] < positions.size()) {
+            pos = std::exchange(positions[*matches[idx]], std::nullopt);
+        }
+        if (pos) {
+            auto entry = std::move(previous[*pos]);
+            entry.index = idx;
+            keep(entry);
+            result.push_back(std::move(entry));
+        } else {
+            auto created = create(idx);
+            if (created) { result.push_back(std::move(*created)); }
+        }
+    }
+    return result;
+}
+
 } // namespace keyleds::service
 
 #endif
@@ -0,0 +1,55 @@
+/* Keyleds -- Gaming keyboard tool
+ * Copyright (C) 2017 Julien Hartmann, juli1.hartmann@gmail.com
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+#ifndef KEYLEDSD_SERVICE_DEVICESTATE_H_5A3F81C2
+#define KEYLEDSD_SERVICE_DEVICESTATE_H_5A3F81C2
+#ifndef KEYLEDSD_INTERNAL
+#   error "Internal header - must not be pulled into plugins"
+#endif
+
+#include "keyledsd/RenderTarget.h"
+#include <optional>
+#include <string>
+#include <string_view>
+
+namespace keyleds::service {
+
+/****************************************************************************/
+// Persisted device state
+//
+// The last frame sent to a device is saved when its manager goes away, and
+// replayed as soon as the device is opened again, so it shows the right colors
+// while effects are still loading. It lives in the cache directory: losing it
+// only costs a moment of stale colors.
+
+/// Serializes a frame, one RGBA quadruplet per key
+std::string                 encodeDeviceState(const RenderTarget &);
+
+/// Parses a serialized frame. Returns nothing if data is corrupt or does not
+/// have the expected number of keys, which happens when layout changed.
+std::optional<RenderTarget> decodeDeviceState(std::string_view, RenderTarget::size_type keyCount);
+
+/// Reads persisted frame of device with given serial, if any
+std::optional<RenderTarget> loadDeviceState(const std::string & serial, RenderTarget::size_type keyCount);
+
+/// Persists frame of device with given serial, errors are ignored
+void                        saveDeviceState(const std::string & serial, const RenderTarget &);
+
+/****************************************************************************/
+
+} // namespace keyleds::service
+
+#endif
@@ -20,6 +20,7 @@
 #   error "Internal header - must not be pulled into plugins"
 #endif
 
+#include "keyledsd/service/KeyEventRouter.h"
 #include "keyledsd/tools/Event.h"
 #include "keyledsd/tools/XContextWatcher.h"
 #include "keyledsd/tools/XInputWatcher.h"
@@ -28,6 +29,9 @@
 #include <utility>
 #include <vector>
 
+struct uv_timer_s;
+using uv_timer_t = struct uv_timer_s;
+
 namespace keyleds::tools::xlib {
     class Display;
     class XInputWatcher;
@@ -35,11 +39,22 @@ namespace keyleds::tools::xlib {
 
 namespace keyleds::service {
 
+class DeviceManager;
+
 /****************************************************************************/
 
 /** Main display manager
  *
  * Centralizes all operations and information for a specific display.
+ *
+ * Key events are delivered straight to the DeviceManager owning the input
+ * device they come from. Device managers must be registered with the display
+ * for this to happen, and unregistered before they are destroyed.
+ *
+ * Context changes that only affect the window title are coalesced: some
+ * applications retitle their window many times per second, so those are
+ * delayed by up to titleDelay and only the latest context is sent. Any
+ * other change is sent immediately, along with pending title changes.
  */
 class DisplayManager final
 {
@@ -47,6 +62,8 @@ class DisplayManager final
     using XContextWatcher = tools::xlib::XContextWatcher;
     using XInputWatcher = tools::xlib::XInputWatcher;
     using context_map = std::vector<std::pair<std::string, std::string>>;
+public:
+    static constexpr unsigned titleDelay = 100;     ///< Coalescing window, in milliseconds
 public:
                     DisplayManager(std::unique_ptr<Display>, uv_loop_t &);
                     ~DisplayManager();
@@ -56,16 +73,22 @@ public:
     void            scanDevices();
     const context_map & currentContext() const { return m_context; }
 
+    void            addDeviceManager(DeviceManager &);
+    void            removeDeviceManager(const DeviceManager &);
+
     // signals
     tools::Callback<const context_map &>            contextChanged;
-    tools::Callback<const std::string &, int, bool> keyEventReceived;
 
 private:
     /// Receives notifications from m_contextWatcher. Forwards them through contextChanged signal.
     void            onContextChanged(const XContextWatcher::context_map &);
 
-    /// Receives notifications from m_inputWatcher. Forwards them through keyEventReceived signal.
-    void            onKeyEventReceived(const std::string & devNode, int key, bool press);
+    /// Sends pending context through contextChanged signal
+    void            flushContext();
+
+    /// Receives notifications from m_inputWatcher. Forwards them to the device's manager.
+    void            onKeyEventReceived(int deviceId, int key, bool press,
+                                       XInputWatcher::time_point);
 
 private:
     std::unique_ptr<Display>    m_display;          ///< Connection to X display
@@ -73,6 +96,8 @@ private:
     XInputWatcher               m_inputWatcher;     ///< Watches keypresses
     tools::FDWatcher            m_fdWatcher;        ///< Monitors display socket
     context_map                 m_context;          ///< Current context values
+    std::unique_ptr<uv_timer_t> m_titleTimer;       ///< Pending title change, if active
+    KeyEventRouter<DeviceManager> m_keyRouter;      ///< Xinput device to manager map
 };
 
 /****************************************************************************/
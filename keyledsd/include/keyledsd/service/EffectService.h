@@ -41,6 +41,10 @@ public:
                   const Configuration::Effect &, std::vector<KeyGroup>);
     ~EffectService() override;
 
+    /// Points the service at an equivalent configuration, when carrying
+    /// its effect over to a new configuration
+    void                setConfiguration(const Configuration &, const Configuration::Effect &);
+
     const std::string & deviceName() const override;
     const std::string & deviceModel() const override;
     const std::string & deviceSerial() const override;
@@ -55,16 +59,22 @@ public:
     void                destroyRenderTarget(RenderTarget *) override;
 
     const std::string & getFile(const std::string &) override;
+    const std::string & loadCache(const std::string &) override;
+    void                saveCache(const std::string &, const std::string &) override;
 
     void                log(logging::level_t, const char * msg) override;
 
+    void                subscribeContext(bool) override;
+    bool                contextSubscribed() const noexcept { return m_contextSubscribed; }
+
 private:
     const DeviceManager &                       m_manager;
-    const Configuration &                       m_configuration;
-    const Configuration::Effect &               m_effectConfiguration;
+    const Configuration *                       m_configuration;
+    const Configuration::Effect *               m_effectConfiguration;
     const std::vector<KeyGroup>                 m_keyGroups;
     std::vector<std::unique_ptr<RenderTarget>>  m_renderTargets;
     std::string                                 m_fileData;
+    bool                                        m_contextSubscribed = true;
 };
 
 /****************************************************************************/
@@ -0,0 +1,87 @@
+/* Keyleds -- Gaming keyboard tool
+ * Copyright (C) 2017 Julien Hartmann, juli1.hartmann@gmail.com
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+#ifndef KEYLEDSD_SERVICE_IDLEMONITOR_H_0C7E52B9
+#define KEYLEDSD_SERVICE_IDLEMONITOR_H_0C7E52B9
+#ifndef KEYLEDSD_INTERNAL
+#   error "Internal header - must not be pulled into plugins"
+#endif
+
+#include <cassert>
+#include <chrono>
+#include <cstddef>
+#include <optional>
+
+namespace keyleds::service {
+
+/****************************************************************************/
+
+/** Device presence tracker
+ *
+ * Counts attached devices and tells when the service has gone without any
+ * for longer than a timeout, so it can exit when started on demand. It has
+ * no timer of its own: the owner arms one on deadline(). A zero timeout
+ * disables it.
+ */
+class IdleMonitor final
+{
+public:
+    using clock = std::chrono::steady_clock;
+public:
+    explicit    IdleMonitor(clock::time_point now = clock::now()) : m_idleSince(now) {}
+
+    clock::duration timeout() const { return m_timeout; }
+    std::size_t devices() const { return m_devices; }
+
+    /// Sets timeout, counting from now if no device is attached
+    void        setTimeout(clock::duration timeout, clock::time_point now = clock::now())
+    {
+        m_timeout = timeout;
+        if (m_devices == 0) { m_idleSince = now; }
+    }
+
+    void        deviceAdded() { ++m_devices; }
+
+    void        deviceRemoved(clock::time_point now = clock::now())
+    {
+        assert(m_devices > 0);
+        if (--m_devices == 0) { m_idleSince = now; }
+    }
+
+    /// When service should exit, if no device appears until then
+    std::optional<clock::time_point> deadline() const
+    {
+        if (m_timeout == clock::duration::zero() || m_devices > 0) { return std::nullopt; }
+        return m_idleSince + m_timeout;
+    }
+
+    bool        expired(clock::time_point now = clock::now()) const
+    {
+        const auto when = deadline();
+        return when && now >= *when;
+    }
+
+private:
+    clock::duration     m_timeout = clock::duration::zero();
+    std::size_t         m_devices = 0;
+    clock::time_point   m_idleSince;    ///< When device count last dropped to zero
+};
+
+/****************************************************************************/
+
+} // namespace keyleds::service
+
+#endif
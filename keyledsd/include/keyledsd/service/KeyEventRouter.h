@@ -0,0 +1,138 @@
+/* Keyleds -- Gaming keyboard tool
+ * Copyright (C) 2017 Julien Hartmann, juli1.hartmann@gmail.com
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+#ifndef KEYLEDSD_SERVICE_KEYEVENTROUTER_H_6D2A90F1
+#define KEYLEDSD_SERVICE_KEYEVENTROUTER_H_6D2A90F1
+#ifndef KEYLEDSD_INTERNAL
+#   error "Internal header - must not be pulled into plugins"
+#endif
+
+#include <algorithm>
+#include <cstddef>
+#include <string>
+#include <utility>
+#include <vector>
+
+namespace keyleds::service {
+
+/****************************************************************************/
+
+/** Key event routing table
+ *
+ * Maps input device identifiers, as given by an event source such as XInput,
+ * to the target that handles their key events. Identifiers and targets are
+ * matched on device node when either one is added, so that routing an event
+ * only takes an array lookup.
+ *
+ * Identifiers are expected to be small integers, as table size is that of
+ * the highest one.
+ */
+template <typename Target> class KeyEventRouter final
+{
+public:
+    using id_type = int;
+    using dev_list = std::vector<std::string>;
+public:
+    /// Registers an input device, routing it to the target that owns its node, if any
+    void            addInput(id_type id, std::string devNode);
+    void            removeInput(id_type id);
+
+    /// Registers a target, routing all known inputs on any of its nodes to it
+    void            addTarget(Target & target, dev_list devNodes);
+    void            removeTarget(const Target & target);
+
+    /// Returns target for given input, or nullptr
+    Target *        route(id_type id) const noexcept
+    {
+        return 0 <= id && std::size_t(id) < m_routes.size() ? m_routes[std::size_t(id)] : nullptr;
+    }
+
+private:
+    void            setRoute(id_type id, Target * target);
+
+private:
+    std::vector<std::pair<id_type, std::string>>    m_inputs;   ///< Known input devices
+    std::vector<std::pair<Target *, dev_list>>      m_targets;  ///< Known targets
+    std::vector<Target *>                           m_routes;   ///< Target by input identifier
+};
+
+/****************************************************************************/
+
+template <typename Target>
+void KeyEventRouter<Target>::addInput(id_type id, std::string devNode)
+{
+    if (id < 0) { return; }
+    removeInput(id);
+
+    auto it = std::find_if(m_targets.begin(), m_targets.end(), [&](const auto & target) {
+        return std::find(target.second.begin(), target.second.end(), devNode) != target.second.end();
+    });
+    setRoute(id, it != m_targets.end() ? it->first : nullptr);
+    m_inputs.emplace_back(id, std::move(devNode));
+}
+
+template <typename Target>
+void KeyEventRouter<Target>::removeInput(id_type id)
+{
+    auto it = std::find_if(m_inputs.begin(), m_inputs.end(),
+                           [id](const auto & input) { return input.first == id; });
+    if (it == m_inputs.end()) { return; }
+
+    setRoute(id, nullptr);
+    if (it != m_inputs.end() - 1) { *it = std::move(m_inputs.back()); }
+    m_inputs.pop_back();
+}
+
+template <typename Target>
+void KeyEventRouter<Target>::addTarget(Target & target, dev_list devNodes)
+{
+    removeTarget(target);
+    for (const auto & input : m_inputs) {
+        if (std::find(devNodes.begin(), devNodes.end(), input.second) != devNodes.end()) {
+            setRoute(input.first, &target);
+        }
+    }
+    m_targets.emplace_back(&target, std::move(devNodes));
+}
+
+template <typename Target>
+void KeyEventRouter<Target>::removeTarget(const Target & target)
+{
+    auto it = std::find_if(m_targets.begin(), m_targets.end(),
+                           [&target](const auto & item) { return item.first == &target; });
+    if (it == m_targets.end()) { return; }
+
+    std::replace(m_routes.begin(), m_routes.end(), it->first, static_cast<Target *>(nullptr));
+    if (it != m_targets.end() - 1) { *it = std::move(m_targets.back()); }
+    m_targets.pop_back();
+}
+
+template <typename Target>
+void KeyEventRouter<Target>::setRoute(id_type id, Target * target)
+{
+    const auto index = std::size_t(id);
+    if (index >= m_routes.size()) {
+        if (target == nullptr) { return; }
+        m_routes.resize(index + 1, nullptr);
+    }
+    m_routes[index] = target;
+}
+
+/****************************************************************************/
+
+} // namespace keyleds::service
+
+#endif
@@ -0,0 +1,114 @@
+/* Keyleds -- Gaming keyboard tool
+ * Copyright (C) 2017 Julien Hartmann, juli1.hartmann@gmail.com
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+#ifndef KEYLEDSD_PROFILEMATCHER_H_4C9E27D1
+#define KEYLEDSD_PROFILEMATCHER_H_4C9E27D1
+#ifndef KEYLEDSD_INTERNAL
+#   error "Internal header - must not be pulled into plugins"
+#endif
+
+#include "keyledsd/service/Configuration.h"
+#include "keyledsd/service/Context.h"
+#include <cstddef>
+#include <string>
+#include <unordered_map>
+#include <utility>
+#include <vector>
+
+namespace keyleds::service {
+
+/****************************************************************************/
+
+/** Compiled profile selection
+ *
+ * Selects the profile a device should use for a context, following the same
+ * rules as iterating the configuration's profile list: last matching profile
+ * wins, falling back to the default profile, with the overlay profile always
+ * appended.
+ *
+ * Profiles that do not apply to the device are dropped and effect group names
+ * are resolved once, on construction, and lookup keys are interned. Profiles
+ * with at least one exact-match lookup entry are indexed by that entry's key
+ * and value, so a context only evaluates the lookups of profiles whose exact
+ * entry it matches, plus those of profiles that have none. Results are
+ * memoised per distinct context.
+ *
+ * It holds pointers into the configuration, which must outlive it.
+ */
+class ProfileMatcher final
+{
+    using Profile = Configuration::Profile;
+    using EffectGroup = Configuration::EffectGroup;
+public:
+    struct Result final
+    {
+        const Profile *                     profile = nullptr;  ///< nullptr if none matched
+        std::vector<const EffectGroup *>    effectGroups;       ///< including overlay's
+    };
+    static constexpr std::size_t maxCachedContexts = 64;
+
+public:
+                    ProfileMatcher() = default;
+                    ProfileMatcher(const Configuration &, const std::string & deviceName);
+                    ProfileMatcher(ProfileMatcher &&) noexcept = default;
+    ProfileMatcher & operator=(ProfileMatcher &&) noexcept = default;
+                    ~ProfileMatcher();
+
+    /// Returns selection for context. Reference is valid until next call
+    const Result &  match(const Context & context);
+
+    /// Tells whether selection may differ after given keys changed
+    bool            dependsOn(const Context::key_list & keys) const
+                    { return intersects(m_keys, keys); }
+
+private:
+    using LookupEntry = Profile::Lookup::Entry;
+    struct Candidate final
+    {
+        const Profile *                     profile = nullptr;
+        std::vector<const EffectGroup *>    effectGroups;
+        std::vector<std::pair<Context::key_type, const LookupEntry *>> lookup;
+
+        bool matches(const Context &) const;
+    };
+    using index_list = std::vector<std::size_t>;
+    using value_index = std::unordered_map<std::string, index_list>;
+
+    struct ContextHash final
+    {
+        std::size_t operator()(const Context & context) const noexcept { return context.hash(); }
+    };
+
+    const Candidate * select(const Context & context) const;
+    Result          makeResult(const Candidate *) const;
+    static Candidate makeCandidate(const Configuration &, const Profile &);
+
+private:
+    std::vector<Candidate>  m_candidates;   ///< Device's profiles, in configuration order
+    std::vector<std::pair<Context::key_type, value_index>> m_index; ///< Candidates by exact entry
+    index_list              m_unindexed;    ///< Candidates without exact entries
+    Context::key_list       m_keys;         ///< Keys looked up by any candidate, sorted
+    Candidate               m_default = {};  ///< Default profile, if profile is set
+    Candidate               m_overlay = {};  ///< Overlay profile, if profile is set
+
+    std::unordered_map<Context, Result, ContextHash> m_cache;  ///< Memoised results
+};
+
+/****************************************************************************/
+
+} // namespace keyleds::service
+
+#endif
@@ -23,9 +23,11 @@
 #include "keyledsd/device/Device.h"
 #include "keyledsd/tools/AnimationLoop.h"
 #include "keyledsd/RenderTarget.h"
+#include <array>
 #include <atomic>
 #include <chrono>
 #include <mutex>
+#include <optional>
 #include <vector>
 
 namespace keyleds::service {
@@ -47,6 +49,8 @@ public:
     ~RenderLoop() override;
 
     void                forceRefresh() { m_forceRefresh.store(true, std::memory_order_relaxed); }
+    /// Number of entries in frames sent to the device
+    RenderTarget::size_type keyCount() const { return m_state.size(); }
 
     /// Returns a lock that bars the render loop from using renderers while it is held
     /// Holding it is mandatory for modifying any renderer or the list itself
@@ -58,28 +62,47 @@ public:
     /// calling their render method.
     renderer_list &     renderers() { return m_renderers; }
 
+    /// Frame to send to the device as soon as loop starts, before any renderer runs.
+    /// Must be called before start.
+    void                setInitialState(std::optional<RenderTarget>);
+    /// Last frame the device is known to display, or null if it was never read.
+    /// Must not be called while loop is running.
+    const RenderTarget * state() const { return m_stateKnown ? &m_state : nullptr; }
+
 private:
     bool                render(milliseconds) override;
+    void                idle(clock::time_point deadline) override;
     void                run() override;
 
     /// Reads current device led state into the render target
     void                getDeviceState(RenderTarget & state);
+    /// Sends keys that differ between m_state and target to the device, and commits
+    void                sendChanges(const RenderTarget & target, bool force);
+    /// Records how long a frame took, logging percentiles once enough are recorded
+    void                recordFrameTime(clock::duration);
 
 private:
     device::Device &    m_device;               ///< The device to render to
     renderer_list       m_renderers;            ///< Current list of renderers (unowned)
     std::mutex          m_mRenderers;           ///< Controls access to m_renderers
+    renderer_list       m_idleRenderers;        ///< Snapshot of m_renderers idle() works through
 
     clock::time_point   m_lastErrorTime;        ///< When did last I/O error occur?
     std::chrono::microseconds   m_commitDelay;  ///< Wait that amount between sending and committing
     std::atomic<bool>   m_forceRefresh;         ///< Force one-time full refresh at next render
+    bool                m_traceFirstFrame;      ///< Startup trace awaits our first frame
 
     RenderTarget        m_state;                ///< Current state of the device
+    bool                m_stateKnown = false;   ///< Whether m_state was read from the device
+    std::optional<RenderTarget> m_initialState; ///< Sent once on startup, then cleared
     RenderTarget        m_buffer;               ///< Buffer to render into, avoids re-creating it
                                                 ///  on every render
     std::vector<device::Device::ColorDirective> m_directives;
                                                 ///< Buffer of directives, avoids new/delete on
                                                 ///< every render
+    std::array<std::chrono::microseconds, 256> m_frameTimes;
+                                                ///< Durations of last frames, for statistics
+    std::size_t         m_frameTimeCount = 0;   ///< Number of valid entries in m_frameTimes
 };
 
 /****************************************************************************/
@@ -23,13 +23,20 @@
 #include "keyledsd/device/Device.h"
 #include "keyledsd/device/Logitech.h"
 #include "keyledsd/service/Configuration.h"
+#include "keyledsd/service/Context.h"
+#include "keyledsd/service/IdleMonitor.h"
 #include "keyledsd/tools/DeviceWatcher.h"
 #include "keyledsd/tools/Event.h"
 #include "keyledsd/tools/FileWatcher.h"
+#include <chrono>
 #include <memory>
 #include <string>
 #include <vector>
 
+struct uv_timer_s;
+using uv_timer_t = struct uv_timer_s;
+
+namespace keyleds::tools { class EvdevWatcher; }
 namespace keyleds::tools::xlib { class Display; }
 
 namespace keyleds::service {
@@ -54,6 +61,12 @@ class Service final
 
     using device_list = std::vector<std::unique_ptr<DeviceManager>>;
     using display_list = std::vector<std::unique_ptr<DisplayManager>>;
+    struct KeySource
+    {
+        const DeviceManager *                   manager;
+        std::unique_ptr<tools::EvdevWatcher>    watcher;
+    };
+    using key_source_list = std::vector<KeySource>;
 public:
                         Service(EffectManager &, FileWatcher &,
                                 Configuration, uv_loop_t & loop);
@@ -64,16 +77,19 @@ public:
     const EffectManager & effectManager() const { return m_effectManager; }
     const Configuration & configuration() const { return m_configuration; }
     bool                autoQuit() const { return m_autoQuit; }
-    const string_map &  context() const { return m_context; }
+    bool                evdevKeys() const { return m_evdevKeys; }
+    IdleMonitor::clock::duration idleTimeout() const { return m_idle.timeout(); }
+    const Context &     context() const { return m_context; }
     const device_list & devices() const { return m_devices; }
 
     void                addDisplay(std::unique_ptr<tools::xlib::Display>);
 
     void                setConfiguration(Configuration);
     void                setAutoQuit(bool);
+    void                setEvdevKeys(bool);     ///< read keys from event devices instead of displays
+    void                setIdleTimeout(std::chrono::seconds); ///< exit after that long without devices, 0 to disable
     void                setContext(const string_map &);
     void                handleGenericEvent(const string_map &);
-    void                handleKeyEvent(const std::string &, int, bool);
     void                forceRefreshDevices();
 
     // signals
@@ -87,16 +103,25 @@ private:
     void                onConfigurationFileChanged(FileWatcher::Event);
     void                onDeviceAdded(const tools::device::Description &);
     void                onDeviceRemoved(const tools::device::Description &);
+
+    void                addKeySource(DeviceManager &);
+    void                removeKeySource(const DeviceManager &);
+    void                updateIdleTimer();
 private:
     EffectManager &     m_effectManager;    ///< Controls lifecycle of effects (injected)
     FileWatcher &       m_fileWatcher;      ///< Connection to inotify
     Configuration       m_configuration;
     uv_loop_t &         m_loop;             ///< Event loop
     bool                m_autoQuit = false; ///< Quit when last device is removed?
+    bool                m_evdevKeys = false; ///< Bypass displays for key events?
 
-    string_map          m_context;          ///< Current context. Used when instanciating new managers
+    Context             m_context;          ///< Current context. Used when instanciating new managers
     device_list         m_devices;          ///< Map of serial number to DeviceManager instances
     display_list        m_displays;         ///< Connections to X displays
+    key_source_list     m_keySources;       ///< Event device readers, when m_evdevKeys is set
+    IdleMonitor         m_idle;             ///< Tracks time without devices, for on-demand mode
+    std::unique_ptr<uv_timer_t> m_idleTimer; ///< Fires when m_idle deadline is reached
+    std::unique_ptr<uv_timer_t> m_memoryTimer; ///< Periodically logs memory use
 
     DeviceWatcher       m_deviceWatcher;    ///< Connection to libudev
     FileWatcher::subscription m_fileWatcherSub; ///< Notifications for conf change
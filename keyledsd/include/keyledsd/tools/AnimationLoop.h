@@ -58,6 +58,7 @@ public:
 protected:
     virtual void    run();
     virtual bool    render(milliseconds) = 0;
+    virtual void    idle(clock::time_point /* deadline */) {} ///< called with time left after render
 
 private:
     /// Simply calls the animation loop's run method
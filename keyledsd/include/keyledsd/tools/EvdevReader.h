@@ -0,0 +1,74 @@
+/* Keyleds -- Gaming keyboard tool
+ * Copyright (C) 2017 Julien Hartmann, juli1.hartmann@gmail.com
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+#ifndef TOOLS_EVDEVREADER_H_2C9A7E13
+#define TOOLS_EVDEVREADER_H_2C9A7E13
+
+#include "keyledsd/tools/Event.h"
+#include <chrono>
+#include <cstddef>
+#include <string>
+
+namespace keyleds::tools {
+
+/****************************************************************************/
+
+/** Kernel event device reader
+ *
+ * Decodes key events from a Linux evdev node, or from any file holding
+ * recorded input_event structures. It does no polling on its own: the owner
+ * calls readAll() whenever the descriptor becomes readable.
+ *
+ * Device nodes are switched to CLOCK_MONOTONIC, which steady_clock uses too,
+ * so event times need no conversion. Recorded files keep their own times.
+ */
+class EvdevReader final
+{
+public:
+    using time_point = std::chrono::steady_clock::time_point;
+    static constexpr std::size_t batchSize = 64;    ///< events fetched per read call
+public:
+    explicit        EvdevReader(int fd) noexcept;   ///< takes ownership of fd
+                    EvdevReader(EvdevReader &&) noexcept;
+    EvdevReader &   operator=(EvdevReader &&) noexcept;
+                    ~EvdevReader();
+
+    /// Opens given path in non-blocking mode, throws std::system_error on failure
+    static EvdevReader open(const std::string & path);
+
+    int             fd() const { return m_fd; }
+
+    /// Reads and decodes all events currently available, emitting keyEventReceived
+    /// for every key press and release. Auto-repeat events are dropped.
+    /// @return false once the device is gone or the file is exhausted
+    bool            readAll();
+
+    // signals
+    /// Emitted for every key event read
+    /// @param key the key code, as sent by the kernel device
+    /// @param pressed true if this indicates a keypress, otherwise it's a key release
+    /// @param time when the kernel recorded the event
+    Callback<int, bool, time_point> keyEventReceived;
+
+private:
+    int             m_fd;
+};
+
+/****************************************************************************/
+
+} // namespace keyleds::tools
+
+#endif
@@ -0,0 +1,70 @@
+/* Keyleds -- Gaming keyboard tool
+ * Copyright (C) 2017 Julien Hartmann, juli1.hartmann@gmail.com
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+#ifndef TOOLS_EVDEVWATCHER_H_6B0D43F8
+#define TOOLS_EVDEVWATCHER_H_6B0D43F8
+
+#include "keyledsd/tools/EvdevReader.h"
+#include "keyledsd/tools/Event.h"
+#include <memory>
+#include <string>
+#include <vector>
+
+namespace keyleds::tools {
+
+/****************************************************************************/
+
+/** Evdev - key events watcher
+ *
+ * Reads key events straight from the kernel event devices of a keyboard,
+ * without going through a display server. Nodes that cannot be opened,
+ * typically for lack of permission, are logged and skipped. Non-evdev input
+ * nodes, such as legacy mouse devices, are ignored.
+ */
+class EvdevWatcher final
+{
+public:
+                    EvdevWatcher(const std::vector<std::string> & devNodes, uv_loop_t &);
+                    EvdevWatcher(const EvdevWatcher &) = delete;
+    EvdevWatcher &  operator=(const EvdevWatcher &) = delete;
+                    ~EvdevWatcher();
+
+    bool            empty() const { return m_inputs.empty(); }
+
+    // signals
+    /// Emitted whenever a key event happens on any watched node
+    /// @param key the key code, as sent by the kernel device
+    /// @param pressed true if this indicates a keypress, otherwise it's a key release
+    /// @param time when the kernel recorded the event, on steady_clock
+    Callback<int, bool, EvdevReader::time_point> keyEventReceived;
+
+private:
+    struct Input
+    {
+        std::string                 devNode;
+        EvdevReader                 reader;
+        std::unique_ptr<FDWatcher>  watcher;
+    };
+    void            onReady(Input &);
+private:
+    std::vector<std::unique_ptr<Input>> m_inputs;
+};
+
+/****************************************************************************/
+
+} // namespace keyleds::tools
+
+#endif
@@ -0,0 +1,100 @@
+/* Keyleds -- Gaming keyboard tool
+ * Copyright (C) 2017 Julien Hartmann, juli1.hartmann@gmail.com
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+#ifndef TOOLS_MEMORYACCOUNTING_H_3F6C2A97
+#define TOOLS_MEMORYACCOUNTING_H_3F6C2A97
+
+#include <atomic>
+#include <cstddef>
+#include <string>
+#include <vector>
+
+namespace keyleds::tools::memory {
+
+/****************************************************************************/
+
+/** Memory use counter for a subsystem
+ *
+ * Subsystems create one static instance each, and report allocations and
+ * releases to it. Counters register themselves on creation, so instances
+ * living in plugins are reported along those of the service, and go away
+ * when the plugin is unloaded. Updates are lock-free and may come from any
+ * thread.
+ *
+ * Several counters may share a name, their values are then added together,
+ * except for peaks: the merged peak is the highest of individual peaks and
+ * current total, a lower bound of the actual combined peak.
+ */
+class Counter final
+{
+public:
+    using size_type = std::size_t;
+public:
+    explicit    Counter(const char * name);
+                Counter(const Counter &) = delete;
+    Counter &   operator=(const Counter &) = delete;
+                ~Counter();
+
+    const char * name() const noexcept { return m_name; }
+    size_type   bytes() const noexcept { return m_bytes.load(std::memory_order_relaxed); }
+    size_type   peak() const noexcept { return m_peak.load(std::memory_order_relaxed); }
+    size_type   blocks() const noexcept { return m_blocks.load(std::memory_order_relaxed); }
+
+    /// Records a new block of given size
+    void        allocated(size_type size) noexcept
+                    { m_blocks.fetch_add(1, std::memory_order_relaxed); add(size); }
+    /// Records the release of a block of given size
+    void        released(size_type size) noexcept
+                    { m_blocks.fetch_sub(1, std::memory_order_relaxed); remove(size); }
+    /// Records a block changing size
+    void        resized(size_type from, size_type to) noexcept
+                    { if (to > from) { add(to - from); } else { remove(from - to); } }
+
+private:
+    void        add(size_type size) noexcept
+    {
+        auto value = m_bytes.fetch_add(size, std::memory_order_relaxed) + size;
+        auto peak = m_peak.load(std::memory_order_relaxed);
+        while (value > peak &&
+               !m_peak.compare_exchange_weak(peak, value, std::memory_order_relaxed)) {}
+    }
+    void        remove(size_type size) noexcept
+                    { m_bytes.fetch_sub(size, std::memory_order_relaxed); }
+
+private:
+    const char *            m_name;         ///< Subsystem name, must be a literal
+    std::atomic<size_type>  m_bytes = 0;    ///< Bytes currently held
+    std::atomic<size_type>  m_peak = 0;     ///< Highest m_bytes so far
+    std::atomic<size_type>  m_blocks = 0;   ///< Number of blocks currently held
+};
+
+/// Snapshot of a subsystem's memory use
+struct Usage final
+{
+    std::string             name;
+    Counter::size_type      bytes;
+    Counter::size_type      peak;
+    Counter::size_type      blocks;
+};
+
+/// Returns memory use of all subsystems, sorted by name
+std::vector<Usage> usage();
+
+/****************************************************************************/
+
+} // namespace keyleds::tools::memory
+
+#endif
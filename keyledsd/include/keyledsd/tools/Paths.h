@@ -26,6 +26,7 @@
 #include <ios>
 #include <optional>
 #include <string>
+#include <string_view>
 #include <type_traits>
 #include <utility>
 #include <vector>
@@ -78,6 +79,10 @@ open_filebuf(XDG type, const std::string &, std::ios::openmode);
 /// files of the given type. Those may differ depending on open mode, thus the extra flag.
 std::vector<std::string> getPaths(XDG type, bool extra);
 
+/// Replaces contents of file at given absolute path, creating missing directories.
+/// Data goes through a temporary file, so readers never see a partial write.
+bool writeFile(const std::string & path, std::string_view data);
+
 
 /// Opens the given file, using the file described by given path and XDG type.
 template <typename T> std::optional<detail::open_file_return<T>>
@@ -0,0 +1,108 @@
+/* Keyleds -- Gaming keyboard tool
+ * Copyright (C) 2017 Julien Hartmann, juli1.hartmann@gmail.com
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+#ifndef TOOLS_STARTUPTRACE_H_D4A07B61
+#define TOOLS_STARTUPTRACE_H_D4A07B61
+
+#include <atomic>
+#include <chrono>
+#include <cstddef>
+#include <iosfwd>
+#include <mutex>
+#include <string>
+#include <string_view>
+#include <vector>
+
+namespace keyleds::tools {
+
+/****************************************************************************/
+
+/** Startup phase recorder
+ *
+ * Collects named time spans while enabled, grouped by scope (typically a
+ * device node). Recording is thread-safe, and costs a single atomic load
+ * while disabled, so probes can stay in place permanently.
+ *
+ * Synchronous phases use the RAII Phase object. Phases that end on another
+ * thread use begin/end; they are counted as pending until they end, which
+ * tells when startup has settled.
+ */
+class StartupTrace final
+{
+public:
+    using clock = std::chrono::steady_clock;
+    struct Span final
+    {
+        std::string         scope;
+        std::string         name;
+        clock::time_point   start;
+        clock::time_point   end;
+    };
+    using span_list = std::vector<Span>;
+
+    class Phase final
+    {
+    public:
+                    Phase(StartupTrace *, std::string_view scope, std::string_view name);
+                    Phase(const Phase &) = delete;
+        Phase &     operator=(const Phase &) = delete;
+                    ~Phase();
+    private:
+        StartupTrace *      m_trace;    ///< null if trace was disabled on creation
+        std::string         m_scope;
+        std::string         m_name;
+        clock::time_point   m_start;
+    };
+private:
+                        StartupTrace() = default;
+public:
+                        StartupTrace(const StartupTrace &) = delete;
+    static StartupTrace & instance();
+
+    bool                enabled() const { return m_enabled.load(std::memory_order_relaxed); }
+    void                start();                ///< Clears recorded data and enables recording
+    void                stop();                 ///< Disables recording, keeping data
+
+    /// Times the lifetime of returned object
+    [[nodiscard]] Phase phase(std::string_view scope, std::string_view name);
+    /// Opens a phase that will be closed by end, possibly from another thread
+    void                begin(std::string_view scope, std::string_view name);
+    /// Closes a phase opened with begin, does nothing if there is none
+    void                end(std::string_view scope, std::string_view name);
+    void                record(std::string_view scope, std::string_view name,
+                               clock::time_point start, clock::time_point end);
+
+    std::size_t         pending() const;        ///< Number of phases opened with begin still running
+    span_list           spans() const;          ///< Completed spans, sorted by start time
+
+    /// Prints a table of spans with their offset from start and their duration
+    void                writeSummary(std::ostream &) const;
+    /// Writes spans in Chrome trace event format, for chrome://tracing or Perfetto
+    void                writeTrace(std::ostream &) const;
+
+private:
+    std::atomic<bool>   m_enabled = false;
+    mutable std::mutex  m_mutex;                ///< Protects all fields below
+    clock::time_point   m_origin;               ///< When start() was called
+    span_list           m_spans;                ///< Completed spans
+    span_list           m_open;                 ///< Spans opened with begin, end not set
+};
+
+/****************************************************************************/
+
+} // namespace keyleds::tools
+
+#endif
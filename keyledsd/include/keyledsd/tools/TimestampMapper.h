@@ -0,0 +1,63 @@
+/* Keyleds -- Gaming keyboard tool
+ * Copyright (C) 2017 Julien Hartmann, juli1.hartmann@gmail.com
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+#ifndef TOOLS_TIMESTAMPMAPPER_H_9E21C5D0
+#define TOOLS_TIMESTAMPMAPPER_H_9E21C5D0
+
+#include <chrono>
+#include <cstdint>
+#include <optional>
+
+namespace keyleds::tools {
+
+/****************************************************************************/
+
+/** Foreign timestamp converter
+ *
+ * Maps millisecond timestamps from another clock, such as X server time, onto
+ * steady_clock. The offset between both clocks is estimated from event arrival
+ * times: the smallest offset seen is the one with least delivery latency. An
+ * offset jumping forward past resyncThreshold, as happens when server time
+ * wraps around, resets the estimate.
+ */
+class TimestampMapper final
+{
+public:
+    using clock = std::chrono::steady_clock;
+    static constexpr auto resyncThreshold = std::chrono::seconds(1);
+public:
+    /// Converts a timestamp, given the time it was received at.
+    /// Result is never later than arrival.
+    clock::time_point   map(std::uint32_t stamp, clock::time_point arrival = clock::now())
+    {
+        const auto offset = arrival.time_since_epoch() - std::chrono::milliseconds(stamp);
+        if (!m_offset || offset < *m_offset || offset > *m_offset + resyncThreshold) {
+            m_offset = offset;
+        }
+        return clock::time_point(*m_offset + std::chrono::milliseconds(stamp));
+    }
+
+    void                reset() { m_offset.reset(); }
+
+private:
+    std::optional<clock::duration>  m_offset;   ///< steady_clock minus foreign clock
+};
+
+/****************************************************************************/
+
+} // namespace keyleds::tools
+
+#endif
@@ -23,6 +23,7 @@
 #undef CursorShape
 #undef Bool
 #include <memory>
+#include <optional>
 #include <utility>
 #include <vector>
 
@@ -37,6 +38,11 @@ namespace keyleds::tools::xlib {
  * and gets updated as the watcher receives events through the X display connection.
  *
  * Every context update generates a contextChanged signal.
+ *
+ * Window properties are fetched asynchronously in batches, and errors caused by
+ * windows disappearing are handled through replies. Event handling only sends
+ * requests, and processReplies() picks up their replies without blocking, so
+ * a window switch costs two round trips and the event loop never waits on them.
  */
 class XContextWatcher final
 {
@@ -50,6 +56,10 @@ public:
 
     const context_map & current() const noexcept { return m_context; }
 
+    /// Handles replies that have arrived for requests sent while handling events.
+    /// Never blocks. Must be invoked after each Display::processEvents() call.
+    void            processReplies();
+
     // signals
     tools::Callback<const context_map &>    contextChanged;
 
@@ -57,12 +67,13 @@ private:
     /// Invoked from the main X display event loop for Xinput events
     virtual void    handleEvent(const XEvent &);
 
-    /// Invoked from handleEvent when it detects the active window has changed
+    /// Invoked from processReplies when it detects the active window has changed
     /// Passed window is the new active window; m_activeWindow still has the old one.
-    /// Both may be nullptr.
+    /// Both may be nullptr. Unless silent, context is updated once the new window's
+    /// properties are loaded.
     virtual void    onActiveWindowChanged(Window *, bool silent);
 
-    /// Builds a context and emit a contextChanged signal for given window
+    /// Builds a context from given window's loaded properties and emits a contextChanged signal
     /// Signal is debounced: if built context is equal to current, signal is not sent.
     void            setContext(Window *);
 
@@ -70,6 +81,7 @@ private:
     Display &               m_display;          ///< X display connection
     Display::subscription   m_displayReg;       ///< callback registration for X events
     std::unique_ptr<Window> m_activeWindow;     ///< Currently active window, or nullptr if none
+    std::optional<PropertyRequest> m_activeRequest; ///< Pending active window query
     context_map             m_context;          ///< Current context
 };
 
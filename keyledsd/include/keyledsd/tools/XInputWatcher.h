@@ -18,6 +18,7 @@
 #define TOOLS_XINPUTWATCHER_H_51CB4EAC
 
 #include "keyledsd/tools/Event.h"
+#include "keyledsd/tools/TimestampMapper.h"
 #include "keyledsd/tools/XWindow.h"
 #include <string>
 #include <vector>
@@ -33,6 +34,8 @@ namespace keyleds::tools::xlib {
 class XInputWatcher final
 {
     using device_list = std::vector<Device>;
+public:
+    using time_point = TimestampMapper::clock::time_point;
 public:
                     XInputWatcher(Display & display);
                     ~XInputWatcher();
@@ -42,11 +45,18 @@ public:
     void            scan();                 ///< Rescans Xinput devices actively
 
     // signals
-    /// Emitted whenever a key event happens on any slave keyboard
-    /// @param devNode the path to kernel device that the event originates from.
+    /// Emitted whenever a slave keyboard is enabled, including by scan
+    /// @param deviceId the Xinput device identifier, as passed to keyEventReceived
+    /// @param devNode the path to kernel device that the keyboard maps to
+    tools::Callback<int, const std::string &>       inputEnabled;
+    /// Emitted whenever a slave keyboard is disabled
+    tools::Callback<int>                            inputDisabled;
+    /// Emitted whenever a key event happens on any enabled slave keyboard
+    /// @param deviceId the Xinput device identifier the event originates from.
     /// @param key the key code, as sent by the kernel device
     /// @param pressed true if this indicates a keypress, otherwise it's a key release
-    tools::Callback<const std::string &, int, bool> keyEventReceived;
+    /// @param time when the event happened, converted from server time to steady_clock
+    tools::Callback<int, int, bool, time_point>     keyEventReceived;
 
 protected:
     /// Invoked from the main X display event loop for Xinput events
@@ -63,6 +73,7 @@ protected:
     Display::subscription m_displayReg; ///< callback registration for X events
     int             m_XIopcode;         ///< XInput extension code
     device_list     m_devices;          ///< List of enabled devices
+    TimestampMapper m_serverTime;       ///< Converts event times to steady_clock
 };
 
 /****************************************************************************/
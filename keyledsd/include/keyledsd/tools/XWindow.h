@@ -25,13 +25,18 @@
 
 #include <X11/Xlib.h>
 #undef Bool
+#include <cstdint>
 #include <functional>
 #include <memory>
+#include <optional>
 #include <stdexcept>
 #include <string>
+#include <unordered_map>
 #include <utility>
 #include <vector>
 
+struct xcb_connection_t;
+
 
 /** Xlib object-oriented wrappers
  *
@@ -50,10 +55,54 @@ using X11Display = ::Display;
 
 /****************************************************************************/
 
+/** Asynchronous window property fetch
+ *
+ * Sends a GetProperty request through XCB on creation, and only waits for the
+ * reply when it is first accessed, so fetches issued back to back complete in
+ * a single round trip. Errors, such as the window having been destroyed in the
+ * meantime, come back with the reply instead of reaching Xlib's error handler,
+ * so trapping them needs no synchronization. A reply that is never accessed is
+ * discarded on destruction. Event-driven code can use poll() instead, which
+ * never blocks.
+ *
+ * @note This class is not thread-safe.
+ */
+class PropertyRequest final
+{
+public:
+                            PropertyRequest(const Display & display, ::Window window,
+                                            Atom atom, Atom type);
+                            PropertyRequest(PropertyRequest &&) noexcept;
+    PropertyRequest &       operator=(PropertyRequest &&) = delete;
+                            ~PropertyRequest();
+
+    const std::string &     value();    ///< Raw property data, empty if not set or on error
+    bool                    failed();   ///< Whether the server replied with an error
+
+    /// Picks up the reply if it has arrived, without blocking. Returns true
+    /// once it has, after which value() and failed() do not block either.
+    bool                    poll();
+
+private:
+    void                    wait();
+    void                    store(void * reply, bool failed);
+
+private:
+    xcb_connection_t *      m_connection;       ///< Connection the request was sent on
+    unsigned int            m_sequence;         ///< Request cookie, valid while m_pending
+    Atom                    m_type;             ///< Expected property type
+    bool                    m_pending = true;   ///< Set until reply is read or discarded
+    bool                    m_failed = false;   ///< Set if reply was an error
+    std::string             m_value;            ///< Property data, once reply is read
+};
+
+/****************************************************************************/
+
 /** X window wrapper
  *
  * Simple wrapper to query information about an X display window.
  * Gives an object interface to Xlib's ::Window handle, but doesn't assume ownership.
+ * Name and class are cached, and refreshed together by update().
  *
  * @note This class is not thread-safe.
  */
@@ -68,25 +117,41 @@ public:
     handle_type             handle() const { return m_window; }
 
     void                    changeAttributes(unsigned long mask, const XSetWindowAttributes & attrs);
-
-    std::string             name() const;
+    /// Selects events to receive for the window. The request is sent on next flush or
+    /// round trip, and errors are discarded, so it never blocks
+    void                    setEventMask(std::uint32_t mask);
+
+    /// Fetches name, and class the first time, in a single round trip.
+    /// Returns false if the window no longer exists.
+    bool                    update();
+
+    /// Same as update(), split for event-driven use: requestUpdate() sends the
+    /// requests, then pollUpdate() returns the result once all replies are in,
+    /// or nothing while some are pending. Requesting again discards pending replies.
+    void                    requestUpdate();
+    std::optional<bool>     pollUpdate();
+    bool                    updatePending() const { return m_nameRequest.has_value(); }
+
+    const std::string &     name() const { return m_name; }     ///< As of last update()
     std::string             iconName() const;
-    const std::string &     className() const
-                                { if (!m_classLoaded) { loadClass(); } return m_className; }
-    const std::string &     instanceName() const
-                                { if (!m_classLoaded) { loadClass(); } return m_instanceName; }
+    const std::string &     className() const { return m_className; }
+    const std::string &     instanceName() const { return m_instanceName; }
 
     std::string             getProperty(Atom atom, Atom type) const;
 
 private:
-    void                    loadClass() const;
+    bool                    finishUpdate();     ///< Reads replies, blocking if needed
 
 private:
     Display &               m_display;          ///< Display the window belongs to
     handle_type             m_window;           ///< Window handle
-    mutable std::string     m_className;        ///< Cached window class name
-    mutable std::string     m_instanceName;     ///< Cached window instance name
-    mutable bool            m_classLoaded = false; ///< Set when caches are loaded
+    std::optional<PropertyRequest> m_netNameRequest;    ///< Pending update, UTF-8 name
+    std::optional<PropertyRequest> m_nameRequest;       ///< Pending update, set while one is
+    std::optional<PropertyRequest> m_classRequest;      ///< Pending update, class names
+    std::string             m_name;             ///< Cached window name
+    std::string             m_className;        ///< Cached window class name
+    std::string             m_instanceName;     ///< Cached window instance name
+    bool                    m_classLoaded = false; ///< Set when class names are loaded
 };
 
 /****************************************************************************/
@@ -136,7 +201,7 @@ private:
 class Display final
 {
     struct HandlerInfo;
-    using atom_map = std::vector<std::pair<std::string, Atom>>;
+    using atom_map = std::unordered_map<std::string, Atom>;
     using handle_type = X11Display *;
     using event_handler = std::function<void(const XEvent &)>;
     using event_type = int;
@@ -169,9 +234,14 @@ public:
     // Properties
     const std::string &     name() const { return m_name; }
     handle_type             handle() const { return m_display.get(); }
+    xcb_connection_t *      xcbConnection() const { return m_connection; }
     Window &                root() { return m_root; }
     const Window &          root() const { return m_root; }
     Atom                    atom(const std::string & name) const;
+    /// Loads given atoms into the cache in a single round trip
+    void                    loadAtoms(const std::vector<std::string> & names) const;
+    /// Sends pending XCB requests to the server without waiting
+    void                    flush();
 
     // Event handling
     int                     connection() const; ///< file descriptor of connection to X server
@@ -179,6 +249,9 @@ public:
     subscription            registerHandler(event_type, event_handler);
 
     std::unique_ptr<Window> getActiveWindow();  ///< Window keypresses currently go into. Might be null.
+    /// Same as getActiveWindow(), split for event-driven use
+    PropertyRequest         requestActiveWindow();
+    std::unique_ptr<Window> activeWindow(PropertyRequest &);
 
 private:
     /// Opens a connection through Xlib to specified display.
@@ -190,9 +263,10 @@ private:
 
 private:
     display_ptr             m_display;          ///< Xlib descriptor for the connection to the server
+    xcb_connection_t *      m_connection;       ///< Same connection, for XCB requests
     std::string             m_name;             ///< Display name, in Xlib format, eg: ":0"
     Window                  m_root;             ///< Window at the root of the display.
-    mutable atom_map        m_atomCache;        ///< key-sorted list of key-values
+    mutable atom_map        m_atomCache;        ///< Interned atoms by name, None if not found
     std::vector<HandlerInfo> m_handlers;        ///< Callback list
     subscription_id_type    m_nextSubscription; ///< Next available subscription id
 };
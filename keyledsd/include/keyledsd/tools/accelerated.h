@@ -62,6 +62,57 @@ void blend(uint8_t * a, const uint8_t * b, size_t length);
  */
 void multiply(uint8_t * a, const uint8_t * b, size_t length);
 
+/** Scale a R8G8B8A8 color stream by a constant color
+ *
+ * Multiplies each channel of each entry by the matching channel of factor,
+ * with the same rounding as multiply. This is equivalent to multiplying
+ * with a stream filled with factor, without having to build that stream.
+ *
+ * The scaling operation uses SSE2 or AVX2 if available.
+ *
+ * @param[in|out] a An array of colors used as a destination. Must be 16-byte aligned.
+ * @param factor A single R8G8B8A8 color, whose channels are the factors to apply.
+ * @param length The number of colors in the array. Must be a multiple of 4.
+ */
+void scale(uint8_t * a, const uint8_t * factor, size_t length);
+
+/** Fill selected entries of a R8G8B8A8 color stream with a constant color
+ *
+ * Entry n is written if bit n%64 of mask[n/64] is set, and left untouched
+ * otherwise. Blocks of entries with no bit set are skipped without touching
+ * memory, so sparse masks are cheap.
+ *
+ * @param[in|out] a An array of colors used as a destination. Must be 16-byte aligned.
+ * @param color A single R8G8B8A8 color to write.
+ * @param mask A bitset holding at least length bits.
+ * @param length The number of colors in the array. Must be a multiple of 4.
+ */
+void fill_masked(uint8_t * a, const uint8_t * color, const uint64_t * mask, size_t length);
+
+/** Copy selected entries of a R8G8B8A8 color stream
+ *
+ * Same as fill_masked, taking entries from b instead of a constant.
+ *
+ * @param[in|out] a An array of colors used as a destination. Must be 16-byte aligned.
+ * @param b An array of colors used as a source. Must be 16-byte aligned.
+ * @param mask A bitset holding at least length bits.
+ * @param length The number of colors in the arrays. Must be a multiple of 4.
+ * @note Arrays must not overlap.
+ */
+void copy_masked(uint8_t * a, const uint8_t * b, const uint64_t * mask, size_t length);
+
+/** Blend selected entries of two R8G8B8A8 color streams
+ *
+ * Same as blend, restricted to entries selected as in fill_masked.
+ *
+ * @param[in|out] a An array of colors used as a destination. Must be 16-byte aligned.
+ * @param b An array of colors used as a source. Must be 16-byte aligned.
+ * @param mask A bitset holding at least length bits.
+ * @param length The number of colors in the arrays. Must be a multiple of 4.
+ * @note Arrays must not overlap.
+ */
+void blend_masked(uint8_t * a, const uint8_t * b, const uint64_t * mask, size_t length);
+
 #ifdef __cplusplus
     namespace detail {  // exposed for testing purposes
 #endif
@@ -71,6 +122,18 @@ void multiply(uint8_t * a, const uint8_t * b, size_t length);
         void multiply_plain(uint8_t * a, const uint8_t * b, size_t length);
         void multiply_sse2(uint8_t * a, const uint8_t * b, size_t length);
         void multiply_avx2(uint8_t * a, const uint8_t * b, size_t length);
+        void scale_plain(uint8_t * a, const uint8_t * factor, size_t length);
+        void scale_sse2(uint8_t * a, const uint8_t * factor, size_t length);
+        void scale_avx2(uint8_t * a, const uint8_t * factor, size_t length);
+        void fill_masked_plain(uint8_t * a, const uint8_t * color, const uint64_t * mask, size_t length);
+        void fill_masked_sse2(uint8_t * a, const uint8_t * color, const uint64_t * mask, size_t length);
+        void fill_masked_avx2(uint8_t * a, const uint8_t * color, const uint64_t * mask, size_t length);
+        void copy_masked_plain(uint8_t * a, const uint8_t * b, const uint64_t * mask, size_t length);
+        void copy_masked_sse2(uint8_t * a, const uint8_t * b, const uint64_t * mask, size_t length);
+        void copy_masked_avx2(uint8_t * a, const uint8_t * b, const uint64_t * mask, size_t length);
+        void blend_masked_plain(uint8_t * a, const uint8_t * b, const uint64_t * mask, size_t length);
+        void blend_masked_sse2(uint8_t * a, const uint8_t * b, const uint64_t * mask, size_t length);
+        void blend_masked_avx2(uint8_t * a, const uint8_t * b, const uint64_t * mask, size_t length);
 #ifdef __cplusplus
     } // namespace detail
 
@@ -80,18 +143,51 @@ void multiply(uint8_t * a, const uint8_t * b, size_t length);
                 { detail::blend_plain(a, b, length); }
             static inline void multiply(uint8_t * a, const uint8_t * b, size_t length)
                 { detail::multiply_plain(a, b, length); }
+            static inline void scale(uint8_t * a, const uint8_t * factor, size_t length)
+                { detail::scale_plain(a, factor, length); }
+            static inline void fill_masked(uint8_t * a, const uint8_t * color,
+                                           const uint64_t * mask, size_t length)
+                { detail::fill_masked_plain(a, color, mask, length); }
+            static inline void copy_masked(uint8_t * a, const uint8_t * b,
+                                           const uint64_t * mask, size_t length)
+                { detail::copy_masked_plain(a, b, mask, length); }
+            static inline void blend_masked(uint8_t * a, const uint8_t * b,
+                                            const uint64_t * mask, size_t length)
+                { detail::blend_masked_plain(a, b, mask, length); }
         };
         struct sse2 {
             static inline void blend(uint8_t * a, const uint8_t * b, size_t length)
                 { detail::blend_sse2(a, b, length); }
             static inline void multiply(uint8_t * a, const uint8_t * b, size_t length)
                 { detail::multiply_sse2(a, b, length); }
+            static inline void scale(uint8_t * a, const uint8_t * factor, size_t length)
+                { detail::scale_sse2(a, factor, length); }
+            static inline void fill_masked(uint8_t * a, const uint8_t * color,
+                                           const uint64_t * mask, size_t length)
+                { detail::fill_masked_sse2(a, color, mask, length); }
+            static inline void copy_masked(uint8_t * a, const uint8_t * b,
+                                           const uint64_t * mask, size_t length)
+                { detail::copy_masked_sse2(a, b, mask, length); }
+            static inline void blend_masked(uint8_t * a, const uint8_t * b,
+                                            const uint64_t * mask, size_t length)
+                { detail::blend_masked_sse2(a, b, mask, length); }
         };
         struct avx2 {
             static inline void blend(uint8_t * a, const uint8_t * b, size_t length)
                 { detail::blend_avx2(a, b, length); }
             static inline void multiply(uint8_t * a, const uint8_t * b, size_t length)
                 { detail::multiply_avx2(a, b, length); }
+            static inline void scale(uint8_t * a, const uint8_t * factor, size_t length)
+                { detail::scale_avx2(a, factor, length); }
+            static inline void fill_masked(uint8_t * a, const uint8_t * color,
+                                           const uint64_t * mask, size_t length)
+                { detail::fill_masked_avx2(a, color, mask, length); }
+            static inline void copy_masked(uint8_t * a, const uint8_t * b,
+                                           const uint64_t * mask, size_t length)
+                { detail::copy_masked_avx2(a, b, mask, length); }
+            static inline void blend_masked(uint8_t * a, const uint8_t * b,
+                                            const uint64_t * mask, size_t length)
+                { detail::blend_masked_avx2(a, b, mask, length); }
         };
     } // namespace architecture
 
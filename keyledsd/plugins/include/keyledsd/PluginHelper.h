@@ -152,7 +152,7 @@ class SimpleEffect : public Effect
 public:
     void    handleContextChange(const string_map &) override {}
     void    handleGenericEvent(const string_map &) override {}
-    void    handleKeyEvent(const KeyDatabase::Key &, bool) override {}
+    void    handleKeyEvent(const KeyDatabase::Key &, bool, clock::time_point) override {}
 };
 
 
@@ -168,6 +168,11 @@ public:
     Effect * createEffect(const std::string & name, EffectService & service) override
     {
         if (name == m_name) {
+            // Effects that keep SimpleEffect's handler ignore context changes
+            using handler_type = decltype(&T::handleContextChange);
+            if constexpr (std::is_same_v<handler_type, decltype(&SimpleEffect::handleContextChange)>) {
+                service.subscribeContext(false);
+            }
             if constexpr (detail::has_factory_v<T>) {
                 return T::create(service);
             } else {
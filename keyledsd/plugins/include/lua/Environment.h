@@ -19,10 +19,12 @@
 
 #include <optional>
 #include <string>
+#include "lua/lua_Allocator.h"
 #include "lua/lua_Interpolator.h"
 #include "lua/lua_Key.h"
 #include "lua/lua_KeyDatabase.h"
 #include "lua/lua_KeyGroup.h"
+#include "lua/lua_Monitor.h"
 #include "lua/lua_RGBAColor.h"
 #include "lua/lua_RenderTarget.h"
 #include "lua/lua_Thread.h"
@@ -37,7 +39,12 @@ struct Thread;
 
 /****************************************************************************/
 
-/// Synctactical sugar for manipulating lua_State: Environment(lua).controller()
+/** Synctactical sugar for manipulating lua_State: Environment(lua).controller()
+ *
+ * A lua state may be shared by several effects, each running in its own
+ * environment table. The controller is therefore not bound to the state: each
+ * effect must set itself as controller before running any lua code.
+ */
 class Environment final
 {
 public:
@@ -48,12 +55,17 @@ public:
     public:
         virtual void            print(const std::string &) const = 0;
         virtual std::optional<RGBAColor> parseColor(const std::string &) const = 0;
+        virtual const KeyDatabase & keyDB() const = 0;
 
         virtual RenderTarget *  createRenderTarget() = 0;
         virtual void            destroyRenderTarget(RenderTarget *) = 0;
 
         virtual int             createThread(lua_State * lua, int nargs) = 0;
         virtual void            destroyThread(lua_State * lua, Thread &) = 0;
+        virtual ThreadScheduler & threads() = 0;
+
+        virtual InterpolatorPool & interpolators() = 0;
+        virtual Monitor &       monitor() = 0;
     protected:
         ~Controller() {}
     };
@@ -61,11 +73,16 @@ public:
 public:
                     Environment(lua_State * lua) : m_lua(lua) {}
 
-    void            openKeyleds(Controller *);
+    void            openKeyleds();
+    void            setController(Controller *);
     Controller *    controller() const;
 
-    void            stepInterpolators(Interpolator::milliseconds elapsed)
-        { Interpolator::stepAll(m_lua, elapsed); }
+    /// Records current controller as owner of object at index, for finalizers
+    void            setOwner(int index);
+    /// Returns recorded owner of object at index, or current controller if none
+    Controller *    owner(int index) const;
+    /// Destroys all render targets owned by controller, marking their lua objects as gone
+    void            destroyRenderTargets(Controller *);
 
     static const void * const waitToken;
 private:
@@ -17,9 +17,13 @@
 #ifndef KEYLEDS_PLUGINS_LUA_LUAEFFECT_H_F038C73D
 #define KEYLEDS_PLUGINS_LUA_LUAEFFECT_H_F038C73D
 
+#include <cstddef>
 #include <memory>
+#include <mutex>
+#include <vector>
 #include "keyledsd/PluginHelper.h"
 #include "lua/Environment.h"
+#include "lua/StatePool.h"
 
 struct lua_State;
 
@@ -30,43 +34,79 @@ namespace keyleds::plugin::lua {
 
 class LuaEffect final : public SimpleEffect, public keyleds::lua::Environment::Controller
 {
-    struct lua_state_deleter { void operator()(lua_State *) const; };
-    using state_ptr = std::unique_ptr<lua_State, lua_state_deleter>;
 public:
-                    LuaEffect(std::string name, EffectService &, state_ptr);
+                    LuaEffect(std::string name, EffectService &, StatePool &, StatePool::State *);
                     LuaEffect(const LuaEffect &) = delete;
                     ~LuaEffect();
 
-    // Factory method
+    // Factory method, code may be lua source or bytecode from compile()
     static std::unique_ptr<LuaEffect> create(const std::string & name, EffectService &,
-                                             const std::string & code);
+                                             StatePool &, const std::string & code);
+
+    /// Compiles code into bytecode, loading faster in create(). Returns an
+    /// empty string and sets error if code cannot be loaded.
+    static std::string compile(const std::string & name, const std::string & code,
+                               std::string & error);
+
+    /// Key events lost because the queue was full, since creation
+    std::size_t     droppedKeyEvents() const { return m_droppedKeyEvents; }
 
 public: // Effect interface for keyleds & lua init hook
     void            init();
     void            render(milliseconds elapsed, RenderTarget & target) override;
+    void            idle(clock::time_point deadline) override;
     void            handleContextChange(const string_map &) override;
     void            handleGenericEvent(const string_map &) override;
-    void            handleKeyEvent(const KeyDatabase::Key &, bool) override;
+    void            handleKeyEvent(const KeyDatabase::Key &, bool, clock::time_point) override;
 
 public: // Environment::Controller interface for lua
     void            print(const std::string &) const override;
     std::optional<RGBAColor> parseColor(const std::string &) const override;
+    const KeyDatabase & keyDB() const override { return m_service.keyDB(); }
     RenderTarget *  createRenderTarget() override;
     void            destroyRenderTarget(RenderTarget *) override;
     int             createThread(lua_State * lua, int nargs) override;
     void            destroyThread(lua_State * lua, Thread &) override;
+    keyleds::lua::ThreadScheduler & threads() override { return m_threads; }
+    keyleds::lua::InterpolatorPool & interpolators() override { return m_interpolators; }
+    keyleds::lua::Monitor & monitor() override { return m_monitor; }
 
 private:
-           void     setupState();
+    std::unique_lock<std::mutex> enter();
+           void     setupEnvironment();
+           void     deliverKeyEvents();
+           void     releaseFadeTargets();
            void     stepThreads(milliseconds);
            void     runThread(Thread &, lua_State * thread, int nargs);
-    static bool     pushHook(lua_State *, const char *);
+           bool     pushHook(const char *);
+           void     dumpProfile() const;
     static bool     handleError(lua_State *, EffectService &, int code);
 private:
+    struct KeyEvent final
+    {
+        const KeyDatabase::Key * key;
+        bool            press;
+        clock::time_point time;
+    };
+    using key_event_list = std::vector<KeyEvent>;
+
     std::string     m_name;         ///< Name of the effect, from config file
     EffectService & m_service;      ///< For communicating with keyleds
-    state_ptr       m_state;        ///< Lua container this effect's scripts runs in
+    keyleds::lua::InterpolatorPool m_interpolators; ///< Running fades
+    keyleds::lua::ThreadScheduler m_threads;        ///< Sleeping threads
+    keyleds::lua::Monitor m_monitor;                ///< Instruction budget and profiler
+    StatePool &     m_pool;         ///< Where m_state comes from and goes back to
+    StatePool::State * m_state;     ///< Lua container this effect's scripts runs in
+    int             m_env;          ///< Registry reference to this effect's global table
+    int             m_threadList;   ///< Registry reference to this effect's thread list
+    int             m_eventList;    ///< Registry reference to array given to onKeyEvents
+    int             m_eventPool;    ///< Registry reference to event tables, reused across frames
+    key_event_list  m_keyEvents;    ///< Key events received since last frame
+    std::size_t     m_eventCount;   ///< Number of events delivered in last batch
+    std::size_t     m_droppedKeyEvents; ///< Key events lost to a full queue
     bool            m_enabled;      ///< Should render/event handlers be run?
+    std::string     m_profilePath;  ///< Where to dump profile, empty if not profiling
+    clock::time_point m_profileDumped; ///< When profile was last dumped
 };
 
 /****************************************************************************/
@@ -0,0 +1,117 @@
+/* Keyleds -- Gaming keyboard tool
+ * Copyright (C) 2017 Julien Hartmann, juli1.hartmann@gmail.com
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+#ifndef KEYLEDS_PLUGINS_LUA_STATEPOOL_H_9B1F64D2
+#define KEYLEDS_PLUGINS_LUA_STATEPOOL_H_9B1F64D2
+
+#include <chrono>
+#include <cstddef>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <vector>
+
+struct lua_State;
+
+namespace keyleds::plugin::lua {
+
+/****************************************************************************/
+
+/** Pool of initialized lua states
+ *
+ * Creating a lua state, loading libraries and registering keyleds bindings
+ * is done once per pooled state. Effects acquire a state when they are
+ * created and release it when destroyed, leaving it ready for the next one.
+ * Library tables, type metatables and globals are put back the way they were
+ * when the state was created once its last user releases it.
+ *
+ * Each effect runs in its own environment table, holding its own copy of
+ * library tables, while the string metatable and type metatables are hidden
+ * from scripts. So a state can also be shared by several effect instances at
+ * once, none of them seeing changes made by others, unless given the debug
+ * library, which bypasses all this. Sharing effects must agree on a share
+ * key, and must lock the state's mutex before using it, as they may run
+ * from different threads. Exclusive states use an empty share key.
+ *
+ * Acquiring and releasing states must be done from a single thread.
+ */
+class StatePool final
+{
+    struct lua_state_deleter { void operator()(lua_State *) const; };
+public:
+    using state_ptr = std::unique_ptr<lua_State, lua_state_deleter>;
+    using clock = std::chrono::steady_clock;
+
+    class State final
+    {
+    public:
+        explicit        State(state_ptr);
+
+        lua_State *     lua() const noexcept { return m_lua.get(); }
+        std::mutex &    mutex() noexcept { return m_mutex; }
+        unsigned        users() const noexcept { return m_users; }
+        std::size_t     memoryInUse() const;    ///< in bytes
+
+        /// Pushes a new global table for a user: it falls back to shared globals,
+        /// but holds its own copy of library tables.
+        void            pushEnvironment();
+
+        /// Runs incremental garbage collection steps until deadline, or cycle completion
+        void            collect(clock::time_point deadline);
+        /// Runs a full garbage collection cycle
+        void            collectAll();
+        /// Runs a full garbage collection cycle if memory use went far past the
+        /// threshold, for when collect() is not given time, eg while paused
+        void            collectOverdue();
+
+    private:
+        state_ptr       m_lua;              ///< Actual lua state
+        std::mutex      m_mutex;            ///< Serializes access from all users
+        std::string     m_shareKey;         ///< Users must have this key, empty if exclusive
+        unsigned        m_users = 0;        ///< Number of effects using this state
+        bool            m_collecting = false;   ///< Is a garbage collection cycle in progress?
+        std::size_t     m_gcThreshold;      ///< Memory use that starts next collection cycle
+
+        friend class StatePool;
+    };
+
+public:
+                    StatePool() = default;
+                    StatePool(const StatePool &) = delete;
+    StatePool &     operator=(const StatePool &) = delete;
+                    ~StatePool();
+
+    /// Returns a state for an effect, sharing it with other effects using the
+    /// same key if any. Returns nullptr if a new state cannot be created.
+    State *         acquire(const std::string & shareKey);
+    /// Gives back a state, once the effect has cleaned its environment
+    void            release(State *);
+
+    /// Creates a bare lua state, with allocator and panic handler set
+    static state_ptr newState();
+
+private:
+    static state_ptr createState();
+
+private:
+    std::vector<std::unique_ptr<State>> m_states;
+};
+
+/****************************************************************************/
+
+} // namespace keyleds::plugin::lua
+
+#endif
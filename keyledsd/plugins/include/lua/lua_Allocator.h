@@ -0,0 +1,84 @@
+/* Keyleds -- Gaming keyboard tool
+ * Copyright (C) 2017 Julien Hartmann, juli1.hartmann@gmail.com
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+#ifndef KEYLEDS_PLUGINS_LUA_LUA_ALLOCATOR_H_5E0A93C1
+#define KEYLEDS_PLUGINS_LUA_LUA_ALLOCATOR_H_5E0A93C1
+
+#include <array>
+#include <cstddef>
+#include <vector>
+
+namespace keyleds::lua {
+
+/****************************************************************************/
+
+/** Pooled memory allocator for a lua state.
+ *
+ * Small blocks are carved from fixed-size slabs and recycled through one free
+ * list per size class, so the allocation churn of a running effect does not
+ * reach the system allocator. Larger blocks are passed through to it.
+ * Slabs are only released when the allocator is destroyed, which must happen
+ * after the lua state using it is closed.
+ *
+ * Also tracks memory use, to drive garbage collection. Use by all lua states
+ * is reported to service-wide memory accounting as well.
+ */
+class Allocator final
+{
+public:
+    using size_type = std::size_t;
+public:
+                Allocator() = default;
+                Allocator(const Allocator &) = delete;
+    Allocator & operator=(const Allocator &) = delete;
+                ~Allocator();
+
+    size_type   inUse() const noexcept { return m_inUse; }        ///< bytes used by lua
+    size_type   peak() const noexcept { return m_peak; }          ///< highest inUse() so far
+    size_type   reserved() const noexcept { return m_reserved; }  ///< bytes taken from system
+
+    /// Allocation function, matching lua_Alloc, with the Allocator as user data
+    static void * alloc(void * ud, void * ptr, size_t osize, size_t nsize) noexcept;
+
+private:
+    void *      allocate(size_type) noexcept;
+    void        deallocate(void *, size_type) noexcept;
+    void *      reallocate(void *, size_type osize, size_type nsize) noexcept;
+    void        track(size_type osize, size_type nsize) noexcept;
+
+private:
+    static constexpr size_type granularity = 16;    ///< size class width, also block alignment
+    static constexpr size_type maxPooledSize = 256; ///< larger blocks go to system allocator
+    static constexpr size_type slabSize = 16384;    ///< memory reserved at once for small blocks
+    static constexpr size_type classCount = maxPooledSize / granularity;
+
+    struct FreeBlock { FreeBlock * next; };
+
+    std::array<FreeBlock *, classCount> m_freeLists = {};  ///< recycled blocks, per size class
+    std::vector<void *> m_slabs;            ///< all slabs, for releasing them on destruction
+    char *      m_slabCursor = nullptr;     ///< unused part of current slab
+    char *      m_slabEnd = nullptr;        ///< end of current slab
+
+    size_type   m_inUse = 0;
+    size_type   m_peak = 0;
+    size_type   m_reserved = 0;
+};
+
+/****************************************************************************/
+
+} // namespace keyleds::lua
+
+#endif
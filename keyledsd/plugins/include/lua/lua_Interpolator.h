@@ -18,6 +18,9 @@
 #define KEYLEDS_PLUGINS_LUA_LUA_INTERPOLATOR_H_BCD195FC
 
 #include <chrono>
+#include <cstddef>
+#include <unordered_map>
+#include <vector>
 #include "lua/lua_types.h"
 #include "keyledsd/PluginHelper.h"
 
@@ -25,29 +28,116 @@ namespace keyleds::lua {
 
 /****************************************************************************/
 
+/** Native storage for running interpolators.
+ *
+ * Each effect owns one pool. Running interpolators are stored contiguously and
+ * stepped in a single pass that writes directly into their render target, so
+ * stepping does not call into lua at all. Lua objects only hold a handle.
+ *
+ * Entries are indexed both by handle and by key, so starting, stopping and
+ * querying an interpolator do not depend on how many are running.
+ *
+ * The pool does not own render targets. Entries referencing a target must be
+ * removed using stopAll() or removeTarget() before the target is destroyed.
+ * Targets left without running interpolators are reported through
+ * releaseIdleTargets(), so their owner can drop references it holds for them.
+ */
+class InterpolatorPool final
+{
+public:
+    using milliseconds = std::chrono::duration<unsigned, std::milli>;
+    using handle_type = unsigned;
+    using size_type = std::size_t;
+    static constexpr handle_type invalid_handle = 0;
+
+public:
+    /// Starts animating a key, replacing any interpolator running on the same key.
+    /// Returns a handle that remains unique for the lifetime of the pool.
+    handle_type start(RenderTarget &, unsigned keyIndex, milliseconds duration,
+                      RGBAColor startValue, RGBAColor finishValue);
+    bool        isRunning(handle_type) const noexcept;
+    void        stop(handle_type) noexcept;
+    void        stopAll(const RenderTarget &) noexcept;     ///< keeps per-target storage for reuse
+    void        removeTarget(const RenderTarget &) noexcept;///< stops all and frees per-target storage
+
+    /// Invokes func on each target whose last interpolator finished or was stopped
+    /// since last call, and that has not started another one since.
+    template <typename Func> void releaseIdleTargets(Func && func);
+
+    /// Advances all interpolators and updates their keys. Finished ones are removed.
+    void        step(milliseconds elapsed) noexcept;
+
+    bool        empty() const noexcept { return m_entries.empty(); }
+    size_type   size() const noexcept { return m_entries.size(); }
+
+private:
+    struct Entry final
+    {
+        handle_type     handle;         ///< Identifier given to lua
+        RenderTarget *  target;         ///< Where to write animated color
+        unsigned        index;          ///< Key index within render target
+        milliseconds    duration;       ///< Animation duration in ms
+        milliseconds    elapsed;        ///< Elapsed time in ms
+        RGBAColor       startValue;     ///< Color when elapsed == 0
+        RGBAColor       finishValue;    ///< Color when elapsed >= duration
+
+        RGBAColor       value() const noexcept;
+    };
+    using entry_list = std::vector<Entry>;
+    using slot_map = std::unordered_map<handle_type, size_type>;
+    struct TargetKeys final
+    {
+        std::vector<handle_type> handles;   ///< Handle running on each key, if any
+        size_type       running = 0;        ///< Number of valid handles
+        bool            idle = false;       ///< Whether target is in m_idleTargets
+    };
+    using key_map = std::unordered_map<const RenderTarget *, TargetKeys>;
+    using target_list = std::vector<const RenderTarget *>;
+
+    void                remove(size_type slot) noexcept;
+
+    entry_list          m_entries;          ///< Running interpolators, in no particular order
+    slot_map            m_slots;            ///< Position in m_entries of each running handle
+    key_map             m_keys;             ///< Handle running on each key of a target, if any
+    target_list         m_idleTargets;      ///< Targets whose running count dropped to zero
+    handle_type         m_nextHandle = 1;   ///< Handle to give next started interpolator
+};
+
+template <typename Func> void InterpolatorPool::releaseIdleTargets(Func && func)
+{
+    for (const auto * target : m_idleTargets) {
+        auto it = m_keys.find(target);
+        if (it == m_keys.end()) { func(target); continue; }
+        it->second.idle = false;
+        if (it->second.running == 0) { func(target); }
+    }
+    m_idleTargets.clear();
+}
+
+/****************************************************************************/
+
 /** Color interpolator for animating keys.
- * This is a lua userdata-based object created using `fade()` from lua.
+ * This is a lua userdata-based object created using `fade()` from lua. It holds
+ * the animation parameters, and a handle into the effect's InterpolatorPool
+ * while it runs. The render target it runs on is referenced until its last
+ * interpolator is done, so a script may drop the target while fades complete.
  */
 struct Interpolator
 {
     enum {
         hasStartValueFlag = (1 << 1)
     };
-    using milliseconds = std::chrono::duration<unsigned, std::milli>;
+    using milliseconds = InterpolatorPool::milliseconds;
 
-    int             id;             ///< luaL_ref id in registry
+    InterpolatorPool::handle_type handle;   ///< Running instance in pool, if any
     unsigned        flags;          ///< See flags_type above
-    unsigned        index;          ///< Key index withing render target
     milliseconds    duration;       ///< Animation duration in ms
-    milliseconds    elapsed;        ///< Elapsed time in ms
     RGBAColor       startValue;     ///< Color when elapsed == 0
     RGBAColor       finishValue;    ///< Color when elapsed >= duration
 
     static void start(lua_State *, unsigned keyIndex); // on stack: (interpolator, rendertarget) [-2, 0]
     static void stop(lua_State *);                     // on stack: (interpolator) [-1, 0]
-    static void stepAll(lua_State *, milliseconds);
-
-    RGBAColor   value() const;
+    static void releaseTarget(lua_State *, const RenderTarget *); // drops reference taken by start
 };
 
 int luaNewInterpolator(lua_State *);
@@ -0,0 +1,95 @@
+/* Keyleds -- Gaming keyboard tool
+ * Copyright (C) 2017 Julien Hartmann, juli1.hartmann@gmail.com
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+#ifndef KEYLEDS_PLUGINS_LUA_LUA_MONITOR_H_5E0A7C31
+#define KEYLEDS_PLUGINS_LUA_LUA_MONITOR_H_5E0A7C31
+
+#include <chrono>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+struct lua_Debug;
+struct lua_State;
+
+namespace keyleds::lua {
+
+/****************************************************************************/
+
+/** Execution monitor for an effect's scripts.
+ *
+ * A count hook installed on lua states calls into the monitor of the running
+ * effect every hookInterval instructions. The monitor enforces an instruction
+ * budget on each call into lua, so a runaway script raises an error instead of
+ * freezing the device, and optionally samples the running script and line,
+ * attributing time elapsed since the previous sample to it.
+ */
+class Monitor final
+{
+public:
+    using clock = std::chrono::steady_clock;
+    static constexpr int hookInterval = 1000;       ///< instructions between samples
+
+    struct Location final
+    {
+        std::string     name;           ///< Script and line
+        clock::duration time;           ///< Time attributed to location
+        unsigned long   samples;        ///< Number of times it was sampled
+    };
+    using location_list = std::vector<Location>;
+
+public:
+    /// Sets maximum number of instructions per call into lua, 0 for no limit
+    void            setBudget(unsigned long instructions) noexcept { m_budget = instructions; }
+    void            setProfiling(bool enabled) noexcept { m_profiling = enabled; }
+    bool            profiling() const noexcept { return m_profiling; }
+
+    /// Starts monitoring a new call into lua code, resetting the budget
+    void            start() noexcept;
+    /// Whether budget was exceeded since last start()
+    bool            exceeded() const noexcept { return m_exceeded; }
+
+    /// Returns sampled locations, most expensive first
+    location_list   profile() const;
+
+    /// Installs the hook on a lua state, threads created from it inherit it
+    static void     install(lua_State *);
+    /// Makes budgets enforceable on a lua state. LuaJIT does not run hooks
+    /// from compiled code, so this turns its compiler off for the state.
+    static void     enforce(lua_State *);
+    /// Removes the hook and turns LuaJIT's compiler back on, for reusing the state
+    static void     uninstall(lua_State *);
+
+private:
+    bool            sample(lua_State *, lua_Debug *);
+    static void     hook(lua_State *, lua_Debug *);
+
+private:
+    using location_map = std::unordered_map<std::string, Location>;
+
+    unsigned long   m_budget = 0;           ///< Instructions allowed per call, 0 if unlimited
+    unsigned long   m_executed = 0;         ///< Instructions run since start(), approximately
+    bool            m_exceeded = false;     ///< Budget exceeded since start()?
+    bool            m_profiling = false;    ///< Should locations be sampled?
+    clock::time_point m_lastSample;         ///< When time was last attributed
+    location_map    m_locations;            ///< Sampled locations, by name
+};
+
+/****************************************************************************/
+
+} // namespace keyleds::lua
+
+#endif
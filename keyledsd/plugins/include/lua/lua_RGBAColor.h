@@ -30,9 +30,22 @@ template <> struct metatable<keyleds::RGBAColor>
     { static const char * const name; static constexpr struct luaL_Reg * methods = nullptr;
       static const struct luaL_Reg meta_methods[]; struct weak_table : std::false_type{}; };
 
+/// Converts a [0, 1] lua number into a channel value, rounding and saturating.
+/// Inverse of channel / 255, which is how channels are handed to lua.
+unsigned char toChannel(lua_Number);
+
 void lua_push(lua_State * lua, keyleds::RGBAColor);
 RGBAColor lua_tocolor(lua_State * lua, int index);
-RGBAColor lua_checkcolor(lua_State * lua, int index);
+RGBAColor lua_checkcolor(lua_State * lua, int index);  ///< accepts both color objects and packed colors
+
+/// Packed colors are plain lua numbers holding 0xRRGGBBAA. They are not
+/// collectable, so manipulating them creates no garbage. Only integers in
+/// the 32-bit range are accepted as packed colors.
+void lua_pushpacked(lua_State * lua, keyleds::RGBAColor);
+RGBAColor lua_topacked(lua_State * lua, int index);
+
+/// Helper functions for manipulating packed colors, registered as rgba library
+extern const struct luaL_Reg packedColorFunctions[];
 
 /****************************************************************************/
 
@@ -18,6 +18,9 @@
 #define KEYLEDS_PLUGINS_LUA_LUA_THREAD_H_761E3512
 
 #include <chrono>
+#include <cstddef>
+#include <cstdint>
+#include <vector>
 #include "lua/lua_types.h"
 
 namespace keyleds::lua {
@@ -29,10 +32,55 @@ namespace keyleds::lua {
 struct Thread
 {
     using milliseconds = std::chrono::duration<unsigned, std::milli>;
+    using time_point = std::chrono::duration<std::uint64_t, std::milli>; ///< since effect creation
 
     int             id;         ///< unique identifier
     bool            running;    ///< whether the thread is currently running (schedulable)
-    milliseconds    sleepTime;  ///< time until thread should be awoken
+    bool            scheduled;  ///< whether the thread is in the scheduler's queue
+    time_point      wakeTime;   ///< when thread should be awoken
+    milliseconds    sleepTime;  ///< time left until wakeTime when the thread was paused
+};
+
+/** Sleeping thread queue
+ *
+ * Keeps threads waiting on a timer in a min-heap ordered by wake time, so
+ * stepping the scheduler only touches threads that are due. Threads with
+ * the same wake time are woken in the order they were scheduled.
+ * Threads are referenced, not owned: they must be cancelled before they
+ * are destroyed.
+ */
+class ThreadScheduler final
+{
+public:
+    using milliseconds = Thread::milliseconds;
+    using time_point = Thread::time_point;
+    using size_type = std::size_t;
+public:
+    time_point      now() const noexcept { return m_now; }
+    void            advance(milliseconds elapsed) noexcept { m_now += elapsed; }
+
+    void            schedule(Thread &);             ///< queue thread until its wakeTime
+    void            cancel(Thread &) noexcept;      ///< remove thread from queue, if queued
+    void            pause(Thread &) noexcept;       ///< cancel and remember time left
+    void            resume(Thread &);               ///< reschedule paused thread
+    Thread *        popDue() noexcept;              ///< remove and return next due thread, if any
+
+    bool            empty() const noexcept { return m_heap.empty(); }
+    size_type       size() const noexcept { return m_heap.size(); }
+
+private:
+    struct Entry final
+    {
+        time_point      wakeTime;
+        std::uint64_t   sequence;   ///< keeps ordering stable for equal wake times
+        Thread *        thread;
+    };
+    struct later final { bool operator()(const Entry &, const Entry &) const noexcept; };
+    using heap_type = std::vector<Entry>;
+private:
+    heap_type       m_heap;
+    time_point      m_now = time_point::zero();
+    std::uint64_t   m_nextSequence = 0;
 };
 
 int luaNewThread(lua_State *);
@@ -17,6 +17,7 @@
 #include "keyledsd/PluginHelper.h"
 #include "keyledsd/tools/utils.h"
 #include <algorithm>
+#include <chrono>
 #include <vector>
 
 using namespace std::literals::chrono_literals;
@@ -79,15 +80,20 @@ public:
         blend(target, m_buffer);
     }
 
-    void handleKeyEvent(const KeyDatabase::Key & key, bool) override
+    void handleKeyEvent(const KeyDatabase::Key & key, bool, clock::time_point time) override
     {
+        // Start from actual press time, so delivery latency does not delay the fade
+        const auto now = clock::now();
+        const auto age = time < now ? std::chrono::duration_cast<milliseconds>(now - time)
+                                    : milliseconds::zero();
+
         for (auto & keyPress : m_presses) {
             if (keyPress.key == &key) {
-                keyPress.age = milliseconds::zero();
+                keyPress.age = age;
                 return;
             }
         }
-        m_presses.push_back({ &key, milliseconds::zero() });
+        m_presses.push_back({ &key, age });
     }
 
 private:
@@ -45,9 +45,7 @@ public:
             auto color = parseConfig<RGBAColor>(service, std::get<std::string>(item.second));
 
             if (group && color) {
-                std::for_each(group->begin(), group->end(), [this, &color](auto & key) {
-                    m_buffer[key.index] = *color;
-                });
+                fill(m_buffer, *color, KeyDatabase::KeySet(service.keyDB().size(), *group));
             }
         }
 
@@ -16,15 +16,104 @@
  */
 #include "keyledsd/PluginHelper.h"
 #include "lua/LuaEffect.h"
+#include "lua/StatePool.h"
 #include <algorithm>
 #include <cassert>
+#include <cstdint>
+#include <cstdio>
+#include <cstring>
+#include <lua.hpp>
 #include <memory>
+#include <string_view>
+#include <unordered_map>
 #include <vector>
 
 using keyleds::plugin::lua::LuaEffect;
+using keyleds::plugin::lua::StatePool;
 
 namespace keyleds::plugin {
 
+/// FNV-1a hash, stable across runs for naming and checking cache files
+static std::uint64_t hashData(std::string_view data)
+{
+    std::uint64_t hash = 0xcbf29ce484222325u;
+    for (auto byte : data) {
+        hash ^= static_cast<unsigned char>(byte);
+        hash *= 0x100000001b3u;
+    }
+    return hash;
+}
+
+/// Bytecode is specific to the engine and version that produced it, so each
+/// gets its own cache directory, eg lua/LuaJIT-2.1.0-beta3/<hash>.luac
+static std::string cacheName(std::uint64_t hash)
+{
+#ifdef LUAJIT_VERSION
+    auto result = std::string("lua/" LUAJIT_VERSION "/");
+#else
+    auto result = std::string("lua/" LUA_RELEASE "/");
+#endif
+    std::replace(result.begin(), result.end(), ' ', '-');
+
+    char buffer[16 + sizeof(".luac")];
+    std::snprintf(buffer, sizeof(buffer), "%016llx.luac",
+                  static_cast<unsigned long long>(hash));
+    return result + buffer;
+}
+
+#ifdef LUAJIT_VERSION
+static constexpr char engineVersion[] = LUAJIT_VERSION;
+#else
+static constexpr char engineVersion[] = LUA_RELEASE;
+#endif
+
+/// Lua loads bytecode without verifying it, and malformed bytecode can crash
+/// the engine. Cache files start with this header, which must match exactly
+/// before the chunk that follows is handed to lua.
+struct CacheHeader final
+{
+    char            magic[8];       ///< File type and format revision
+    char            engine[32];     ///< Engine that dumped the chunk, zero-padded
+    std::uint64_t   sourceHash;     ///< Hash of the source the chunk was compiled from
+    std::uint64_t   size;           ///< Chunk size, in bytes
+    std::uint64_t   checksum;       ///< Hash of the chunk
+};
+static constexpr char cacheMagic[sizeof(CacheHeader::magic)] = "KLDLUA1";
+static_assert(sizeof(engineVersion) <= sizeof(CacheHeader::engine));
+static_assert(sizeof(CacheHeader) == 64, "header is compared bytewise, it must have no padding");
+
+static CacheHeader makeHeader(std::uint64_t sourceHash, std::string_view bytecode)
+{
+    CacheHeader header = {};
+    std::memcpy(header.magic, cacheMagic, sizeof(header.magic));
+    std::memcpy(header.engine, engineVersion, sizeof(engineVersion));
+    header.sourceHash = sourceHash;
+    header.size = bytecode.size();
+    header.checksum = hashData(bytecode);
+    return header;
+}
+
+/// Prepends a header to bytecode compiled from source with given hash
+static std::string packCache(std::uint64_t sourceHash, const std::string & bytecode)
+{
+    const auto header = makeHeader(sourceHash, bytecode);
+    auto result = std::string(reinterpret_cast<const char *>(&header), sizeof(header));
+    result += bytecode;
+    return result;
+}
+
+/// Returns bytecode from cache file data, or an empty string if the file was
+/// written by another engine, for another source, or was damaged.
+static std::string unpackCache(std::uint64_t sourceHash, const std::string & data)
+{
+    if (data.size() < sizeof(CacheHeader)) { return {}; }
+    const auto bytecode = std::string_view(data).substr(sizeof(CacheHeader));
+
+    const auto expected = makeHeader(sourceHash, bytecode);
+    if (std::memcmp(data.data(), &expected, sizeof(expected)) != 0) { return {}; }
+    return std::string(bytecode);
+}
+
 
 class LuaPlugin final : public Plugin
 {
@@ -33,24 +122,29 @@ class LuaPlugin final : public Plugin
     };
     using state_list = std::vector<StateInfo>;
 
+    struct CompiledScript {
+        std::uint64_t   hash;       ///< Hash of the source bytecode was compiled from
+        std::string     bytecode;   ///< Loadable chunk, as dumped by lua
+    };
+    using script_map = std::unordered_map<std::string, CompiledScript>;
+
 public:
     explicit LuaPlugin(const char *) {}
 
     Effect * createEffect(const std::string & name, EffectService & service) override
     {
-        auto source = service.getFile("effects/" + name + ".lua");
-        if (source.empty()) { return nullptr; }
+        const auto * script = getScript(name, service);
+        service.getFile({});    // let the service clear file data
+        if (!script) { return nullptr; }
 
         StateInfo info;
         try {
-            info.effect = LuaEffect::create(name, service, source);
+            info.effect = LuaEffect::create(name, service, m_pool, script->bytecode);
         } catch (std::exception & err) {
             service.log(logging::error::value, err.what());
             return nullptr;
         }
 
-        service.getFile({});    // let the service clear file data
-
         if (!info.effect) { return nullptr; }
 
         return m_states.emplace_back(std::move(info)).effect.get();
@@ -68,7 +162,39 @@ public:
 
 
 private:
+    /// Returns compiled script for effect, compiling it if its source has changed
+    /// since last time. Compiled scripts are cached in memory and on disk.
+    const CompiledScript * getScript(const std::string & name, EffectService & service)
+    {
+        const auto source = service.getFile("effects/" + name + ".lua");  // copy, buffer is reused
+        if (source.empty()) { return nullptr; }
+
+        const auto hash = hashData(source);
+        auto it = m_scripts.find(name);
+        if (it != m_scripts.end() && it->second.hash == hash) { return &it->second; }
+
+        auto bytecode = unpackCache(hash, service.loadCache(cacheName(hash)));
+        if (bytecode.empty()) {
+            std::string error;
+            bytecode = LuaEffect::compile(name, source, error);
+            if (bytecode.empty()) {
+                service.log(logging::error::value, error.c_str());
+                return nullptr;
+            }
+            service.saveCache(cacheName(hash), packCache(hash, bytecode));
+        }
+
+        if (it == m_scripts.end()) {
+            it = m_scripts.emplace(name, CompiledScript{}).first;
+        }
+        it->second = { hash, std::move(bytecode) };
+        return &it->second;
+    }
+
+private:
+    StatePool   m_pool;     ///< Lua states, must outlive effects using them
     state_list  m_states;
+    script_map  m_scripts;  ///< Compiled scripts, by effect name
 };
 
 KEYLEDSD_EXPORT_PLUGIN("lua", LuaPlugin);
@@ -25,6 +25,7 @@
 namespace keyleds::lua {
 
 static void * const controllerToken = const_cast<void **>(&controllerToken);
+static void * const ownerToken = const_cast<void **>(&ownerToken);
 
 /****************************************************************************/
 // Global scope
@@ -54,6 +55,11 @@ static int luaToColor(lua_State * lua)      // (any) => (table)
     int nargs = lua_gettop(lua);
     if (nargs == 1) {
         // We are called as a conversion function
+        if (lua_type(lua, 1) == LUA_TNUMBER) {
+            // On a packed color, unpack it
+            lua_push(lua, lua_topacked(lua, 1));
+            return 1;
+        }
         if (lua_isstring(lua, 1)) {
             // On a string, parse it
             auto * controller = Environment(lua).controller();
@@ -110,14 +116,18 @@ static const luaL_Reg keyledsGlobals[] = {
 
 const void * const Environment::waitToken = &Environment::waitToken;
 
-void Environment::openKeyleds(Controller * controller)
+void Environment::openKeyleds()
 {
     SAVE_TOP(m_lua);
 
-    // Save controller pointer
-    lua_pushlightuserdata(m_lua, controllerToken);
-    lua_pushlightuserdata(m_lua, static_cast<void *>(controller));
-    lua_rawset(m_lua, LUA_GLOBALSINDEX);
+    // Create owner table, weak-keyed so it does not keep objects alive
+    lua_pushlightuserdata(m_lua, ownerToken);
+    lua_newtable(m_lua);                // push(owners)
+    lua_createtable(m_lua, 0, 1);       // push(metatable)
+    lua_pushliteral(m_lua, "k");        // push("k")
+    lua_setfield(m_lua, -2, "__mode");  // pop("k")
+    lua_setmetatable(m_lua, -2);        // pop(metatable)
+    lua_rawset(m_lua, LUA_REGISTRYINDEX);
 
     // Register types
     registerType<Interpolator>(m_lua);
@@ -132,6 +142,19 @@ void Environment::openKeyleds(Controller * controller)
     lua_pushvalue(m_lua, LUA_GLOBALSINDEX);
     luaL_register(m_lua, nullptr, keyledsGlobals);
     lua_pop(m_lua, 1);
+    luaL_register(m_lua, "rgba", packedColorFunctions);
+    lua_pop(m_lua, 1);
+
+    CHECK_TOP(m_lua, 0);
+}
+
+void Environment::setController(Controller * controller)
+{
+    SAVE_TOP(m_lua);
+
+    lua_pushlightuserdata(m_lua, controllerToken);
+    lua_pushlightuserdata(m_lua, static_cast<void *>(controller));
+    lua_rawset(m_lua, LUA_REGISTRYINDEX);
 
     CHECK_TOP(m_lua, 0);
 }
@@ -141,7 +164,7 @@ Environment::Controller * Environment::controller() const
     SAVE_TOP(m_lua);
 
     lua_pushlightuserdata(m_lua, controllerToken);
-    lua_rawget(m_lua, LUA_GLOBALSINDEX);
+    lua_rawget(m_lua, LUA_REGISTRYINDEX);
     auto * controller = static_cast<Controller *>(const_cast<void *>(lua_topointer(m_lua, -1)));
     lua_pop(m_lua, 1);
 
@@ -149,6 +172,62 @@ Environment::Controller * Environment::controller() const
     return controller;
 }
 
+void Environment::setOwner(int index)
+{
+    SAVE_TOP(m_lua);
+    if (index < 0) { index = lua_gettop(m_lua) + index + 1; }
+
+    lua_pushlightuserdata(m_lua, ownerToken);
+    lua_rawget(m_lua, LUA_REGISTRYINDEX);               // push(owners)
+    lua_pushvalue(m_lua, index);                        // push(object)
+    lua_pushlightuserdata(m_lua, static_cast<void *>(controller())); // push(controller)
+    lua_rawset(m_lua, -3);                              // pop(object, controller)
+    lua_pop(m_lua, 1);                                  // pop(owners)
+
+    CHECK_TOP(m_lua, 0);
+}
+
+Environment::Controller * Environment::owner(int index) const
+{
+    SAVE_TOP(m_lua);
+    if (index < 0) { index = lua_gettop(m_lua) + index + 1; }
+
+    lua_pushlightuserdata(m_lua, ownerToken);
+    lua_rawget(m_lua, LUA_REGISTRYINDEX);               // push(owners)
+    lua_pushvalue(m_lua, index);                        // push(object)
+    lua_rawget(m_lua, -2);                              // pop(object) push(owner)
+    auto * owner = static_cast<Controller *>(const_cast<void *>(lua_topointer(m_lua, -1)));
+    lua_pop(m_lua, 2);                                  // pop(owners, owner)
+
+    CHECK_TOP(m_lua, 0);
+    return owner ? owner : controller();
+}
+
+void Environment::destroyRenderTargets(Controller * controller)
+{
+    SAVE_TOP(m_lua);
+
+    lua_pushlightuserdata(m_lua, ownerToken);
+    lua_rawget(m_lua, LUA_REGISTRYINDEX);               // push(owners)
+    lua_pushnil(m_lua);                                 // push(nil)
+    while (lua_next(m_lua, -2) != 0) {                  // pop(key) push(object, owner)
+        if (lua_topointer(m_lua, -1) == controller && lua_is<RenderTarget *>(m_lua, -2)) {
+            auto & target = lua_to<RenderTarget *>(m_lua, -2);
+            if (target) {
+                controller->destroyRenderTarget(target);
+                target = nullptr;                       // mark object as gone
+            }
+            lua_pushvalue(m_lua, -2);                   // push(object)
+            lua_pushnil(m_lua);                         // push(nil)
+            lua_rawset(m_lua, -5);                      // pop(object, nil)
+        }
+        lua_pop(m_lua, 1);                              // pop(owner)
+    }
+    lua_pop(m_lua, 1);                                  // pop(owners)
+
+    CHECK_TOP(m_lua, 0);
+}
+
 /****************************************************************************/
 
 } // namespace keyleds::lua
@@ -20,134 +20,211 @@
 #include "lua/lua_common.h"
 #include <algorithm>
 #include <cassert>
-#include <cstring>
+#include <fstream>
+#include <iomanip>
 #include <lua.hpp>
+#include <numeric>
 #include <sstream>
 
 using keyleds::plugin::lua::LuaEffect;
 using namespace keyleds::lua;
 
 /****************************************************************************/
-// Constants defining LUA environment
-
-// LUA libraries to load
-static constexpr std::array<lua_CFunction, 4> loadModules = {{
-    luaopen_base, luaopen_math, luaopen_string, luaopen_table,
-}};
-static_assert(loadModules.back() == luaopen_table,
-              "unexpected last element, is size correct?");
-
-// Symbols not in this list get removed once libraries are loaded
-static constexpr std::array<const char *, 25> globalWhitelist = {{
-    // Libraries
-    "coroutine", "math", "string", "table",
-    // Functions
-    "assert", "error", "getmetatable", "ipairs",
-    "next", "pairs", "pcall", "print",
-    "rawequal", "rawget", "rawset", "select",
-    "setmetatable", "tonumber", "tostring", "type",
-    "unpack", "wait", "xpcall",
-    // Values
-    "_G", "_VERSION"
-}};
-
-static void * const threadToken = const_cast<void **>(&threadToken);
+// Constants
+
+// Instructions a single call into lua may run before it is aborted. Budgets are
+// opt-in, as enforcing one turns LuaJIT's compiler off for the whole state.
+static constexpr unsigned defaultInstructionBudget = 0;
+
+// Key events beyond that many in a single frame are dropped
+static constexpr std::size_t maxQueuedKeyEvents = 256;
+
+// Interval between profile dumps, while rendering
+static constexpr auto profileDumpInterval = std::chrono::seconds(10);
 
 /****************************************************************************/
 // Helper functions
 
-static int luaPanicHandler(lua_State *);
 static int luaErrorHandler(lua_State *);
 
 /****************************************************************************/
 // Lifecycle management
 
-LuaEffect::LuaEffect(std::string name, EffectService & service, state_ptr state)
+LuaEffect::LuaEffect(std::string name, EffectService & service,
+                     StatePool & pool, StatePool::State * state)
  : m_name(std::move(name)),
    m_service(service),
-   m_state(std::move(state)),
+   m_pool(pool),
+   m_state(state),
+   m_env(LUA_NOREF),
+   m_threadList(LUA_NOREF),
+   m_eventList(LUA_NOREF),
+   m_eventPool(LUA_NOREF),
+   m_eventCount(0),
+   m_droppedKeyEvents(0),
    m_enabled(true)
 {}
 
-LuaEffect::~LuaEffect() = default;
-
-std::unique_ptr<LuaEffect> LuaEffect::create(const std::string & name, EffectService & service,
-                                             const std::string & code)
+LuaEffect::~LuaEffect()
 {
-    // Create a LUA state
-    state_ptr state(luaL_newstate());
-    auto * lua = state.get();
-    lua_atpanic(lua, luaPanicHandler);
+    {
+        auto lock = enter();
+        auto * lua = m_state->lua();
+
+        // Other effects may keep using the state, leave nothing behind
+        Environment(lua).destroyRenderTargets(this);
+        luaL_unref(lua, LUA_REGISTRYINDEX, m_eventPool);
+        luaL_unref(lua, LUA_REGISTRYINDEX, m_eventList);
+        luaL_unref(lua, LUA_REGISTRYINDEX, m_threadList);
+        luaL_unref(lua, LUA_REGISTRYINDEX, m_env);
+        Environment(lua).setController(nullptr);
+    }
+    m_pool.release(m_state);
 
-    SAVE_TOP(lua);
+    if (!m_profilePath.empty()) { dumpProfile(); }
+}
 
-    // Load script
-    if (luaL_loadbuffer(lua, code.data(), code.size(), name.c_str()) != 0) {
-        service.log(logging::error::value, lua_tostring(lua, -1));
+std::unique_ptr<LuaEffect> LuaEffect::create(const std::string & name, EffectService & service,
+                                             StatePool & pool, const std::string & code)
+{
+    // Effects opting in share their state with other effects on the same device
+    const std::string shareKey = getConfig<bool>(service, "shared").value_or(false)
+                               ? service.deviceSerial() : std::string();
+    auto * state = pool.acquire(shareKey);
+    if (!state) {
+        service.log(logging::error::value, "cannot create lua state");
         return nullptr;
-    }                                       // ^push (script)
+    }
+    auto effect = std::make_unique<LuaEffect>(name, service, pool, state);
+    auto * lua = state->lua();
+
+    // Setup optional watchdog and profiler, hooks slow lua down so only install if used
+    const auto budget = getConfig<unsigned>(service, "budget").value_or(defaultInstructionBudget);
+    effect->m_monitor.setBudget(budget);
+    if (auto path = getConfig<std::string>(service, "profile"); path && !path->empty()) {
+        effect->m_profilePath = std::move(*path);
+        effect->m_profileDumped = clock::now();
+        effect->m_monitor.setProfiling(true);
+    }
+    if (budget != 0 || effect->m_monitor.profiling()) { Monitor::install(lua); }
+    if (budget != 0) { Monitor::enforce(lua); }
 
-    auto effect = std::make_unique<LuaEffect>(name, service, std::move(state));
-    effect->setupState();
+    {
+        auto lock = effect->enter();
+        SAVE_TOP(lua);
+
+        effect->setupEnvironment();
+
+        // Load script
+        if (luaL_loadbuffer(lua, code.data(), code.size(), name.c_str()) != 0) {
+            service.log(logging::error::value, lua_tostring(lua, -1));
+            lua_pop(lua, 1);                    // pop(error)
+            return nullptr;
+        }                                       // ^push (script)
+
+        // Script runs in the effect's own global table
+        lua_rawgeti(lua, LUA_REGISTRYINDEX, effect->m_env); // push(env)
+        lua_setfenv(lua, -2);                   // pop(env)
+
+        // Run script to let it build its environment
+        lua_pushcfunction(lua, luaErrorHandler);// push (errhandler)
+        lua_insert(lua, -2);                    // swap (script, errhandler) => (errhandler, script)
+        if (!handleError(lua, service, lua_pcall(lua, 0, 0, -2))) { // pop (errhandler, script)
+            return nullptr;
+        }
 
-    // Run script to let it build its environment
-    lua_pushcfunction(lua, luaErrorHandler);// push (errhandler)
-    lua_insert(lua, -2);                    // swap (script, errhandler) => (errhandler, script)
-    if (!handleError(lua, service, lua_pcall(lua, 0, 0, -2))) { // pop (errhandler, script)
-        return nullptr;
+        CHECK_TOP(lua, 0);
     }
 
-    CHECK_TOP(lua, 0);
-
     // Let the effect run init hook
     effect->init();
+
+    // Start from a clean heap, as collection was held back while loading
+    auto lock = effect->enter();
+    state->collectAll();
+
+    // Scripts without a hook have no use for context changes once active
+    if (effect->pushHook("onContextChange")) {
+        lua_pop(lua, 1);                        // pop(hook)
+    } else {
+        service.subscribeContext(false);
+    }
     return effect;
 }
 
-void LuaEffect::setupState()
+std::string LuaEffect::compile(const std::string & name, const std::string & code,
+                               std::string & error)
 {
-    auto lua = m_state.get();
-    SAVE_TOP(lua);
-
-    // Load libraries in default environment
-    for (const auto & module : loadModules) {
-        lua_pushcfunction(lua, module);
-        lua_call(lua, 0, 0);
+    auto state = StatePool::newState();
+    if (!state) {
+        error = "cannot create lua state";
+        return {};
     }
+    auto * lua = state.get();
 
-    // Remove global symbols not in whitelist
-    lua_pushnil(lua);
-    while (lua_next(lua, LUA_GLOBALSINDEX) != 0) {
-        lua_pop(lua, 1);
-        if (lua_isstring(lua, -1)) {
-            const char * key = lua_tostring(lua, -1);
-            auto it = std::find_if(globalWhitelist.begin(), globalWhitelist.end(),
-                                   [key](const auto * item) { return std::strcmp(key, item) == 0; });
-            if (it == globalWhitelist.end()) {
-                lua_pushnil(lua);
-                lua_setglobal(lua, key);
-            }
+    if (luaL_loadbuffer(lua, code.data(), code.size(), name.c_str()) != 0) {
+        error = lua_tostring(lua, -1);
+        return {};
+    }                                       // ^push (script)
+
+    // Debug information is kept, so error messages still have line numbers
+    std::string result;
+    auto writer = [](lua_State *, const void * data, size_t size, void * ud) -> int {
+        try {
+            static_cast<std::string *>(ud)->append(static_cast<const char *>(data), size);
+        } catch (...) {
+            return 1;
         }
+        return 0;
+    };
+    if (lua_dump(lua, writer, &result) != 0) {
+        error = "cannot dump bytecode";
+        return {};
     }
+    return result;
+}
+
+/// Locks the state and makes this effect the controller of lua code run
+/// until the lock is released
+std::unique_lock<std::mutex> LuaEffect::enter()
+{
+    std::unique_lock<std::mutex> lock(m_state->mutex());
+    Environment(m_state->lua()).setController(this);
+    m_monitor.start();
+    return lock;
+}
 
-    // Load keyleds library, passing ourselves as controller
-    Environment(lua).openKeyleds(this);
+void LuaEffect::setupEnvironment()
+{
+    auto * lua = m_state->lua();
+    SAVE_TOP(lua);
 
-    // Add debug module if configuration requests it
+    // Create global table, isolated from other users of the state
+    m_state->pushEnvironment();             // push(env)
+
+    // Add debug module if configuration requests it, keeping it out of shared globals
     if (getConfig<bool>(m_service, "debug").value_or(false)) {
         lua_pushcfunction(lua, luaopen_debug);
-        lua_call(lua, 0, 0);
+        lua_call(lua, 0, 1);                // push(debug)
+        lua_setfield(lua, -2, "debug");     // pop(debug)
+        lua_pushnil(lua);
+        lua_setglobal(lua, "debug");
     }
 
-    // Insert thread list
-    lua_pushlightuserdata(lua, threadToken);
+    // Create thread list
     lua_newtable(lua);
-    lua_rawset(lua, LUA_REGISTRYINDEX);
+    m_threadList = luaL_ref(lua, LUA_REGISTRYINDEX);
+
+    // Create key event batch and its pool of event tables
+    lua_newtable(lua);
+    m_eventList = luaL_ref(lua, LUA_REGISTRYINDEX);
+    lua_newtable(lua);
+    m_eventPool = luaL_ref(lua, LUA_REGISTRYINDEX);
 
     // Set keyleds members
     lua_createtable(lua, 0, 6);
     lua_pushvalue(lua, -1);
-    lua_setglobal(lua, "keyleds");
+    lua_setfield(lua, -3, "keyleds");
     {
         lua_pushlstring(lua, m_service.deviceName().data(), m_service.deviceName().size());
         lua_setfield(lua, -2, "deviceName");
@@ -191,6 +268,7 @@ void LuaEffect::setupState()
     }
     lua_pop(lua, 1);        // pop(keyleds)
 
+    m_env = luaL_ref(lua, LUA_REGISTRYINDEX);   // pop(env)
     CHECK_TOP(lua, 0);
 }
 
@@ -200,10 +278,11 @@ void LuaEffect::setupState()
 void LuaEffect::init()
 {
     if (!m_enabled) { return; }
-    auto lua = m_state.get();
+    auto lock = enter();
+    auto * lua = m_state->lua();
     SAVE_TOP(lua);
 
-    if (pushHook(lua, "init")) {                    // push(init)
+    if (pushHook("init")) {                         // push(init)
         lua_pushcfunction(lua, luaErrorHandler);    // push(errhandler)
         lua_insert(lua, -2);                        // swap(init, errhandler) => (errhandler, init)
         if (!handleError(lua, m_service,
@@ -217,16 +296,19 @@ void LuaEffect::init()
 void LuaEffect::render(milliseconds elapsed, RenderTarget & target)
 {
     if (!m_enabled) { return; }
-    auto lua = m_state.get();
+    auto lock = enter();
+    auto * lua = m_state->lua();
 
-    Environment(lua).stepInterpolators(elapsed);
+    m_interpolators.step(elapsed);
     stepThreads(elapsed);
+    deliverKeyEvents();
+    if (!m_enabled) { return; }
 
     SAVE_TOP(lua);
     lua_push(lua, &target);                         // push(rendertarget)
 
     lua_pushcfunction(lua, luaErrorHandler);        // push(errhandler)
-    if (pushHook(lua, "render")) {                  // push(render)
+    if (pushHook("render")) {                       // push(render)
         lua_pushinteger(lua, lua_Integer(elapsed.count())); // push(arg1)
         lua_pushvalue(lua, -4);                     // push(arg2)
         if (!handleError(lua, m_service,
@@ -237,18 +319,44 @@ void LuaEffect::render(milliseconds elapsed, RenderTarget & target)
         lua_pop(lua, 1);                            // pop(errhandler)
     }
 
+    m_interpolators.stopAll(target);                // target is only valid during render
     lua_to<RenderTarget *>(lua, -1) = nullptr;      // mark target as gone
     lua_pop(lua, 1);
+    releaseFadeTargets();
     CHECK_TOP(lua, 0);
+
+    // Frames overrunning their period leave no idle time to collect garbage
+    m_state->collectOverdue();
+
+    // Script may have caught budget errors, or overrun it in a thread
+    if (m_monitor.exceeded()) {
+        m_service.log(logging::error::value, "instruction budget exceeded, disabling effect");
+        m_enabled = false;
+    }
+
+    if (!m_profilePath.empty()) {
+        auto now = clock::now();
+        if (now - m_profileDumped >= profileDumpInterval) {
+            dumpProfile();
+            m_profileDumped = now;
+        }
+    }
+}
+
+void LuaEffect::idle(clock::time_point deadline)
+{
+    auto lock = enter();
+    m_state->collect(deadline);
 }
 
 void LuaEffect::handleContextChange(const string_map & data)
 {
     if (!m_enabled) { return; }
-    auto lua = m_state.get();
+    auto lock = enter();
+    auto * lua = m_state->lua();
     SAVE_TOP(lua);
     lua_pushcfunction(lua, luaErrorHandler);        // push(errhandler)
-    if (pushHook(lua, "onContextChange")) {         // push(hook)
+    if (pushHook("onContextChange")) {              // push(hook)
         lua_createtable(lua, 0, static_cast<int>(data.size())); // push table
         for (const auto & item : data) {
             lua_pushlstring(lua, item.first.c_str(), item.first.size());
@@ -262,15 +370,17 @@ void LuaEffect::handleContextChange(const string_map & data)
         lua_pop(lua, 1);                            // pop(errhandler)
     }
     CHECK_TOP(lua, 0);
+    m_state->collectOverdue();                      // render loop may be paused
 }
 
 void LuaEffect::handleGenericEvent(const string_map & data)
 {
     if (!m_enabled) { return; }
-    auto lua = m_state.get();
+    auto lock = enter();
+    auto * lua = m_state->lua();
     SAVE_TOP(lua);
     lua_pushcfunction(lua, luaErrorHandler);        // push(errhandler)
-    if (pushHook(lua, "onGenericEvent")) {          // push(hook)
+    if (pushHook("onGenericEvent")) {               // push(hook)
         lua_createtable(lua, 0, static_cast<int>(data.size())); // push table
         for (const auto & item : data) {
             lua_pushlstring(lua, item.first.c_str(), item.first.size());
@@ -284,24 +394,95 @@ void LuaEffect::handleGenericEvent(const string_map & data)
         lua_pop(lua, 1);                            // pop(errhandler)
     }
     CHECK_TOP(lua, 0);
+    m_state->collectOverdue();                      // render loop may be paused
 }
 
-void LuaEffect::handleKeyEvent(const KeyDatabase::Key & key, bool press)
+/// Queues key events, they are delivered to lua once per frame, before rendering.
+/// Events beyond queue capacity are dropped and counted, with a warning on the first one.
+void LuaEffect::handleKeyEvent(const KeyDatabase::Key & key, bool press, clock::time_point time)
 {
     if (!m_enabled) { return; }
-    auto lua = m_state.get();
+    std::lock_guard<std::mutex> lock(m_state->mutex());
+    if (m_keyEvents.size() < maxQueuedKeyEvents) {
+        m_keyEvents.push_back({&key, press, time});
+        return;
+    }
+    if (m_droppedKeyEvents++ == 0) {
+        m_service.log(logging::warning::value,
+                      "key event queue full, dropping events until next frame");
+    }
+}
+
+/// Runs onKeyEvents hook once with all queued events if script has it,
+/// onKeyEvent hook for each event otherwise.
+/// Events carry their age: how many milliseconds ago they happened.
+/// Event tables are reused across frames, so steady state allocates nothing.
+void LuaEffect::deliverKeyEvents()
+{
+    if (m_keyEvents.empty()) { return; }
+    auto * lua = m_state->lua();
     SAVE_TOP(lua);
+
+    const auto now = clock::now();
+    const auto ageOf = [now](const KeyEvent & event) {
+        return event.time < now
+            ? lua_Integer(std::chrono::duration_cast<std::chrono::milliseconds>(now - event.time).count())
+            : lua_Integer(0);
+    };
+
     lua_pushcfunction(lua, luaErrorHandler);        // push(errhandler)
-    if (pushHook(lua, "onKeyEvent")) {              // push(hook)
-        lua_push(lua, &key);                        // push(arg1)
-        lua_pushboolean(lua, press);                // push(arg2)
+    if (pushHook("onKeyEvents")) {                  // push(hook)
+        lua_rawgeti(lua, LUA_REGISTRYINDEX, m_eventList);   // push(events)
+        lua_rawgeti(lua, LUA_REGISTRYINDEX, m_eventPool);   // push(pool)
+        for (std::size_t idx = 0; idx < m_keyEvents.size(); ++idx) {
+            const auto luaIdx = static_cast<int>(idx + 1);
+            lua_rawgeti(lua, -1, luaIdx);           // push(event)
+            if (lua_isnil(lua, -1)) {
+                lua_pop(lua, 1);                    // pop(nil)
+                lua_createtable(lua, 0, 3);         // push(event)
+                lua_pushvalue(lua, -1);
+                lua_rawseti(lua, -3, luaIdx);       // pool[idx] = event
+            }
+            lua_push(lua, m_keyEvents[idx].key);
+            lua_setfield(lua, -2, "key");
+            lua_pushboolean(lua, m_keyEvents[idx].press);
+            lua_setfield(lua, -2, "pressed");
+            lua_pushinteger(lua, ageOf(m_keyEvents[idx]));
+            lua_setfield(lua, -2, "age");
+            lua_rawseti(lua, -3, luaIdx);           // pop(event) events[idx] = event
+        }
+        lua_pop(lua, 1);                            // pop(pool)
+
+        // Clear leftovers from a longer previous batch, keeping the array allocated
+        for (auto idx = m_keyEvents.size(); idx < m_eventCount; ++idx) {
+            lua_pushnil(lua);
+            lua_rawseti(lua, -2, static_cast<int>(idx + 1));
+        }
+        m_eventCount = m_keyEvents.size();
+
         if (!handleError(lua, m_service,
-                         lua_pcall(lua, 2, 0, -4))) {// pop(errhandler, hook, arg1, arg2)
+                         lua_pcall(lua, 1, 0, -3))) {// pop(errhandler, hook, events)
             m_enabled = false;
         }
     } else {
         lua_pop(lua, 1);                            // pop(errhandler)
+        for (const auto & event : m_keyEvents) {
+            if (!m_enabled) { break; }
+            lua_pushcfunction(lua, luaErrorHandler);// push(errhandler)
+            if (!pushHook("onKeyEvent")) {          // push(hook)
+                lua_pop(lua, 1);                    // pop(errhandler)
+                break;
+            }
+            lua_push(lua, event.key);               // push(arg1)
+            lua_pushboolean(lua, event.press);      // push(arg2)
+            lua_pushinteger(lua, ageOf(event));     // push(arg3)
+            if (!handleError(lua, m_service,
+                             lua_pcall(lua, 3, 0, -5))) {// pop(errhandler, hook, arg1, arg2, arg3)
+                m_enabled = false;
+            }
+        }
     }
+    m_keyEvents.clear();
     CHECK_TOP(lua, 0);
 }
 
@@ -329,22 +510,33 @@ keyleds::RenderTarget * LuaEffect::createRenderTarget()
 
 void LuaEffect::destroyRenderTarget(RenderTarget * target)
 {
+    m_interpolators.removeTarget(*target);
+    releaseFadeTargets();
     m_service.destroyRenderTarget(target);
 }
 
+/// Drops references kept on render targets whose fades are all done
+void LuaEffect::releaseFadeTargets()
+{
+    auto * lua = m_state->lua();
+    m_interpolators.releaseIdleTargets([lua](const RenderTarget * target) {
+        Interpolator::releaseTarget(lua, target);
+    });
+}
+
 /// pushes the thread onto the stack - [-nargs-1 ; +1]
 int LuaEffect::createThread(lua_State * lua, int nargs)
 {
     SAVE_TOP(lua);
-    lua_push(lua, Thread{0, true, Thread::milliseconds::zero()});   // push(thread)
+    lua_push(lua, Thread{LUA_NOREF, true, false, m_threads.now(),
+                         Thread::milliseconds::zero()});            // push(thread)
 
     lua_createtable(lua, 0, 1);                     // push(fenv)
-    auto * thread = lua_newthread(m_state.get());   // push(thread)
+    auto * thread = lua_newthread(m_state->lua());  // push(thread)
     lua_setfield(lua, -2, "thread");                // pop(thread)
     lua_setfenv(lua, -2);                           // pop(fenv)
 
-    lua_pushlightuserdata(lua, threadToken); // push(token)
-    lua_rawget(lua, LUA_REGISTRYINDEX);             // pop(token) push(threadlist)
+    lua_rawgeti(lua, LUA_REGISTRYINDEX, m_threadList); // push(threadlist)
     lua_pushvalue(lua, -2);                         // push(thread)
     auto id = luaL_ref(lua, -2);                    // pop(thread)
     lua_to<Thread>(lua, -2).id = id;
@@ -362,60 +554,43 @@ int LuaEffect::createThread(lua_State * lua, int nargs)
 void LuaEffect::destroyThread(lua_State * lua, Thread & thread)
 {
     SAVE_TOP(lua);
-    lua_pushlightuserdata(lua, threadToken);
-    lua_rawget(lua, LUA_REGISTRYINDEX);
+    lua_rawgeti(lua, LUA_REGISTRYINDEX, m_threadList);
 
+    m_threads.cancel(thread);
     luaL_unref(lua, -1, thread.id);
     lua_pop(lua, 1);
+    thread.id = LUA_NOREF;
     thread.running = false;
     CHECK_TOP(lua, 0);
 }
 
 void LuaEffect::stepThreads(milliseconds elapsed)
 {
-    auto * lua = m_state.get();
+    m_threads.advance(elapsed);
+
+    auto * lua = m_state->lua();
     SAVE_TOP(lua);
-    lua_pushlightuserdata(lua, threadToken);
-    lua_rawget(lua, LUA_REGISTRYINDEX);
-
-    auto size = lua_objlen(lua, -1);
-    assert(size <= std::numeric_limits<int>::max());
-    for (int index = 1; index <= int(size); ++index) {
-        lua_rawgeti(lua, -1, index);                    // push(threadInfo)
-        if (!lua_is<Thread>(lua, -1)) {
-            lua_pop(lua, 1);                            // (pop(threadInfo))
-            continue;
-        }
+    lua_rawgeti(lua, LUA_REGISTRYINDEX, m_threadList);  // push(threadlist)
 
-        auto & threadInfo = lua_to<Thread>(lua, -1);
+    // Threads that wait again before the current time are popped again
+    while (auto * threadInfo = m_threads.popDue()) {
+        lua_rawgeti(lua, -1, threadInfo->id);           // push(threadInfo)
+        assert(&lua_to<Thread>(lua, -1) == threadInfo);
+        lua_getfenv(lua, -1);                           // push(fenv)
+        lua_getfield(lua, -1, "thread");                // push(thread)
+        auto * thread = static_cast<lua_State *>(const_cast<void *>(lua_topointer(lua, -1)));
 
-        if (threadInfo.running) {
-            if (threadInfo.sleepTime <= elapsed) {
-                lua_getfenv(lua, -1);                   // push(fenv)
-                lua_getfield(lua, -1, "thread");        // push(thread)
-                auto * thread = static_cast<lua_State *>(const_cast<void *>(lua_topointer(lua, -1)));
+        runThread(*threadInfo, thread, 0);
 
-                while (threadInfo.running && threadInfo.sleepTime <= elapsed) {
-                    runThread(threadInfo, thread, 0);
-                }
-
-                lua_pop(lua, 2);                        // pop(fenv, thread)
-            }
-            if (threadInfo.sleepTime > elapsed) {
-                threadInfo.sleepTime -= elapsed;
-            } else {
-                threadInfo.sleepTime = Thread::milliseconds::zero();
-            }
-        }
-        lua_pop(lua, 1);                                // pop(threadInfo)
+        lua_pop(lua, 3);                                // pop(threadInfo, fenv, thread)
     }
-    lua_pop(lua, 1);                                    // pop(animlist)
+    lua_pop(lua, 1);                                    // pop(threadlist)
     CHECK_TOP(lua, 0);
 }
 
 void LuaEffect::runThread(Thread & threadInfo, lua_State * thread, int nargs)
 {
-    auto * lua = m_state.get();
+    auto * lua = m_state->lua();
     SAVE_TOP(lua);
 
     bool terminate = true;
@@ -429,7 +604,17 @@ void LuaEffect::runThread(Thread & threadInfo, lua_State * thread, int nargs)
                 lua_pop(lua, 1);
                 break;
             }
-            threadInfo.sleepTime += Thread::milliseconds(unsigned(1000.0 * lua_tonumber(thread, 2)));
+            if (threadInfo.id == LUA_NOREF) { break; }  // stopped itself while running
+
+            // Wake time is relative to the time the thread was due, not to
+            // the time it actually ran, so periodic threads do not drift.
+            threadInfo.wakeTime += Thread::milliseconds(unsigned(1000.0 * lua_tonumber(thread, 2)));
+            if (threadInfo.running) {
+                m_threads.schedule(threadInfo);
+            } else {                                // paused itself while running
+                threadInfo.running = true;
+                m_threads.pause(threadInfo);
+            }
             terminate = false;
             break;
         case LUA_ERRRUN:
@@ -444,18 +629,21 @@ void LuaEffect::runThread(Thread & threadInfo, lua_State * thread, int nargs)
             m_service.log(logging::critical::value, "unexpected error");
     }
     if (terminate) {
-        destroyThread(m_state.get(), threadInfo);
+        destroyThread(lua, threadInfo);
     }
     CHECK_TOP(lua, 0);
 }
 
 /****************************************************************************/
-// Static Helper methods
+// Helper methods
 
-bool LuaEffect::pushHook(lua_State * lua, const char * name)
+bool LuaEffect::pushHook(const char * name)
 {
+    auto * lua = m_state->lua();
     SAVE_TOP(lua);
-    lua_getglobal(lua, name);               // push(hook)
+    lua_rawgeti(lua, LUA_REGISTRYINDEX, m_env); // push(env)
+    lua_getfield(lua, -1, name);            // push(hook)
+    lua_remove(lua, -2);                    // pop(env)
     if (!lua_isfunction(lua, -1)) {
         lua_pop(lua, 1);                    // pop(hook)
         CHECK_TOP(lua, 0);
@@ -488,12 +676,38 @@ bool LuaEffect::handleError(lua_State * lua, EffectService & service, int code)
     return ok;
 }
 
-void LuaEffect::lua_state_deleter::operator()(lua_State *p) const { lua_close(p); }
+/// Writes sampled profile to configured file, replacing previous dump
+void LuaEffect::dumpProfile() const
+{
+    using std::chrono::duration;
+    using std::chrono::duration_cast;
 
-/****************************************************************************/
+    std::ofstream file(m_profilePath, std::ios::out | std::ios::trunc);
+    if (!file) {
+        m_service.log(logging::warning::value, ("cannot write profile to " + m_profilePath).c_str());
+        return;
+    }
 
-/// Convert a lua panic into abort - gives better messages than letting lua exit().
-static int luaPanicHandler(lua_State *) { abort(); }
+    const auto locations = m_monitor.profile();
+    const auto total = std::accumulate(
+        locations.begin(), locations.end(), Monitor::clock::duration::zero(),
+        [](auto sum, const auto & location) { return sum + location.time; });
+
+    file <<"# lua profile for effect " <<m_name <<"\n"
+         <<"# time (ms)   share  samples  location\n"
+         <<std::fixed;
+    for (const auto & location : locations) {
+        auto ms = duration_cast<duration<double, std::milli>>(location.time).count();
+        auto share = total.count() > 0 ? 100.0 * double(location.time.count())
+                                               / double(total.count()) : 0.0;
+        file <<std::setw(11) <<std::setprecision(3) <<ms
+             <<std::setw(7) <<std::setprecision(1) <<share <<'%'
+             <<std::setw(9) <<location.samples
+             <<"  " <<location.name <<'\n';
+    }
+}
+
+/****************************************************************************/
 
 /// Builds the error message for script errors
 static int luaErrorHandler(lua_State * lua)
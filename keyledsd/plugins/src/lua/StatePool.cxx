@@ -0,0 +1,429 @@
+/* Keyleds -- Gaming keyboard tool
+ * Copyright (C) 2017 Julien Hartmann, juli1.hartmann@gmail.com
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+#include "lua/StatePool.h"
+
+#include "lua/Environment.h"
+#include "lua/lua_common.h"
+#include "lua/lua_Monitor.h"
+#include <algorithm>
+#include <array>
+#include <cassert>
+#include <cstdlib>
+#include <cstring>
+#include <lua.hpp>
+
+using keyleds::plugin::lua::StatePool;
+using keyleds::lua::Allocator;
+using keyleds::lua::Environment;
+using keyleds::lua::Monitor;
+
+/****************************************************************************/
+// Constants defining LUA environment
+
+// LUA libraries to load
+static constexpr std::array<lua_CFunction, 4> loadModules = {{
+    luaopen_base, luaopen_math, luaopen_string, luaopen_table,
+}};
+static_assert(loadModules.back() == luaopen_table,
+              "unexpected last element, is size correct?");
+
+// Symbols not in this list get removed once libraries are loaded
+static constexpr std::array<const char *, 25> globalWhitelist = {{
+    // Libraries
+    "coroutine", "math", "string", "table",
+    // Functions
+    "assert", "error", "getmetatable", "ipairs",
+    "next", "pairs", "pcall", "print",
+    "rawequal", "rawget", "rawset", "select",
+    "setmetatable", "tonumber", "tostring", "type",
+    "unpack", "wait", "xpcall",
+    // Values
+    "_G", "_VERSION"
+}};
+
+// Pool sizing
+static constexpr std::size_t maxIdleStates = 4;     // idle states beyond that are closed
+static constexpr unsigned maxSharedUsers = 16;      // effects sharing a single state
+
+// Garbage collection is started once memory use doubles since last cycle
+static constexpr std::size_t gcPauseRatio = 2;
+static constexpr std::size_t gcMinimumThreshold = 64 * 1024;
+// A full cycle is forced once memory use gets that much past the threshold
+static constexpr std::size_t gcOverdueRatio = 4;
+
+/// Convert a lua panic into abort - gives better messages than letting lua exit().
+static int luaPanicHandler(lua_State *) { abort(); }
+
+/// Registry key of the pristine copy of library tables, taken when creating a state
+static void * const snapshotToken = const_cast<void **>(&snapshotToken);
+
+/****************************************************************************/
+// State snapshots
+//
+// Scripts share library tables, type metatables and the global table with
+// every later user of a pooled state. A shallow copy of each such table is
+// taken once the state is initialized, and written back when it goes idle.
+// Weak tables hold per-object bookkeeping, they are left alone.
+
+static bool isWeakTable(lua_State * lua, int index)
+{
+    if (lua_getmetatable(lua, index) == 0) { return false; }
+    lua_getfield(lua, -1, "__mode");
+    bool result = lua_isstring(lua, -1) != 0;
+    lua_pop(lua, 2);
+    return result;
+}
+
+/// Records a copy of table at index and those it references into snapshot at top of stack
+static void snapshotTable(lua_State * lua, int index)
+{
+    if (index < 0 && index > LUA_REGISTRYINDEX) { index = lua_gettop(lua) + index + 1; }
+    int snapshot = lua_gettop(lua);
+    luaL_checkstack(lua, 8, nullptr);
+
+    lua_pushvalue(lua, index);
+    lua_rawget(lua, snapshot);
+    bool known = !lua_isnil(lua, -1);
+    lua_pop(lua, 1);
+    if (known || isWeakTable(lua, index)) { return; }
+
+    lua_pushvalue(lua, index);                      // push(table)
+    lua_newtable(lua);                              // push(copy)
+    lua_pushnil(lua);
+    while (lua_next(lua, index) != 0) {             // push(key, value)
+        lua_pushvalue(lua, -2);
+        lua_insert(lua, -2);
+        lua_rawset(lua, -4);                        // pop(key, value)
+    }
+    if (lua_getmetatable(lua, index) != 0) {        // push(metatable)
+        lua_setmetatable(lua, -2);                  // pop(metatable)
+    }
+    lua_rawset(lua, snapshot);                      // pop(table, copy)
+
+    // Follow references to other tables
+    lua_pushnil(lua);
+    while (lua_next(lua, index) != 0) {             // push(key, value)
+        if (lua_istable(lua, -1)) {
+            lua_pushvalue(lua, snapshot);
+            snapshotTable(lua, -2);
+            lua_pop(lua, 1);
+        }
+        lua_pop(lua, 1);                            // pop(value)
+    }
+    if (lua_getmetatable(lua, index) != 0) {        // push(metatable)
+        lua_pushvalue(lua, snapshot);
+        snapshotTable(lua, -2);
+        lua_pop(lua, 2);
+    }
+}
+
+static void takeSnapshot(lua_State * lua)
+{
+    SAVE_TOP(lua);
+
+    lua_pushlightuserdata(lua, snapshotToken);
+    lua_newtable(lua);                              // push(snapshot)
+
+    // Globals and every library reachable from them
+    snapshotTable(lua, LUA_GLOBALSINDEX);
+
+    // Type metatables and loaded modules
+    lua_pushnil(lua);
+    while (lua_next(lua, LUA_REGISTRYINDEX) != 0) { // push(key, value)
+        if (lua_type(lua, -2) == LUA_TSTRING && lua_istable(lua, -1)) {
+            lua_pushvalue(lua, -3);
+            snapshotTable(lua, -2);
+            lua_pop(lua, 1);
+        }
+        lua_pop(lua, 1);                            // pop(value)
+    }
+
+    // Metatable shared by all strings
+    lua_pushliteral(lua, "");
+    if (lua_getmetatable(lua, -1) != 0) {
+        lua_pushvalue(lua, -3);
+        snapshotTable(lua, -2);
+        lua_pop(lua, 2);
+    }
+    lua_pop(lua, 1);
+
+    lua_rawset(lua, LUA_REGISTRYINDEX);             // pop(token, snapshot)
+    CHECK_TOP(lua, 0);
+}
+
+static void restoreSnapshot(lua_State * lua)
+{
+    SAVE_TOP(lua);
+
+    lua_pushlightuserdata(lua, snapshotToken);
+    lua_rawget(lua, LUA_REGISTRYINDEX);             // push(snapshot)
+    lua_pushnil(lua);
+    while (lua_next(lua, -2) != 0) {                // push(table, copy)
+        // Remove keys added since snapshot
+        lua_pushnil(lua);
+        while (lua_next(lua, -3) != 0) {            // push(key, value)
+            lua_pop(lua, 1);
+            lua_pushvalue(lua, -1);
+            lua_rawget(lua, -3);
+            bool added = lua_isnil(lua, -1);
+            lua_pop(lua, 1);
+            if (added) {
+                lua_pushvalue(lua, -1);
+                lua_pushnil(lua);
+                lua_rawset(lua, -5);
+            }
+        }
+        // Put back original values and metatable
+        lua_pushnil(lua);
+        while (lua_next(lua, -2) != 0) {            // push(key, value)
+            lua_pushvalue(lua, -2);
+            lua_insert(lua, -2);
+            lua_rawset(lua, -5);                    // pop(key, value)
+        }
+        if (lua_getmetatable(lua, -1) == 0) { lua_pushnil(lua); }
+        lua_setmetatable(lua, -3);
+        lua_pop(lua, 1);                            // pop(copy)
+    }
+    lua_pop(lua, 1);                                // pop(snapshot)
+
+    CHECK_TOP(lua, 0);
+}
+
+/// Gives environment at top of stack its own shallow copy of every library table
+static void copyLibraries(lua_State * lua)
+{
+    SAVE_TOP(lua);
+
+    lua_pushnil(lua);
+    while (lua_next(lua, LUA_GLOBALSINDEX) != 0) {  // push(name, library)
+        if (!lua_istable(lua, -1) || lua_rawequal(lua, -1, LUA_GLOBALSINDEX)) {
+            lua_pop(lua, 1);
+            continue;
+        }
+        lua_newtable(lua);                          // push(copy)
+        lua_pushnil(lua);
+        while (lua_next(lua, -3) != 0) {            // push(key, value)
+            lua_pushvalue(lua, -2);
+            lua_insert(lua, -2);
+            lua_rawset(lua, -4);                    // pop(key, value)
+        }
+        lua_pushvalue(lua, -3);
+        lua_insert(lua, -2);
+        lua_rawset(lua, -5);                        // pop(name, copy)
+        lua_pop(lua, 1);                            // pop(library)
+    }
+
+    CHECK_TOP(lua, 0);
+}
+
+/****************************************************************************/
+
+StatePool::State::State(state_ptr lua)
+ : m_lua(std::move(lua)),
+   m_gcThreshold(std::max(gcPauseRatio * memoryInUse(), gcMinimumThreshold))
+{}
+
+std::size_t StatePool::State::memoryInUse() const
+{
+    return std::size_t(lua_gc(m_lua.get(), LUA_GCCOUNT, 0)) * 1024
+         + std::size_t(lua_gc(m_lua.get(), LUA_GCCOUNTB, 0));
+}
+
+void StatePool::State::collect(clock::time_point deadline)
+{
+    auto * lua = m_lua.get();
+
+    if (!m_collecting) {
+        if (memoryInUse() < m_gcThreshold) { return; }
+        m_collecting = true;
+    }
+
+    // Run at least one step, so collection keeps up even without idle time
+    do {
+        if (lua_gc(lua, LUA_GCSTEP, 0) != 0) {
+            m_collecting = false;
+            m_gcThreshold = std::max(gcPauseRatio * memoryInUse(), gcMinimumThreshold);
+            break;
+        }
+    } while (clock::now() < deadline);
+
+    lua_gc(lua, LUA_GCSTOP, 0);     // stepping re-enables automatic collection
+}
+
+void StatePool::State::collectAll()
+{
+    lua_gc(m_lua.get(), LUA_GCCOLLECT, 0);
+    lua_gc(m_lua.get(), LUA_GCSTOP, 0);
+    m_collecting = false;
+    m_gcThreshold = std::max(gcPauseRatio * memoryInUse(), gcMinimumThreshold);
+}
+
+void StatePool::State::pushEnvironment()
+{
+    auto * lua = m_lua.get();
+    SAVE_TOP(lua);
+
+    // Shared globals are reachable through the metatable, hide it
+    lua_newtable(lua);                      // push(env)
+    lua_createtable(lua, 0, 2);             // push(metatable)
+    lua_pushvalue(lua, LUA_GLOBALSINDEX);
+    lua_setfield(lua, -2, "__index");
+    lua_pushboolean(lua, 0);
+    lua_setfield(lua, -2, "__metatable");
+    lua_setmetatable(lua, -2);              // pop(metatable)
+    lua_pushvalue(lua, -1);
+    lua_setfield(lua, -2, "_G");
+    copyLibraries(lua);
+
+    CHECK_TOP(lua, 1);
+}
+
+void StatePool::State::collectOverdue()
+{
+    if (memoryInUse() >= gcOverdueRatio * m_gcThreshold) { collectAll(); }
+}
+
+/****************************************************************************/
+
+StatePool::~StatePool()
+{
+    assert(std::all_of(m_states.begin(), m_states.end(),
+                       [](const auto & state) { return state->m_users == 0; }));
+}
+
+StatePool::State * StatePool::acquire(const std::string & shareKey)
+{
+    // Look for a shared state with room left
+    if (!shareKey.empty()) {
+        auto it = std::find_if(m_states.begin(), m_states.end(), [&shareKey](const auto & state) {
+            return state->m_shareKey == shareKey && state->m_users < maxSharedUsers;
+        });
+        if (it != m_states.end()) {
+            ++(*it)->m_users;
+            return it->get();
+        }
+    }
+
+    // Look for an idle state
+    auto it = std::find_if(m_states.begin(), m_states.end(),
+                           [](const auto & state) { return state->m_users == 0; });
+    if (it == m_states.end()) {
+        auto lua = createState();
+        if (!lua) { return nullptr; }
+        m_states.push_back(std::make_unique<State>(std::move(lua)));
+        it = m_states.end() - 1;
+    }
+    (*it)->m_shareKey = shareKey;
+    (*it)->m_users = 1;
+    return it->get();
+}
+
+void StatePool::release(State * state)
+{
+    auto it = std::find_if(m_states.begin(), m_states.end(),
+                           [state](const auto & item) { return item.get() == state; });
+    assert(it != m_states.end());
+    assert(state->m_users > 0);
+
+    if (--state->m_users > 0) { return; }
+
+    auto idleStates = std::count_if(m_states.begin(), m_states.end(),
+                                    [](const auto & item) { return item->m_users == 0; });
+    if (std::size_t(idleStates) > maxIdleStates) {
+        m_states.erase(it);
+        return;
+    }
+
+    // Reset state: drop whatever last users left behind
+    Environment(state->lua()).setController(nullptr);
+    Monitor::uninstall(state->lua());
+    restoreSnapshot(state->lua());
+    state->collectAll();
+}
+
+StatePool::state_ptr StatePool::newState()
+{
+    // Use our own allocator if lua lets us
+    auto allocator = std::make_unique<Allocator>();
+    state_ptr state(lua_newstate(Allocator::alloc, allocator.get()));
+    if (state) {
+        allocator.release();                // now owned by the state
+    } else {
+        state.reset(luaL_newstate());       // LuaJIT on some 64-bit platforms
+    }
+    if (state) { lua_atpanic(state.get(), luaPanicHandler); }
+    return state;
+}
+
+StatePool::state_ptr StatePool::createState()
+{
+    auto state = newState();
+    if (!state) { return state; }
+    auto * lua = state.get();
+
+    // Garbage collection is driven by users, never from allocations
+    lua_gc(lua, LUA_GCSTOP, 0);
+
+    SAVE_TOP(lua);
+
+    // Load libraries in default environment
+    for (const auto & module : loadModules) {
+        lua_pushcfunction(lua, module);
+        lua_call(lua, 0, 0);
+    }
+
+    // Remove global symbols not in whitelist
+    lua_pushnil(lua);
+    while (lua_next(lua, LUA_GLOBALSINDEX) != 0) {
+        lua_pop(lua, 1);
+        if (lua_isstring(lua, -1)) {
+            const char * key = lua_tostring(lua, -1);
+            auto it = std::find_if(globalWhitelist.begin(), globalWhitelist.end(),
+                                   [key](const auto * item) { return std::strcmp(key, item) == 0; });
+            if (it == globalWhitelist.end()) {
+                lua_pushnil(lua);
+                lua_setglobal(lua, key);
+            }
+        }
+    }
+
+    // Load keyleds library
+    Environment(lua).openKeyleds();
+
+    // String metatable is shared by all strings, hide it from scripts
+    lua_pushliteral(lua, "");
+    if (lua_getmetatable(lua, -1) != 0) {   // push(metatable)
+        lua_pushboolean(lua, 0);
+        lua_setfield(lua, -2, "__metatable");
+        lua_pop(lua, 1);                    // pop(metatable)
+    }
+    lua_pop(lua, 1);                        // pop("")
+
+    // Remember pristine library tables, so they can be reset between users
+    takeSnapshot(lua);
+
+    CHECK_TOP(lua, 0);
+    return state;
+}
+
+void StatePool::lua_state_deleter::operator()(lua_State *p) const
+{
+    void * ud;
+    auto allocf = lua_getallocf(p, &ud);
+    lua_close(p);
+    if (allocf == Allocator::alloc) { delete static_cast<Allocator *>(ud); }
+}
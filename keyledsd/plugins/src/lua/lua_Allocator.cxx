@@ -0,0 +1,157 @@
+/* Keyleds -- Gaming keyboard tool
+ * Copyright (C) 2017 Julien Hartmann, juli1.hartmann@gmail.com
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+#include "lua/lua_Allocator.h"
+
+#include "keyledsd/tools/MemoryAccounting.h"
+#include <algorithm>
+#include <cassert>
+#include <cstdlib>
+#include <cstring>
+
+namespace keyleds::lua {
+
+static_assert(alignof(std::max_align_t) <= 16, "size class granularity must ensure alignment");
+
+static tools::memory::Counter memoryCounter("lua");
+
+/****************************************************************************/
+
+Allocator::~Allocator()
+{
+    for (auto * slab : m_slabs) { std::free(slab); }
+}
+
+void * Allocator::alloc(void * ud, void * ptr, size_t osize, size_t nsize) noexcept
+{
+    auto & self = *static_cast<Allocator *>(ud);
+    if (ptr == nullptr) { osize = 0; }      // lua 5.2+ passes object type in osize
+
+    void * result = nullptr;
+    if (nsize == 0) {
+        if (ptr != nullptr) { self.deallocate(ptr, osize); }
+    } else if (ptr == nullptr) {
+        result = self.allocate(nsize);
+    } else {
+        result = self.reallocate(ptr, osize, nsize);
+    }
+    if (nsize == 0 || result != nullptr) { self.track(osize, nsize); }
+    return result;
+}
+
+/****************************************************************************/
+
+static constexpr std::size_t sizeClass(std::size_t size, std::size_t granularity)
+{
+    return (size - 1) / granularity;
+}
+
+void * Allocator::allocate(size_type size) noexcept
+{
+    assert(size > 0);
+    if (size > maxPooledSize) {
+        auto * ptr = std::malloc(size);
+        if (ptr) { m_reserved += size; }
+        return ptr;
+    }
+
+    auto & freeList = m_freeLists[sizeClass(size, granularity)];
+    if (freeList) {
+        auto * block = freeList;
+        freeList = block->next;
+        return block;
+    }
+
+    const auto blockSize = (sizeClass(size, granularity) + 1) * granularity;
+    if (size_type(m_slabEnd - m_slabCursor) < blockSize) {
+        auto * slab = static_cast<char *>(std::malloc(slabSize));
+        if (!slab) { return nullptr; }
+        try {
+            m_slabs.push_back(slab);
+        } catch (...) {
+            std::free(slab);
+            return nullptr;
+        }
+        m_slabCursor = slab;
+        m_slabEnd = slab + slabSize;
+        m_reserved += slabSize;
+    }
+    auto * block = m_slabCursor;
+    m_slabCursor += blockSize;
+    return block;
+}
+
+void Allocator::deallocate(void * ptr, size_type size) noexcept
+{
+    if (size > maxPooledSize) {
+        std::free(ptr);
+        m_reserved -= size;
+        return;
+    }
+    auto & freeList = m_freeLists[sizeClass(size, granularity)];
+    auto * block = static_cast<FreeBlock *>(ptr);
+    block->next = freeList;
+    freeList = block;
+}
+
+void * Allocator::reallocate(void * ptr, size_type osize, size_type nsize) noexcept
+{
+    if (osize > maxPooledSize && nsize > maxPooledSize) {
+        auto * result = std::realloc(ptr, nsize);
+        if (result) { m_reserved = m_reserved - osize + nsize; }
+        return result;
+    }
+    if (osize <= maxPooledSize && nsize <= maxPooledSize &&
+        sizeClass(osize, granularity) == sizeClass(nsize, granularity)) {
+        return ptr;
+    }
+
+    auto * result = allocate(nsize);
+    if (result) {
+        std::memcpy(result, ptr, std::min(osize, nsize));
+        deallocate(ptr, osize);
+        return result;
+    }
+    if (nsize > osize) { return nullptr; }
+
+    // Lua assumes shrinking never fails, so keep the block where it is. It will
+    // be handled as a pooled block from now on, make it a slab of its own so it
+    // still gets released on destruction.
+    if (osize > maxPooledSize) {
+        try {
+            m_slabs.push_back(ptr);
+        } catch (...) {}                    // then it is only lost on destruction
+    }
+    return ptr;
+}
+
+void Allocator::track(size_type osize, size_type nsize) noexcept
+{
+    m_inUse = m_inUse - osize + nsize;
+    m_peak = std::max(m_peak, m_inUse);
+
+    if (nsize == 0) {
+        if (osize > 0) { memoryCounter.released(osize); }
+    } else if (osize == 0) {
+        memoryCounter.allocated(nsize);
+    } else {
+        memoryCounter.resized(osize, nsize);
+    }
+}
+
+/****************************************************************************/
+
+} // namespace keyleds::lua
@@ -18,8 +18,8 @@
 
 #include "lua/Environment.h"
 #include "lua/lua_common.h"
+#include <algorithm>
 #include <cassert>
-#include <limits>
 #include <lua.hpp>
 
 using namespace std::chrono_literals;
@@ -30,25 +30,8 @@ using milliseconds = Interpolator::milliseconds;
 
 static constexpr milliseconds maximumDuration = 1h;  // One hour
 
-static void * const interpolatorToken = const_cast<void **>(&interpolatorToken);
-static const char targetLink[] = "target";
-
-/****************************************************************************/
-
-static void pushRegistry(lua_State * lua)
-{
-    SAVE_TOP(lua);
-    lua_pushlightuserdata(lua, interpolatorToken);
-    lua_rawget(lua, LUA_REGISTRYINDEX);
-    if (!lua_istable(lua, -1)) {
-        lua_pop(lua, 1);
-        lua_createtable(lua, 1, 1);
-        lua_pushlightuserdata(lua, interpolatorToken);
-        lua_pushvalue(lua, -2);
-        lua_rawset(lua, LUA_REGISTRYINDEX);
-    }
-    CHECK_TOP(lua, +1);
-}
+// Registry key of the table holding render targets with running interpolators
+static void * const targetsToken = const_cast<void **>(&targetsToken);
 
 /****************************************************************************/
 
@@ -75,14 +58,10 @@ int luaNewInterpolator(lua_State * lua)
 
     // Create object
     lua_push(lua, Interpolator{
-        LUA_NOREF, flags, 0,
+        InterpolatorPool::invalid_handle, flags,
         std::chrono::duration_cast<Interpolator::milliseconds>(duration),
-        Interpolator::milliseconds::zero(),
         startValue, finishValue
     });                                                         // push(interpol)
-    lua_createtable(lua, 0, 1);                                 // push(fenv)
-    lua_setfenv(lua, -2);                                       // pop(fenv)
-
     return 1;
 }
 
@@ -117,56 +96,62 @@ void Interpolator::start(lua_State * lua, unsigned keyIndex)
     auto & interpolator = lua_to<Interpolator>(lua, -2);
     auto * target = lua_to<RenderTarget *>(lua, -1);
 
-    if (interpolator.id != LUA_NOREF) {
-        luaL_error(lua, "interpolator already active");
+    auto * controller = Environment(lua).controller();
+    if (!controller) {
+        luaL_error(lua, noEffectTokenErrorMessage);
         // does not return
     }
+    auto & pool = controller->interpolators();
 
-    SAVE_TOP(lua);
-    pushRegistry(lua);                                              // push(registry)
-
-    // see whether another interpolator already runs on this key
-    auto size = lua_objlen(lua, -1);
-    assert(size <= std::numeric_limits<int>::max());
-    for (decltype(size) index = 1; index <= size; ++index) {
-        lua_rawgeti(lua, -1, static_cast<int>(index));              // push(otherinter)
-        if (lua_isuserdata(lua, -1)) {      // any user data is an Interpolator
-            auto & other = lua_to<Interpolator>(lua, -1);
-            if (other.index == keyIndex) {
-                lua_getfenv(lua, -1);                               // push(otherfenv)
-                lua_getfield(lua, -1, targetLink);                  // push(othertarget)
-                auto * otherTarget = lua_to<RenderTarget *>(lua, -1);
-                lua_pop(lua, 2);                                    // pop(otherfenv, othertarget)
-                if (otherTarget == target) {
-                    Interpolator::stop(lua);    // (pop(otherinter))
-                    continue;
-                }
-            }
-        }
-        lua_pop(lua, 1);                                            // pop(otherinter)
+    if (pool.isRunning(interpolator.handle)) {
+        luaL_error(lua, "interpolator already active");
+        // does not return
     }
 
-    lua_pushvalue(lua, -3);                                         // push(interpolator)
-    interpolator.id = luaL_ref(lua, -2);                            // pop(interpolator)
+    SAVE_TOP(lua);
 
     // fill in missing values
-    interpolator.index = keyIndex;
-    interpolator.elapsed = Interpolator::milliseconds::zero();
+    auto startValue = interpolator.startValue;
     if ((interpolator.flags & Interpolator::hasStartValueFlag) == 0) {
-        interpolator.startValue = (*lua_to<RenderTarget *>(lua, -2))[keyIndex];
+        startValue = (*target)[keyIndex];
     } else {
-        (*target)[keyIndex] = interpolator.startValue;
+        (*target)[keyIndex] = startValue;
     }
 
-    // create a reference to the render target
-    lua_getfenv(lua, -3);                                           // push(fenv)
-    lua_pushvalue(lua, -3);                                         // push(target)
-    lua_setfield(lua, -2, targetLink);                              // pop(target)
+    interpolator.handle = pool.start(*target, keyIndex, interpolator.duration,
+                                     startValue, interpolator.finishValue);
 
-    lua_pop(lua, 4);                                                // pop(arg1, arg2, registry, fenv)
+    // Keep the target alive while it is animated
+    lua_pushlightuserdata(lua, targetsToken);
+    lua_rawget(lua, LUA_REGISTRYINDEX);                             // push(targets)
+    if (lua_isnil(lua, -1)) {
+        lua_pop(lua, 1);
+        lua_newtable(lua);
+        lua_pushlightuserdata(lua, targetsToken);
+        lua_pushvalue(lua, -2);
+        lua_rawset(lua, LUA_REGISTRYINDEX);
+    }
+    lua_pushlightuserdata(lua, target);
+    lua_pushvalue(lua, -3);
+    lua_rawset(lua, -3);                                            // targets[ptr] = target
+    lua_pop(lua, 3);                                                // pop(arg1, arg2, targets)
     CHECK_TOP(lua, -2);
 }
 
+void Interpolator::releaseTarget(lua_State * lua, const RenderTarget * target)
+{
+    SAVE_TOP(lua);
+    lua_pushlightuserdata(lua, targetsToken);
+    lua_rawget(lua, LUA_REGISTRYINDEX);                             // push(targets)
+    if (!lua_isnil(lua, -1)) {
+        lua_pushlightuserdata(lua, const_cast<RenderTarget *>(target));
+        lua_pushnil(lua);
+        lua_rawset(lua, -3);
+    }
+    lua_pop(lua, 1);                                                // pop(targets)
+    CHECK_TOP(lua, 0);
+}
+
 void Interpolator::stop(lua_State * lua)
 {
     SAVE_TOP(lua);
@@ -175,56 +160,134 @@ void Interpolator::stop(lua_State * lua)
 
     auto & interpolator = lua_to<Interpolator>(lua, -1);
 
-    lua_getfenv(lua, -1);                                   // push(fenv)
-    pushRegistry(lua);                                      // push(registry)
+    auto * controller = Environment(lua).controller();
+    if (!controller) {
+        luaL_error(lua, noEffectTokenErrorMessage);
+        // does not return
+    }
+    controller->interpolators().stop(interpolator.handle);
+    interpolator.handle = InterpolatorPool::invalid_handle;
 
-    // unregister interpolator from running list
-    luaL_unref(lua, -1, interpolator.id);
-    interpolator.id = LUA_NOREF;
+    lua_pop(lua, 1);                                        // pop(interpolator)
+    CHECK_TOP(lua, -1);
+}
 
-    // remove reference to the render target
-    lua_pushnil(lua);                                       // push(nil)
-    lua_setfield(lua, -3, targetLink);                      // pop(nil)
+/****************************************************************************/
 
-    lua_pop(lua, 3);                                        // pop(interpolator, fenv, registry)
-    CHECK_TOP(lua, -1);
+InterpolatorPool::handle_type
+InterpolatorPool::start(RenderTarget & target, unsigned keyIndex, milliseconds duration,
+                        RGBAColor startValue, RGBAColor finishValue)
+{
+    auto & targetKeys = m_keys[&target];
+    auto & keys = targetKeys.handles;
+    if (keys.size() <= keyIndex) {
+        keys.resize(std::max(target.size(), size_type(keyIndex) + 1), invalid_handle);
+    }
+
+    auto handle = m_nextHandle++;
+    if (m_nextHandle == invalid_handle) { ++m_nextHandle; }
+
+    auto entry = Entry{
+        handle, &target, keyIndex, duration, milliseconds::zero(), startValue, finishValue
+    };
+
+    // Only one interpolator may run on a given key, it is replaced in place
+    auto & running = keys[keyIndex];
+    if (running != invalid_handle) {
+        auto node = m_slots.extract(running);
+        assert(node);
+        m_entries[node.mapped()] = entry;
+        node.key() = handle;
+        m_slots.insert(std::move(node));
+    } else {
+        m_entries.push_back(entry);
+        try {
+            m_slots.emplace(handle, m_entries.size() - 1);
+        } catch (...) {
+            m_entries.pop_back();
+            throw;
+        }
+        ++targetKeys.running;
+    }
+    running = handle;
+    return handle;
 }
 
-void Interpolator::stepAll(lua_State * lua, milliseconds elapsed)
+bool InterpolatorPool::isRunning(handle_type handle) const noexcept
 {
-    SAVE_TOP(lua);
-    pushRegistry(lua);                                              // push(registry)
-
-    auto size = lua_objlen(lua, -1);
-    assert(size <= std::numeric_limits<int>::max());
-    for (decltype(size) index = 1; index <= size; ++index) {
-        lua_rawgeti(lua, -1, static_cast<int>(index));              // push(interpolator)
-        if (lua_isuserdata(lua, -1)) {      // any user data is an Interpolator
-            auto & interpolator = lua_to<Interpolator>(lua, -1);
-
-            lua_getfenv(lua, -1);                                   // push(fenv)
-            lua_getfield(lua, -1, targetLink);                      // push(target)
-            auto * target = lua_to<RenderTarget *>(lua, -1);
-            assert(target);
-            lua_pop(lua, 2);                                        // pop(fenv, target)
-
-            interpolator.elapsed += elapsed;
-            if (interpolator.elapsed >= interpolator.duration) {
-                (*target)[interpolator.index] = interpolator.finishValue;
-                Interpolator::stop(lua);                            // pop(interpolator)
-                continue;
-            }
-
-            (*target)[interpolator.index] = interpolator.value();
+    return m_slots.find(handle) != m_slots.end();
+}
+
+void InterpolatorPool::stop(handle_type handle) noexcept
+{
+    auto it = m_slots.find(handle);
+    if (it != m_slots.end()) { remove(it->second); }
+}
+
+void InterpolatorPool::stopAll(const RenderTarget & target) noexcept
+{
+    auto keysIt = m_keys.find(&target);
+    if (keysIt == m_keys.end()) { return; }
+
+    for (auto handle : keysIt->second.handles) {
+        if (handle == invalid_handle) { continue; }
+        auto it = m_slots.find(handle);
+        assert(it != m_slots.end());
+        remove(it->second);
+    }
+}
+
+void InterpolatorPool::removeTarget(const RenderTarget & target) noexcept
+{
+    stopAll(target);
+    m_keys.erase(&target);
+}
+
+void InterpolatorPool::step(milliseconds elapsed) noexcept
+{
+    // Order does not matter, as there is at most one entry per key:
+    // finished entries are replaced with the last one.
+    std::size_t idx = 0;
+    while (idx < m_entries.size()) {
+        auto & entry = m_entries[idx];
+        entry.elapsed += elapsed;
+        if (entry.elapsed >= entry.duration) {
+            (*entry.target)[entry.index] = entry.finishValue;
+            remove(idx);
+            continue;
         }
-        lua_pop(lua, 1);                                            // pop(interpolator)
+        (*entry.target)[entry.index] = entry.value();
+        ++idx;
     }
+}
 
-    lua_pop(lua, 1);                                                // pop(registry)
-    CHECK_TOP(lua, 0);
+/// Removes entry at given position, moving the last entry into its slot
+void InterpolatorPool::remove(size_type slot) noexcept
+{
+    assert(slot < m_entries.size());
+    const auto & entry = m_entries[slot];
+
+    auto keysIt = m_keys.find(entry.target);
+    assert(keysIt != m_keys.end());
+    keysIt->second.handles[entry.index] = invalid_handle;
+    if (--keysIt->second.running == 0 && !keysIt->second.idle) {
+        try {
+            m_idleTargets.push_back(entry.target);
+            keysIt->second.idle = true;
+        } catch (...) {
+            // Target stays referenced until stopped or destroyed, only costs memory
+        }
+    }
+    m_slots.erase(entry.handle);
+
+    if (slot != m_entries.size() - 1) {
+        m_entries[slot] = m_entries.back();
+        m_slots.find(m_entries[slot].handle)->second = slot;
+    }
+    m_entries.pop_back();
 }
 
-RGBAColor Interpolator::value() const
+RGBAColor InterpolatorPool::Entry::value() const noexcept
 {
     using ct = RGBAColor::channel_type;
     return {
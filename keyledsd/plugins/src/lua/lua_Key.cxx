@@ -16,6 +16,7 @@
  */
 #include "lua/lua_Key.h"
 
+#include "lua/Environment.h"
 #include "lua/lua_common.h"
 #include <cstring>
 #include <lua.hpp>
@@ -26,6 +27,29 @@ namespace keyleds::lua {
 
 /****************************************************************************/
 
+/// Pushes normalized geometry field, if field names one
+static bool pushGeometry(lua_State * lua, const KeyDatabase::Key & key, const char * field)
+{
+    using Geometry = KeyDatabase::Geometry;
+    const KeyDatabase::simd_vector<float> Geometry::* array = nullptr;
+    if (std::strcmp(field, "x") == 0) {
+        array = &Geometry::x;
+    } else if (std::strcmp(field, "y") == 0) {
+        array = &Geometry::y;
+    } else if (std::strcmp(field, "width") == 0) {
+        array = &Geometry::width;
+    } else if (std::strcmp(field, "height") == 0) {
+        array = &Geometry::height;
+    } else {
+        return false;
+    }
+
+    auto * controller = Environment(lua).controller();
+    if (!controller) { luaL_error(lua, noEffectTokenErrorMessage); }
+    lua_pushnumber(lua, (controller->keyDB().geometry().*array)[key.index]);
+    return true;
+}
+
 static int index(lua_State * lua)
 {
     const auto * key = lua_to<const KeyDatabase::Key *>(lua, 1);
@@ -45,7 +69,9 @@ static int index(lua_State * lua)
         lua_pushnumber(lua, key->position.x1);
     } else if (std::strcmp(field, "y1") == 0) {
         lua_pushnumber(lua, key->position.y1);
-    } else {
+    } else if (std::strcmp(field, "block") == 0) {
+        lua_pushnumber(lua, key->block);
+    } else if (!pushGeometry(lua, *key, field)) {
         return luaL_error(lua, badKeyErrorMessage, field);
     }
     return 1;
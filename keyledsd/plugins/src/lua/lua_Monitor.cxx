@@ -0,0 +1,97 @@
+/* Keyleds -- Gaming keyboard tool
+ * Copyright (C) 2017 Julien Hartmann, juli1.hartmann@gmail.com
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+#include "lua/lua_Monitor.h"
+
+#include <algorithm>
+#include <lua.hpp>
+#include "lua/Environment.h"
+
+using keyleds::lua::Environment;
+using keyleds::lua::Monitor;
+
+static const char budgetErrorMessage[] = "instruction budget exceeded";
+
+/****************************************************************************/
+
+void Monitor::start() noexcept
+{
+    m_executed = 0;
+    m_exceeded = false;
+    if (m_profiling) { m_lastSample = clock::now(); }
+}
+
+Monitor::location_list Monitor::profile() const
+{
+    location_list result;
+    result.reserve(m_locations.size());
+    for (const auto & item : m_locations) { result.push_back(item.second); }
+    std::sort(result.begin(), result.end(),
+              [](const auto & lhs, const auto & rhs) { return lhs.time > rhs.time; });
+    return result;
+}
+
+bool Monitor::sample(lua_State * lua, lua_Debug * ar)
+{
+    m_executed += hookInterval;
+    if (m_budget != 0 && m_executed > m_budget) { m_exceeded = true; }
+
+    if (m_profiling && lua_getinfo(lua, "Sl", ar) != 0) {
+        auto now = clock::now();
+        auto name = std::string(ar->short_src) + ':' + std::to_string(ar->currentline);
+        auto it = m_locations.find(name);
+        if (it == m_locations.end()) {
+            it = m_locations.emplace(name, Location{name, clock::duration::zero(), 0}).first;
+        }
+        it->second.time += now - m_lastSample;
+        it->second.samples += 1;
+        m_lastSample = now;
+    }
+    return !m_exceeded;
+}
+
+void Monitor::hook(lua_State * lua, lua_Debug * ar)
+{
+    auto * controller = Environment(lua).controller();
+    if (!controller) { return; }
+    if (!controller->monitor().sample(lua, ar)) {
+        luaL_error(lua, budgetErrorMessage);    // does not return
+    }
+}
+
+void Monitor::install(lua_State * lua)
+{
+    lua_sethook(lua, hook, LUA_MASKCOUNT, hookInterval);
+}
+
+void Monitor::enforce(lua_State * lua)
+{
+#ifdef LUAJIT_VERSION
+    // Traces compiled before must go too, loops in them would never be hooked
+    luaJIT_setmode(lua, 0, LUAJIT_MODE_ENGINE | LUAJIT_MODE_OFF);
+    luaJIT_setmode(lua, 0, LUAJIT_MODE_ENGINE | LUAJIT_MODE_FLUSH);
+#else
+    static_cast<void>(lua);
+#endif
+}
+
+void Monitor::uninstall(lua_State * lua)
+{
+    lua_sethook(lua, nullptr, 0, 0);
+#ifdef LUAJIT_VERSION
+    luaJIT_setmode(lua, 0, LUAJIT_MODE_ENGINE | LUAJIT_MODE_ON);
+#endif
+}
@@ -21,6 +21,8 @@
 #include <algorithm>
 #include <array>
 #include <cassert>
+#include <cmath>
+#include <cstdint>
 #include <cstring>
 #include <iomanip>
 #include <limits>
@@ -34,6 +36,14 @@ namespace keyleds::lua {
 /****************************************************************************/
 
 static constexpr std::array<const char *, 4> keys = {{ "red", "green", "blue", "alpha" }};
+static constexpr unsigned channel_max = std::numeric_limits<RGBAColor::channel_type>::max();
+static_assert(std::is_same_v<RGBAColor::channel_type, unsigned char>, "toChannel must return channel_type");
+
+unsigned char toChannel(lua_Number value)
+{
+    if (!(value > 0.0)) { return 0; }
+    return RGBAColor::channel_type(std::min(value, 1.0) * lua_Number(channel_max) + 0.5);
+}
 
 static int indexForKey(lua_State * lua, const char * key)
 {
@@ -206,12 +216,9 @@ RGBAColor lua_tocolor(lua_State * lua, int index)
         luaL_argerror(lua, 2, badTypeErrorMessage);
     }
 
-    static constexpr unsigned channel_max = std::numeric_limits<RGBAColor::channel_type>::max();
     auto result = RGBAColor(
-        RGBAColor::channel_type(std::min(channel_max, unsigned(256.0 * lua_tonumber(lua, -4)))),
-        RGBAColor::channel_type(std::min(channel_max, unsigned(256.0 * lua_tonumber(lua, -3)))),
-        RGBAColor::channel_type(std::min(channel_max, unsigned(256.0 * lua_tonumber(lua, -2)))),
-        RGBAColor::channel_type(std::min(channel_max, unsigned(256.0 * lua_tonumber(lua, -1))))
+        toChannel(lua_tonumber(lua, -4)), toChannel(lua_tonumber(lua, -3)),
+        toChannel(lua_tonumber(lua, -2)), toChannel(lua_tonumber(lua, -1))
     );
     lua_pop(lua, 4);
     CHECK_TOP(lua, 0);
@@ -220,6 +227,7 @@ RGBAColor lua_tocolor(lua_State * lua, int index)
 
 RGBAColor lua_checkcolor(lua_State * lua, int index)
 {
+    if (lua_type(lua, index) == LUA_TNUMBER) { return lua_topacked(lua, index); }
     if (!lua_is<RGBAColor>(lua, index)) {
         luaL_argerror(lua, index, badTypeErrorMessage);
         // does not return
@@ -227,6 +235,127 @@ RGBAColor lua_checkcolor(lua_State * lua, int index)
     return lua_tocolor(lua, index);
 }
 
+/****************************************************************************/
+// Packed colors
+
+void lua_pushpacked(lua_State * lua, RGBAColor value)
+{
+    const auto packed = std::uint32_t(value.red) << 24 | std::uint32_t(value.green) << 16
+                      | std::uint32_t(value.blue) << 8 | std::uint32_t(value.alpha);
+    lua_pushnumber(lua, lua_Number(packed));
+}
+
+RGBAColor lua_topacked(lua_State * lua, int index)
+{
+    const auto value = luaL_checknumber(lua, index);
+    if (!(0.0 <= value && value <= lua_Number(std::numeric_limits<std::uint32_t>::max())) ||
+        value != std::floor(value)) {
+        luaL_argerror(lua, index, badTypeErrorMessage);
+        // does not return
+    }
+    const auto packed = static_cast<std::uint32_t>(value);
+    return RGBAColor(RGBAColor::channel_type(packed >> 24), RGBAColor::channel_type(packed >> 16),
+                     RGBAColor::channel_type(packed >> 8), RGBAColor::channel_type(packed));
+}
+
+static int packedPack(lua_State * lua)      // (r, g, b [, a]) | (color) => (packed)
+{
+    if (lua_gettop(lua) >= 3) {
+        lua_pushpacked(lua, RGBAColor(
+            toChannel(luaL_checknumber(lua, 1)), toChannel(luaL_checknumber(lua, 2)),
+            toChannel(luaL_checknumber(lua, 3)), toChannel(luaL_optnumber(lua, 4, 1.0))
+        ));
+        return 1;
+    }
+    if (lua_type(lua, 1) == LUA_TSTRING) {  // let tocolor parse color names
+        lua_getglobal(lua, "tocolor");
+        lua_pushvalue(lua, 1);
+        lua_call(lua, 1, 1);
+        if (lua_isnil(lua, -1)) { return 1; }
+        lua_replace(lua, 1);
+    }
+    lua_pushpacked(lua, lua_checkcolor(lua, 1));
+    return 1;
+}
+
+static int packedUnpack(lua_State * lua)    // (packed) => (r, g, b, a)
+{
+    const auto color = lua_checkcolor(lua, 1);
+    lua_pushnumber(lua, lua_Number(color.red) / 255.0);
+    lua_pushnumber(lua, lua_Number(color.green) / 255.0);
+    lua_pushnumber(lua, lua_Number(color.blue) / 255.0);
+    lua_pushnumber(lua, lua_Number(color.alpha) / 255.0);
+    return 4;
+}
+
+static int packedToTable(lua_State * lua)   // (packed) => (color)
+{
+    lua_push(lua, lua_checkcolor(lua, 1));
+    return 1;
+}
+
+/// Same as color objects: adds rgb channels of second color, weighted by its alpha
+static int packedAdd(lua_State * lua)       // (packed, packed) => (packed)
+{
+    const auto lhs = lua_checkcolor(lua, 1), rhs = lua_checkcolor(lua, 2);
+    auto channel = [&rhs](unsigned left, unsigned right) {
+        return RGBAColor::channel_type(std::min(channel_max, left + right * rhs.alpha / channel_max));
+    };
+    lua_pushpacked(lua, RGBAColor(channel(lhs.red, rhs.red), channel(lhs.green, rhs.green),
+                                  channel(lhs.blue, rhs.blue), lhs.alpha));
+    return 1;
+}
+
+/// Same as color objects: subtracts rgb channels of second color, weighted by its alpha
+static int packedSub(lua_State * lua)       // (packed, packed) => (packed)
+{
+    const auto lhs = lua_checkcolor(lua, 1), rhs = lua_checkcolor(lua, 2);
+    auto channel = [&rhs](unsigned left, unsigned right) {
+        const auto amount = right * rhs.alpha / channel_max;
+        return RGBAColor::channel_type(left > amount ? left - amount : 0u);
+    };
+    lua_pushpacked(lua, RGBAColor(channel(lhs.red, rhs.red), channel(lhs.green, rhs.green),
+                                  channel(lhs.blue, rhs.blue), lhs.alpha));
+    return 1;
+}
+
+/// Same as color objects: scales rgb channels, leaving alpha alone
+static int packedMul(lua_State * lua)       // (packed, number) => (packed)
+{
+    const auto color = lua_checkcolor(lua, 1);
+    const auto factor = luaL_checknumber(lua, 2);
+    auto channel = [factor](unsigned value) {
+        return RGBAColor::channel_type(std::clamp(factor * value, 0.0, lua_Number(channel_max)));
+    };
+    lua_pushpacked(lua, RGBAColor(channel(color.red), channel(color.green),
+                                  channel(color.blue), color.alpha));
+    return 1;
+}
+
+/// Linear interpolation of all four channels, ratio is clamped to [0, 1]
+static int packedLerp(lua_State * lua)      // (packed, packed, number) => (packed)
+{
+    const auto from = lua_checkcolor(lua, 1), to = lua_checkcolor(lua, 2);
+    const auto ratio = std::clamp(luaL_checknumber(lua, 3), 0.0, 1.0);
+    auto channel = [ratio](unsigned left, unsigned right) {
+        return RGBAColor::channel_type(lua_Number(left) + ratio * (lua_Number(right) - lua_Number(left)));
+    };
+    lua_pushpacked(lua, RGBAColor(channel(from.red, to.red), channel(from.green, to.green),
+                                  channel(from.blue, to.blue), channel(from.alpha, to.alpha)));
+    return 1;
+}
+
+const struct luaL_Reg packedColorFunctions[] = {
+    { "add",        packedAdd },
+    { "lerp",       packedLerp },
+    { "mul",        packedMul },
+    { "pack",       packedPack },
+    { "sub",        packedSub },
+    { "totable",    packedToTable },
+    { "unpack",     packedUnpack },
+    { nullptr,      nullptr }
+};
+
 
 /****************************************************************************/
 
@@ -35,24 +35,19 @@ static int toTargetIndex(lua_State * lua, int idx) // 0-based
     if (lua_is<const KeyDatabase::Key *>(lua, idx)) {
         return static_cast<int>(lua_to<const KeyDatabase::Key *>(lua, idx)->index);
     }
-    if (lua_isnumber(lua, idx)) {
+    if (lua_type(lua, idx) == LUA_TNUMBER) {
         return static_cast<int>(lua_tointeger(lua, idx) - 1);
     }
     if (lua_isstring(lua, idx)) {
         size_t size;
         const char * keyName = lua_tolstring(lua, idx, &size);
 
-        lua_getglobal(lua, "keyleds");
-        lua_getfield(lua, -1, "db");
-        if (!lua_is<const KeyDatabase *>(lua, -1)) {
-            return luaL_error(lua, "keyleds.db is not a valid database");
-        }
-
-        auto * db = lua_to<const KeyDatabase *>(lua, -1);
-        lua_pop(lua, 2);
+        auto * controller = Environment(lua).controller();
+        if (!controller) { return luaL_error(lua, noEffectTokenErrorMessage); }
 
-        auto it = db->findName(keyName);
-        if (it != db->end()) {
+        const auto & db = controller->keyDB();
+        auto it = db.findName(keyName);
+        if (it != db.end()) {
             return static_cast<int>(it->index);
         }
         return -1;
@@ -62,36 +57,81 @@ static int toTargetIndex(lua_State * lua, int idx) // 0-based
 
 /****************************************************************************/
 
-static int blend(lua_State * lua)
+static const char * const blendModes[] = { "blend", "multiply", nullptr };
+
+/// Returns the key group at index, or nullptr if there is no key group at index
+static const KeyDatabase::KeyGroup * toKeyGroup(lua_State * lua, int idx)
+{
+    if (lua_isnoneornil(lua, idx)) { return nullptr; }
+    if (!lua_is<const KeyDatabase::KeyGroup *>(lua, idx)) {
+        luaL_argerror(lua, idx, badTypeErrorMessage);
+        // does not return
+    }
+    return lua_to<const KeyDatabase::KeyGroup *>(lua, idx);
+}
+
+/****************************************************************************/
+
+static int blend(lua_State * lua)           // (target, source [, mode])
 {
     using keyleds::blend;
+    using keyleds::multiply;
 
     auto * to = lua_check<RenderTarget *>(lua, 1);
     if (!to) { return luaL_argerror(lua, 1, noLongerExistsErrorMessage); }
     auto * from = lua_check<RenderTarget *>(lua, 2);
     if (!from) { return luaL_argerror(lua, 2, noLongerExistsErrorMessage); }
 
-    blend(*to, *from);
+    switch (luaL_checkoption(lua, 3, blendModes[0], blendModes)) {
+        case 0: blend(*to, *from); break;
+        case 1: multiply(*to, *from); break;
+    }
     return 0;
 }
 
-static int copy(lua_State * lua)
+static int copy(lua_State * lua)            // (target, source [, group])
 {
     auto * to = lua_check<RenderTarget *>(lua, 1);
     if (!to) { return luaL_argerror(lua, 1, noLongerExistsErrorMessage); }
     auto * from = lua_check<RenderTarget *>(lua, 2);
     if (!from) { return luaL_argerror(lua, 2, noLongerExistsErrorMessage); }
 
-    std::copy(from->begin(), from->end(), to->begin());
+    const auto * group = toKeyGroup(lua, 3);
+    if (!group) {
+        std::copy(from->begin(), from->end(), to->begin());
+        return 0;
+    }
+    for (const auto & key : *group) {
+        if (key.index < to->size()) { (*to)[key.index] = (*from)[key.index]; }
+    }
     return 0;
 }
 
-static int fill(lua_State * lua)
+static int fill(lua_State * lua)            // (target, color [, group | first, last])
 {
     auto * to = lua_check<RenderTarget *>(lua, 1);
     if (!to) { return luaL_argerror(lua, 1, noLongerExistsErrorMessage); }
+    const auto color = lua_checkcolor(lua, 2);
+
+    if (lua_type(lua, 3) == LUA_TNUMBER) {
+        // Range is 1-based and inclusive, like lua's string.sub
+        auto first = std::max(luaL_checkinteger(lua, 3), lua_Integer(1));
+        auto last = std::min(luaL_optinteger(lua, 4, lua_Integer(to->size())),
+                             lua_Integer(to->size()));
+        if (first <= last) {
+            std::fill(to->begin() + (first - 1), to->begin() + last, color);
+        }
+        return 0;
+    }
 
-    std::fill(to->begin(), to->end(), lua_checkcolor(lua, 2));
+    const auto * group = toKeyGroup(lua, 3);
+    if (!group) {
+        std::fill(to->begin(), to->end(), color);
+        return 0;
+    }
+    for (const auto & key : *group) {
+        if (key.index < to->size()) { (*to)[key.index] = color; }
+    }
     return 0;
 }
 
@@ -108,6 +148,39 @@ static int multiply(lua_State * lua)
     return 0;
 }
 
+static int scale(lua_State * lua)           // (target, number | color)
+{
+    using keyleds::scale;
+
+    auto * to = lua_check<RenderTarget *>(lua, 1);
+    if (!to) { return luaL_argerror(lua, 1, noLongerExistsErrorMessage); }
+
+    RGBAColor factor;
+    if (lua_type(lua, 2) == LUA_TNUMBER) {
+        auto value = toChannel(lua_tonumber(lua, 2));
+        factor = RGBAColor(value, value, value, value);
+    } else {
+        factor = lua_checkcolor(lua, 2);
+    }
+
+    scale(*to, factor);
+    return 0;
+}
+
+static int get(lua_State * lua)             // (target, key) => (packed | nil)
+{
+    auto * target = lua_check<RenderTarget *>(lua, 1);
+    if (!target) { return luaL_argerror(lua, 1, noLongerExistsErrorMessage); }
+
+    int index = toTargetIndex(lua, 2);
+    if (index < 0 || static_cast<unsigned>(index) >= target->size()) {
+        lua_pushnil(lua);
+        return 1;
+    }
+    lua_pushpacked(lua, (*target)[static_cast<unsigned>(index)]);
+    return 1;
+}
+
 static int create(lua_State * lua)
 {
     auto * controller = Environment(lua).controller();
@@ -117,6 +190,7 @@ static int create(lua_State * lua)
     std::fill(target->begin(), target->end(), RGBAColor(0, 0, 0, 0));
 
     lua_push(lua, target);
+    Environment(lua).setOwner(-1);
     return 1;
 }
 
@@ -127,8 +201,8 @@ static int destroy(lua_State * lua)
     auto * target = lua_to<RenderTarget *>(lua, 1);
     if (!target) { return 0; }                  // object marked as gone already
 
-    auto * controller = Environment(lua).controller();
-    assert(controller);
+    auto * controller = Environment(lua).owner(1);
+    if (!controller) { return 0; }              // owner is gone, so is the target
 
     controller->destroyRenderTarget(target);
 
@@ -192,8 +266,10 @@ const struct luaL_Reg metatable<RenderTarget *>::methods[] = {
     { "blend",      blend },
     { "copy",       copy },
     { "fill",       fill },
+    { "get",        get },
     { "multiply",   multiply },
     { "new",        create },
+    { "scale",      scale },
     { nullptr,      nullptr }
 };
 const struct luaL_Reg metatable<RenderTarget *>::meta_methods[] = {
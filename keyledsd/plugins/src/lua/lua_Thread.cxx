@@ -18,6 +18,8 @@
 
 #include "lua/Environment.h"
 #include "lua/lua_common.h"
+#include <algorithm>
+#include <cassert>
 
 namespace keyleds::lua {
 
@@ -27,25 +29,41 @@ int luaNewThread(lua_State * lua)
 {
     if (!lua_isfunction(lua, 1)) { return luaL_argerror(lua, 1, badTypeErrorMessage); }
 
-    Environment(lua).controller()->createThread(lua, lua_gettop(lua) - 1);
+    auto * controller = Environment(lua).controller();
+    if (!controller) { return luaL_error(lua, noEffectTokenErrorMessage); }
+
+    controller->createThread(lua, lua_gettop(lua) - 1);
     return 1;
 }
 
 static int pause(lua_State * lua)
 {
-    lua_check<Thread>(lua, 1).running = false;
+    auto & thread = lua_check<Thread>(lua, 1);
+    auto * controller = Environment(lua).controller();
+    if (!controller) { return luaL_error(lua, noEffectTokenErrorMessage); }
+
+    controller->threads().pause(thread);
     return 0;
 }
 
 static int resume(lua_State * lua)
 {
-    lua_check<Thread>(lua, 1).running = true;
+    auto & thread = lua_check<Thread>(lua, 1);
+    if (thread.id == LUA_NOREF) { return 0; }   // thread was stopped
+    auto * controller = Environment(lua).controller();
+    if (!controller) { return luaL_error(lua, noEffectTokenErrorMessage); }
+
+    controller->threads().resume(thread);
     return 0;
 }
 
 static int stop(lua_State * lua)
 {
-    Environment(lua).controller()->destroyThread(lua, lua_check<Thread>(lua, 1));
+    auto & thread = lua_check<Thread>(lua, 1);
+    auto * controller = Environment(lua).controller();
+    if (!controller) { return luaL_error(lua, noEffectTokenErrorMessage); }
+
+    controller->destroyThread(lua, thread);
     return 0;
 }
 
@@ -57,6 +75,63 @@ static int index(lua_State * lua)
 
 /****************************************************************************/
 
+bool ThreadScheduler::later::operator()(const Entry & lhs, const Entry & rhs) const noexcept
+{
+    if (lhs.wakeTime != rhs.wakeTime) { return lhs.wakeTime > rhs.wakeTime; }
+    return lhs.sequence > rhs.sequence;
+}
+
+void ThreadScheduler::schedule(Thread & thread)
+{
+    cancel(thread);
+    m_heap.push_back({ thread.wakeTime, m_nextSequence++, &thread });
+    std::push_heap(m_heap.begin(), m_heap.end(), later());
+    thread.scheduled = true;
+}
+
+void ThreadScheduler::cancel(Thread & thread) noexcept
+{
+    if (!thread.scheduled) { return; }
+    auto it = std::find_if(m_heap.begin(), m_heap.end(),
+                           [&thread](const auto & entry) { return entry.thread == &thread; });
+    assert(it != m_heap.end());
+    *it = m_heap.back();
+    m_heap.pop_back();
+    std::make_heap(m_heap.begin(), m_heap.end(), later());
+    thread.scheduled = false;
+}
+
+void ThreadScheduler::pause(Thread & thread) noexcept
+{
+    if (!thread.running) { return; }
+    thread.running = false;
+    thread.sleepTime = thread.wakeTime > m_now
+                     ? std::chrono::duration_cast<milliseconds>(thread.wakeTime - m_now)
+                     : milliseconds::zero();
+    cancel(thread);
+}
+
+void ThreadScheduler::resume(Thread & thread)
+{
+    if (thread.running) { return; }
+    thread.running = true;
+    thread.wakeTime = m_now + thread.sleepTime;
+    schedule(thread);
+}
+
+Thread * ThreadScheduler::popDue() noexcept
+{
+    if (m_heap.empty() || m_heap.front().wakeTime > m_now) { return nullptr; }
+
+    std::pop_heap(m_heap.begin(), m_heap.end(), later());
+    auto * thread = m_heap.back().thread;
+    m_heap.pop_back();
+    thread->scheduled = false;
+    return thread;
+}
+
+/****************************************************************************/
+
 const char * const metatable<Thread>::name = "Thread";
 const struct luaL_Reg metatable<Thread>::methods[] = {
     { "new",        luaNewThread },
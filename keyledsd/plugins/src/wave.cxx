@@ -107,15 +107,12 @@ private:
         auto freqY = length > 0
                    ? 1000.0f / float(length) * std::cos(2.0f * pi / 360.0f * direction)
                    : 0.0f;
-        auto bounds = keyDB.bounds();
+        const auto & geometry = keyDB.geometry();
 
         auto keyPhase = [&](const auto & key) {
-            auto x = (key.position.x0 + key.position.x1) / 2u;
-            auto y = (key.position.y0 + key.position.y1) / 2u;
-
             // Reverse Y axis as keyboard layout uses top<down
-            auto xpos = float(x - bounds.x0) / float(bounds.x1 - bounds.x0);
-            auto ypos = 1.0f - float(y - bounds.x0) / float(bounds.x1 - bounds.x0);
+            auto xpos = geometry.x[key.index];
+            auto ypos = 1.0f - geometry.y[key.index];
 
             auto phase = std::fmod(freqX * xpos + freqY * ypos, 1.0f);
             if (phase < 0.0f) { phase += 1.0f; }
@@ -0,0 +1,88 @@
+/* Keyleds -- Gaming keyboard tool
+ * Copyright (C) 2017 Julien Hartmann, juli1.hartmann@gmail.com
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+#include "lua/lua_Allocator.h"
+#include <gtest/gtest.h>
+#include <cstdint>
+#include <cstring>
+
+using keyleds::lua::Allocator;
+
+TEST(AllocatorTest, tracking) {
+    auto allocator = Allocator();
+    EXPECT_EQ(0u, allocator.inUse());
+
+    auto * small = Allocator::alloc(&allocator, nullptr, 0, 24);
+    ASSERT_NE(nullptr, small);
+    auto * large = Allocator::alloc(&allocator, nullptr, 0, 4096);
+    ASSERT_NE(nullptr, large);
+    EXPECT_EQ(24u + 4096u, allocator.inUse());
+    EXPECT_LE(allocator.inUse(), allocator.reserved());
+
+    EXPECT_EQ(nullptr, Allocator::alloc(&allocator, large, 4096, 0));
+    EXPECT_EQ(24u, allocator.inUse());
+    EXPECT_EQ(24u + 4096u, allocator.peak());
+
+    EXPECT_EQ(nullptr, Allocator::alloc(&allocator, small, 24, 0));
+    EXPECT_EQ(0u, allocator.inUse());
+}
+
+TEST(AllocatorTest, alignment) {
+    auto allocator = Allocator();
+    for (std::size_t size = 1; size < 512; size += 7) {
+        auto * ptr = Allocator::alloc(&allocator, nullptr, 0, size);
+        ASSERT_NE(nullptr, ptr);
+        EXPECT_EQ(0u, reinterpret_cast<std::uintptr_t>(ptr) % alignof(std::max_align_t));
+        Allocator::alloc(&allocator, ptr, size, 0);
+    }
+}
+
+TEST(AllocatorTest, reuse) {
+    auto allocator = Allocator();
+    auto * first = Allocator::alloc(&allocator, nullptr, 0, 40);
+    Allocator::alloc(&allocator, first, 40, 0);
+
+    // Same size class gets the freed block back, without reserving more memory
+    auto reserved = allocator.reserved();
+    auto * second = Allocator::alloc(&allocator, nullptr, 0, 33);
+    EXPECT_EQ(first, second);
+    EXPECT_EQ(reserved, allocator.reserved());
+}
+
+TEST(AllocatorTest, reallocate) {
+    auto allocator = Allocator();
+    auto * ptr = static_cast<char *>(Allocator::alloc(&allocator, nullptr, 0, 8));
+    std::memcpy(ptr, "keyleds", 8);
+
+    // Within size class, block does not move
+    EXPECT_EQ(ptr, Allocator::alloc(&allocator, ptr, 8, 16));
+
+    // Growing to another class, then to a system block, keeps contents
+    ptr = static_cast<char *>(Allocator::alloc(&allocator, ptr, 16, 100));
+    ASSERT_NE(nullptr, ptr);
+    EXPECT_STREQ("keyleds", ptr);
+    ptr = static_cast<char *>(Allocator::alloc(&allocator, ptr, 100, 1000));
+    ASSERT_NE(nullptr, ptr);
+    EXPECT_STREQ("keyleds", ptr);
+    EXPECT_EQ(1000u, allocator.inUse());
+
+    // Shrinking back to a pooled block too
+    ptr = static_cast<char *>(Allocator::alloc(&allocator, ptr, 1000, 10));
+    ASSERT_NE(nullptr, ptr);
+    EXPECT_STREQ("keyleds", ptr);
+    EXPECT_EQ(10u, allocator.inUse());
+    Allocator::alloc(&allocator, ptr, 10, 0);
+}
@@ -0,0 +1,95 @@
+/* Keyleds -- Gaming keyboard tool
+ * Copyright (C) 2017 Julien Hartmann, juli1.hartmann@gmail.com
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+#include "lua/StatePool.h"
+
+#include "keyledsd/RenderTarget.h"
+#include "lua/Environment.h"
+#include <algorithm>
+#include <benchmark/benchmark.h>
+#include <chrono>
+#include <lua.hpp>
+#include <vector>
+
+using keyleds::RenderTarget;
+using keyleds::lua::lua_push;
+using keyleds::plugin::lua::StatePool;
+using clock_type = StatePool::clock;
+
+// Garbage-heavy frame, modelled on bundled effects using color objects
+static const char frame[] = R"(
+    local hot, cold = tocolor(1, 0, 0), tocolor(0, 0, 1)
+    return function(target, ratio)
+        for key = 1, #target do
+            target[key] = hot * ratio + cold * (1 - ratio)
+        end
+    end
+)";
+
+static constexpr auto frameSlack = std::chrono::milliseconds(8);   // time left after a frame at 60fps
+
+/// Renders frames, reporting frame time percentiles in microseconds
+static void runFrames(benchmark::State & state, bool collectInSlack)
+{
+    StatePool pool;
+    auto * luaState = pool.acquire("");
+    auto * lua = luaState->lua();
+    if (luaL_loadbuffer(lua, frame, sizeof(frame) - 1, "frame") != 0 || lua_pcall(lua, 0, 1, 0) != 0) {
+        state.SkipWithError(lua_tostring(lua, -1));
+        return;
+    }                                                   // push(frame)
+    auto target = RenderTarget(RenderTarget::size_type(state.range(0)));
+    lua_push(lua, &target);                             // push(target)
+    if (!collectInSlack) { lua_gc(lua, LUA_GCRESTART, 0); } // collector runs from allocations
+
+    std::vector<double> times;
+    times.reserve(std::size_t(state.max_iterations));
+    for (auto _ : state) {
+        const auto start = clock_type::now();
+        lua_pushvalue(lua, -2);
+        lua_pushvalue(lua, -2);
+        lua_pushnumber(lua, 0.5);
+        lua_call(lua, 2, 0);
+        const auto end = clock_type::now();
+        times.push_back(std::chrono::duration<double, std::micro>(end - start).count());
+
+        if (collectInSlack) {
+            state.PauseTiming();
+            luaState->collect(end + frameSlack);
+            state.ResumeTiming();
+        }
+    }
+    lua_pop(lua, 2);
+    pool.release(luaState);
+
+    auto percentile = [&times](std::size_t pct) {
+        auto it = times.begin() + std::ptrdiff_t((times.size() - 1) * pct / 100);
+        std::nth_element(times.begin(), it, times.end());
+        return *it;
+    };
+    state.counters["p50"] = percentile(50);
+    state.counters["p95"] = percentile(95);
+    state.counters["p99"] = percentile(99);
+    state.counters["max"] = percentile(100);
+}
+
+static void BM_FrameTime_automaticGC(benchmark::State & state) { runFrames(state, false); }
+BENCHMARK(BM_FrameTime_automaticGC)->Arg(128)->Iterations(10000);
+
+static void BM_FrameTime_slackGC(benchmark::State & state) { runFrames(state, true); }
+BENCHMARK(BM_FrameTime_slackGC)->Arg(128)->Iterations(10000);
+
+BENCHMARK_MAIN();
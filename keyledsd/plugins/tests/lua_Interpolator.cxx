@@ -0,0 +1,147 @@
+/* Keyleds -- Gaming keyboard tool
+ * Copyright (C) 2017 Julien Hartmann, juli1.hartmann@gmail.com
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+#include "lua/lua_Interpolator.h"
+
+#include "keyledsd/RenderTarget.h"
+#include <gtest/gtest.h>
+#include <vector>
+
+using keyleds::RenderTarget;
+using keyleds::RGBAColor;
+using keyleds::lua::InterpolatorPool;
+
+using namespace std::chrono_literals;
+
+static const RGBAColor black = {0, 0, 0, 255};
+static const RGBAColor white = {255, 255, 255, 255};
+
+TEST(InterpolatorPoolTest, startStop) {
+    auto target = RenderTarget(8);
+    auto pool = InterpolatorPool();
+
+    const auto first = pool.start(target, 1, 100ms, black, white);
+    const auto second = pool.start(target, 2, 100ms, black, white);
+    const auto third = pool.start(target, 3, 100ms, black, white);
+    EXPECT_EQ(3u, pool.size());
+    EXPECT_FALSE(pool.isRunning(InterpolatorPool::invalid_handle));
+
+    pool.stop(first);   // moves last entry into its slot
+    EXPECT_FALSE(pool.isRunning(first));
+    EXPECT_TRUE(pool.isRunning(second));
+    EXPECT_TRUE(pool.isRunning(third));
+
+    pool.stop(third);
+    pool.stop(third);   // stopping twice is harmless
+    EXPECT_TRUE(pool.isRunning(second));
+    EXPECT_EQ(1u, pool.size());
+}
+
+TEST(InterpolatorPoolTest, replaceOnSameKey) {
+    auto target = RenderTarget(8);
+    auto pool = InterpolatorPool();
+
+    const auto first = pool.start(target, 4, 100ms, black, white);
+    const auto other = pool.start(target, 5, 100ms, black, white);
+    const auto second = pool.start(target, 4, 50ms, white, black);
+    EXPECT_NE(first, second);
+    EXPECT_FALSE(pool.isRunning(first));
+    EXPECT_TRUE(pool.isRunning(second));
+    EXPECT_EQ(2u, pool.size());
+
+    pool.stop(first);   // stale handle does not stop the replacement
+    EXPECT_TRUE(pool.isRunning(second));
+
+    pool.step(60ms);
+    EXPECT_FALSE(pool.isRunning(second));
+    EXPECT_TRUE(pool.isRunning(other));
+    EXPECT_EQ(black, target[4]);
+}
+
+TEST(InterpolatorPoolTest, step) {
+    auto target = RenderTarget(8);
+    auto pool = InterpolatorPool();
+
+    const auto shortHandle = pool.start(target, 0, 10ms, black, white);
+    const auto longHandle = pool.start(target, 1, 100ms, black, white);
+    const auto lastHandle = pool.start(target, 2, 100ms, black, white);
+
+    pool.step(50ms);    // first one finishes, last one takes its slot
+    EXPECT_FALSE(pool.isRunning(shortHandle));
+    EXPECT_EQ(white, target[0]);
+    EXPECT_EQ((RGBAColor{127, 127, 127, 255}), target[1]);
+
+    pool.stop(lastHandle);
+    EXPECT_TRUE(pool.isRunning(longHandle));
+    EXPECT_EQ(1u, pool.size());
+
+    pool.step(50ms);
+    EXPECT_TRUE(pool.empty());
+    EXPECT_EQ(white, target[1]);
+}
+
+TEST(InterpolatorPoolTest, stopAll) {
+    auto first = RenderTarget(8);
+    auto second = RenderTarget(8);
+    auto pool = InterpolatorPool();
+
+    const auto kept = pool.start(second, 0, 100ms, black, white);
+    for (unsigned idx = 0; idx < 8; ++idx) {
+        pool.start(first, idx, 100ms, black, white);
+    }
+    pool.stopAll(first);
+    EXPECT_EQ(1u, pool.size());
+    EXPECT_TRUE(pool.isRunning(kept));
+
+    // Target slots are released and can be used again
+    const auto restarted = pool.start(first, 3, 100ms, black, white);
+    EXPECT_TRUE(pool.isRunning(restarted));
+    pool.stop(kept);
+    EXPECT_TRUE(pool.isRunning(restarted));
+    EXPECT_EQ(1u, pool.size());
+}
+
+TEST(InterpolatorPoolTest, releaseIdleTargets) {
+    auto first = RenderTarget(8);
+    auto second = RenderTarget(8);
+    auto third = RenderTarget(8);
+    auto pool = InterpolatorPool();
+    auto idle = std::vector<const RenderTarget *>();
+    const auto collect = [&idle](const RenderTarget * target) { idle.push_back(target); };
+
+    pool.start(first, 0, 10ms, black, white);
+    pool.start(first, 1, 100ms, black, white);
+    const auto stopped = pool.start(second, 0, 100ms, black, white);
+    pool.start(third, 0, 10ms, black, white);
+    pool.stop(stopped);
+    pool.step(20ms);                        // first still has one running
+    pool.releaseIdleTargets(collect);
+    EXPECT_EQ((std::vector<const RenderTarget *>{&second, &third}), idle);
+
+    // Reported once only, and not if restarted before release
+    idle.clear();
+    pool.start(first, 2, 10ms, black, white);
+    pool.stopAll(first);
+    pool.start(first, 3, 10ms, black, white);
+    pool.releaseIdleTargets(collect);
+    EXPECT_TRUE(idle.empty());
+
+    // Removed targets are reported even though pool no longer knows them
+    pool.removeTarget(first);
+    pool.releaseIdleTargets(collect);
+    EXPECT_EQ((std::vector<const RenderTarget *>{&first}), idle);
+    EXPECT_TRUE(pool.empty());
+}
@@ -0,0 +1,97 @@
+/* Keyleds -- Gaming keyboard tool
+ * Copyright (C) 2017 Julien Hartmann, juli1.hartmann@gmail.com
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+#include "lua/lua_Interpolator.h"
+
+#include "keyledsd/RenderTarget.h"
+#include <benchmark/benchmark.h>
+#include <vector>
+
+using keyleds::RenderTarget;
+using keyleds::RGBAColor;
+using keyleds::lua::InterpolatorPool;
+
+using namespace std::chrono_literals;
+
+
+static void BM_InterpolatorPool_step(benchmark::State & state)
+{
+    const auto count = unsigned(state.range(0));
+    auto target = RenderTarget(RenderTarget::size_type(count));
+    auto pool = InterpolatorPool();
+
+    for (auto _ : state) {
+        state.PauseTiming();
+        for (unsigned idx = 0; idx < count; ++idx) {
+            pool.start(target, idx, InterpolatorPool::milliseconds(1000 + idx),
+                       RGBAColor{0, 0, 0, 255}, RGBAColor{255, 128, 64, 255});
+        }
+        state.ResumeTiming();
+
+        // Step a full second worth of frames at 60fps
+        for (unsigned frame = 0; frame < 60; ++frame) {
+            pool.step(16ms);
+        }
+        benchmark::DoNotOptimize(target.data());
+    }
+    state.SetItemsProcessed(int64_t(state.iterations()) * 60 * count);
+}
+BENCHMARK(BM_InterpolatorPool_step)->RangeMultiplier(2)->Range(128, 2<<10);
+
+static void BM_InterpolatorPool_start(benchmark::State & state)
+{
+    const auto count = unsigned(state.range(0));
+    auto target = RenderTarget(RenderTarget::size_type(count));
+    auto pool = InterpolatorPool();
+
+    for (auto _ : state) {
+        for (unsigned idx = 0; idx < count; ++idx) {
+            pool.start(target, idx, 1000ms,
+                       RGBAColor{0, 0, 0, 255}, RGBAColor{255, 128, 64, 255});
+        }
+        state.PauseTiming();
+        pool.stopAll(target);
+        state.ResumeTiming();
+    }
+    state.SetItemsProcessed(int64_t(state.iterations()) * count);
+}
+BENCHMARK(BM_InterpolatorPool_start)->RangeMultiplier(2)->Range(128, 2<<10);
+
+static void BM_InterpolatorPool_stop(benchmark::State & state)
+{
+    const auto count = unsigned(state.range(0));
+    auto target = RenderTarget(RenderTarget::size_type(count));
+    auto pool = InterpolatorPool();
+    auto handles = std::vector<InterpolatorPool::handle_type>(count);
+
+    for (auto _ : state) {
+        state.PauseTiming();
+        for (unsigned idx = 0; idx < count; ++idx) {
+            handles[idx] = pool.start(target, idx, 1000ms,
+                                      RGBAColor{0, 0, 0, 255}, RGBAColor{255, 128, 64, 255});
+        }
+        state.ResumeTiming();
+
+        for (auto handle : handles) {
+            benchmark::DoNotOptimize(pool.isRunning(handle));
+            pool.stop(handle);
+        }
+    }
+    state.SetItemsProcessed(int64_t(state.iterations()) * count);
+}
+BENCHMARK(BM_InterpolatorPool_stop)->RangeMultiplier(2)->Range(128, 2<<10);
+
+BENCHMARK_MAIN();
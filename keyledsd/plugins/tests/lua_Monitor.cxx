@@ -0,0 +1,115 @@
+/* Keyleds -- Gaming keyboard tool
+ * Copyright (C) 2017 Julien Hartmann, juli1.hartmann@gmail.com
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+#include "lua/lua_Monitor.h"
+
+#include "lua/Environment.h"
+#include "lua/StatePool.h"
+#include <gtest/gtest.h>
+#include <lua.hpp>
+#include <string>
+
+using keyleds::KeyDatabase;
+using keyleds::RenderTarget;
+using keyleds::lua::Environment;
+using keyleds::lua::InterpolatorPool;
+using keyleds::lua::Monitor;
+using keyleds::lua::ThreadScheduler;
+using keyleds::plugin::lua::StatePool;
+
+/// Minimal controller, only providing a monitor
+class FakeController final : public Environment::Controller
+{
+public:
+    void            print(const std::string &) const override {}
+    std::optional<keyleds::RGBAColor> parseColor(const std::string &) const override { return {}; }
+    const KeyDatabase & keyDB() const override { return m_keyDB; }
+    RenderTarget *  createRenderTarget() override { return nullptr; }
+    void            destroyRenderTarget(RenderTarget *) override {}
+    int             createThread(lua_State *, int) override { return 0; }
+    void            destroyThread(lua_State *, Thread &) override {}
+    ThreadScheduler & threads() override { return m_threads; }
+    InterpolatorPool & interpolators() override { return m_interpolators; }
+    Monitor &       monitor() override { return m_monitor; }
+private:
+    KeyDatabase     m_keyDB;
+    ThreadScheduler m_threads;
+    InterpolatorPool m_interpolators;
+    Monitor         m_monitor;
+};
+
+class MonitorTest : public ::testing::Test
+{
+protected:
+    void SetUp() override
+    {
+        m_state = m_pool.acquire("");
+        ASSERT_NE(nullptr, m_state);
+        Environment(m_state->lua()).setController(&m_controller);
+        Monitor::install(m_state->lua());
+    }
+    void TearDown() override { m_pool.release(m_state); }
+
+    /// Runs code in state, returning whether it completed without error
+    bool run(const char * code)
+    {
+        auto * lua = m_state->lua();
+        m_controller.monitor().start();
+        bool success = luaL_loadbuffer(lua, code, std::char_traits<char>::length(code), "test") == 0 &&
+                       lua_pcall(lua, 0, 0, 0) == 0;
+        if (!success) { lua_pop(lua, 1); }
+        return success;
+    }
+
+    StatePool           m_pool;
+    StatePool::State *  m_state = nullptr;
+    FakeController      m_controller;
+};
+
+TEST_F(MonitorTest, withinBudget) {
+    m_controller.monitor().setBudget(1000000);
+    Monitor::enforce(m_state->lua());
+    EXPECT_TRUE(run("local x = 0; for i = 1, 1000 do x = x + i end"));
+    EXPECT_FALSE(m_controller.monitor().exceeded());
+}
+
+TEST_F(MonitorTest, stopsHotLoop) {
+    // Such a loop gets compiled right away by LuaJIT, where hooks do not run
+    m_controller.monitor().setBudget(1000000);
+    Monitor::enforce(m_state->lua());
+    EXPECT_FALSE(run("while true do end"));
+    EXPECT_TRUE(m_controller.monitor().exceeded());
+}
+
+TEST_F(MonitorTest, stopsLoopCompiledBefore) {
+    // Traces compiled while the state was not budgeted must not be entered either
+    EXPECT_TRUE(run("function spin(n) local x = 0; while x < n do x = x + 1 end end spin(100000)"));
+    m_controller.monitor().setBudget(1000000);
+    Monitor::enforce(m_state->lua());
+    EXPECT_FALSE(run("spin(1e12)"));
+    EXPECT_TRUE(m_controller.monitor().exceeded());
+}
+
+TEST_F(MonitorTest, releaseUninstalls) {
+    Monitor::enforce(m_state->lua());
+    auto * state = m_state;
+    m_pool.release(m_state);
+
+    // Next user of the state gets it without hook, and compiler back on
+    m_state = m_pool.acquire("");
+    ASSERT_EQ(state, m_state);
+    EXPECT_EQ(nullptr, lua_gethook(m_state->lua()));
+}
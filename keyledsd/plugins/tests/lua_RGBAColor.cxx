@@ -0,0 +1,81 @@
+/* Keyleds -- Gaming keyboard tool
+ * Copyright (C) 2017 Julien Hartmann, juli1.hartmann@gmail.com
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+#include "lua/lua_RGBAColor.h"
+
+#include "lua/StatePool.h"
+#include <gtest/gtest.h>
+#include <lua.hpp>
+#include <string>
+
+using keyleds::lua::toChannel;
+using keyleds::plugin::lua::StatePool;
+
+/// Runs a chunk in the state's global environment, returning its first result as a string
+static std::string run(StatePool::State * state, const char * code)
+{
+    auto * lua = state->lua();
+    if (luaL_loadbuffer(lua, code, std::char_traits<char>::length(code), "test") != 0 ||
+        lua_pcall(lua, 0, 1, 0) != 0) {
+        std::string error = lua_tostring(lua, -1);
+        lua_pop(lua, 1);
+        return "error: " + error;
+    }
+    std::string result = lua_isstring(lua, -1) ? lua_tostring(lua, -1) : "";
+    lua_pop(lua, 1);
+    return result;
+}
+
+TEST(RGBAColorTest, toChannel) {
+    for (unsigned channel = 0; channel <= 255; ++channel) {
+        EXPECT_EQ(channel, toChannel(lua_Number(channel) / 255.0));
+    }
+    EXPECT_EQ(0u, toChannel(-1.0));
+    EXPECT_EQ(255u, toChannel(2.0));
+    EXPECT_EQ(128u, toChannel(0.5));
+}
+
+TEST(RGBAColorTest, roundTrip) {
+    auto pool = StatePool();
+    auto * state = pool.acquire("");
+    ASSERT_NE(nullptr, state);
+
+    // Unpacked channels go back to the same packed color
+    EXPECT_EQ("ok", run(state, R"(
+        for c = 0, 255 do
+            local packed = rgba.pack(c / 255, 1 - c / 255, c / 255, 1)
+            local r, g, b, a = rgba.unpack(packed)
+            if math.abs(r - c / 255) > 1e-9 or rgba.pack(r, g, b, a) ~= packed then return c end
+            if rgba.pack(rgba.totable(packed)) ~= packed then return c end
+            if rgba.pack(tocolor(r, g, b, a)) ~= packed then return c end
+        end
+        return "ok"
+    )"));
+    pool.release(state);
+}
+
+TEST(RGBAColorTest, packedRange) {
+    auto pool = StatePool();
+    auto * state = pool.acquire("");
+    ASSERT_NE(nullptr, state);
+
+    EXPECT_EQ("true", run(state, "return tostring(pcall(rgba.unpack, 0))"));
+    EXPECT_EQ("true", run(state, "return tostring(pcall(rgba.unpack, 0xffffffff))"));
+    EXPECT_EQ("false", run(state, "return tostring(pcall(rgba.unpack, 0.5))"));
+    EXPECT_EQ("false", run(state, "return tostring(pcall(rgba.unpack, -1))"));
+    EXPECT_EQ("false", run(state, "return tostring(pcall(rgba.unpack, 2^32))"));
+    pool.release(state);
+}
@@ -0,0 +1,252 @@
+/* Keyleds -- Gaming keyboard tool
+ * Copyright (C) 2017 Julien Hartmann, juli1.hartmann@gmail.com
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+#include "lua/Environment.h"
+
+#include "keyledsd/RenderTarget.h"
+#include <algorithm>
+#include <benchmark/benchmark.h>
+#include <fstream>
+#include <iterator>
+#include <lua.hpp>
+#include <memory>
+#include <string>
+#include <vector>
+
+using keyleds::KeyDatabase;
+using keyleds::RGBAColor;
+using keyleds::RenderTarget;
+using keyleds::lua::Environment;
+using keyleds::lua::InterpolatorPool;
+using keyleds::lua::Monitor;
+using keyleds::lua::ThreadScheduler;
+using keyleds::lua::lua_push;
+
+// Per-frame color maths modelled on bundled effects, using color objects
+static const char tableFrame[] = R"(
+    local hot, cold = tocolor(1, 0, 0), tocolor(0, 0, 1)
+    return function(target, ratio)
+        for key = 1, #target do
+            target[key] = hot * ratio + cold * (1 - ratio)      -- heatmap
+            target[key] = target[key] * 0.9                     -- decay
+        end
+    end
+)";
+
+// Same maths, using packed colors
+static const char packedFrame[] = R"(
+    local hot, cold = rgba.pack(1, 0, 0), rgba.pack(0, 0, 1)
+    return function(target, ratio)
+        for key = 1, #target do
+            target[key] = rgba.lerp(cold, hot, ratio)           -- heatmap
+            target[key] = rgba.mul(target:get(key), 0.9)        -- decay
+        end
+    end
+)";
+
+/// Memory used by lua state, in bytes
+static std::size_t memoryInUse(lua_State * lua)
+{
+    return std::size_t(lua_gc(lua, LUA_GCCOUNT, 0)) * 1024
+         + std::size_t(lua_gc(lua, LUA_GCCOUNTB, 0));
+}
+
+/// Renders frames using given script, reporting garbage generated per frame
+template <std::size_t N>
+static void runFrames(benchmark::State & state, const char (&script)[N])
+{
+    std::unique_ptr<lua_State, void(*)(lua_State *)> lua(luaL_newstate(), lua_close);
+    luaL_openlibs(lua.get());
+    Environment(lua.get()).openKeyleds();
+
+    auto target = RenderTarget(RenderTarget::size_type(state.range(0)));
+    if (luaL_loadbuffer(lua.get(), script, N - 1, "frame") != 0 || lua_pcall(lua.get(), 0, 1, 0) != 0) {
+        state.SkipWithError(lua_tostring(lua.get(), -1));
+        return;
+    }                                                   // push(frame)
+    lua_push(lua.get(), &target);                       // push(target)
+
+    lua_gc(lua.get(), LUA_GCCOLLECT, 0);
+    lua_gc(lua.get(), LUA_GCSTOP, 0);
+
+    std::size_t garbage = 0;
+    for (auto _ : state) {
+        const auto before = memoryInUse(lua.get());
+        lua_pushvalue(lua.get(), -2);
+        lua_pushvalue(lua.get(), -2);
+        lua_pushnumber(lua.get(), 0.5);
+        lua_call(lua.get(), 2, 0);
+        garbage += memoryInUse(lua.get()) - before;
+
+        state.PauseTiming();
+        lua_gc(lua.get(), LUA_GCCOLLECT, 0);
+        lua_gc(lua.get(), LUA_GCSTOP, 0);
+        state.ResumeTiming();
+    }
+    state.counters["garbage"] = benchmark::Counter(double(garbage), benchmark::Counter::kAvgIterations);
+    state.SetItemsProcessed(int64_t(state.iterations()) * state.range(0));
+}
+
+static void BM_ColorTable_frame(benchmark::State & state) { runFrames(state, tableFrame); }
+BENCHMARK(BM_ColorTable_frame)->Arg(128);
+
+static void BM_ColorPacked_frame(benchmark::State & state) { runFrames(state, packedFrame); }
+BENCHMARK(BM_ColorPacked_frame)->Arg(128);
+
+/****************************************************************************/
+// Bundled heatmap effect, as shipped before packed colors and as shipped now
+
+static const char heatmapBefore[] = R"(
+cold = tocolor(keyleds.config.cold) or tocolor('blue')
+hot = tocolor(keyleds.config.hot) or tocolor('red')
+transparent = tocolor(0, 0, 0, 0)
+
+function init()
+    contexts = {}
+    currentId, presses, maximum = "\0", {}, 0
+    buffer = RenderTarget:new()
+end
+
+function renderToBuffer(buffer, presses, maximum)
+    buffer:fill(transparent)
+    for key, count in pairs(presses) do
+        local ratio = count / maximum
+        buffer[key] = hot * ratio + cold * (1 - ratio)
+    end
+end
+
+function onKeyEvents(events)
+    local changed = false
+    for _, event in ipairs(events) do
+        if event.pressed then
+            local count = (presses[event.key] or 0) + 1
+            presses[event.key] = count
+            if count > maximum then maximum = count end
+            changed = true
+        end
+    end
+
+    if changed then renderToBuffer(buffer, presses, maximum) end
+end
+)";
+
+/// Lets effect scripts create render targets and parse colors, without a device
+class HeatmapController final : public Environment::Controller
+{
+public:
+    explicit            HeatmapController(std::size_t keys) : m_keys(keys) {}
+
+    void                print(const std::string &) const override {}
+    std::optional<RGBAColor> parseColor(const std::string & str) const override
+                        { return RGBAColor::parse(str); }
+    const KeyDatabase & keyDB() const override { return m_keyDB; }
+
+    RenderTarget *      createRenderTarget() override
+    {
+        m_targets.push_back(std::make_unique<RenderTarget>(m_keys));
+        return m_targets.back().get();
+    }
+    void                destroyRenderTarget(RenderTarget * target) override
+    {
+        m_targets.erase(std::remove_if(m_targets.begin(), m_targets.end(),
+                                       [target](const auto & item) { return item.get() == target; }),
+                        m_targets.end());
+    }
+
+    int                 createThread(lua_State *, int) override { return 0; }
+    void                destroyThread(lua_State *, Thread &) override {}
+    ThreadScheduler &   threads() override { return m_threads; }
+    InterpolatorPool &  interpolators() override { return m_interpolators; }
+    Monitor &           monitor() override { return m_monitor; }
+
+private:
+    std::size_t         m_keys;
+    KeyDatabase         m_keyDB;
+    std::vector<std::unique_ptr<RenderTarget>> m_targets;
+    ThreadScheduler     m_threads;
+    InterpolatorPool    m_interpolators;
+    Monitor             m_monitor;
+};
+
+/// Feeds a key press on every key to heatmap each frame, reporting garbage generated per frame
+static void runHeatmap(benchmark::State & state, const std::string & script)
+{
+    const auto keys = std::size_t(state.range(0));
+    auto controller = HeatmapController(keys);
+
+    std::unique_ptr<lua_State, void(*)(lua_State *)> lua(luaL_newstate(), lua_close);
+    luaL_openlibs(lua.get());
+    Environment(lua.get()).openKeyleds();
+    Environment(lua.get()).setController(&controller);
+
+    // Effect configuration, left to defaults
+    lua_createtable(lua.get(), 0, 1);
+    lua_newtable(lua.get());
+    lua_setfield(lua.get(), -2, "config");
+    lua_setglobal(lua.get(), "keyleds");
+
+    if (luaL_loadbuffer(lua.get(), script.data(), script.size(), "heatmap") != 0 ||
+        lua_pcall(lua.get(), 0, 0, 0) != 0) {
+        state.SkipWithError(lua_tostring(lua.get(), -1));
+        return;
+    }
+    lua_getglobal(lua.get(), "init");
+    lua_call(lua.get(), 0, 0);
+
+    // Event list is built once and reused, like LuaEffect does
+    lua_getglobal(lua.get(), "onKeyEvents");                // push(hook)
+    lua_createtable(lua.get(), int(keys), 0);               // push(events)
+    for (std::size_t idx = 1; idx <= keys; ++idx) {
+        lua_createtable(lua.get(), 0, 2);
+        lua_pushinteger(lua.get(), lua_Integer(idx));
+        lua_setfield(lua.get(), -2, "key");
+        lua_pushboolean(lua.get(), 1);
+        lua_setfield(lua.get(), -2, "pressed");
+        lua_rawseti(lua.get(), -2, int(idx));
+    }
+
+    lua_gc(lua.get(), LUA_GCCOLLECT, 0);
+    lua_gc(lua.get(), LUA_GCSTOP, 0);
+
+    std::size_t garbage = 0;
+    for (auto _ : state) {
+        const auto before = memoryInUse(lua.get());
+        lua_pushvalue(lua.get(), -2);
+        lua_pushvalue(lua.get(), -2);
+        lua_call(lua.get(), 1, 0);
+        garbage += memoryInUse(lua.get()) - before;
+
+        state.PauseTiming();
+        lua_gc(lua.get(), LUA_GCCOLLECT, 0);
+        lua_gc(lua.get(), LUA_GCSTOP, 0);
+        state.ResumeTiming();
+    }
+    state.counters["garbage"] = benchmark::Counter(double(garbage), benchmark::Counter::kAvgIterations);
+    state.SetItemsProcessed(int64_t(state.iterations()) * state.range(0));
+}
+
+static void BM_Heatmap_before(benchmark::State & state) { runHeatmap(state, heatmapBefore); }
+BENCHMARK(BM_Heatmap_before)->Arg(128);
+
+static void BM_Heatmap_after(benchmark::State & state)
+{
+    std::ifstream file(KEYLEDSD_EFFECTS_DIR "/heatmap.lua");
+    if (!file) { state.SkipWithError("cannot open heatmap.lua"); return; }
+    runHeatmap(state, std::string(std::istreambuf_iterator<char>(file), {}));
+}
+BENCHMARK(BM_Heatmap_after)->Arg(128);
+
+BENCHMARK_MAIN();
@@ -0,0 +1,123 @@
+/* Keyleds -- Gaming keyboard tool
+ * Copyright (C) 2017 Julien Hartmann, juli1.hartmann@gmail.com
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+#include "lua/Environment.h"
+
+#include "keyledsd/KeyDatabase.h"
+#include "keyledsd/RenderTarget.h"
+#include <benchmark/benchmark.h>
+#include <lua.hpp>
+#include <memory>
+#include <string>
+#include <vector>
+
+using keyleds::KeyDatabase;
+using keyleds::RenderTarget;
+using keyleds::lua::Environment;
+using keyleds::lua::lua_push;
+
+static constexpr unsigned keyCount = 128;
+
+// Each script returns a function run once per iteration. Native versions use
+// bulk render target methods, loop versions the per-key code they replace.
+static const char preamble[] =
+    "local target, source, group, color = target, source, group, rgba.pack(1, 0, 0, 1)\n";
+
+static const char groupFillNative[] = "return function() target:fill(color, group) end";
+static const char groupFillLoop[] = R"(
+    return function()
+        for i = 1, #group do target[group[i]] = color end
+    end
+)";
+
+static const char rangeFillNative[] = "return function() target:fill(color, 17, 80) end";
+static const char rangeFillLoop[] = R"(
+    return function()
+        for key = 17, 80 do target[key] = color end
+    end
+)";
+
+static const char maskedCopyNative[] = "return function() target:copy(source, group) end";
+static const char maskedCopyLoop[] = R"(
+    return function()
+        for i = 1, #group do
+            local key = group[i]
+            target[key] = source[key]
+        end
+    end
+)";
+
+/// Keyboard with keyCount keys, in rows of 16
+static KeyDatabase makeDatabase()
+{
+    std::vector<KeyDatabase::Key> keys;
+    keys.reserve(keyCount);
+    for (unsigned idx = 0; idx < keyCount; ++idx) {
+        const auto x = (idx % 16) * 20, y = (idx / 16) * 20;
+        keys.push_back({idx, int(idx + 1), "K" + std::to_string(idx), {x, y, x + 18, y + 18}});
+    }
+    return KeyDatabase(std::move(keys));
+}
+
+template <std::size_t N>
+static void runScript(benchmark::State & state, const char (&script)[N])
+{
+    static const auto db = makeDatabase();
+    std::vector<std::string> names;             // group holds every other key
+    for (unsigned idx = 0; idx < keyCount; idx += 2) { names.push_back("K" + std::to_string(idx)); }
+    const auto group = db.makeGroup("half", names);
+    auto target = RenderTarget(keyCount), source = RenderTarget(keyCount);
+
+    std::unique_ptr<lua_State, void(*)(lua_State *)> lua(luaL_newstate(), lua_close);
+    luaL_openlibs(lua.get());
+    Environment(lua.get()).openKeyleds();
+    lua_push(lua.get(), &target);
+    lua_setglobal(lua.get(), "target");
+    lua_push(lua.get(), &source);
+    lua_setglobal(lua.get(), "source");
+    lua_push(lua.get(), &group);
+    lua_setglobal(lua.get(), "group");
+
+    const auto code = std::string(preamble) + std::string(script, N - 1);
+    if (luaL_loadbuffer(lua.get(), code.data(), code.size(), "bench") != 0 ||
+        lua_pcall(lua.get(), 0, 1, 0) != 0) {
+        state.SkipWithError(lua_tostring(lua.get(), -1));
+        return;
+    }                                                   // push(function)
+
+    for (auto _ : state) {
+        lua_pushvalue(lua.get(), -1);
+        lua_call(lua.get(), 0, 0);
+    }
+    lua_pop(lua.get(), 1);
+}
+
+static void BM_GroupFill_native(benchmark::State & state) { runScript(state, groupFillNative); }
+BENCHMARK(BM_GroupFill_native);
+static void BM_GroupFill_loop(benchmark::State & state) { runScript(state, groupFillLoop); }
+BENCHMARK(BM_GroupFill_loop);
+
+static void BM_RangeFill_native(benchmark::State & state) { runScript(state, rangeFillNative); }
+BENCHMARK(BM_RangeFill_native);
+static void BM_RangeFill_loop(benchmark::State & state) { runScript(state, rangeFillLoop); }
+BENCHMARK(BM_RangeFill_loop);
+
+static void BM_MaskedCopy_native(benchmark::State & state) { runScript(state, maskedCopyNative); }
+BENCHMARK(BM_MaskedCopy_native);
+static void BM_MaskedCopy_loop(benchmark::State & state) { runScript(state, maskedCopyLoop); }
+BENCHMARK(BM_MaskedCopy_loop);
+
+BENCHMARK_MAIN();
@@ -0,0 +1,147 @@
+/* Keyleds -- Gaming keyboard tool
+ * Copyright (C) 2017 Julien Hartmann, juli1.hartmann@gmail.com
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+#include "lua/StatePool.h"
+#include <gtest/gtest.h>
+#include <lua.hpp>
+#include <string>
+
+using keyleds::plugin::lua::StatePool;
+
+/// Runs a chunk in the given environment, or the state's global environment if
+/// env is LUA_NOREF, returning its first result as a string
+static std::string run(StatePool::State * state, const char * code, int env = LUA_NOREF)
+{
+    auto * lua = state->lua();
+    if (luaL_loadbuffer(lua, code, std::char_traits<char>::length(code), "test") != 0) {
+        std::string error = lua_tostring(lua, -1);
+        lua_pop(lua, 1);
+        return "error: " + error;
+    }
+    if (env != LUA_NOREF) {
+        lua_rawgeti(lua, LUA_REGISTRYINDEX, env);
+        lua_setfenv(lua, -2);
+    }
+    if (lua_pcall(lua, 0, 1, 0) != 0) {
+        std::string error = lua_tostring(lua, -1);
+        lua_pop(lua, 1);
+        return "error: " + error;
+    }
+    std::string result = lua_isstring(lua, -1) ? lua_tostring(lua, -1) : "";
+    lua_pop(lua, 1);
+    return result;
+}
+
+TEST(StatePoolTest, reuseIdle) {
+    auto pool = StatePool();
+    auto * state1 = pool.acquire("");
+    ASSERT_NE(nullptr, state1);
+    pool.release(state1);
+
+    auto * state2 = pool.acquire("");
+    EXPECT_EQ(state1, state2);
+    pool.release(state2);
+}
+
+TEST(StatePoolTest, share) {
+    auto pool = StatePool();
+    auto * state1 = pool.acquire("key");
+    auto * state2 = pool.acquire("key");
+    auto * state3 = pool.acquire("");
+    EXPECT_EQ(state1, state2);
+    EXPECT_NE(state1, state3);
+    EXPECT_EQ(2u, state1->users());
+    pool.release(state1);
+    pool.release(state2);
+    pool.release(state3);
+}
+
+TEST(StatePoolTest, releaseRestoresLibraries) {
+    auto pool = StatePool();
+    auto * state = pool.acquire("");
+    ASSERT_NE(nullptr, state);
+    EXPECT_EQ("", run(state, R"(
+        string.upper = nil
+        string.leak = true
+        table.insert = function() end
+        math.pi = 3
+        setmetatable(math, { __index = function() return 0 end })
+        leak = true
+        tostring = nil
+    )"));
+    pool.release(state);
+
+    ASSERT_EQ(state, pool.acquire(""));
+    EXPECT_EQ("function", run(state, "return type(string.upper)"));
+    EXPECT_EQ("nil", run(state, "return type(string.leak)"));
+    EXPECT_EQ("1", run(state, "local t = {}; table.insert(t, 1); return tostring(#t)"));
+    EXPECT_EQ("3.1416", run(state, "return string.format('%.4f', math.pi)"));
+    EXPECT_EQ("false", run(state, "return tostring(getmetatable(''))"));
+    EXPECT_EQ("nil", run(state, "return type(getmetatable(math))"));
+    EXPECT_EQ("nil", run(state, "return type(rawget(_G, 'leak'))"));
+    EXPECT_EQ("function", run(state, "return type(tostring)"));
+    pool.release(state);
+}
+
+TEST(StatePoolTest, environmentsAreIsolated) {
+    auto pool = StatePool();
+    auto * state = pool.acquire("key");
+    ASSERT_EQ(state, pool.acquire("key"));
+    auto * lua = state->lua();
+    state->pushEnvironment();
+    const int env1 = luaL_ref(lua, LUA_REGISTRYINDEX);
+    state->pushEnvironment();
+    const int env2 = luaL_ref(lua, LUA_REGISTRYINDEX);
+
+    EXPECT_EQ("", run(state, R"(
+        string.upper = nil
+        string.leak = true
+        math.pi = 3
+        leak = true
+    )", env1));
+    EXPECT_EQ("function", run(state, "return type(string.upper)", env2));
+    EXPECT_EQ("nil", run(state, "return type(string.leak)", env2));
+    EXPECT_EQ("3.1416", run(state, "return string.format('%.4f', math.pi)", env2));
+    EXPECT_EQ("nil", run(state, "return type(leak)", env2));
+    EXPECT_EQ("function", run(state, "return type(string.upper)"));
+
+    // Shared tables cannot be reached through metatables
+    EXPECT_EQ("false", run(state, "return tostring(getmetatable(_G))", env1));
+    EXPECT_EQ("false", run(state, "return tostring(getmetatable(''))", env1));
+
+    luaL_unref(lua, LUA_REGISTRYINDEX, env1);
+    luaL_unref(lua, LUA_REGISTRYINDEX, env2);
+    pool.release(state);
+    pool.release(state);
+}
+
+TEST(StatePoolTest, collectOverdue) {
+    auto pool = StatePool();
+    auto * state = pool.acquire("");
+    ASSERT_NE(nullptr, state);
+
+    // Collection never runs on its own, garbage piles up until a collect call
+    EXPECT_EQ("", run(state, "for i = 1, 1000 do local t = {} end"));
+    const auto small = state->memoryInUse();
+    state->collectOverdue();
+    EXPECT_LE(small, state->memoryInUse());
+
+    EXPECT_EQ("", run(state, "for i = 1, 200000 do local t = { i, i } end"));
+    const auto large = state->memoryInUse();
+    state->collectOverdue();
+    EXPECT_GT(large / 4, state->memoryInUse());
+    pool.release(state);
+}
@@ -0,0 +1,75 @@
+/* Keyleds -- Gaming keyboard tool
+ * Copyright (C) 2017 Julien Hartmann, juli1.hartmann@gmail.com
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+#include "lua/StatePool.h"
+#include <benchmark/benchmark.h>
+#include <lua.hpp>
+#include <memory>
+
+using keyleds::plugin::lua::StatePool;
+
+/// Creates a state from scratch for every effect, as if there was no pooling
+static void BM_StatePool_create(benchmark::State & state)
+{
+    std::size_t memory = 0;
+    for (auto _ : state) {
+        auto pool = std::make_unique<StatePool>();
+        auto * luaState = pool->acquire("");
+        if (!luaState) { state.SkipWithError("cannot create lua state"); return; }
+        memory += luaState->memoryInUse();
+        pool->release(luaState);
+
+        state.PauseTiming();
+        pool.reset();               // closing the state is not part of creation
+        state.ResumeTiming();
+    }
+    state.counters["memory"] = benchmark::Counter(double(memory), benchmark::Counter::kAvgIterations);
+}
+BENCHMARK(BM_StatePool_create);
+
+/// Reuses an idle state, including the cleanup done when it is given back
+static void BM_StatePool_reuse(benchmark::State & state)
+{
+    auto pool = StatePool();
+    pool.release(pool.acquire(""));
+
+    std::size_t memory = 0;
+    for (auto _ : state) {
+        auto * luaState = pool.acquire("");
+        memory += luaState->memoryInUse();
+        pool.release(luaState);
+    }
+    state.counters["memory"] = benchmark::Counter(double(memory), benchmark::Counter::kAvgIterations);
+}
+BENCHMARK(BM_StatePool_reuse);
+
+/// Sets up the global environment of a new effect, including its library copies
+static void BM_StatePool_environment(benchmark::State & state)
+{
+    auto pool = StatePool();
+    auto * luaState = pool.acquire("");
+    auto * lua = luaState->lua();
+
+    for (auto _ : state) {
+        luaState->pushEnvironment();
+        lua_pop(lua, 1);
+    }
+    lua_gc(lua, LUA_GCCOLLECT, 0);
+    pool.release(luaState);
+}
+BENCHMARK(BM_StatePool_environment);
+
+BENCHMARK_MAIN();
@@ -0,0 +1,174 @@
+/* Keyleds -- Gaming keyboard tool
+ * Copyright (C) 2017 Julien Hartmann, juli1.hartmann@gmail.com
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+#include "lua/lua_Thread.h"
+
+#include "lua/StatePool.h"
+#include <gtest/gtest.h>
+#include <lua.hpp>
+#include <string>
+
+using keyleds::lua::Thread;
+using keyleds::lua::ThreadScheduler;
+using keyleds::plugin::lua::StatePool;
+
+using namespace std::chrono_literals;
+
+static Thread makeThread(int id, Thread::time_point wakeTime)
+{
+    return Thread{id, true, false, wakeTime, Thread::milliseconds::zero()};
+}
+
+TEST(ThreadSchedulerTest, empty) {
+    auto scheduler = ThreadScheduler();
+    EXPECT_TRUE(scheduler.empty());
+    EXPECT_EQ(0u, scheduler.size());
+    EXPECT_EQ(nullptr, scheduler.popDue());
+
+    scheduler.advance(1000ms);
+    EXPECT_EQ(Thread::time_point(1000ms), scheduler.now());
+    EXPECT_EQ(nullptr, scheduler.popDue());
+}
+
+TEST(ThreadSchedulerTest, ordering) {
+    auto scheduler = ThreadScheduler();
+    auto thread1 = makeThread(1, 300ms);
+    auto thread2 = makeThread(2, 100ms);
+    auto thread3 = makeThread(3, 200ms);
+    auto thread4 = makeThread(4, 100ms);
+
+    for (auto * thread : { &thread1, &thread2, &thread3, &thread4 }) {
+        scheduler.schedule(*thread);
+        EXPECT_TRUE(thread->scheduled);
+    }
+    EXPECT_EQ(4u, scheduler.size());
+
+    EXPECT_EQ(nullptr, scheduler.popDue());     // nothing due yet
+    scheduler.advance(99ms);
+    EXPECT_EQ(nullptr, scheduler.popDue());
+
+    scheduler.advance(1ms);                     // same wake time: scheduling order
+    EXPECT_EQ(&thread2, scheduler.popDue());
+    EXPECT_FALSE(thread2.scheduled);
+    EXPECT_EQ(&thread4, scheduler.popDue());
+    EXPECT_EQ(nullptr, scheduler.popDue());
+
+    scheduler.advance(500ms);                   // several due at once: wake time order
+    EXPECT_EQ(&thread3, scheduler.popDue());
+    EXPECT_EQ(&thread1, scheduler.popDue());
+    EXPECT_EQ(nullptr, scheduler.popDue());
+    EXPECT_TRUE(scheduler.empty());
+}
+
+TEST(ThreadSchedulerTest, reschedule) {
+    auto scheduler = ThreadScheduler();
+    auto thread1 = makeThread(1, 100ms);
+    auto thread2 = makeThread(2, 150ms);
+    scheduler.schedule(thread1);
+    scheduler.schedule(thread2);
+
+    thread1.wakeTime = 200ms;                   // scheduling again replaces entry
+    scheduler.schedule(thread1);
+    EXPECT_EQ(2u, scheduler.size());
+
+    scheduler.advance(400ms);
+    auto * thread = scheduler.popDue();
+    ASSERT_EQ(&thread2, thread);
+
+    thread->wakeTime += 100ms;                  // still before now: due again
+    scheduler.schedule(*thread);
+    EXPECT_EQ(&thread1, scheduler.popDue());
+    EXPECT_EQ(&thread2, scheduler.popDue());
+    EXPECT_EQ(nullptr, scheduler.popDue());
+}
+
+TEST(ThreadSchedulerTest, cancel) {
+    auto scheduler = ThreadScheduler();
+    auto thread1 = makeThread(1, 100ms);
+    auto thread2 = makeThread(2, 200ms);
+    auto thread3 = makeThread(3, 300ms);
+    scheduler.schedule(thread1);
+    scheduler.schedule(thread2);
+    scheduler.schedule(thread3);
+
+    scheduler.cancel(thread1);
+    EXPECT_FALSE(thread1.scheduled);
+    EXPECT_EQ(2u, scheduler.size());
+    scheduler.cancel(thread1);                  // cancelling twice is harmless
+    EXPECT_EQ(2u, scheduler.size());
+
+    scheduler.advance(1000ms);
+    EXPECT_EQ(&thread2, scheduler.popDue());
+    scheduler.cancel(thread2);                  // not scheduled anymore
+    EXPECT_EQ(&thread3, scheduler.popDue());
+    EXPECT_EQ(nullptr, scheduler.popDue());
+}
+
+TEST(ThreadSchedulerTest, pauseResume) {
+    auto scheduler = ThreadScheduler();
+    auto thread1 = makeThread(1, 100ms);
+    auto thread2 = makeThread(2, 150ms);
+    scheduler.schedule(thread1);
+    scheduler.schedule(thread2);
+
+    scheduler.advance(40ms);
+    scheduler.pause(thread1);
+    EXPECT_FALSE(thread1.running);
+    EXPECT_FALSE(thread1.scheduled);
+    EXPECT_EQ(Thread::milliseconds(60ms), thread1.sleepTime);
+
+    scheduler.advance(500ms);                   // paused thread does not wake
+    EXPECT_EQ(&thread2, scheduler.popDue());
+    EXPECT_EQ(nullptr, scheduler.popDue());
+
+    scheduler.resume(thread1);                  // remaining time starts again
+    EXPECT_TRUE(thread1.running);
+    EXPECT_EQ(Thread::time_point(600ms), thread1.wakeTime);
+    scheduler.advance(59ms);
+    EXPECT_EQ(nullptr, scheduler.popDue());
+    scheduler.advance(1ms);
+    EXPECT_EQ(&thread1, scheduler.popDue());
+}
+
+TEST(ThreadTest, noController) {
+    auto pool = StatePool();
+    auto * state = pool.acquire("");
+    ASSERT_NE(nullptr, state);
+    auto * lua = state->lua();
+
+    // Outside of an effect, thread functions raise an error instead of crashing
+    keyleds::lua::lua_push(lua, Thread{1, true, false, {}, {}});
+    lua_setglobal(lua, "t");
+    static const char code[] = R"(
+        local result = {}
+        for _, call in ipairs({
+            function() thread(function() end) end,
+            function() t:pause() end,
+            function() t:resume() end,
+            function() t:stop() end,
+        }) do
+            local ok, err = pcall(call)
+            result[#result + 1] = ok and "ok" or err:match("no effect token") or err
+        end
+        return table.concat(result, ",")
+    )";
+    ASSERT_EQ(0, luaL_loadbuffer(lua, code, sizeof(code) - 1, "test"));
+    ASSERT_EQ(0, lua_pcall(lua, 0, 1, 0)) << lua_tostring(lua, -1);
+    EXPECT_EQ("no effect token,no effect token,no effect token,no effect token",
+              std::string(lua_tostring(lua, -1)));
+    lua_pop(lua, 1);
+    pool.release(state);
+}
@@ -20,6 +20,10 @@
 #include <algorithm>
 #include <cassert>
 #include <cmath>
+#include <cstdint>
+#include <cstdlib>
+#include <cstring>
+#include <numeric>
 #include <ostream>
 
 using keyleds::KeyDatabase;
@@ -28,12 +32,60 @@ using keyleds::KeyDatabase;
 
 template <class T> T abs_difference(T a, T b) { return a > b ? a - b : b - a; }
 
-// Return index in relation table for key pair, given a.index < b.index
-static std::size_t relationIndex(const KeyDatabase::Key & a, const KeyDatabase::Key & b,
-                                 KeyDatabase::size_type N)
+/// Center of a key, as used by all geometric relations
+static std::pair<KeyDatabase::position_type, KeyDatabase::position_type>
+center(const KeyDatabase::Key & key)
 {
-    // Relations are stored in pyramidal array
-    return a.index * (2 * N - 1 - a.index) / 2 + b.index - a.index - 1;
+    return { (key.position.x1 + key.position.x0) / 2, (key.position.y1 + key.position.y0) / 2 };
+}
+
+/// Squared distance between two points, without overflow
+static std::uint64_t squaredDistance(long xa, long ya, long xb, long yb)
+{
+    const auto dx = std::uint64_t(std::labs(xa - xb)), dy = std::uint64_t(std::labs(ya - yb));
+    return dx * dx + dy * dy;
+}
+
+/// Clips parametric segment (x, y) + t * (dx, dy) to a rectangle, narrowing
+/// [tmin, tmax]. Returns whether anything is left (Liang-Barsky).
+static bool clipSegment(double x, double y, double dx, double dy,
+                        double rx0, double ry0, double rx1, double ry1,
+                        double & tmin, double & tmax)
+{
+    const double p[4] = { -dx, dx, -dy, dy };
+    const double q[4] = { x - rx0, rx1 - x, y - ry0, ry1 - y };
+    for (int i = 0; i < 4; ++i) {
+        if (p[i] == 0.0) {
+            if (q[i] < 0.0) { return false; }   // parallel and outside
+            continue;
+        }
+        const auto t = q[i] / p[i];
+        if (p[i] < 0.0) {
+            if (t > tmax) { return false; }
+            tmin = std::max(tmin, t);
+        } else {
+            if (t < tmin) { return false; }
+            tmax = std::min(tmax, t);
+        }
+    }
+    return true;
+}
+
+/****************************************************************************/
+
+// Key codes up to that are looked up in a direct table, others are scanned for.
+// This is KEY_MAX from linux/input-event-codes.h.
+static constexpr int maxTableKeyCode = 0x2ff;
+
+/// FNV-1a hash of a key name
+static std::uint32_t hashName(const char * name)
+{
+    std::uint32_t hash = 2166136261u;
+    for (; *name != '\0'; ++name) {
+        hash ^= static_cast<unsigned char>(*name);
+        hash *= 16777619u;
+    }
+    return hash;
 }
 
 /****************************************************************************/
@@ -42,7 +94,10 @@ static std::size_t relationIndex(const KeyDatabase::Key & a, const KeyDatabase::
 KEYLEDSD_EXPORT KeyDatabase::KeyDatabase(key_list keys)
  : m_keys(std::move(keys)),
    m_bounds(::keyleds::bounds(m_keys.cbegin(), m_keys.cend())),
-   m_relations(computeRelations(m_keys))
+   m_grid(computeGrid(m_keys, m_bounds)),
+   m_geometry(computeGeometry(m_keys, m_bounds)),
+   m_keyCodes(computeKeyCodeTable(m_keys)),
+   m_names(computeNameTable(m_keys))
 {
 #ifndef NDEBUG
     for (auto it = m_keys.begin(); it != m_keys.end(); ++it) {
@@ -53,24 +108,57 @@ KEYLEDSD_EXPORT KeyDatabase::KeyDatabase(key_list keys)
 
 KEYLEDSD_EXPORT KeyDatabase::~KeyDatabase() = default;
 
+KEYLEDSD_EXPORT std::size_t KeyDatabase::memoryUsage() const noexcept
+{
+    auto result = m_keys.capacity() * sizeof(Key);
+    for (const auto & key : m_keys) {
+        // Short names live within the string object itself
+        const auto * object = reinterpret_cast<const char *>(&key.name);
+        const auto * data = key.name.data();
+        if (data < object || data >= object + sizeof(key.name)) { result += key.name.capacity() + 1; }
+    }
+    result += (m_grid.cellStart.capacity() + m_grid.keys.capacity()) * sizeof(Key::index_type);
+    result += (m_geometry.x.capacity() + m_geometry.y.capacity()
+               + m_geometry.width.capacity() + m_geometry.height.capacity()) * sizeof(float)
+            + m_geometry.block.capacity() * sizeof(unsigned);
+    result += (m_keyCodes.capacity() + m_names.capacity()) * sizeof(Key::index_type);
+    return result;
+}
+
 KEYLEDSD_EXPORT KeyDatabase::const_iterator KeyDatabase::findKeyCode(int keyCode) const
 {
-    return std::find_if(m_keys.cbegin(), m_keys.cend(),
-                        [&](const auto & key) { return key.keyCode == keyCode; });
+    if (keyCode < 0 || keyCode > maxTableKeyCode) {
+        return std::find_if(m_keys.cbegin(), m_keys.cend(),
+                            [&](const auto & key) { return key.keyCode == keyCode; });
+    }
+    if (std::size_t(keyCode) >= m_keyCodes.size()) { return m_keys.cend(); }
+    return m_keys.cbegin() + difference_type(m_keyCodes[std::size_t(keyCode)]);
 }
 
-KEYLEDSD_EXPORT KEYLEDSD_EXPORT KeyDatabase::const_iterator KeyDatabase::findName(const char * name) const
+KEYLEDSD_EXPORT KeyDatabase::const_iterator KeyDatabase::findName(const char * name) const
 {
-    return std::find_if(m_keys.cbegin(), m_keys.cend(),
-                        [&](const auto & key) { return key.name == name; });
+    if (m_names.empty()) { return m_keys.cend(); }
+
+    // Linear probing, table is never full so an empty slot ends the search
+    const auto mask = m_names.size() - 1;
+    for (auto slot = hashName(name) & mask; m_names[slot] != m_keys.size(); slot = (slot + 1) & mask) {
+        const auto & key = m_keys[m_names[slot]];
+        if (std::strcmp(key.name.c_str(), name) == 0) {
+            return m_keys.cbegin() + difference_type(m_names[slot]);
+        }
+    }
+    return m_keys.cend();
 }
 
 KEYLEDSD_EXPORT KeyDatabase::position_type
 KeyDatabase::distance(const Key & a, const Key & b) const noexcept
 {
     if (a.index == b.index) { return 0; }
-    return m_relations[a.index < b.index ? relationIndex(a, b, size())
-                                         : relationIndex(b, a, size())].distance;
+    const auto [xa, ya] = center(a);
+    const auto [xb, yb] = center(b);
+    const auto dx = abs_difference(xa, xb);
+    const auto dy = abs_difference(ya, yb);
+    return position_type(std::sqrt(dx * dx + dy * dy));
 }
 
 KEYLEDSD_EXPORT double KeyDatabase::angle(const Key & a, const Key & b) const noexcept
@@ -83,24 +171,289 @@ KEYLEDSD_EXPORT double KeyDatabase::angle(const Key & a, const Key & b) const no
     return std::atan2(ya - yb, xb - xa);    // note: y axis is inverted
 }
 
-KeyDatabase::relation_list KeyDatabase::computeRelations(const key_list & keys)
+KEYLEDSD_EXPORT KeyDatabase::KeyGroup
+KeyDatabase::keysInRadius(position_type x, position_type y, position_type radius) const
+{
+    std::vector<const_iterator> result;
+    if (m_keys.empty()) { return KeyGroup({}, std::move(result)); }
+
+    auto column = [this](long value) {
+        value = std::clamp(value - long(m_bounds.x0), 0l, long(m_grid.columns * m_grid.cellWidth) - 1);
+        return unsigned(value) / m_grid.cellWidth;
+    };
+    auto row = [this](long value) {
+        value = std::clamp(value - long(m_bounds.y0), 0l, long(m_grid.rows * m_grid.cellHeight) - 1);
+        return unsigned(value) / m_grid.cellHeight;
+    };
+
+    const auto limit = std::uint64_t(radius) * radius;
+    for (auto r = row(long(y) - long(radius)); r <= row(long(y) + long(radius)); ++r) {
+        for (auto c = column(long(x) - long(radius)); c <= column(long(x) + long(radius)); ++c) {
+            const auto cell = r * m_grid.columns + c;
+            for (auto idx = m_grid.cellStart[cell]; idx < m_grid.cellStart[cell + 1]; ++idx) {
+                const auto & key = m_keys[m_grid.keys[idx]];
+                const auto [kx, ky] = center(key);
+                if (squaredDistance(long(kx), long(ky), long(x), long(y)) <= limit) {
+                    result.push_back(m_keys.cbegin() + difference_type(key.index));
+                }
+            }
+        }
+    }
+    std::sort(result.begin(), result.end());
+    return KeyGroup({}, std::move(result));
+}
+
+KEYLEDSD_EXPORT KeyDatabase::KeyGroup
+KeyDatabase::nearestKeys(position_type x, position_type y, size_type count) const
+{
+    using candidate = std::pair<std::uint64_t, Key::index_type>;    // (squared distance, index)
+    count = std::min(count, m_keys.size());
+    if (count == 0) { return KeyGroup(); }
+
+    const auto startColumn = long(std::min(
+        (x > m_bounds.x0 ? x - m_bounds.x0 : 0) / m_grid.cellWidth, m_grid.columns - 1));
+    const auto startRow = long(std::min(
+        (y > m_bounds.y0 ? y - m_bounds.y0 : 0) / m_grid.cellHeight, m_grid.rows - 1));
+    const auto cellSize = std::min(m_grid.cellWidth, m_grid.cellHeight);
+
+    auto visitCell = [&](long c, long r, std::vector<candidate> & best) {
+        if (c < 0 || r < 0 || c >= long(m_grid.columns) || r >= long(m_grid.rows)) { return; }
+        const auto cell = std::size_t(r) * m_grid.columns + std::size_t(c);
+        for (auto idx = m_grid.cellStart[cell]; idx < m_grid.cellStart[cell + 1]; ++idx) {
+            const auto [kx, ky] = center(m_keys[m_grid.keys[idx]]);
+            const auto item = candidate(squaredDistance(long(kx), long(ky), long(x), long(y)),
+                                        m_grid.keys[idx]);
+            if (best.size() < count) {
+                best.push_back(item);
+                std::push_heap(best.begin(), best.end());
+            } else if (item < best.front()) {
+                std::pop_heap(best.begin(), best.end());
+                best.back() = item;
+                std::push_heap(best.begin(), best.end());
+            }
+        }
+    };
+
+    // Visit rings of cells around start cell, until next ring cannot hold anything closer
+    std::vector<candidate> best;
+    best.reserve(count);
+    const auto maxRing = long(std::max(m_grid.columns, m_grid.rows));
+    for (long ring = 0; ring <= maxRing; ++ring) {
+        for (long c = startColumn - ring; c <= startColumn + ring; ++c) {
+            visitCell(c, startRow - ring, best);
+            if (ring > 0) { visitCell(c, startRow + ring, best); }
+        }
+        for (long r = startRow - ring + 1; r <= startRow + ring - 1; ++r) {
+            visitCell(startColumn - ring, r, best);
+            visitCell(startColumn + ring, r, best);
+        }
+        const auto nextRingDistance = std::uint64_t(ring) * cellSize;
+        if (best.size() == count && nextRingDistance * nextRingDistance > best.front().first) {
+            break;
+        }
+    }
+
+    std::sort(best.begin(), best.end());
+    std::vector<const_iterator> result;
+    result.reserve(best.size());
+    for (const auto & item : best) {
+        result.push_back(m_keys.cbegin() + difference_type(item.second));
+    }
+    return KeyGroup({}, std::move(result));
+}
+
+KEYLEDSD_EXPORT KeyDatabase::KeyGroup
+KeyDatabase::keysOnLine(position_type x0, position_type y0, position_type x1, position_type y1) const
+{
+    return traceLine(double(x0), double(y0), double(x1), double(y1));
+}
+
+KEYLEDSD_EXPORT KeyDatabase::KeyGroup
+KeyDatabase::keysOnRay(position_type x, position_type y, double angle) const
+{
+    if (m_keys.empty()) { return KeyGroup(); }
+
+    // Any length taking the ray out of bounds will do
+    const auto length = double(m_bounds.x1 - m_bounds.x0) + double(m_bounds.y1 - m_bounds.y0)
+                      + std::abs(double(x) - double(m_bounds.x0))
+                      + std::abs(double(y) - double(m_bounds.y0)) + 1.0;
+    return traceLine(double(x), double(y),
+                     double(x) + length * std::cos(angle),
+                     double(y) - length * std::sin(angle));     // note: y axis is inverted
+}
+
+/// Collects keys intersecting segment, walking grid cells along it. Cells are
+/// widened by the largest key size, as keys are stored in their center's cell.
+KeyDatabase::KeyGroup KeyDatabase::traceLine(double x0, double y0, double x1, double y1) const
+{
+    if (m_keys.empty()) { return KeyGroup(); }
+    const auto dx = x1 - x0, dy = y1 - y0;
+
+    // Clip to area where keys are, skipping the walk entirely if it misses
+    double tmin = 0.0, tmax = 1.0;
+    if (!clipSegment(x0, y0, dx, dy,
+                     double(m_bounds.x0) - 1.0, double(m_bounds.y0) - 1.0,
+                     double(m_bounds.x1) + 1.0, double(m_bounds.y1) + 1.0, tmin, tmax)) {
+        return KeyGroup();
+    }
+
+    const auto cellSize = double(std::min(m_grid.cellWidth, m_grid.cellHeight));
+    const auto spread = long(1 + m_grid.margin / std::min(m_grid.cellWidth, m_grid.cellHeight));
+    const auto length = std::hypot(dx, dy) * (tmax - tmin);
+    const auto steps = long(std::ceil(2.0 * length / cellSize));
+
+    std::vector<Key::index_type> candidates;
+    long lastColumn = -1, lastRow = -1;
+    for (long step = 0; step <= steps; ++step) {
+        const auto t = tmin + (tmax - tmin) * (steps > 0 ? double(step) / double(steps) : 0.0);
+        const auto px = std::clamp(x0 + t * dx - double(m_bounds.x0), 0.0, double(m_grid.columns * m_grid.cellWidth - 1));
+        const auto py = std::clamp(y0 + t * dy - double(m_bounds.y0), 0.0, double(m_grid.rows * m_grid.cellHeight - 1));
+        const auto column = long(px) / long(m_grid.cellWidth);
+        const auto row = long(py) / long(m_grid.cellHeight);
+        if (column == lastColumn && row == lastRow) { continue; }
+        lastColumn = column;
+        lastRow = row;
+
+        for (auto r = std::max(0l, row - spread); r <= std::min(long(m_grid.rows) - 1, row + spread); ++r) {
+            for (auto c = std::max(0l, column - spread); c <= std::min(long(m_grid.columns) - 1, column + spread); ++c) {
+                const auto cell = std::size_t(r) * m_grid.columns + std::size_t(c);
+                candidates.insert(candidates.end(),
+                                  m_grid.keys.begin() + m_grid.cellStart[cell],
+                                  m_grid.keys.begin() + m_grid.cellStart[cell + 1]);
+            }
+        }
+    }
+    std::sort(candidates.begin(), candidates.end());
+    candidates.erase(std::unique(candidates.begin(), candidates.end()), candidates.end());
+
+    // Keep keys the segment actually crosses, ordered by where it enters them
+    std::vector<std::pair<double, Key::index_type>> hits;
+    for (auto index : candidates) {
+        const auto & rect = m_keys[index].position;
+        double enter = 0.0, leave = 1.0;
+        if (clipSegment(x0, y0, dx, dy, double(rect.x0), double(rect.y0),
+                        double(rect.x1), double(rect.y1), enter, leave)) {
+            hits.emplace_back(enter, index);
+        }
+    }
+    std::sort(hits.begin(), hits.end());
+
+    std::vector<const_iterator> result;
+    result.reserve(hits.size());
+    for (const auto & hit : hits) {
+        result.push_back(m_keys.cbegin() + difference_type(hit.second));
+    }
+    return KeyGroup({}, std::move(result));
+}
+
+/// Builds uniform grid over bounds, with about one cell per key so each cell
+/// holds a handful of keys. Keys are bucketed using a counting sort.
+KeyDatabase::Grid KeyDatabase::computeGrid(const key_list & keys, Rect bounds)
+{
+    Grid grid;
+    if (keys.empty()) { return grid; }
+
+    const auto width = double(bounds.x1 - bounds.x0 + 1);
+    const auto height = double(bounds.y1 - bounds.y0 + 1);
+    const auto count = double(keys.size());
+    const auto columns = std::max(1.0, std::round(std::sqrt(count * width / height)));
+    const auto rows = std::max(1.0, std::ceil(count / columns));
+
+    grid.cellWidth = std::max(position_type(1), position_type(std::ceil(width / columns)));
+    grid.cellHeight = std::max(position_type(1), position_type(std::ceil(height / rows)));
+    grid.columns = unsigned(std::ceil(width / double(grid.cellWidth)));
+    grid.rows = unsigned(std::ceil(height / double(grid.cellHeight)));
+
+    auto cellOf = [&](const Key & key) {
+        const auto [x, y] = center(key);
+        return std::size_t((y - bounds.y0) / grid.cellHeight) * grid.columns
+             + std::size_t((x - bounds.x0) / grid.cellWidth);
+    };
+
+    // Count keys per cell, then turn counts into start offsets
+    grid.cellStart.assign(std::size_t(grid.columns) * grid.rows + 1, 0);
+    for (const auto & key : keys) {
+        ++grid.cellStart[cellOf(key) + 1];
+        grid.margin = std::max({grid.margin, (key.position.x1 - key.position.x0 + 1) / 2,
+                                             (key.position.y1 - key.position.y0 + 1) / 2});
+    }
+    std::partial_sum(grid.cellStart.begin(), grid.cellStart.end(), grid.cellStart.begin());
+
+    auto next = index_table(grid.cellStart.begin(), grid.cellStart.end() - 1);
+    grid.keys.resize(keys.size());
+    for (const auto & key : keys) {
+        grid.keys[next[cellOf(key)]++] = key.index;
+    }
+    return grid;
+}
+
+/// Builds normalized geometry arrays. Padding entries are zero, so they
+/// contribute nothing to sums and are easy to spot.
+KeyDatabase::Geometry KeyDatabase::computeGeometry(const key_list & keys, Rect bounds)
+{
+    Geometry geometry;
+    if (keys.empty()) { return geometry; }
+
+    const auto size = (keys.size() + Geometry::simdWidth - 1) / Geometry::simdWidth
+                    * Geometry::simdWidth;
+    geometry.x.resize(size);
+    geometry.y.resize(size);
+    geometry.width.resize(size);
+    geometry.height.resize(size);
+    geometry.block.resize(size);
+
+    // Degenerate bounds put every key at 0 rather than dividing by zero
+    const auto scaleX = bounds.x1 > bounds.x0 ? 1.0f / float(bounds.x1 - bounds.x0) : 0.0f;
+    const auto scaleY = bounds.y1 > bounds.y0 ? 1.0f / float(bounds.y1 - bounds.y0) : 0.0f;
+
+    for (const auto & key : keys) {
+        const auto & pos = key.position;
+        geometry.x[key.index] = (float(pos.x0 - bounds.x0) + float(pos.x1 - bounds.x0)) / 2.0f * scaleX;
+        geometry.y[key.index] = (float(pos.y0 - bounds.y0) + float(pos.y1 - bounds.y0)) / 2.0f * scaleY;
+        geometry.width[key.index] = float(pos.x1 - pos.x0) * scaleX;
+        geometry.height[key.index] = float(pos.y1 - pos.y0) * scaleY;
+        geometry.block[key.index] = key.block;
+    }
+    return geometry;
+}
+
+/// Builds direct table from key code to key index. It only covers key codes
+/// up to the highest one in use, which is typically a few hundred entries.
+KeyDatabase::index_table KeyDatabase::computeKeyCodeTable(const key_list & keys)
+{
+    const auto none = Key::index_type(keys.size());
+    int maxKeyCode = -1;
+    for (const auto & key : keys) {
+        if (key.keyCode <= maxTableKeyCode) { maxKeyCode = std::max(maxKeyCode, key.keyCode); }
+    }
+
+    auto result = index_table(std::size_t(maxKeyCode + 1), none);
+    for (const auto & key : keys) {
+        if (key.keyCode < 0 || key.keyCode > maxTableKeyCode) { continue; }
+        auto & slot = result[std::size_t(key.keyCode)];
+        if (slot == none) { slot = key.index; }     // first key wins, as in a scan
+    }
+    return result;
+}
+
+/// Builds hash table from key name to key index, with a power-of-two size
+/// at least twice the number of keys so probe sequences remain short.
+KeyDatabase::index_table KeyDatabase::computeNameTable(const key_list & keys)
 {
-    KeyDatabase::relation_list result;
-    result.reserve(keys.size() * (keys.size() - 1) / 2);
+    if (keys.empty()) { return {}; }
+    const auto none = Key::index_type(keys.size());
 
-    for (auto it = keys.begin(); it != keys.end(); ++it) {
-        for (auto other = std::next(it); other != keys.end(); ++other) {
-            auto xa = (it->position.x1 + it->position.x0) / 2;
-            auto ya = (it->position.y1 + it->position.y0) / 2;
-            auto xb = (other->position.x1 + other->position.x0) / 2;
-            auto yb = (other->position.y1 + other->position.y0) / 2;
-            auto dx = abs_difference(xa, xb);
-            auto dy = abs_difference(ya, yb);
+    std::size_t size = 1;
+    while (size < 2 * keys.size()) { size *= 2; }
+    auto result = index_table(size, none);
 
-            result.push_back(Relation{
-                position_type(std::sqrt(dx * dx + dy * dy))
-            });
+    const auto mask = size - 1;
+    for (const auto & key : keys) {
+        auto slot = hashName(key.name.c_str()) & mask;
+        while (result[slot] != none && keys[result[slot]].name != key.name) {
+            slot = (slot + 1) & mask;
         }
+        if (result[slot] == none) { result[slot] = key.index; }   // first key wins
     }
     return result;
 }
@@ -113,6 +466,54 @@ KEYLEDSD_EXPORT KeyDatabase::KeyGroup::KeyGroup(std::string name, key_list keys)
 
 KEYLEDSD_EXPORT KeyDatabase::KeyGroup::~KeyGroup() = default;
 
+/****************************************************************************/
+
+KEYLEDSD_EXPORT KeyDatabase::KeySet::KeySet(size_type size)
+ : m_size(size), m_words((size + wordBits - 1) / wordBits, 0)
+{}
+
+KEYLEDSD_EXPORT KeyDatabase::KeySet::KeySet(size_type size, const KeyGroup & keys)
+ : KeySet(size)
+{
+    for (const auto & key : keys) { insert(key); }
+}
+
+KEYLEDSD_EXPORT KeyDatabase::KeySet::~KeySet() = default;
+
+KEYLEDSD_EXPORT KeyDatabase::KeySet::size_type KeyDatabase::KeySet::count() const noexcept
+{
+    size_type result = 0;
+    for (auto word : m_words) { result += size_type(__builtin_popcountll(word)); }
+    return result;
+}
+
+KEYLEDSD_EXPORT bool KeyDatabase::KeySet::empty() const noexcept
+{
+    return std::all_of(m_words.begin(), m_words.end(), [](auto word) { return word == 0; });
+}
+
+KEYLEDSD_EXPORT KeyDatabase::KeySet KeyDatabase::KeySet::operator~() const
+{
+    auto result = *this;
+    for (auto & word : result.m_words) { word = ~word; }
+    if (m_size % wordBits != 0) {   // keep bits past size() clear
+        result.m_words.back() &= (word_type(1) << (m_size % wordBits)) - 1;
+    }
+    return result;
+}
+
+KEYLEDSD_EXPORT KeyDatabase::KeyGroup
+KeyDatabase::KeySet::group(const KeyDatabase & db, std::string name) const
+{
+    assert(m_size == db.size());
+    std::vector<const_iterator> result;
+    result.reserve(count());
+    forEach([&](auto idx) { result.push_back(db.begin() + difference_type(idx)); });
+    return KeyGroup(std::move(name), std::move(result));
+}
+
+/****************************************************************************/
+
 KEYLEDSD_EXPORT std::ostream &
 keyleds::operator<<(std::ostream & out, const KeyDatabase::Key & key)
 {
@@ -17,6 +17,7 @@
 #include "keyledsd/RenderTarget.h"
 
 #include "config.h"
+#include "keyledsd/tools/MemoryAccounting.h"
 #include <memory>
 #include <type_traits>
 
@@ -32,6 +33,8 @@ static constexpr auto alignColors = static_cast<RenderTarget::size_type>(
 );
 
 
+static keyleds::tools::memory::Counter memoryCounter("render-targets");
+
 /// Returns the given value, aligned to upper bound of given aligment
 template <typename T> constexpr T align(T value, T alignment)
 {
@@ -44,18 +47,20 @@ KEYLEDSD_EXPORT RenderTarget::RenderTarget(size_type size)
  : m_size(size),                            // m_size tracks actual number of keys
    m_capacity(align(size, alignColors)),    // m_capacity tracks actual buffer size
    m_colors(new (operator new[](m_capacity * sizeof(RGBAColor), alignBytes)) RGBAColor[m_size])
-{}
+{
+    memoryCounter.allocated(m_capacity * sizeof(RGBAColor));
+}
 
 KEYLEDSD_EXPORT RenderTarget::~RenderTarget()
 {
-    std::destroy(begin(), end());
-    operator delete[](m_colors, alignBytes);
+    if (m_colors) { clear(); }
 }
 
 KEYLEDSD_EXPORT void RenderTarget::clear() noexcept
 {
     std::destroy(begin(), end());
     operator delete[](m_colors, alignBytes);
+    memoryCounter.released(m_capacity * sizeof(RGBAColor));
     m_size = 0;
     m_capacity = 0;
     m_colors = nullptr;
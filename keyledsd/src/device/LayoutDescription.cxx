@@ -373,3 +373,19 @@ LayoutDescription LayoutDescription::loadFile(const std::string & path)
     INFO("loading layout ", file->path);
     return parse(file->stream);
 }
+
+std::optional<LayoutDescription> LayoutDescription::loadOverride(const std::string & path)
+{
+    for (auto dir : tools::paths::getPaths(tools::paths::XDG::Data, true)) {
+        while (dir.size() > 1 && dir.back() == '/') { dir.pop_back(); }
+        if (dir == SYS_DATA_DIR) { continue; }  // shipped layouts, builtin() has them
+
+        const auto fullPath = dir + "/" KEYLEDSD_DATA_PREFIX "/layouts/" + path;
+        auto file = std::ifstream(fullPath, std::ios::binary);
+        if (!file) { continue; }
+
+        INFO("loading layout override ", fullPath);
+        return parse(file);
+    }
+    return std::nullopt;
+}
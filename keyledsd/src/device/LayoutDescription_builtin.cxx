@@ -0,0 +1,47 @@
+/* Keyleds -- Gaming keyboard tool
+ * Copyright (C) 2017 Julien Hartmann, juli1.hartmann@gmail.com
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+#include "keyledsd/device/LayoutDescription.h"
+
+#include <algorithm>
+#include <cstring>
+
+using keyleds::device::LayoutDescription;
+namespace detail = keyleds::device::detail;
+
+/****************************************************************************/
+
+std::optional<LayoutDescription> LayoutDescription::builtin(const std::string & path)
+{
+    const auto * begin = detail::builtinLayouts;
+    const auto * end = detail::builtinLayouts + detail::builtinLayoutCount;
+    const auto * it = std::lower_bound(begin, end, path, [](const auto & layout, const auto & file) {
+        return std::strcmp(layout.file, file.c_str()) < 0;
+    });
+    if (it == end || path != it->file) { return std::nullopt; }
+
+    auto result = LayoutDescription{it->name, {}, {}};
+    result.keys.reserve(it->keyCount);
+    std::transform(it->keys, it->keys + it->keyCount, std::back_inserter(result.keys),
+                   [names = it->names](const auto & key) {
+                       return Key{key.block, key.code, {key.x0, key.y0, key.x1, key.y1},
+                                  names + key.name};
+                   });
+    result.spurious.reserve(it->spuriousCount);
+    std::transform(it->spurious, it->spurious + it->spuriousCount, std::back_inserter(result.spurious),
+                   [](const auto & pos) { return pos_list::value_type{pos.block, pos.code}; });
+    return result;
+}
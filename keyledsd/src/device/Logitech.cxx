@@ -19,6 +19,7 @@
 #include "config.h"
 #include "keyleds.h"
 #include "keyledsd/logging.h"
+#include "keyledsd/tools/StartupTrace.h"
 #include <algorithm>
 #include <cassert>
 #include <cerrno>
@@ -70,15 +71,30 @@ Logitech::~Logitech() = default;
 
 std::unique_ptr<keyleds::device::Device> Logitech::open(const std::string & path)
 {
-    auto device = device_ptr(keyleds_open(path.c_str(), KEYLEDSD_APP_ID));
-    if (device == nullptr) { throw error(keyleds_get_error_str(), keyleds_get_errno()); }
-
-    auto type = getType(device.get());
-    auto name = getName(device.get());
-    std::string model, serial, firmware;
-    parseVersion(device.get(), &model, &serial, &firmware);
-    auto layout = keyleds_keyboard_layout(device.get(), KEYLEDS_TARGET_DEFAULT);
-    auto blocks = getBlocks(device.get());
+    auto & trace = tools::StartupTrace::instance();
+    auto device = device_ptr();
+    {
+        auto phase = trace.phase(path, "open");
+        device.reset(keyleds_open(path.c_str(), KEYLEDSD_APP_ID));
+        if (device == nullptr) { throw error(keyleds_get_error_str(), keyleds_get_errno()); }
+    }
+
+    std::string name, model, serial, firmware;
+    Type type;
+    int layout;
+    {
+        auto phase = trace.phase(path, "probe");
+        type = getType(device.get());
+        name = getName(device.get());
+        parseVersion(device.get(), &model, &serial, &firmware);
+        layout = keyleds_keyboard_layout(device.get(), KEYLEDS_TARGET_DEFAULT);
+    }
+
+    auto blocks = block_list();
+    {
+        auto phase = trace.phase(path, "blocks");
+        blocks = getBlocks(device.get());
+    }
 
     return std::unique_ptr<Logitech>(new Logitech(
         std::move(device), path,
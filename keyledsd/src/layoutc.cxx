@@ -0,0 +1,172 @@
+/* Keyleds -- Gaming keyboard tool
+ * Copyright (C) 2017 Julien Hartmann, juli1.hartmann@gmail.com
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+/** Layout compiler
+ *
+ * Build-time tool that parses shipped layout files and writes them out as
+ * C++ tables, so keyledsd need not locate and parse YAML when opening devices.
+ *
+ * Usage: keyledsd-layoutc output.cxx layout.yaml...
+ */
+#include "keyledsd/device/LayoutDescription.h"
+
+#include <algorithm>
+#include <cstdio>
+#include <exception>
+#include <fstream>
+#include <iostream>
+#include <limits>
+#include <map>
+#include <string>
+#include <vector>
+
+using keyleds::device::LayoutDescription;
+
+/****************************************************************************/
+
+static std::string baseName(const std::string & path)
+{
+    auto pos = path.rfind('/');
+    return pos == std::string::npos ? path : path.substr(pos + 1);
+}
+
+static std::string quote(const std::string & value)
+{
+    std::string result = "\"";
+    for (char chr : value) {
+        if (chr == '"' || chr == '\\') {
+            result += '\\';
+            result += chr;
+        } else if (chr < ' ' || chr > '~') {
+            char buffer[5];
+            std::snprintf(buffer, sizeof(buffer), "\\%03o", static_cast<unsigned char>(chr));
+            result += buffer;
+        } else {
+            result += chr;
+        }
+    }
+    return result + '"';
+}
+
+/// Checks a value fits in the compact tables
+static unsigned check(unsigned value, const std::string & file)
+{
+    if (value > std::numeric_limits<std::uint16_t>::max()) {
+        throw std::out_of_range(file + ": value " + std::to_string(value) + " out of range");
+    }
+    return value;
+}
+
+static void writeLayout(std::ostream & out, std::size_t index,
+                        const std::string & file, const LayoutDescription & layout)
+{
+    // Key names are pooled, so keys hold no pointer and tables need no relocation
+    std::map<std::string, std::size_t> offsets;
+    std::size_t poolSize = 0;
+    out <<"static const char names" <<index <<"[] =";
+    for (const auto & key : layout.keys) {
+        if (offsets.emplace(key.name, poolSize).second) {
+            out <<"\n    " <<quote(key.name + '\0');
+            poolSize += key.name.size() + 1;
+        }
+    }
+    if (offsets.empty()) { out <<" \"\""; }
+    out <<";\n";
+
+    if (!layout.keys.empty()) {
+        out <<"static const BuiltinLayout::Key keys" <<index <<"[] = {\n";
+        for (const auto & key : layout.keys) {
+            out <<"    {" <<check(key.block, file) <<", " <<check(key.code, file)
+                <<", " <<check(key.position.x0, file) <<", " <<check(key.position.y0, file)
+                <<", " <<check(key.position.x1, file) <<", " <<check(key.position.y1, file)
+                <<", " <<offsets[key.name] <<"},\n";
+        }
+        out <<"};\n";
+    }
+    if (!layout.spurious.empty()) {
+        out <<"static const BuiltinLayout::Position spurious" <<index <<"[] = {\n";
+        for (const auto & pos : layout.spurious) {
+            out <<"    {" <<check(pos.first, file) <<", " <<check(pos.second, file) <<"},\n";
+        }
+        out <<"};\n";
+    }
+}
+
+/****************************************************************************/
+
+int main(int argc, char * argv[])
+{
+    if (argc < 2) {
+        std::cerr <<"Usage: " <<argv[0] <<" output.cxx layout.yaml...\n";
+        return 1;
+    }
+
+    std::vector<std::pair<std::string, LayoutDescription>> layouts;
+    try {
+        for (int idx = 2; idx < argc; ++idx) {
+            auto file = std::ifstream(argv[idx], std::ios::binary);
+            if (!file) { throw std::runtime_error(std::string("cannot open ") + argv[idx]); }
+            try {
+                layouts.emplace_back(baseName(argv[idx]), LayoutDescription::parse(file));
+            } catch (LayoutDescription::ParseError & error) {
+                throw std::runtime_error(std::string(argv[idx]) + ": " + error.what());
+            }
+        }
+    } catch (std::exception & error) {
+        std::cerr <<argv[0] <<": " <<error.what() <<'\n';
+        return 1;
+    }
+    std::sort(layouts.begin(), layouts.end(),
+              [](const auto & lhs, const auto & rhs) { return lhs.first < rhs.first; });
+
+    auto out = std::ofstream(argv[1], std::ios::binary | std::ios::trunc);
+    try {
+        out <<"// Generated by keyledsd-layoutc - do not edit\n"
+              "#include \"keyledsd/device/LayoutDescription.h\"\n\n"
+              "namespace keyleds::device::detail {\n\n";
+
+        for (std::size_t idx = 0; idx < layouts.size(); ++idx) {
+            writeLayout(out, idx, layouts[idx].first, layouts[idx].second);
+        }
+
+        out <<"\nextern const BuiltinLayout builtinLayouts[] = {\n";
+        for (std::size_t idx = 0; idx < layouts.size(); ++idx) {
+            const auto & layout = layouts[idx].second;
+            out <<"    {" <<quote(layouts[idx].first) <<", " <<quote(layout.name)
+                <<", names" <<idx <<", ";
+            if (layout.keys.empty()) { out <<"nullptr, 0, "; }
+            else { out <<"keys" <<idx <<", " <<layout.keys.size() <<", "; }
+            if (layout.spurious.empty()) { out <<"nullptr, 0},\n"; }
+            else { out <<"spurious" <<idx <<", " <<layout.spurious.size() <<"},\n"; }
+        }
+        if (layouts.empty()) { out <<"    {nullptr, nullptr, nullptr, nullptr, 0, nullptr, 0}\n"; }
+        out <<"};\n"
+            <<"extern const std::size_t builtinLayoutCount = " <<layouts.size() <<";\n\n"
+            <<"} // namespace keyleds::device::detail\n";
+    } catch (std::exception & error) {
+        std::cerr <<argv[0] <<": " <<error.what() <<'\n';
+        out.close();
+        std::remove(argv[1]);
+        return 1;
+    }
+    out.close();
+    if (!out) {
+        std::cerr <<argv[0] <<": could not write " <<argv[1] <<'\n';
+        std::remove(argv[1]);
+        return 1;
+    }
+    return 0;
+}
@@ -25,12 +25,16 @@
 #include "keyledsd/service/StaticModuleRegistry.h"
 #include "keyledsd/tools/Event.h"
 #include "keyledsd/tools/FileWatcher.h"
+#include "keyledsd/tools/StartupTrace.h"
 #include "keyledsd/tools/XWindow.h"
+#include <cerrno>
 #include <clocale>
 #include <csignal>
+#include <cstdlib>
 #include <cstring>
 #include <exception>
 #include <fcntl.h>
+#include <fstream>
 #ifdef _GNU_SOURCE
 #include <getopt.h>
 #endif
@@ -49,6 +53,10 @@ LOGGING("main");
 using keyleds::service::Configuration;
 
 static uv_loop_t main_loop;
+static uv_timer_t trace_timer;
+
+static constexpr unsigned startupTracePoll = 100;       // milliseconds
+static constexpr unsigned startupTraceTimeout = 10000;  // milliseconds
 
 /****************************************************************************/
 // Command line parsing
@@ -61,6 +69,9 @@ public:
     keyleds::logging::level_t   logLevel = keyleds::logging::warning::value;
     bool                        autoQuit = false;
     bool                        noDBus = false;
+    bool                        evdevKeys = false;
+    unsigned long               idleTimeout = 0;    ///< Seconds without device before exiting
+    std::optional<std::string>  traceStartup;   ///< Empty to print summary, else trace file path
 
 public:
     static std::optional<Options> parse(int & argc, char * argv[])
@@ -71,27 +82,41 @@ public:
 #ifdef _GNU_SOURCE
         static constexpr struct option optionDescriptions[] = {
             {"config",      1, nullptr, 'c' },
+            {"evdev",       0, nullptr, 'e' },
             {"help",        0, nullptr, 'h' },
+            {"idle-exit",   1, nullptr, 'i' },
             {"module-path", 1, nullptr, 'm' },
             {"quiet",       0, nullptr, 'q' },
             {"single",      0, nullptr, 's' },
             {"verbose",     0, nullptr, 'v' },
             {"no-dbus",     0, nullptr, 'D' },
+            {"trace-startup", 2, nullptr, 'T' },
             {nullptr, 0, nullptr, 0}
         };
-        while ((opt = ::getopt_long(argc, argv, ":c:hm:qsvD", optionDescriptions, nullptr)) >= 0) {
+        while ((opt = ::getopt_long(argc, argv, ":c:ehi:m:qsvDT::", optionDescriptions, nullptr)) >= 0) {
 #else
-        while ((opt = ::getopt(argc, argv, ":c:hm:qsvD")) >= 0) {
+        while ((opt = ::getopt(argc, argv, ":c:ehi:m:qsvDT")) >= 0) {
 #endif
             switch(opt) {
             case 'c': options.configPath = optarg; break;
+            case 'e': options.evdevKeys = true; break;
+            case 'i': {
+                char * end;
+                options.idleTimeout = std::strtoul(optarg, &end, 10);
+                if (*optarg == '\0' || *end != '\0') {
+                    std::cerr <<argv[0] <<": invalid idle delay -- '" <<optarg <<"'\n";
+                    return std::nullopt;
+                }
+                } break;
             case 'm': options.modulePaths.emplace_back(optarg); break;
             case 'q': options.logLevel = keyleds::logging::critical::value; break;
             case 's': options.autoQuit = true; break;
             case 'v': options.logLevel += 1; break;
             case 'D': options.noDBus = true; break;
+            case 'T': options.traceStartup = optarg ? optarg : ""; break;
             case 'h':
-                std::cout <<"Usage: " <<argv[0] <<" [-c path] [-h] [-m path] [-q] [-s] [-v] [-D]\n";
+                std::cout <<"Usage: " <<argv[0] <<" [-c path] [-e] [-h] [-i seconds] [-m path] [-q] [-s] [-v] [-D]"
+                             " [--trace-startup[=file]]\n";
                 return std::nullopt;
             case ':':
                 std::cerr <<argv[0] <<": option -- '" <<char(::optopt) <<"' requires an argument\n";
@@ -160,6 +185,31 @@ static void handleSignalEvent(const Options & options, keyleds::service::Service
     }
 }
 
+/// Polled once loop runs, reports startup trace when no phase is pending anymore
+static void checkStartupTrace(uv_timer_t * timer)
+{
+    static unsigned elapsed = 0;
+    auto & trace = keyleds::tools::StartupTrace::instance();
+
+    elapsed += startupTracePoll;
+    if (trace.pending() > 0 && elapsed < startupTraceTimeout) { return; }
+    uv_timer_stop(timer);
+    trace.stop();
+
+    const auto & path = *static_cast<const Options *>(timer->data)->traceStartup;
+    if (path.empty()) {
+        trace.writeSummary(std::cerr);
+        return;
+    }
+    std::ofstream out(path);
+    trace.writeTrace(out);
+    if (out) {
+        NOTICE("startup trace written to ", path);
+    } else {
+        ERROR("could not write startup trace to ", path);
+    }
+}
+
 /****************************************************************************/
 
 int main(int argc, char * argv[])
@@ -172,6 +222,9 @@ int main(int argc, char * argv[])
     const auto options = Options::parse(argc, argv);
     if (!options) { return 1; }
 
+    auto & trace = tools::StartupTrace::instance();
+    if (options->traceStartup) { trace.start(); }
+
     // Configure logging - intentionally leak policy in case some destructor logs stuff
     auto logPolicy = new logging::FilePolicy(STDERR_FILENO, options->logLevel);
     logging::Configuration::instance().setPolicy(logPolicy);
@@ -181,6 +234,7 @@ int main(int argc, char * argv[])
     // Load configuration
     auto configuration = Configuration();
     try {
+        auto phase = trace.phase("keyledsd", "configuration");
         configuration = Configuration::loadFile(options->configPath);
         INFO("using ", configuration.path);
     } catch (std::exception & error) {
@@ -191,6 +245,7 @@ int main(int argc, char * argv[])
     // Register modules
     auto effectManager = service::EffectManager();
     {
+        auto phase = trace.phase("keyledsd", "plugins");
         std::copy(options->modulePaths.cbegin(), options->modulePaths.cend(),
                 std::back_inserter(effectManager.searchPaths()));
         std::copy(configuration.pluginPaths.begin(), configuration.pluginPaths.end(),
@@ -212,13 +267,21 @@ int main(int argc, char * argv[])
 
 #ifndef NO_DBUS
     sd_bus * bus = nullptr;
-    if (int err = sd_bus_open_user(&bus); err < 0) {
-        CRITICAL("Could not connect to session bus: ", strerror(-err));
-        return 2;
-    }
-    if (int err = sd_bus_request_name(bus, "org.etherdream.KeyledsService", 0); err < 0) {
-        CRITICAL("Could not reserve name on session bus: ", strerror(-err));
-        return 2;
+    {
+        auto phase = trace.phase("keyledsd", "dbus");
+        if (int err = sd_bus_open_user(&bus); err < 0) {
+            CRITICAL("Could not connect to session bus: ", strerror(-err));
+            return 2;
+        }
+        if (int err = sd_bus_request_name(bus, "org.etherdream.KeyledsService", 0); err < 0) {
+            if (err == -EEXIST) {
+                // Not a failure when activated on demand: service is already there
+                NOTICE("another instance owns org.etherdream.KeyledsService, exiting");
+                return 0;
+            }
+            CRITICAL("Could not reserve name on session bus: ", strerror(-err));
+            return 2;
+        }
     }
 #endif
 
@@ -231,14 +294,23 @@ int main(int argc, char * argv[])
             effectManager, watcher, std::move(configuration), main_loop
         );
         service.setAutoQuit(options->autoQuit);
+        service.setEvdevKeys(options->evdevKeys);
+        service.setIdleTimeout(std::chrono::seconds(
+            static_cast<std::chrono::seconds::rep>(options->idleTimeout)
+        ));
 
         try {
+            auto phase = trace.phase("keyledsd", "display");
             auto display = std::make_unique<tools::xlib::Display>();
             NOTICE("connected to display ", display->name());
             service.addDisplay(std::move(display));
         } catch (tools::xlib::Error & err) {
-            CRITICAL("X display initialization failed: ", err.what());
-            return 2;
+            // Key events can do without a display, context tracking cannot
+            if (!options->evdevKeys) {
+                CRITICAL("X display initialization failed: ", err.what());
+                return 2;
+            }
+            WARNING("running without display: ", err.what());
         }
 
 #ifndef NO_DBUS
@@ -261,7 +333,18 @@ int main(int argc, char * argv[])
             );
         }
 
+        // Device scan and first frames happen once loop runs, so report is deferred
+        if (options->traceStartup) {
+            uv_timer_init(&main_loop, &trace_timer);
+            trace_timer.data = const_cast<Options *>(&*options);
+            uv_timer_start(&trace_timer, checkStartupTrace, startupTracePoll, startupTracePoll);
+        }
+
         uv_run(&main_loop, UV_RUN_DEFAULT);
+
+        if (options->traceStartup) {
+            uv_close(reinterpret_cast<uv_handle_t *>(&trace_timer), nullptr);
+        }
     }
     uv_run(&main_loop, UV_RUN_NOWAIT);  // let closed handles cleanup
     uv_loop_close(&main_loop);
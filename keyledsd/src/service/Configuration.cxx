@@ -27,15 +27,6 @@
 
 namespace keyleds::service  {
 
-/****************************************************************************/
-
-struct Configuration::Profile::Lookup::Entry
-{
-    std::string key;        ///< context entry key
-    std::string value;      ///< string representation of the regex
-    std::regex  regex;      ///< regex to match context entry value against
-};
-
 /****************************************************************************/
 /****************************************************************************/
 /** Builder class that creates a Configuration object from a YAML file.
@@ -672,8 +663,77 @@ std::string getDeviceName(const Configuration & config, const std::string & seri
     return dit != config.devices.end() ? dit->first : serial;
 }
 
+bool sameEffectEnvironment(const Configuration & a, const Configuration & b)
+{
+    return a.keyGroups == b.keyGroups && a.customColors == b.customColors;
+}
+
+std::vector<std::optional<std::size_t>>
+matchEffects(const Configuration::EffectGroup & from, const Configuration::EffectGroup & to)
+{
+    auto result = std::vector<std::optional<std::size_t>>(to.effects.size());
+    if (from.keyGroups != to.keyGroups) { return result; }
+
+    auto taken = std::vector<bool>(from.effects.size(), false);
+    for (std::size_t idx = 0; idx < to.effects.size(); ++idx) {
+        for (std::size_t fromIdx = 0; fromIdx < from.effects.size(); ++fromIdx) {
+            if (!taken[fromIdx] && from.effects[fromIdx] == to.effects[idx]) {
+                taken[fromIdx] = true;
+                result[idx] = fromIdx;
+                break;
+            }
+        }
+    }
+    return result;
+}
+
 /****************************************************************************/
 
+/// Recognizes patterns that are a literal, optionally surrounded with ".*"
+static std::pair<Configuration::Profile::Lookup::Entry::Kind, std::string>
+classifyPattern(const std::string & pattern)
+{
+    using Kind = Configuration::Profile::Lookup::Entry::Kind;
+    static constexpr char wildcard[] = ".*";
+    static constexpr char special[] = R"(\^$.|?*+()[]{})";
+
+    auto first = std::string::size_type(0), last = pattern.size();
+    const bool leading = pattern.compare(0, 2, wildcard) == 0;
+    if (leading) { first += 2; }
+    const bool trailing = last >= first + 2 && pattern.compare(last - 2, 2, wildcard) == 0;
+    if (trailing) { last -= 2; }
+
+    auto text = pattern.substr(first, last - first);
+    if (text.find_first_of(special) != std::string::npos) { return { Kind::Regex, {} }; }
+    if (leading && trailing) { return { Kind::Contains, std::move(text) }; }
+    if (leading) { return { Kind::Suffix, std::move(text) }; }
+    if (trailing) { return { Kind::Prefix, std::move(text) }; }
+    return { Kind::Exact, std::move(text) };
+}
+
+bool Configuration::Profile::Lookup::Entry::matches(const std::string & input) const
+{
+    // Wildcards do not span line terminators in std::regex, let it handle those
+    const bool multiline = kind != Kind::Exact && kind != Kind::Regex
+                        && input.find_first_of("\n\r") != std::string::npos;
+    if (multiline) { return std::regex_match(input, regex); }
+
+    switch (kind) {
+    case Kind::Exact:
+        return input == text;
+    case Kind::Prefix:
+        return input.compare(0, text.size(), text) == 0;
+    case Kind::Suffix:
+        return input.size() >= text.size()
+            && input.compare(input.size() - text.size(), text.size(), text) == 0;
+    case Kind::Contains:
+        return input.find(text) != std::string::npos;
+    case Kind::Regex:
+        break;
+    }
+    return std::regex_match(input, regex);
+}
+
 Configuration::Profile::Lookup::Lookup(string_map filters)
  : m_entries(buildRegexps(std::move(filters)))
 {}
@@ -691,7 +751,7 @@ bool Configuration::Profile::Lookup::match(const string_map & context) const
                 [&entry](const auto & ctxEntry) { return ctxEntry.first == entry.key; }
             );
             const auto & value = it != context.end() ? it->second : std::string();
-            return std::regex_match(value, entry.regex);
+            return entry.matches(value);
     });
 }
 
@@ -704,10 +764,13 @@ Configuration::Profile::Lookup::buildRegexps(string_map filters)
                    [](auto & entry) {
                        auto regex = std::regex(entry.second,
                                                std::regex::nosubs | std::regex::optimize);
+                       auto [kind, text] = classifyPattern(entry.second);
                        return Entry{
                            std::move(entry.first),
                            std::move(entry.second),
-                           std::move(regex)
+                           std::move(regex),
+                           kind,
+                           std::move(text)
                        };
                    });
     return result;
@@ -0,0 +1,169 @@
+/* Keyleds -- Gaming keyboard tool
+ * Copyright (C) 2017 Julien Hartmann, juli1.hartmann@gmail.com
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+#include "keyledsd/service/Context.h"
+
+#include <algorithm>
+#include <cassert>
+#include <deque>
+#include <functional>
+#include <iterator>
+#include <unordered_map>
+
+using keyleds::service::Context;
+
+/****************************************************************************/
+
+namespace {
+    struct KeyTable final
+    {
+        std::unordered_map<std::string_view, Context::key_type> ids;
+        std::deque<std::string> names;      ///< Deque so views in ids remain valid
+    };
+
+    KeyTable & keyTable()
+    {
+        static KeyTable table;
+        return table;
+    }
+
+    auto keyLess = [](const Context::Entry & entry, Context::key_type key) { return entry.key < key; };
+}
+
+/****************************************************************************/
+
+Context::key_type Context::intern(std::string_view key)
+{
+    auto & table = keyTable();
+    auto it = table.ids.find(key);
+    if (it != table.ids.end()) { return it->second; }
+
+    const auto id = static_cast<key_type>(table.names.size());
+    const auto & name = table.names.emplace_back(key);
+    table.ids.emplace(name, id);
+    return id;
+}
+
+const std::string & Context::keyName(key_type key)
+{
+    const auto & names = keyTable().names;
+    assert(key < names.size());
+    return names[key];
+}
+
+Context::Context(const string_map & values)
+{
+    merge(values);
+}
+
+Context::key_list Context::merge(const string_map & values)
+{
+    auto hash = std::hash<std::string>();
+    key_list changed;
+
+    for (const auto & [name, value] : values) {
+        const auto key = intern(name);
+        auto it = std::lower_bound(m_entries.begin(), m_entries.end(), key, keyLess);
+        const bool exists = it != m_entries.end() && it->key == key;
+
+        if (value.empty()) {
+            if (!exists) { continue; }
+            m_hash -= entryHash(*it);
+            m_entries.erase(it);
+        } else {
+            const auto valueHash = hash(value);
+            if (exists) {
+                if (it->hash == valueHash && it->value == value) { continue; }
+                m_hash -= entryHash(*it);
+                it->hash = valueHash;
+                it->value = value;
+            } else {
+                it = m_entries.insert(it, Entry{key, valueHash, value, m_nextOrder++});
+            }
+            m_hash += entryHash(*it);
+        }
+        auto cit = std::lower_bound(changed.begin(), changed.end(), key);
+        if (cit == changed.end() || *cit != key) { changed.insert(cit, key); }
+    }
+    return changed;
+}
+
+const std::string * Context::find(key_type key) const
+{
+    auto it = std::lower_bound(m_entries.begin(), m_entries.end(), key, keyLess);
+    return it != m_entries.end() && it->key == key ? &it->value : nullptr;
+}
+
+const std::string & Context::operator[](key_type key) const
+{
+    static const std::string empty;
+    const auto * value = find(key);
+    return value != nullptr ? *value : empty;
+}
+
+Context::key_list Context::keys() const
+{
+    key_list result;
+    result.reserve(m_entries.size());
+    std::transform(m_entries.begin(), m_entries.end(), std::back_inserter(result),
+                   [](const auto & entry) { return entry.key; });
+    return result;
+}
+
+Context::string_map Context::toMap() const
+{
+    std::vector<const Entry *> sorted;
+    sorted.reserve(m_entries.size());
+    std::transform(m_entries.begin(), m_entries.end(), std::back_inserter(sorted),
+                   [](const auto & entry) { return &entry; });
+    std::sort(sorted.begin(), sorted.end(),
+              [](const auto * lhs, const auto * rhs) { return lhs->order < rhs->order; });
+
+    string_map result;
+    result.reserve(sorted.size());
+    std::transform(sorted.begin(), sorted.end(), std::back_inserter(result),
+                   [](const auto * entry) { return std::make_pair(keyName(entry->key), entry->value); });
+    return result;
+}
+
+bool Context::operator==(const Context & other) const
+{
+    return m_hash == other.m_hash && std::equal(
+        m_entries.begin(), m_entries.end(), other.m_entries.begin(), other.m_entries.end(),
+        [](const auto & lhs, const auto & rhs) {
+            return lhs.key == rhs.key && lhs.hash == rhs.hash && lhs.value == rhs.value;
+        });
+}
+
+std::size_t Context::entryHash(const Entry & entry) noexcept
+{
+    // Mix key into value hash, so swapping values between keys changes the result
+    auto result = entry.hash ^ (std::size_t(entry.key) + 0x9e3779b97f4a7c15u
+                                + (entry.hash << 6) + (entry.hash >> 2));
+    return result * 0xff51afd7ed558ccdu;
+}
+
+bool keyleds::service::intersects(const Context::key_list & lhs, const Context::key_list & rhs)
+{
+    auto lit = lhs.begin();
+    auto rit = rhs.begin();
+    while (lit != lhs.end() && rit != rhs.end()) {
+        if (*lit < *rit) { ++lit; }
+        else if (*rit < *lit) { ++rit; }
+        else { return true; }
+    }
+    return false;
+}
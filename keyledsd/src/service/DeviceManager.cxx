@@ -19,8 +19,10 @@
 
 #include "config.h"
 #include "keyledsd/logging.h"
+#include "keyledsd/service/DeviceState.h"
 #include "keyledsd/service/EffectService.h"
 #include "keyledsd/tools/DeviceWatcher.h"
+#include "keyledsd/tools/MemoryAccounting.h"
 #include <algorithm>
 #include <cassert>
 #include <unistd.h>
@@ -29,8 +31,7 @@ LOGGING("dev-manager");
 
 namespace keyleds::service {
 
-static constexpr char defaultProfileName[] = "__default__";
-static constexpr char overlayProfileName[] = "__overlay__";
+static tools::memory::Counter layoutMemory("layouts");
 
 /****************************************************************************/
 
@@ -52,36 +53,69 @@ DeviceManager::DeviceManager(EffectManager & effectManager, FileWatcher & fileWa
       m_renderLoop(*m_device, KEYLEDSD_RENDER_FPS)
 {
     setConfiguration(conf);
+    m_renderLoop.setInitialState(loadDeviceState(m_serial, m_renderLoop.keyCount()));
     m_renderLoop.start();
+    layoutMemory.allocated(m_keyDB.memoryUsage());
 }
 
 DeviceManager::~DeviceManager()
 {
     m_renderLoop.stop();            // destroying the loop is UB if the thread is still running
+    if (const auto * state = m_renderLoop.state()) { saveDeviceState(m_serial, *state); }
+    layoutMemory.released(m_keyDB.memoryUsage());
 }
 
+/// Switches to a new configuration. Effects whose configuration is unchanged
+/// are carried over with their state, and keep rendering until next context
+/// change selects effects anew. Previous configuration must remain valid until
+/// this returns.
 void DeviceManager::setConfiguration(const Configuration * conf)
 {
     assert(conf != nullptr);
     auto lock = m_renderLoop.lock();
-
-    m_renderLoop.renderers().clear();
-    m_effectGroups.clear();
-    m_activeEffects.clear();
+    const auto * previous = m_configuration;
+    auto name = getDeviceName(*conf, m_serial);
 
     m_configuration = conf;
-    m_name = getDeviceName(*conf, m_serial);
+
+    std::vector<detail::EffectGroup> effectGroups;
+    if (previous && name == m_name && sameEffectEnvironment(*previous, *conf)) {
+        for (auto & group : m_effectGroups) {
+            auto updated = updateEffectGroup(group, *previous);
+            if (updated) { effectGroups.push_back(std::move(*updated)); }
+        }
+    }
+    m_name = std::move(name);
+    m_profiles = ProfileMatcher(*conf, m_name);
+    m_activeProfile = nullptr;          // belongs to previous configuration
+
+    // Stop rendering effects that are about to be destroyed
+    auto isLoaded = [&effectGroups](const Effect * effect) {
+        return std::any_of(effectGroups.begin(), effectGroups.end(), [&](const auto & group) {
+            return std::any_of(group.effects.begin(), group.effects.end(),
+                               [&](const auto & loaded) { return loaded.effect.get() == effect; });
+        });
+    };
+    m_activeEffects.erase(std::remove_if(m_activeEffects.begin(), m_activeEffects.end(),
+                                         [&](const auto * effect) { return !isLoaded(effect); }),
+                          m_activeEffects.end());
+    auto & renderers = m_renderLoop.renderers();
+    renderers.assign(m_activeEffects.begin(), m_activeEffects.end());
+
+    // Old effect groups are destroyed on return, while still holding the lock
+    std::swap(m_effectGroups, effectGroups);
 }
 
-void DeviceManager::setContext(const string_map & context)
+void DeviceManager::setContext(const Context & context)
 {
     m_activeEffects = loadEffects(context);
     DEBUG("enabling ", m_activeEffects.size(), " effects for loop ", &m_renderLoop);
 
     // Notify newly-active effects of context change
+    const auto values = context.toMap();
     auto lock = m_renderLoop.lock();
     for (auto * effect : m_activeEffects) {
-        effect->handleContextChange(context);
+        effect->handleContextChange(values);
     }
 
     auto & renderers = m_renderLoop.renderers();
@@ -90,6 +124,24 @@ void DeviceManager::setContext(const string_map & context)
     std::copy(m_activeEffects.begin(), m_activeEffects.end(), std::back_inserter(renderers));
 }
 
+void DeviceManager::updateContext(const Context & context, const Context::key_list & changed)
+{
+    if (m_profiles.dependsOn(changed) && m_profiles.match(context).profile != m_activeProfile) {
+        setContext(context);
+        return;
+    }
+
+    // Same profile, so active effects remain the same and only subscribers care
+    const auto subscribers = contextSubscribers();
+    if (subscribers.empty()) { return; }
+
+    const auto values = context.toMap();
+    auto lock = m_renderLoop.lock();
+    for (auto * effect : subscribers) {
+        effect->handleContextChange(values);
+    }
+}
+
 void DeviceManager::handleFileEvent(FileWatcher::Event, uint32_t, const std::string &)
 {
     int result = access(m_device->path().c_str(), R_OK | W_OK);
@@ -102,7 +154,7 @@ void DeviceManager::handleGenericEvent(const string_map & context)
     for (auto * effect : m_activeEffects) { effect->handleGenericEvent(context); }
 }
 
-void DeviceManager::handleKeyEvent(int keyCode, bool press)
+void DeviceManager::handleKeyEvent(int keyCode, bool press, time_point time)
 {
     // Convert raw key code into a reference to its database entry
     auto it = m_keyDB.findKeyCode(keyCode);
@@ -113,7 +165,7 @@ void DeviceManager::handleKeyEvent(int keyCode, bool press)
 
     // Pass event to active effects
     auto lock = m_renderLoop.lock();
-    for (const auto & effect : m_activeEffects) { effect->handleKeyEvent(*it, press); }
+    for (const auto & effect : m_activeEffects) { effect->handleKeyEvent(*it, press, time); }
     DEBUG("key ", it->name, " ", press ? "pressed" : "released", " on device ", m_serial);
 }
 
@@ -122,84 +174,67 @@ void DeviceManager::setPaused(bool val)
     m_renderLoop.setPaused(val);
 }
 
-/// Applies the configuration to a string_map, matching profiles and resolving
+/// Applies the configuration to a context, matching profiles and resolving
 /// effect names. Returns the list of Effect entries in the configuration that
 /// should be loaded for the context. Returned list references Configuration
 /// entries directly, and are therefore invalidated by any operation that
 /// invalidates configuration's iterators.
-std::vector<keyleds::plugin::Effect *> DeviceManager::loadEffects(const string_map & context)
+std::vector<keyleds::plugin::Effect *> DeviceManager::loadEffects(const Context & context)
 {
-    // Match context against profile lookups
-    const Configuration::Profile * profile = nullptr;
-    const Configuration::Profile * defaultProfile = nullptr;
-    const Configuration::Profile * overlayProfile = nullptr;
-
-    for (const auto & profileEntry : m_configuration->profiles) {
-        const auto & devices = profileEntry.devices;
-        if (!devices.empty() && std::find(devices.begin(), devices.end(), m_name) == devices.end()) {
-            continue;
-        }
-        if (profileEntry.name == defaultProfileName) {
-            defaultProfile = &profileEntry;
-        } else if (profileEntry.name == overlayProfileName) {
-            overlayProfile = &profileEntry;
-        } else if (profileEntry.lookup.match(context)) {
-            DEBUG("profile matches: ", profileEntry.name);
-            profile = &profileEntry;
-        }
-    }
-    if (!profile) {
-        if (!defaultProfile) {
-            ERROR("no profile matches and no default profile defined");
-            return {};
-        }
-        profile = defaultProfile;
-    }
-    INFO("selected profile <", profile->name, ">");
-
-    // Collect effect names from selected profile and resolve them
-    std::vector<const Configuration::EffectGroup *> effectGroups;
-
-    for (const auto & name : profile->effectGroups) {
-        auto eit = std::find_if(m_configuration->effectGroups.begin(),
-                                m_configuration->effectGroups.end(),
-                                [&name](auto & group) { return group.name == name; });
-        if (eit == m_configuration->effectGroups.end()) {
-            ERROR("profile <", profile->name, "> references unknown effect group <", name, ">");
-            continue;
-        }
-        effectGroups.push_back(&*eit);
-    }
-    if (overlayProfile != nullptr) {
-        for (const auto & name : overlayProfile->effectGroups) {
-            auto eit = std::find_if(m_configuration->effectGroups.begin(),
-                                    m_configuration->effectGroups.end(),
-                                    [&name](auto & group) { return group.name == name; });
-            if (eit == m_configuration->effectGroups.end()) {
-                ERROR("profile <", profile->name, "> references unknown effect group <", name, ">");
-                continue;
-            }
-            effectGroups.push_back(&*eit);
-        }
+    const auto & selection = m_profiles.match(context);
+    m_activeProfile = selection.profile;
+    if (!selection.profile) {
+        ERROR("no profile matches and no default profile defined");
+        return {};
     }
+    INFO("selected profile <", selection.profile->name, ">");
 
     std::vector<Effect *> effectPtrs;
-    for (const auto & effectGroup : effectGroups) {
+    for (const auto * effectGroup : selection.effectGroups) {
         const auto & loadedEffectGroup = getEffectGroup(*effectGroup);
         const auto & effects = loadedEffectGroup.effects;
         std::transform(effects.begin(), effects.end(), std::back_inserter(effectPtrs),
-                       [](const auto & ptr) { return ptr.get(); });
+                       [](const auto & loaded) { return loaded.effect.get(); });
     }
     return effectPtrs;
 }
 
+std::vector<keyleds::plugin::Effect *> DeviceManager::contextSubscribers() const
+{
+    std::vector<Effect *> result;
+    for (const auto & group : m_effectGroups) {
+        for (const auto & loaded : group.effects) {
+            if (loaded.effect && loaded.service->contextSubscribed() &&
+                std::find(m_activeEffects.begin(), m_activeEffects.end(),
+                          loaded.effect.get()) != m_activeEffects.end()) {
+                result.push_back(loaded.effect.get());
+            }
+        }
+    }
+    return result;
+}
+
 const detail::EffectGroup & DeviceManager::getEffectGroup(const Configuration::EffectGroup & conf)
 {
     auto eit = std::find_if(m_effectGroups.cbegin(), m_effectGroups.cend(),
                             [&](const auto & group) { return group.name == conf.name; });
     if (eit != m_effectGroups.cend()) { return *eit; }
 
-    // Load key groups
+    const auto keyGroups = makeKeyGroups(conf);
+
+    std::vector<detail::LoadedEffect> effects;
+    for (std::size_t idx = 0; idx < conf.effects.size(); ++idx) {
+        auto effect = createEffect(conf, idx, keyGroups);
+        if (effect) { effects.push_back(std::move(*effect)); }
+    }
+
+    m_effectGroups.push_back({conf.name, std::move(effects)});
+    return m_effectGroups.back();
+}
+
+std::vector<KeyDatabase::KeyGroup>
+DeviceManager::makeKeyGroups(const Configuration::EffectGroup & conf) const
+{
     std::vector<KeyDatabase::KeyGroup> keyGroups;
 
     auto group_from_conf = [this](const auto & gconf) {
@@ -209,25 +244,53 @@ const detail::EffectGroup & DeviceManager::getEffectGroup(const Configuration::E
                    std::back_inserter(keyGroups), group_from_conf);
     std::transform(m_configuration->keyGroups.begin(), m_configuration->keyGroups.end(),
                    std::back_inserter(keyGroups), group_from_conf);
+    return keyGroups;
+}
 
-    // Load effects
-    std::vector<EffectManager::effect_ptr> effects;
-    for (const auto & effectConf : conf.effects) {
-        auto effect = m_effectManager.createEffect(
-            effectConf.name, std::make_unique<EffectService>(
-                *this, *m_configuration, effectConf, keyGroups
-            )
-        );
-        if (!effect) {
-            ERROR("plugin for effect ", effectConf.name, " not found");
-            continue;
-        }
-        INFO("loaded plugin effect ", effectConf.name);
-        effects.emplace_back(std::move(effect));
+std::optional<detail::LoadedEffect>
+DeviceManager::createEffect(const Configuration::EffectGroup & conf, std::size_t index,
+                            const std::vector<KeyDatabase::KeyGroup> & keyGroups)
+{
+    const auto & effectConf = conf.effects[index];
+    auto service = std::make_unique<EffectService>(*this, *m_configuration, effectConf, keyGroups);
+    auto * servicePtr = service.get();
+
+    auto effect = m_effectManager.createEffect(effectConf.name, std::move(service));
+    if (!effect) {
+        ERROR("plugin for effect ", effectConf.name, " not found");
+        return std::nullopt;
     }
+    INFO("loaded plugin effect ", effectConf.name);
+    return detail::LoadedEffect{index, std::move(effect), servicePtr};
+}
 
-    m_effectGroups.push_back({conf.name, std::move(effects)});
-    return m_effectGroups.back();
+std::optional<detail::EffectGroup>
+DeviceManager::updateEffectGroup(detail::EffectGroup & group, const Configuration & previous)
+{
+    auto findConf = [&group](const Configuration & conf) -> const Configuration::EffectGroup * {
+        auto it = std::find_if(conf.effectGroups.begin(), conf.effectGroups.end(),
+                               [&](const auto & item) { return item.name == group.name; });
+        return it != conf.effectGroups.end() ? &*it : nullptr;
+    };
+    const auto * previousConf = findConf(previous);
+    const auto * conf = findConf(*m_configuration);
+    if (!previousConf || !conf) { return std::nullopt; }
+
+    const auto matches = matchEffects(*previousConf, *conf);
+    if (std::none_of(matches.begin(), matches.end(), [](const auto & match) { return bool(match); })) {
+        return std::nullopt;    // nothing to keep, group will be loaded anew if needed
+    }
+
+    const auto keyGroups = makeKeyGroups(*conf);
+    auto effects = carryOverEffects(
+        group.effects, matches,
+        [&](detail::LoadedEffect & loaded) {
+            loaded.service->setConfiguration(*m_configuration, conf->effects[loaded.index]);
+            DEBUG("kept effect ", conf->effects[loaded.index].name, " of group ", conf->name);
+        },
+        [&](std::size_t idx) { return createEffect(*conf, idx, keyGroups); }
+    );
+    return detail::EffectGroup{conf->name, std::move(effects)};
 }
 
 } // namespace keyleds::service
@@ -21,9 +21,13 @@
 #include "keyledsd/KeyDatabase.h"
 #include "keyledsd/logging.h"
 #include "keyledsd/tools/DeviceWatcher.h"
+#include "keyledsd/tools/StartupTrace.h"
 #include <algorithm>
+#include <cstdint>
 #include <iomanip>
 #include <sstream>
+#include <unordered_map>
+#include <unordered_set>
 
 LOGGING("device-manager");
 
@@ -47,9 +51,12 @@ device::LayoutDescription loadLayout(const device::Device & device)
     for (auto layoutId : attempts) {
         auto name = layoutName(device.model(), layoutId);
         try {
-            auto result = device::LayoutDescription::loadFile(name);
+            // Layouts provided by the user take precedence over compiled-in ones
+            auto result = device::LayoutDescription::loadOverride(name);
+            if (!result) { result = device::LayoutDescription::builtin(name); }
+            if (!result) { result = device::LayoutDescription::loadFile(name); }
             DEBUG("loaded layout <", name, ">");
-            return result;
+            return std::move(*result);
         } catch (std::runtime_error & error) {
             ERROR("could not load layout <", name, ">: ", error.what());
         }
@@ -92,33 +99,40 @@ std::string getSerial(const tools::device::Description & description)
 
 static KeyDatabase buildKeyDatabase(const device::Device & device, const device::LayoutDescription & layout)
 {
+    auto position = [](auto block, auto code) { return (std::uint64_t(block) << 32) | code; };
+
+    // Index layout by key position, first entry wins
+    std::unordered_map<std::uint64_t, const device::LayoutDescription::Key *> layoutKeys;
+    layoutKeys.reserve(layout.keys.size());
+    for (const auto & key : layout.keys) { layoutKeys.emplace(position(key.block, key.code), &key); }
+
+    std::unordered_set<std::uint64_t> spuriousKeys;
+    for (const auto & pos : layout.spurious) { spuriousKeys.insert(position(pos.first, pos.second)); }
+
     std::vector<KeyDatabase::Key> db;
     KeyDatabase::Key::index_type keyIndex = 0;
+    unsigned blockIndex = 0;
     for (const auto & block : device.blocks()) {
         for (unsigned kidx = 0; kidx < block.keys().size(); ++kidx) {
             const auto keyId = block.keys()[kidx];
             std::string name;
-            auto position = KeyDatabase::Rect{0, 0, 0, 0};
+            auto rect = KeyDatabase::Rect{0, 0, 0, 0};
 
-            bool spurious = std::any_of(
-                layout.spurious.cbegin(), layout.spurious.cend(),
-                [&](const auto & pos) { return pos.first == block.id() && pos.second == keyId; }
-            );
+            bool spurious = spuriousKeys.count(position(block.id(), keyId)) > 0;
             if (spurious) {
                 DEBUG("marking <", int(block.id()), ", ", int(keyId), "> as spurious");
             }
 
-            for (const auto & key : layout.keys) {
-                if (key.block == block.id() && key.code == keyId) {
-                    name = key.name;
-                    position = {
-                        KeyDatabase::position_type(key.position.x0),
-                        KeyDatabase::position_type(key.position.y0),
-                        KeyDatabase::position_type(key.position.x1),
-                        KeyDatabase::position_type(key.position.y1)
-                    };
-                    break;
-                }
+            auto it = layoutKeys.find(position(block.id(), keyId));
+            if (it != layoutKeys.end()) {
+                const auto & key = *it->second;
+                name = key.name;
+                rect = {
+                    KeyDatabase::position_type(key.position.x0),
+                    KeyDatabase::position_type(key.position.y0),
+                    KeyDatabase::position_type(key.position.x1),
+                    KeyDatabase::position_type(key.position.y1)
+                };
             }
             if (name.empty()) { name = device.resolveKey(block.id(), keyId); }
 
@@ -126,18 +140,27 @@ static KeyDatabase buildKeyDatabase(const device::Device & device, const device:
                 keyIndex,
                 spurious ? 0 : device.decodeKeyId(block.id(), keyId),
                 spurious ? std::string() : std::move(name),
-                position
+                rect,
+                blockIndex
             });
             ++keyIndex;
         }
+        ++blockIndex;
     }
     return KeyDatabase(db);
 }
 
 KeyDatabase setupKeyDatabase(device::Device & device)
 {
+    auto & trace = tools::StartupTrace::instance();
+
     // Load layout description file from disk
-    auto layout = loadLayout(device);
+    auto layout = device::LayoutDescription();
+    {
+        auto phase = trace.phase(device.path(), "layout");
+        layout = loadLayout(device);
+    }
+    auto phase = trace.phase(device.path(), "key database");
 
     // Some keyboards do not report all keys, look for missing keys and patch device
     for (const auto & block : device.blocks()) {
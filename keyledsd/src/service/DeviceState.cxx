@@ -0,0 +1,115 @@
+/* Keyleds -- Gaming keyboard tool
+ * Copyright (C) 2017 Julien Hartmann, juli1.hartmann@gmail.com
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+#include "keyledsd/service/DeviceState.h"
+
+#include "config.h"
+#include "keyledsd/logging.h"
+#include "keyledsd/tools/Paths.h"
+#include <algorithm>
+#include <cstdint>
+#include <fstream>
+#include <iterator>
+
+LOGGING("device-state");
+
+namespace keyleds::service {
+
+/****************************************************************************/
+
+static constexpr char stateMagic[] = {'K', 'L', 'S', 'T', 'A', 'T', 'E', '1'};
+static constexpr std::size_t headerSize = sizeof(stateMagic) + 4;
+
+static std::string statePath(const std::string & serial)
+{
+    auto dirs = tools::paths::getPaths(tools::paths::XDG::Cache, false);
+    if (dirs.empty() || serial.empty()) { return {}; }
+
+    auto name = serial;
+    std::replace(name.begin(), name.end(), '/', '_');
+    return dirs.front() + "/" KEYLEDSD_DATA_PREFIX "/devices/" + name + ".state";
+}
+
+/****************************************************************************/
+
+std::string encodeDeviceState(const RenderTarget & state)
+{
+    const auto count = static_cast<std::uint32_t>(state.size());
+
+    std::string result;
+    result.reserve(headerSize + 4 * state.size());
+    result.append(stateMagic, sizeof(stateMagic));
+    for (unsigned shift = 0; shift < 32; shift += 8) {
+        result.push_back(static_cast<char>((count >> shift) & 0xff));
+    }
+    for (const auto & color : state) {
+        result.push_back(static_cast<char>(color.red));
+        result.push_back(static_cast<char>(color.green));
+        result.push_back(static_cast<char>(color.blue));
+        result.push_back(static_cast<char>(color.alpha));
+    }
+    return result;
+}
+
+std::optional<RenderTarget> decodeDeviceState(std::string_view data, RenderTarget::size_type keyCount)
+{
+    if (data.size() != headerSize + 4 * keyCount
+        || data.compare(0, sizeof(stateMagic), stateMagic, sizeof(stateMagic)) != 0) {
+        return std::nullopt;
+    }
+
+    std::uint32_t count = 0;
+    for (unsigned idx = 0; idx < 4; ++idx) {
+        count |= std::uint32_t(static_cast<unsigned char>(data[sizeof(stateMagic) + idx])) << (8 * idx);
+    }
+    if (count != keyCount) { return std::nullopt; }
+
+    auto result = RenderTarget(keyCount);
+    const auto * ptr = reinterpret_cast<const unsigned char *>(data.data() + headerSize);
+    for (auto & color : result) {
+        color = RGBAColor{ptr[0], ptr[1], ptr[2], ptr[3]};
+        ptr += 4;
+    }
+    return result;
+}
+
+std::optional<RenderTarget> loadDeviceState(const std::string & serial, RenderTarget::size_type keyCount)
+{
+    const auto path = statePath(serial);
+    if (path.empty()) { return std::nullopt; }
+
+    auto file = std::ifstream(path, std::ios::binary);
+    if (!file) { return std::nullopt; }
+    const auto data = std::string(std::istreambuf_iterator<char>(file),
+                                  std::istreambuf_iterator<char>());
+
+    auto result = decodeDeviceState(data, keyCount);
+    if (!result) { DEBUG("ignoring stale state file ", path); }
+    return result;
+}
+
+void saveDeviceState(const std::string & serial, const RenderTarget & state)
+{
+    const auto path = statePath(serial);
+    if (path.empty()) { return; }
+    if (!tools::paths::writeFile(path, encodeDeviceState(state))) {
+        DEBUG("cannot write state file ", path);
+    }
+}
+
+/****************************************************************************/
+
+} // namespace keyleds::service
@@ -16,31 +16,65 @@
  */
 #include "keyledsd/service/DisplayManager.h"
 
+#include "keyledsd/service/DeviceManager.h"
+#include <algorithm>
 #include <functional>
+#include <uv.h>
 
 using keyleds::service::DisplayManager;
 
 /****************************************************************************/
 
+/// Tells whether contexts only differ by window title
+static bool onlyTitleDiffers(const std::vector<std::pair<std::string, std::string>> & lhs,
+                             const std::vector<std::pair<std::string, std::string>> & rhs)
+{
+    return std::equal(lhs.begin(), lhs.end(), rhs.begin(), rhs.end(),
+                      [](const auto & litem, const auto & ritem) {
+                          return litem.first == ritem.first &&
+                                 (litem.first == "title" || litem.second == ritem.second);
+                      });
+}
+
+/****************************************************************************/
+
 DisplayManager::DisplayManager(std::unique_ptr<Display> display, uv_loop_t & loop)
  : m_display(std::move(display)),
    m_contextWatcher(*m_display),
    m_inputWatcher(*m_display),
    m_fdWatcher(m_display->connection(), tools::FDWatcher::Read,
-               [this](auto){ m_display->processEvents(); }, loop),
-   m_context(m_contextWatcher.current())
+               [this](auto){
+                   m_display->processEvents();
+                   m_contextWatcher.processReplies();
+               }, loop),
+   m_context(m_contextWatcher.current()),
+   m_titleTimer(std::make_unique<uv_timer_t>())
 {
+    uv_timer_init(&loop, m_titleTimer.get());
+    m_titleTimer->data = this;
+
     using namespace std::placeholders;
     connect(m_contextWatcher.contextChanged, this,
             std::bind(&DisplayManager::onContextChanged, this, _1));
+    connect(m_inputWatcher.inputEnabled, this,
+            [this](int deviceId, const std::string & devNode) { m_keyRouter.addInput(deviceId, devNode); });
+    connect(m_inputWatcher.inputDisabled, this,
+            [this](int deviceId) { m_keyRouter.removeInput(deviceId); });
     connect(m_inputWatcher.keyEventReceived, this,
-            std::bind(&DisplayManager::onKeyEventReceived, this, _1, _2, _3));
+            std::bind(&DisplayManager::onKeyEventReceived, this, _1, _2, _3, _4));
 }
 
 DisplayManager::~DisplayManager()
 {
     disconnect(m_contextWatcher.contextChanged, this);
+    disconnect(m_inputWatcher.inputEnabled, this);
+    disconnect(m_inputWatcher.inputDisabled, this);
     disconnect(m_inputWatcher.keyEventReceived, this);
+
+    // The actual closing is aysnchronous, so we defer deletion in a callback
+    uv_close(reinterpret_cast<uv_handle_t *>(m_titleTimer.release()), [](uv_handle_t * ptr) {
+        delete reinterpret_cast<uv_timer_t *>(ptr);
+    });
 }
 
 void DisplayManager::scanDevices()
@@ -48,13 +82,42 @@ void DisplayManager::scanDevices()
     m_inputWatcher.scan();
 }
 
+void DisplayManager::addDeviceManager(DeviceManager & manager)
+{
+    m_keyRouter.addTarget(manager, manager.eventDevices());
+}
+
+void DisplayManager::removeDeviceManager(const DeviceManager & manager)
+{
+    m_keyRouter.removeTarget(manager);
+}
+
 void DisplayManager::onContextChanged(const XContextWatcher::context_map & context)
 {
+    const bool titleOnly = onlyTitleDiffers(m_context, context);
     m_context = context;
+
+    if (titleOnly) {
+        // Timer is not restarted, so a window retitling constantly still gets updates
+        if (uv_is_active(reinterpret_cast<uv_handle_t *>(m_titleTimer.get())) == 0) {
+            uv_timer_start(m_titleTimer.get(), [](uv_timer_t * handle) {
+                static_cast<DisplayManager *>(handle->data)->flushContext();
+            }, titleDelay, 0);
+        }
+        return;
+    }
+    flushContext();
+}
+
+void DisplayManager::flushContext()
+{
+    uv_timer_stop(m_titleTimer.get());
     contextChanged.emit(m_context);
 }
 
-void DisplayManager::onKeyEventReceived(const std::string & devNode, int key, bool press)
+void DisplayManager::onKeyEventReceived(int deviceId, int key, bool press,
+                                        XInputWatcher::time_point time)
 {
-    keyEventReceived.emit(devNode, key, press);
+    auto * manager = m_keyRouter.route(deviceId);
+    if (manager != nullptr) { manager->handleKeyEvent(key, press, time); }
 }
@@ -20,6 +20,7 @@
 #include "keyledsd/plugin/module.h"
 #include "keyledsd/tools/DynamicLibrary.h"
 #include <algorithm>
+#include <array>
 #include <unistd.h>
 
 LOGGING("effect-manager");
@@ -39,6 +40,11 @@ static constexpr char moduleEntry[] = "keyledsd_module";
 static constexpr std::array<unsigned char, 16> keyledsdModuleUUID = {{
     KEYLEDSD_MODULE_SIGNATURE
 }};
+/// Signature of modules built before plugin interfaces were versioned
+static constexpr std::array<unsigned char, 16> keyledsdLegacyModuleUUID = {{
+    0xa7, 0x96, 0x85, 0xd4, 0xa9, 0x0c, 0x11, 0xe7,
+    0x98, 0x22, 0x28, 0xb2, 0xbd, 0x4c, 0xbb, 0xe3
+}};
 
 /****************************************************************************/
 
@@ -160,6 +166,11 @@ bool EffectManager::load(const std::string & name, std::string * error)
     }
 
     // Check plugin signature and ABI version
+    if (std::equal(keyledsdLegacyModuleUUID.begin(), keyledsdLegacyModuleUUID.end(),
+                   definition->signature)) {
+        if (error) { *error = "plugin was built for an older plugin interface"; }
+        return false;
+    }
     if (!std::equal(keyledsdModuleUUID.begin(), keyledsdModuleUUID.end(), definition->signature)) {
         if (error) { *error = "invalid plugin signature"; }
         return false;
@@ -170,6 +181,15 @@ bool EffectManager::load(const std::string & name, std::string * error)
         return false;
     }
 
+    if (definition->interface_version != KEYLEDSD_PLUGIN_INTERFACE_VERSION) {
+        if (error) {
+            *error = "plugin interface version " + std::to_string(definition->interface_version)
+                   + " does not match keyleds interface version "
+                   + std::to_string(KEYLEDSD_PLUGIN_INTERFACE_VERSION);
+        }
+        return false;
+    }
+
     if (definition->major != KEYLEDSD_VERSION_MAJOR) {
         if (error) {
             *error = "plugin version " + std::to_string(definition->major)
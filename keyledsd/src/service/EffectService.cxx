@@ -20,15 +20,67 @@
 #include "keyledsd/colors.h"
 #include "keyledsd/logging.h"
 #include "keyledsd/service/DeviceManager.h"
+#include "keyledsd/tools/MemoryAccounting.h"
 #include "keyledsd/tools/Paths.h"
 #include <algorithm>
 #include <cassert>
 #include <fstream>
+#include <mutex>
+#include <sys/stat.h>
+#include <unordered_map>
 
 LOGGING("effect-service");
 
 using keyleds::service::EffectService;
 
+/****************************************************************************/
+// File cache, shared by all effects
+
+namespace {
+    struct CachedFile final
+    {
+        std::string     path;       ///< Path the file was found at
+        struct timespec mtime;      ///< Modification time, when data was read
+        off_t           size;       ///< Size, when data was read
+        std::string     data;       ///< File contents
+    };
+}
+
+static std::mutex                                   fileCacheMutex;
+static std::unordered_map<std::string, CachedFile>  fileCache;
+static keyleds::tools::memory::Counter              fileCacheMemory("file-cache");
+
+/// Approximate heap memory held by a cache entry
+static std::size_t footprint(const std::string & name, const CachedFile & file)
+{
+    return name.size() + file.path.size() + file.data.size() + sizeof(CachedFile);
+}
+
+/// Checks whether file currently resolved at path with given info is the cached one
+static bool isValid(const CachedFile & file, const std::string & path, const struct stat & info)
+{
+    return path == file.path
+        && info.st_mtim.tv_sec == file.mtime.tv_sec
+        && info.st_mtim.tv_nsec == file.mtime.tv_nsec
+        && info.st_size == file.size;
+}
+
+/****************************************************************************/
+// Effect instances, not including their render targets or lua states which
+// are accounted for separately
+
+static keyleds::tools::memory::Counter effectMemory("effects");
+
+/// Approximate heap memory held by an effect's service
+static std::size_t footprint(const std::vector<keyleds::KeyDatabase::KeyGroup> & keyGroups)
+{
+    auto result = sizeof(EffectService) + keyGroups.capacity() * sizeof(keyleds::KeyDatabase::KeyGroup);
+    for (const auto & group : keyGroups) {
+        result += group.name().size() + group.size() * sizeof(keyleds::KeyDatabase::const_iterator);
+    }
+    return result;
+}
+
 /****************************************************************************/
 
 EffectService::EffectService(const DeviceManager & manager,
@@ -36,12 +88,25 @@ EffectService::EffectService(const DeviceManager & manager,
                              const Configuration::Effect & effectConfiguration,
                              std::vector<KeyGroup> keyGroups)
  : m_manager(manager),
-   m_configuration(configuration),
-   m_effectConfiguration(effectConfiguration),
+   m_configuration(&configuration),
+   m_effectConfiguration(&effectConfiguration),
    m_keyGroups(std::move(keyGroups))
-{}
+{
+    effectMemory.allocated(footprint(m_keyGroups));
+}
+
+EffectService::~EffectService()
+{
+    effectMemory.released(footprint(m_keyGroups));
+}
 
-EffectService::~EffectService() = default;
+void EffectService::setConfiguration(const Configuration & configuration,
+                                     const Configuration::Effect & effectConfiguration)
+{
+    assert(effectConfiguration == *m_effectConfiguration);
+    m_configuration = &configuration;
+    m_effectConfiguration = &effectConfiguration;
+}
 
 const std::string & EffectService::deviceName() const
     { return m_manager.name(); }
@@ -59,10 +124,10 @@ const std::vector<EffectService::KeyGroup> & EffectService::keyGroups() const
     { return m_keyGroups; }
 
 const EffectService::color_map & EffectService::colors() const
-    { return m_configuration.customColors; }
+    { return m_configuration->customColors; }
 
 const EffectService::config_map & EffectService::configuration() const
-    { return m_effectConfiguration.items; }
+    { return m_effectConfiguration->items; }
 
 keyleds::RenderTarget * EffectService::createRenderTarget()
 {
@@ -86,19 +151,79 @@ void EffectService::destroyRenderTarget(RenderTarget * ptr)
 const std::string & EffectService::getFile(const std::string & name)
 {
     m_fileData.clear();
-    if (!name.empty()) {
-        auto file = tools::paths::open<std::ifstream>(
-            tools::paths::XDG::Data, KEYLEDSD_DATA_PREFIX "/" + name, std::ios::binary
-        );
-        if (file) {
-            m_fileData.assign(std::istreambuf_iterator<char>(file->stream),
-                              std::istreambuf_iterator<char>());
+    if (name.empty()) { return m_fileData; }
+
+    std::lock_guard<std::mutex> lock(fileCacheMutex);
+
+    // Path is resolved every time, so a file created in a higher priority
+    // directory since it was cached overrides the cached one.
+    auto file = tools::paths::open<std::ifstream>(
+        tools::paths::XDG::Data, KEYLEDSD_DATA_PREFIX "/" + name, std::ios::binary
+    );
+    // Stat before reading, so a concurrent modification invalidates the entry
+    struct stat info;
+    const bool statOk = file && stat(file->path.c_str(), &info) == 0;
+
+    auto it = fileCache.find(name);
+    if (it != fileCache.end()) {
+        if (statOk && isValid(it->second, file->path, info)) {
+            m_fileData = it->second.data;
+            return m_fileData;
+        }
+        DEBUG("file ", it->second.path, " was modified or overridden, reloading");
+        fileCacheMemory.released(footprint(it->first, it->second));
+        fileCache.erase(it);
+    }
+
+    if (file) {
+        m_fileData.assign(std::istreambuf_iterator<char>(file->stream),
+                          std::istreambuf_iterator<char>());
+
+        if (statOk) {
+            auto inserted = fileCache.emplace(name, CachedFile{
+                std::move(file->path), info.st_mtim, info.st_size, m_fileData
+            });
+            fileCacheMemory.allocated(footprint(inserted.first->first, inserted.first->second));
         }
     }
     return m_fileData;
 }
 
+const std::string & EffectService::loadCache(const std::string & name)
+{
+    assert(!name.empty() && name.front() != '/');
+    m_fileData.clear();
+
+    auto dirs = tools::paths::getPaths(tools::paths::XDG::Cache, false);
+    if (dirs.empty()) { return m_fileData; }
+
+    auto file = std::ifstream(dirs.front() + "/" KEYLEDSD_DATA_PREFIX "/" + name, std::ios::binary);
+    if (file) {
+        m_fileData.assign(std::istreambuf_iterator<char>(file),
+                          std::istreambuf_iterator<char>());
+    }
+    return m_fileData;
+}
+
+void EffectService::saveCache(const std::string & name, const std::string & data)
+{
+    assert(!name.empty() && name.front() != '/');
+
+    auto dirs = tools::paths::getPaths(tools::paths::XDG::Cache, false);
+    if (dirs.empty()) { return; }
+
+    auto path = dirs.front() + "/" KEYLEDSD_DATA_PREFIX "/" + name;
+    if (!tools::paths::writeFile(path, data)) {
+        DEBUG("cannot write cache file ", path);
+    }
+}
+
 void EffectService::log(logging::level_t level, const char * msg)
 {
-    l_logger.print(level, m_effectConfiguration.name + ": " + msg);
+    l_logger.print(level, m_effectConfiguration->name + ": " + msg);
+}
+
+void EffectService::subscribeContext(bool value)
+{
+    m_contextSubscribed = value;
 }
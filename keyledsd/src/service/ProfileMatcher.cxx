@@ -0,0 +1,142 @@
+/* Keyleds -- Gaming keyboard tool
+ * Copyright (C) 2017 Julien Hartmann, juli1.hartmann@gmail.com
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+#include "keyledsd/service/ProfileMatcher.h"
+
+#include "keyledsd/logging.h"
+#include <algorithm>
+#include <functional>
+#include <iterator>
+
+LOGGING("profile-matcher");
+
+using keyleds::service::ProfileMatcher;
+
+static constexpr char defaultProfileName[] = "__default__";
+static constexpr char overlayProfileName[] = "__overlay__";
+
+/****************************************************************************/
+
+ProfileMatcher::ProfileMatcher(const Configuration & config, const std::string & deviceName)
+{
+    for (const auto & profile : config.profiles) {
+        const auto & devices = profile.devices;
+        if (!devices.empty() && std::find(devices.begin(), devices.end(), deviceName) == devices.end()) {
+            continue;
+        }
+        if (profile.name == defaultProfileName) {
+            m_default = makeCandidate(config, profile);
+            continue;
+        }
+        if (profile.name == overlayProfileName) {
+            m_overlay = makeCandidate(config, profile);
+            continue;
+        }
+
+        const auto idx = m_candidates.size();
+        const auto & candidate = m_candidates.emplace_back(makeCandidate(config, profile));
+        for (const auto & entry : candidate.lookup) { m_keys.push_back(entry.first); }
+
+        // Index by first exact entry, any one will do as all must match
+        auto eit = std::find_if(candidate.lookup.begin(), candidate.lookup.end(), [](const auto & entry) {
+            return entry.second->kind == LookupEntry::Kind::Exact;
+        });
+        if (eit == candidate.lookup.end()) {
+            m_unindexed.push_back(idx);
+            continue;
+        }
+        auto kit = std::find_if(m_index.begin(), m_index.end(),
+                                [&](const auto & item) { return item.first == eit->first; });
+        if (kit == m_index.end()) {
+            kit = m_index.emplace(m_index.end(), eit->first, value_index());
+        }
+        kit->second[eit->second->text].push_back(idx);
+    }
+    std::sort(m_keys.begin(), m_keys.end());
+    m_keys.erase(std::unique(m_keys.begin(), m_keys.end()), m_keys.end());
+
+    DEBUG("compiled ", m_candidates.size(), " profiles for <", deviceName, ">, ",
+          m_unindexed.size(), " need full evaluation");
+}
+
+ProfileMatcher::~ProfileMatcher() = default;
+
+const ProfileMatcher::Result & ProfileMatcher::match(const Context & context)
+{
+    auto it = m_cache.find(context);
+    if (it != m_cache.end()) { return it->second; }
+
+    // Window titles make for many distinct contexts, keep cache bounded
+    if (m_cache.size() >= maxCachedContexts) { m_cache.clear(); }
+    return m_cache.emplace(context, makeResult(select(context))).first->second;
+}
+
+const ProfileMatcher::Candidate * ProfileMatcher::select(const Context & context) const
+{
+    // Gather profiles whose exact entry matches, plus those without one
+    auto candidates = m_unindexed;
+    for (const auto & [key, values] : m_index) {
+        auto vit = values.find(context[key]);
+        if (vit != values.end()) {
+            candidates.insert(candidates.end(), vit->second.begin(), vit->second.end());
+        }
+    }
+
+    // Last matching profile wins, so check from the end
+    std::sort(candidates.begin(), candidates.end(), std::greater<>());
+    for (auto idx : candidates) {
+        const auto & candidate = m_candidates[idx];
+        if (candidate.matches(context)) { return &candidate; }
+    }
+    return m_default.profile != nullptr ? &m_default : nullptr;
+}
+
+ProfileMatcher::Result ProfileMatcher::makeResult(const Candidate * candidate) const
+{
+    if (!candidate) { return {}; }
+
+    auto result = Result{candidate->profile, candidate->effectGroups};
+    result.effectGroups.insert(result.effectGroups.end(),
+                               m_overlay.effectGroups.begin(), m_overlay.effectGroups.end());
+    return result;
+}
+
+ProfileMatcher::Candidate
+ProfileMatcher::makeCandidate(const Configuration & config, const Profile & profile)
+{
+    auto result = Candidate{&profile, {}, {}};
+    for (const auto & entry : profile.lookup.entries()) {
+        result.lookup.emplace_back(Context::intern(entry.key), &entry);
+    }
+    for (const auto & name : profile.effectGroups) {
+        auto eit = std::find_if(config.effectGroups.begin(), config.effectGroups.end(),
+                                [&name](auto & group) { return group.name == name; });
+        if (eit == config.effectGroups.end()) {
+            ERROR("profile <", profile.name, "> references unknown effect group <", name, ">");
+            continue;
+        }
+        result.effectGroups.push_back(&*eit);
+    }
+    return result;
+}
+
+bool ProfileMatcher::Candidate::matches(const Context & context) const
+{
+    // Same as Lookup::match, on interned keys
+    return std::all_of(lookup.begin(), lookup.end(), [&context](const auto & entry) {
+        return entry.second->matches(context[entry.first]);
+    });
+}
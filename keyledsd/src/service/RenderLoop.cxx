@@ -18,6 +18,7 @@
 
 #include "keyledsd/device/Device.h"
 #include "keyledsd/logging.h"
+#include "keyledsd/tools/StartupTrace.h"
 #include <algorithm>
 #include <cassert>
 #include <cerrno>
@@ -32,6 +33,8 @@ using keyleds::service::RenderLoop;
 using namespace std::literals::chrono_literals;
 
 static constexpr auto errorGracePeriod = 60s;
+static constexpr auto idleMargin = 1ms;     // Idle work must end that long before next frame
+static constexpr auto idleSlice = 500us;    // Renderer lock is released that often during idle work
 struct commitDelay {    // Delay between sending color data and commit command.
     static constexpr std::chrono::microseconds initial = 0ms;
     static constexpr std::chrono::microseconds increment = 1000us;
@@ -44,8 +47,11 @@ RenderLoop::RenderLoop(device::Device & device, unsigned fps)
     : AnimationLoop(fps),
       m_device(device),
       m_commitDelay(commitDelay::initial),
-      m_forceRefresh(false)
+      m_forceRefresh(false),
+      m_traceFirstFrame(tools::StartupTrace::instance().enabled())
 {
+    if (m_traceFirstFrame) { tools::StartupTrace::instance().begin(m_device.path(), "first frame"); }
+
     auto nb = std::accumulate(m_device.blocks().begin(), m_device.blocks().end(), std::size_t{0},
                               [](auto val, auto & block) { return val + block.keys().size(); });
     m_state = RenderTarget(nb);
@@ -57,7 +63,10 @@ RenderLoop::RenderLoop(device::Device & device, unsigned fps)
     m_directives.reserve(max);
 }
 
-RenderLoop::~RenderLoop() = default;
+RenderLoop::~RenderLoop()
+{
+    if (m_traceFirstFrame) { tools::StartupTrace::instance().end(m_device.path(), "first frame"); }
+}
 
 /** Lock render loop, to synchronize renderer list access.
  * @return Mutex lock preventing the animation from using renderers until it is destroyed.
@@ -74,6 +83,10 @@ std::unique_lock<std::mutex> RenderLoop::lock()
  */
 bool RenderLoop::render(milliseconds elapsed)
 {
+#ifndef NDEBUG
+    auto startTime = clock::now();
+#endif
+
     // Run all renderers
     bool hasRenderers;
     {
@@ -88,46 +101,103 @@ bool RenderLoop::render(milliseconds elapsed)
         m_device.flush();   // Ensure another program using the device did not fill
                             // The inbound report queue.
 
-        // Compute diff between old LED state and new LED state
-        bool forceRefresh = m_forceRefresh.exchange(false, std::memory_order_relaxed);
-        bool hasChanges = false;
-        auto oldKeyIt = m_state.cbegin();
-        auto newKeyIt = m_buffer.cbegin();
-
-        for (const auto & block : m_device.blocks()) {
-
-            // Look for changed lights within current block
-            const size_t numBlockKeys = block.keys().size();
-            m_directives.clear();
-            for (size_t kIdx = 0; kIdx < numBlockKeys; ++kIdx) {
-                if (forceRefresh || *oldKeyIt != *newKeyIt) {
-                    m_directives.push_back({
-                        block.keys()[kIdx], newKeyIt->red, newKeyIt->green, newKeyIt->blue
-                    });
-                }
-                ++oldKeyIt;
-                ++newKeyIt;
-            }
+        sendChanges(m_buffer, m_forceRefresh.exchange(false, std::memory_order_relaxed));
+
+        using std::swap;
+        swap(m_state, m_buffer);
+
+        if (m_traceFirstFrame) {
+            tools::StartupTrace::instance().end(m_device.path(), "first frame");
+            m_traceFirstFrame = false;
+        }
+#ifndef NDEBUG
+        recordFrameTime(clock::now() - startTime);
+#endif
+    }
 
-            // If some lights have changed within current block, send directives to device
-            if (!m_directives.empty()) {
-                m_device.setColors(block, m_directives.data(),
-                                   static_cast<device::Device::size_type>(m_directives.size()));
-                hasChanges = true;
+    return true;
+}
+
+/** Send frame to device
+ * Only keys whose color differs from current device state are sent, unless forced.
+ * Does not allocate, so it can be used from render.
+ * @param target Frame to send. Must have as many entries as the device has keys.
+ * @param force Send all keys, regardless of current state.
+ */
+void RenderLoop::sendChanges(const RenderTarget & target, bool force)
+{
+    bool hasChanges = false;
+    auto oldKeyIt = m_state.cbegin();
+    auto newKeyIt = target.cbegin();
+
+    for (const auto & block : m_device.blocks()) {
+
+        // Look for changed lights within current block
+        const size_t numBlockKeys = block.keys().size();
+        m_directives.clear();
+        for (size_t kIdx = 0; kIdx < numBlockKeys; ++kIdx) {
+            if (force || *oldKeyIt != *newKeyIt) {
+                m_directives.push_back({
+                    block.keys()[kIdx], newKeyIt->red, newKeyIt->green, newKeyIt->blue
+                });
             }
+            ++oldKeyIt;
+            ++newKeyIt;
         }
 
-        // Commit color changes, if any
-        if (hasChanges) {
-            std::this_thread::sleep_for(m_commitDelay);
-            m_device.commitColors();
+        // If some lights have changed within current block, send directives to device
+        if (!m_directives.empty()) {
+            m_device.setColors(block, m_directives.data(),
+                               static_cast<device::Device::size_type>(m_directives.size()));
+            hasChanges = true;
         }
+    }
 
-        using std::swap;
-        swap(m_state, m_buffer);
+    // Commit color changes, if any
+    if (hasChanges) {
+        std::this_thread::sleep_for(m_commitDelay);
+        m_device.commitColors();
     }
+}
 
-    return true;
+void RenderLoop::setInitialState(std::optional<RenderTarget> state)
+{
+    assert(!state || state->size() == m_state.size());
+    m_initialState = std::move(state);
+}
+
+/** Idle method
+ * Invoked after each render, lets renderers use the time left until next frame.
+ * Work is cut into short slices, releasing the renderer lock in between so
+ * effects can be updated without waiting for, say, a garbage collection to end.
+ * A renderer returning before its slice ends is assumed to have nothing left to do.
+ * Renderers are taken from a snapshot of the list, those removed while idle work
+ * is in progress are skipped, those added wait for next frame.
+ * @param deadline Time next frame is due.
+ */
+void RenderLoop::idle(clock::time_point deadline)
+{
+    const auto end = deadline - idleMargin;
+    {
+        std::lock_guard<std::mutex> lock(m_mRenderers);
+        m_idleRenderers = m_renderers;      // reuses capacity, no allocation in steady state
+    }
+
+    for (auto * renderer : m_idleRenderers) {
+        for (;;) {
+            const auto now = clock::now();
+            if (now >= end) { return; }
+            const auto sliceEnd = std::min(end, now + idleSlice);
+            {
+                std::lock_guard<std::mutex> lock(m_mRenderers);
+                if (std::find(m_renderers.begin(), m_renderers.end(), renderer) == m_renderers.end()) {
+                    break;                  // removed since snapshot, may be gone already
+                }
+                renderer->idle(sliceEnd);
+            }
+            if (clock::now() < sliceEnd) { break; }
+        }
+    }
 }
 
 /** Main render loop loop.
@@ -136,7 +206,17 @@ bool RenderLoop::render(milliseconds elapsed)
 void RenderLoop::run()
 {
     try {
-        getDeviceState(m_state);
+        {
+            auto phase = tools::StartupTrace::instance().phase(m_device.path(), "readback");
+            getDeviceState(m_state);
+            m_stateKnown = true;
+        }
+        if (m_initialState) {
+            auto phase = tools::StartupTrace::instance().phase(m_device.path(), "restore");
+            sendChanges(*m_initialState, false);
+            std::copy(m_initialState->cbegin(), m_initialState->cend(), m_state.begin());
+            m_initialState.reset();
+        }
     } catch (device::Device::error & error) {
         ERROR("device error: ", error.what());
         return;
@@ -180,6 +260,26 @@ void RenderLoop::run()
     }
 }
 
+/** Record frame duration
+ * Once enough frames are recorded, logs their duration percentiles. This allows
+ * spotting spikes that averaged timings would hide.
+ * @param duration How long the frame took, from running renderers to committing.
+ */
+void RenderLoop::recordFrameTime(clock::duration duration)
+{
+    m_frameTimes[m_frameTimeCount++] = std::chrono::duration_cast<std::chrono::microseconds>(duration);
+    if (m_frameTimeCount < m_frameTimes.size()) { return; }
+    m_frameTimeCount = 0;
+
+    auto percentile = [this](std::size_t pct) {
+        auto it = m_frameTimes.begin() + std::ptrdiff_t((m_frameTimes.size() - 1) * pct / 100);
+        std::nth_element(m_frameTimes.begin(), it, m_frameTimes.end());
+        return it->count();
+    };
+    DEBUG("frame times for loop ", this, ": p50=", percentile(50), "us p95=", percentile(95),
+          "us p99=", percentile(99), "us max=", percentile(100), "us");
+}
+
 /** Read current state of all device lights
  * @param [out] state Buffer into which color values will be written.
  */
@@ -22,7 +22,11 @@
 #include "keyledsd/service/Configuration.h"
 #include "keyledsd/service/DeviceManager.h"
 #include "keyledsd/service/DisplayManager.h"
+#include "keyledsd/tools/EvdevWatcher.h"
+#include "keyledsd/tools/MemoryAccounting.h"
+#include "keyledsd/tools/StartupTrace.h"
 #include "keyledsd/tools/XWindow.h"
+#include <algorithm>
 #include <cassert>
 #include <functional>
 #include <optional>
@@ -33,32 +37,10 @@ LOGGING("service");
 
 using keyleds::service::Service;
 
-/****************************************************************************/
+/// How often memory use is logged, so growth over long sessions shows up
+static constexpr auto memoryLogInterval = std::chrono::minutes(10);
 
-static void merge(std::vector<std::pair<std::string, std::string>> & lhs,
-                  const std::vector<std::pair<std::string, std::string>> & rhs)
-{
-    for (auto & newItem : rhs) {
-        auto it = std::find_if(
-            lhs.begin(), lhs.end(),
-            [&newItem](const auto & item) { return item.first == newItem.first; }
-        );
-        if (it != lhs.end()) {
-            // Key exists
-            if (newItem.second.empty()) {
-                // Value is empty, destroy key
-                if (it != lhs.end() - 1) { *it = std::move(lhs.back()); }
-                lhs.pop_back();
-            } else {
-                // Update with new value
-                it->second = newItem.second;
-            }
-        } else if (!newItem.second.empty()) {
-            // Create key
-            lhs.emplace_back(newItem);
-        }
-    }
-}
+/****************************************************************************/
 
 static std::string to_string(const std::vector<std::pair<std::string, std::string>> & val)
 {
@@ -74,6 +56,22 @@ static std::string to_string(const std::vector<std::pair<std::string, std::strin
     return out.str();
 }
 
+/// Logs memory use of all subsystems, if debug messages are enabled
+static void logMemoryUsage()
+{
+    if (l_logger.policy().canSkip(keyleds::logging::debug::value)) { return; }
+
+    std::ostringstream out;
+    bool first = true;
+    for (const auto & entry : keyleds::tools::memory::usage()) {
+        if (!first) { out <<", "; }
+        first = false;
+        out <<entry.name <<' ' <<entry.bytes <<"B in " <<entry.blocks
+            <<" (peak " <<entry.peak <<"B)";
+    }
+    DEBUG("memory use: ", out.str());
+}
+
 /****************************************************************************/
 
 Service::Service(EffectManager & effectManager, tools::FileWatcher & fileWatcher,
@@ -82,8 +80,20 @@ Service::Service(EffectManager & effectManager, tools::FileWatcher & fileWatcher
       m_fileWatcher(fileWatcher),
       m_configuration(std::move(configuration)),
       m_loop(loop),
+      m_idleTimer(std::make_unique<uv_timer_t>()),
+      m_memoryTimer(std::make_unique<uv_timer_t>()),
       m_deviceWatcher(loop)
 {
+    uv_timer_init(&m_loop, m_idleTimer.get());
+    m_idleTimer->data = this;
+
+    const auto memoryLogDelay = static_cast<uint64_t>(
+        std::chrono::milliseconds(memoryLogInterval).count());
+    uv_timer_init(&m_loop, m_memoryTimer.get());
+    uv_timer_start(m_memoryTimer.get(), [](uv_timer_t *) { logMemoryUsage(); },
+                   memoryLogDelay, memoryLogDelay);
+    uv_unref(reinterpret_cast<uv_handle_t *>(m_memoryTimer.get()));
+
     using namespace std::placeholders;
     connect(m_deviceWatcher.deviceAdded, this, std::bind(&Service::onDeviceAdded, this, _1));
     connect(m_deviceWatcher.deviceRemoved, this, std::bind(&Service::onDeviceRemoved, this, _1));
@@ -94,7 +104,16 @@ Service::Service(EffectManager & effectManager, tools::FileWatcher & fileWatcher
     DEBUG("created");
 }
 
-Service::~Service() = default;
+Service::~Service()
+{
+    // The actual closing is aysnchronous, so we defer deletion in a callback
+    uv_close(reinterpret_cast<uv_handle_t *>(m_idleTimer.release()), [](uv_handle_t * ptr) {
+        delete reinterpret_cast<uv_timer_t *>(ptr);
+    });
+    uv_close(reinterpret_cast<uv_handle_t *>(m_memoryTimer.release()), [](uv_handle_t * ptr) {
+        delete reinterpret_cast<uv_timer_t *>(ptr);
+    });
+}
 
 /****************************************************************************/
 
@@ -105,9 +124,10 @@ void Service::addDisplay(std::unique_ptr<tools::xlib::Display> display)
     using namespace std::placeholders;
     connect(displayManager->contextChanged, this,
             std::bind(&Service::setContext, this, _1));
-    connect(displayManager->keyEventReceived, this,
-            std::bind(&Service::handleKeyEvent, this, _1, _2, _3));
 
+    if (!m_evdevKeys) {
+        for (auto & device : m_devices) { displayManager->addDeviceManager(*device); }
+    }
     displayManager->scanDevices();
     setContext(displayManager->currentContext());
 
@@ -122,9 +142,11 @@ void Service::setConfiguration(Configuration config)
     // old configuration must not be destroyed until propagation is complete
     swap(m_configuration, config);
 
-    // Propagate configuration
-    for (auto & device : m_devices) { device->setConfiguration(&m_configuration); }
-    setContext({}); // force context reloading without changing it
+    // Propagate configuration, forcing context reloading without changing it
+    for (auto & device : m_devices) {
+        device->setConfiguration(&m_configuration);
+        device->setContext(m_context);
+    }
 
     // Setup configuration file watch
     if (!m_configuration.path.empty()) {
@@ -133,6 +155,7 @@ void Service::setConfiguration(Configuration config)
             std::bind(&Service::onConfigurationFileChanged, this, std::placeholders::_1)
         );
     }
+    logMemoryUsage();
 }
 
 void Service::setAutoQuit(bool val)
@@ -140,27 +163,32 @@ void Service::setAutoQuit(bool val)
     m_autoQuit = val;
 }
 
-void Service::setContext(const string_map & context)
+void Service::setIdleTimeout(std::chrono::seconds timeout)
 {
-    merge(m_context, context);
-    INFO("setContext ", ::to_string(m_context));
-    for (auto & device : m_devices) { device->setContext(m_context); }
+    m_idle.setTimeout(timeout);
+    updateIdleTimer();
 }
 
-void Service::handleGenericEvent(const string_map & context)
+void Service::setEvdevKeys(bool val)
 {
-    for (auto & device : m_devices) { device->handleGenericEvent(context); }
+    if (val == m_evdevKeys) { return; }
+    for (auto & device : m_devices) { removeKeySource(*device); }
+    m_evdevKeys = val;
+    for (auto & device : m_devices) { addKeySource(*device); }
 }
 
-void Service::handleKeyEvent(const std::string & devNode, int key, bool press)
+void Service::setContext(const string_map & context)
 {
-    for (auto & device : m_devices) {
-        const auto & evDevs = device->eventDevices();
-        if (std::find(evDevs.begin(), evDevs.end(), devNode) != evDevs.end()) {
-            device->handleKeyEvent(key, press);
-            break;
-        }
-    }
+    const auto changed = m_context.merge(context);
+    if (changed.empty()) { return; }
+
+    INFO("setContext ", ::to_string(m_context.toMap()));
+    for (auto & device : m_devices) { device->updateContext(m_context, changed); }
+}
+
+void Service::handleGenericEvent(const string_map & context)
+{
+    for (auto & device : m_devices) { device->handleGenericEvent(context); }
 }
 
 void Service::forceRefreshDevices()
@@ -204,7 +232,10 @@ void Service::onDeviceAdded(const tools::device::Description & description)
             m_effectManager, m_fileWatcher,
             description, std::move(device), &m_configuration
         );
-        manager->setContext(m_context);
+        {
+            auto phase = tools::StartupTrace::instance().phase(description.devNode(), "effects");
+            manager->setContext(m_context);
+        }
 
         deviceManagerAdded.emit(*manager);
 
@@ -214,9 +245,14 @@ void Service::onDeviceAdded(const tools::device::Description & description)
                " firmware ", manager->device().firmware(),
                ", <", manager->device().name(), ">");
 
+        addKeySource(*manager);
         manager->setPaused(false);
         m_devices.emplace_back(std::move(manager));
 
+        m_idle.deviceAdded();
+        updateIdleTimer();
+        logMemoryUsage();
+
     } catch (device::Device::error & error) {
         if (error.expected()) {
             INFO("not opening device ", description.devNode(), ": ", error.what());
@@ -239,10 +275,70 @@ void Service::onDeviceRemoved(const tools::device::Description & description)
 
         NOTICE("removing device ", manager->serial());
 
+        removeKeySource(*manager);
+
         deviceManagerRemoved.emit(*manager);
+        manager.reset();
+
+        m_idle.deviceRemoved();
+        updateIdleTimer();
+        logMemoryUsage();
 
         if (m_devices.empty() && m_autoQuit) {
             uv_stop(&m_loop);
         }
     }
 }
+
+void Service::addKeySource(DeviceManager & manager)
+{
+    if (!m_evdevKeys) {
+        for (auto & display : m_displays) { display->addDeviceManager(manager); }
+        return;
+    }
+    auto watcher = std::make_unique<tools::EvdevWatcher>(manager.eventDevices(), m_loop);
+    if (watcher->empty()) {
+        WARNING("no readable event device for ", manager.serial(), ", key events disabled");
+    }
+    watcher->keyEventReceived.connect(
+        [&manager](int key, bool press, tools::EvdevReader::time_point time) {
+            manager.handleKeyEvent(key, press, time);
+        });
+    m_keySources.push_back({&manager, std::move(watcher)});
+}
+
+void Service::removeKeySource(const DeviceManager & manager)
+{
+    if (!m_evdevKeys) {
+        for (auto & display : m_displays) { display->removeDeviceManager(manager); }
+        return;
+    }
+    m_keySources.erase(
+        std::remove_if(m_keySources.begin(), m_keySources.end(),
+                       [&manager](const auto & source) { return source.manager == &manager; }),
+        m_keySources.end()
+    );
+}
+
+void Service::updateIdleTimer()
+{
+    uv_timer_stop(m_idleTimer.get());
+
+    const auto deadline = m_idle.deadline();
+    if (!deadline) { return; }
+
+    const auto delay = std::max(
+        std::chrono::ceil<std::chrono::milliseconds>(*deadline - IdleMonitor::clock::now()),
+        std::chrono::milliseconds::zero()
+    );
+    uv_timer_start(m_idleTimer.get(), [](uv_timer_t * handle) {
+        auto & service = *static_cast<Service *>(handle->data);
+        if (!service.m_idle.expired()) {
+            service.updateIdleTimer();  // woke up a tad early
+            return;
+        }
+        NOTICE("no device for ", std::chrono::duration_cast<std::chrono::seconds>(
+                   service.m_idle.timeout()).count(), "s, exiting");
+        uv_stop(&service.m_loop);
+    }, static_cast<uint64_t>(delay.count()), 0);
+}
@@ -19,9 +19,11 @@
 #include "keyledsd/service/DeviceManager.h"
 #include "keyledsd/service/Service.h"
 #include "keyledsd/service/dbus/DeviceManager.h"
+#include "keyledsd/tools/MemoryAccounting.h"
 #include <algorithm>
 #include <systemd/sd-bus.h>
 
+using keyleds::service::Context;
 using keyleds::service::dbus::DeviceManagerAdapter;
 using keyleds::service::dbus::ServiceAdapter;
 
@@ -49,8 +51,9 @@ static int getContext(sd_bus *, const char *, const char *, const char *,
 
     ret = sd_bus_message_open_container(reply, SD_BUS_TYPE_ARRAY, "{ss}");
     if (ret < 0) { return ret; }
-    for (const auto & entry : adapter->service().context()) {
-        ret = sd_bus_message_append(reply, "{ss}", entry.first.c_str(), entry.second.c_str());
+    for (const auto & entry : adapter->service().context().entries()) {
+        ret = sd_bus_message_append(reply, "{ss}", Context::keyName(entry.key).c_str(),
+                                    entry.value.c_str());
         if (ret < 0) { return ret; }
     }
     return sd_bus_message_close_container(reply);
@@ -105,6 +108,22 @@ static int getPlugins(sd_bus *, const char *, const char *, const char *,
     return sd_bus_message_close_container(reply);
 }
 
+static int getMemoryUsage(sd_bus *, const char *, const char *, const char *,
+                          sd_bus_message * reply, void *, sd_bus_error *)
+{
+    int ret;
+
+    ret = sd_bus_message_open_container(reply, SD_BUS_TYPE_ARRAY, "(sttt)");
+    if (ret < 0) { return ret; }
+    for (const auto & entry : keyleds::tools::memory::usage()) {
+        ret = sd_bus_message_append(reply, "(sttt)", entry.name.c_str(),
+                                    uint64_t(entry.bytes), uint64_t(entry.peak),
+                                    uint64_t(entry.blocks));
+        if (ret < 0) { return ret; }
+    }
+    return sd_bus_message_close_container(reply);
+}
+
 static int setContextValues(sd_bus_message * message, void *userdata, sd_bus_error *)
 {
     int ret;
@@ -176,8 +195,9 @@ static int sendKeyEvents(sd_bus_message * message, void *userdata, sd_bus_error
         [=](const auto & device){ return device->serial() == serial; }
     );
     if (it != adapter->service().devices().end()) {
-        (*it)->handleKeyEvent(key, true);
-        (*it)->handleKeyEvent(key, false);
+        const auto now = std::chrono::steady_clock::now();
+        (*it)->handleKeyEvent(key, true, now);
+        (*it)->handleKeyEvent(key, false, now);
     }
     return 0;
 }
@@ -189,6 +209,7 @@ static constexpr sd_bus_vtable interfaceVtable[] = {
     SD_BUS_WRITABLE_PROPERTY("autoQuit", "b", getAutoQuit, setAutoQuit, 0, 0),
     SD_BUS_PROPERTY("devices", "ao", getDevices, 0, 0),
     SD_BUS_PROPERTY("plugins", "as", getPlugins, 0, 0),
+    SD_BUS_PROPERTY("memoryUsage", "a(sttt)", getMemoryUsage, 0, 0),   // name, bytes, peak, blocks
     SD_BUS_SIGNAL("deviceAdded", "o", 0),
     SD_BUS_SIGNAL("deviceRemoved", "o", 0),
     SD_BUS_METHOD("setContextValues", "a{ss}", "", setContextValues,
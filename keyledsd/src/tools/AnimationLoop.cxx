@@ -105,10 +105,12 @@ void AnimationLoop::run()
 
         lock.unlock();
         if (!render(m_period)) { break; }
-        lock.lock();
 
         nextDraw += m_period;
         if (nextDraw <= now) { nextDraw = now + m_period; }
+
+        idle(nextDraw);
+        lock.lock();
     }
     DEBUG("AnimationLoop(", this, ") exiting");
 }
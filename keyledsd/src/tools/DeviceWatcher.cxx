@@ -16,6 +16,7 @@
  */
 #include "keyledsd/tools/DeviceWatcher.h"
 
+#include "keyledsd/tools/StartupTrace.h"
 #include <algorithm>
 #include <cassert>
 #include <libudev.h>
@@ -197,6 +198,7 @@ DeviceWatcher::~DeviceWatcher()
 
 void DeviceWatcher::scan()
 {
+    auto phase = StartupTrace::instance().phase("keyledsd", "udev scan");
     auto enumerator = udev_ptr<struct udev_enumerate>(udev_enumerate_new(m_udev.get()));
 
     setupEnumerator(*enumerator);
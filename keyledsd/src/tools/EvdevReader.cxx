@@ -0,0 +1,103 @@
+/* Keyleds -- Gaming keyboard tool
+ * Copyright (C) 2017 Julien Hartmann, juli1.hartmann@gmail.com
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+#include "keyledsd/tools/EvdevReader.h"
+
+#include "keyledsd/logging.h"
+#include <cerrno>
+#include <fcntl.h>
+#include <linux/input.h>
+#include <sys/ioctl.h>
+#include <system_error>
+#include <time.h>
+#include <unistd.h>
+#include <utility>
+
+LOGGING("evdev");
+
+using keyleds::tools::EvdevReader;
+
+/****************************************************************************/
+
+EvdevReader::EvdevReader(int fd) noexcept
+ : m_fd(fd)
+{}
+
+EvdevReader::EvdevReader(EvdevReader && other) noexcept
+ : keyEventReceived(std::move(other.keyEventReceived)),
+   m_fd(std::exchange(other.m_fd, -1))
+{}
+
+EvdevReader & EvdevReader::operator=(EvdevReader && other) noexcept
+{
+    if (this != &other) {
+        if (m_fd >= 0) { ::close(m_fd); }
+        keyEventReceived = std::move(other.keyEventReceived);
+        m_fd = std::exchange(other.m_fd, -1);
+    }
+    return *this;
+}
+
+EvdevReader::~EvdevReader()
+{
+    if (m_fd >= 0) { ::close(m_fd); }
+}
+
+EvdevReader EvdevReader::open(const std::string & path)
+{
+    int fd = ::open(path.c_str(), O_RDONLY | O_NONBLOCK | O_CLOEXEC);
+    if (fd < 0) { throw std::system_error(errno, std::generic_category(), path); }
+
+    // Default is CLOCK_REALTIME, which jumps around; not fatal as times are advisory
+    int clockId = CLOCK_MONOTONIC;
+    if (::ioctl(fd, EVIOCSCLOCKID, &clockId) < 0) {
+        DEBUG("cannot set monotonic clock on ", path, ": ", std::generic_category().message(errno));
+    }
+    return EvdevReader(fd);
+}
+
+bool EvdevReader::readAll()
+{
+    struct input_event events[batchSize];
+
+    for (;;) {
+        auto nread = ::read(m_fd, events, sizeof(events));
+        if (nread < 0) {
+            if (errno == EINTR) { continue; }
+            if (errno == EAGAIN || errno == EWOULDBLOCK) { return true; }
+            DEBUG("read on fd ", m_fd, ": ", std::generic_category().message(errno));
+            return false;   // ENODEV when device is unplugged
+        }
+        if (nread == 0) { return false; }
+
+        const auto count = static_cast<std::size_t>(nread) / sizeof(events[0]);
+        for (std::size_t idx = 0; idx < count; ++idx) {
+            const auto & event = events[idx];
+            if (event.type == EV_KEY && event.value != 2) {
+                keyEventReceived.emit(
+                    event.code, event.value != 0,
+                    time_point(std::chrono::seconds(event.input_event_sec)
+                               + std::chrono::microseconds(event.input_event_usec))
+                );
+            } else if (event.type == EV_SYN && event.code == SYN_DROPPED) {
+                DEBUG("kernel event queue overflowed on fd ", m_fd);
+            }
+        }
+
+        // Kernel hands out everything it has at once: a short read means the queue is empty
+        if (static_cast<std::size_t>(nread) < sizeof(events)) { return true; }
+    }
+}
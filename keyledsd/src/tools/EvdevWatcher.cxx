@@ -0,0 +1,68 @@
+/* Keyleds -- Gaming keyboard tool
+ * Copyright (C) 2017 Julien Hartmann, juli1.hartmann@gmail.com
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+#include "keyledsd/tools/EvdevWatcher.h"
+
+#include "keyledsd/logging.h"
+#include <system_error>
+
+LOGGING("evdev");
+
+using keyleds::tools::EvdevWatcher;
+
+/****************************************************************************/
+
+static bool isEventNode(const std::string & devNode)
+{
+    const auto pos = devNode.rfind('/');
+    return devNode.compare(pos == std::string::npos ? 0 : pos + 1, 5, "event") == 0;
+}
+
+/****************************************************************************/
+
+EvdevWatcher::EvdevWatcher(const std::vector<std::string> & devNodes, uv_loop_t & loop)
+{
+    for (const auto & devNode : devNodes) {
+        if (!isEventNode(devNode)) { continue; }
+        try {
+            auto input = std::make_unique<Input>(Input{devNode, EvdevReader::open(devNode), nullptr});
+            input->reader.keyEventReceived.connect(
+                [this](int key, bool press, EvdevReader::time_point time) {
+                    keyEventReceived.emit(key, press, time);
+                });
+            input->watcher = std::make_unique<FDWatcher>(
+                input->reader.fd(), FDWatcher::Read,
+                [this, ptr = input.get()](auto) { onReady(*ptr); },
+                loop
+            );
+            INFO("reading key events from ", devNode);
+            m_inputs.push_back(std::move(input));
+        } catch (std::system_error & error) {
+            ERROR("cannot read key events: ", error.what());
+        }
+    }
+}
+
+EvdevWatcher::~EvdevWatcher() = default;
+
+void EvdevWatcher::onReady(Input & input)
+{
+    if (!input.reader.readAll()) {
+        // Device went away, udev removal will dispose of us soon
+        INFO("stopped reading key events from ", input.devNode);
+        input.watcher.reset();
+    }
+}
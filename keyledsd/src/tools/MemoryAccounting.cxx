@@ -0,0 +1,83 @@
+/* Keyleds -- Gaming keyboard tool
+ * Copyright (C) 2017 Julien Hartmann, juli1.hartmann@gmail.com
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+#include "keyledsd/tools/MemoryAccounting.h"
+#include "config.h"
+
+#include <algorithm>
+#include <cassert>
+#include <mutex>
+
+using keyleds::tools::memory::Counter;
+
+/****************************************************************************/
+// Registry of all live counters. Function-local statics, as counters are
+// themselves static objects and may be created before this unit is initialized.
+
+static std::mutex & registryMutex()
+{
+    static std::mutex mutex;
+    return mutex;
+}
+
+static std::vector<const Counter *> & registry()
+{
+    static std::vector<const Counter *> counters;
+    return counters;
+}
+
+/****************************************************************************/
+
+KEYLEDSD_EXPORT Counter::Counter(const char * name)
+ : m_name(name)
+{
+    std::lock_guard<std::mutex> lock(registryMutex());
+    registry().push_back(this);
+}
+
+KEYLEDSD_EXPORT Counter::~Counter()
+{
+    std::lock_guard<std::mutex> lock(registryMutex());
+    auto & counters = registry();
+    auto it = std::find(counters.begin(), counters.end(), this);
+    assert(it != counters.end());
+    counters.erase(it);
+}
+
+KEYLEDSD_EXPORT std::vector<keyleds::tools::memory::Usage> keyleds::tools::memory::usage()
+{
+    std::vector<Usage> result;
+
+    std::lock_guard<std::mutex> lock(registryMutex());
+    for (const auto * counter : registry()) {
+        auto it = std::find_if(result.begin(), result.end(), [counter](const auto & item) {
+            return item.name == counter->name();
+        });
+        if (it == result.end()) {
+            result.push_back(Usage{counter->name(), counter->bytes(),
+                                   counter->peak(), counter->blocks()});
+        } else {
+            // Counters need not have peaked together, so peaks cannot be added
+            it->bytes += counter->bytes();
+            it->peak = std::max(it->peak, counter->peak());
+            it->blocks += counter->blocks();
+        }
+    }
+    for (auto & entry : result) { entry.peak = std::max(entry.peak, entry.bytes); }
+    std::sort(result.begin(), result.end(),
+              [](const auto & lhs, const auto & rhs) { return lhs.name < rhs.name; });
+    return result;
+}
@@ -18,12 +18,16 @@
 
 #include "config.h"
 #include <algorithm>
+#include <array>
 #include <cassert>
+#include <cerrno>
+#include <cstdio>
 #include <cstdlib>
 #include <fstream>
 #include <regex>
 #include <sstream>
 #include <stdexcept>
+#include <sys/stat.h>
 
 using keyleds::tools::paths::XDG;
 
@@ -83,6 +87,16 @@ static std::string expandVars(const std::string & value)
     return result;
 }
 
+/// Creates all missing directories in path, up to but excluding last component
+static bool makeParentDirectories(const std::string & path)
+{
+    for (auto pos = path.find('/', 1); pos != std::string::npos; pos = path.find('/', pos + 1)) {
+        auto dir = path.substr(0, pos);
+        if (mkdir(dir.c_str(), 0700) != 0 && errno != EEXIST) { return false; }
+    }
+    return true;
+}
+
 static std::string canonicalPath(const std::string & path)
 {
 #if _POSIX_C_SOURCE >= 200809L
@@ -167,3 +181,24 @@ keyleds::tools::paths::open_filebuf(XDG type, const std::string & path, std::ios
     }
     return std::nullopt;
 }
+
+bool keyleds::tools::paths::writeFile(const std::string & path, std::string_view data)
+{
+    assert(!path.empty() && path.front() == '/');
+    if (!makeParentDirectories(path)) { return false; }
+
+    auto tmpPath = path + ".tmp";
+    {
+        auto file = std::ofstream(tmpPath, std::ios::binary | std::ios::trunc);
+        file.write(data.data(), static_cast<std::streamsize>(data.size()));
+        if (!file) {
+            std::remove(tmpPath.c_str());
+            return false;
+        }
+    }
+    if (std::rename(tmpPath.c_str(), path.c_str()) != 0) {
+        std::remove(tmpPath.c_str());
+        return false;
+    }
+    return true;
+}
@@ -0,0 +1,222 @@
+/* Keyleds -- Gaming keyboard tool
+ * Copyright (C) 2017 Julien Hartmann, juli1.hartmann@gmail.com
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+#include "keyledsd/tools/StartupTrace.h"
+
+#include <algorithm>
+#include <cstdio>
+#include <ostream>
+
+using keyleds::tools::StartupTrace;
+
+/****************************************************************************/
+
+static double toMilliseconds(StartupTrace::clock::duration duration)
+{
+    return std::chrono::duration<double, std::milli>(duration).count();
+}
+
+static long long toMicroseconds(StartupTrace::clock::duration duration)
+{
+    return std::chrono::duration_cast<std::chrono::microseconds>(duration).count();
+}
+
+static void writeJSONString(std::ostream & out, const std::string & value)
+{
+    out <<'"';
+    for (char chr : value) {
+        switch (chr) {
+            case '"':   out <<"\\\""; break;
+            case '\\':  out <<"\\\\"; break;
+            case '\n':  out <<"\\n"; break;
+            default:
+                if (static_cast<unsigned char>(chr) < 0x20) {
+                    char buffer[8];
+                    std::snprintf(buffer, sizeof(buffer), "\\u%04x", static_cast<unsigned>(chr));
+                    out <<buffer;
+                } else {
+                    out <<chr;
+                }
+        }
+    }
+    out <<'"';
+}
+
+/****************************************************************************/
+
+StartupTrace::Phase::Phase(StartupTrace * trace, std::string_view scope, std::string_view name)
+ : m_trace(trace)
+{
+    if (m_trace) {
+        m_scope = scope;
+        m_name = name;
+        m_start = clock::now();
+    }
+}
+
+StartupTrace::Phase::~Phase()
+{
+    if (m_trace) { m_trace->record(m_scope, m_name, m_start, clock::now()); }
+}
+
+/****************************************************************************/
+
+StartupTrace & StartupTrace::instance()
+{
+    static StartupTrace trace;
+    return trace;
+}
+
+void StartupTrace::start()
+{
+    std::lock_guard<std::mutex> lock(m_mutex);
+    m_origin = clock::now();
+    m_spans.clear();
+    m_open.clear();
+    m_enabled.store(true, std::memory_order_relaxed);
+}
+
+void StartupTrace::stop()
+{
+    m_enabled.store(false, std::memory_order_relaxed);
+}
+
+StartupTrace::Phase StartupTrace::phase(std::string_view scope, std::string_view name)
+{
+    return Phase(enabled() ? this : nullptr, scope, name);
+}
+
+void StartupTrace::begin(std::string_view scope, std::string_view name)
+{
+    if (!enabled()) { return; }
+    const auto now = clock::now();
+    std::lock_guard<std::mutex> lock(m_mutex);
+    m_open.push_back({std::string(scope), std::string(name), now, now});
+}
+
+void StartupTrace::end(std::string_view scope, std::string_view name)
+{
+    if (!enabled()) { return; }
+    const auto now = clock::now();
+    std::lock_guard<std::mutex> lock(m_mutex);
+    auto it = std::find_if(m_open.begin(), m_open.end(), [&](const auto & span) {
+        return span.scope == scope && span.name == name;
+    });
+    if (it == m_open.end()) { return; }
+    it->end = now;
+    m_spans.push_back(std::move(*it));
+    m_open.erase(it);
+}
+
+void StartupTrace::record(std::string_view scope, std::string_view name,
+                          clock::time_point start, clock::time_point end)
+{
+    if (!enabled()) { return; }
+    std::lock_guard<std::mutex> lock(m_mutex);
+    m_spans.push_back({std::string(scope), std::string(name), start, end});
+}
+
+std::size_t StartupTrace::pending() const
+{
+    std::lock_guard<std::mutex> lock(m_mutex);
+    return m_open.size();
+}
+
+StartupTrace::span_list StartupTrace::spans() const
+{
+    auto result = span_list();
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        result = m_spans;
+    }
+    std::stable_sort(result.begin(), result.end(),
+                     [](const auto & lhs, const auto & rhs) { return lhs.start < rhs.start; });
+    return result;
+}
+
+/****************************************************************************/
+
+void StartupTrace::writeSummary(std::ostream & out) const
+{
+    const auto spanList = spans();
+    clock::time_point origin, last;
+    std::size_t pendingCount;
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        origin = last = m_origin;
+        pendingCount = m_open.size();
+    }
+    std::size_t scopeWidth = 5;
+    for (const auto & span : spanList) {
+        scopeWidth = std::max(scopeWidth, span.scope.size());
+        last = std::max(last, span.end);
+    }
+
+    char buffer[64];
+    std::snprintf(buffer, sizeof(buffer), "%.1f ms", toMilliseconds(last - origin));
+    out <<"startup trace: " <<buffer <<" total";
+    if (pendingCount > 0) { out <<", " <<pendingCount <<" phase(s) unfinished"; }
+    out <<'\n';
+
+    out <<"    offset   duration  " <<std::string("scope").append(scopeWidth - 5, ' ') <<"  phase\n";
+    for (const auto & span : spanList) {
+        std::snprintf(buffer, sizeof(buffer), "%7.1fms  %7.1fms  ",
+                      toMilliseconds(span.start - origin), toMilliseconds(span.end - span.start));
+        out <<"  " <<buffer
+            <<span.scope <<std::string(scopeWidth - span.scope.size(), ' ')
+            <<"  " <<span.name <<'\n';
+    }
+}
+
+void StartupTrace::writeTrace(std::ostream & out) const
+{
+    const auto spanList = spans();
+    clock::time_point origin;
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        origin = m_origin;
+    }
+
+    // Each scope is shown as a thread of its own
+    std::vector<std::string> scopes;
+    for (const auto & span : spanList) {
+        if (std::find(scopes.begin(), scopes.end(), span.scope) == scopes.end()) {
+            scopes.push_back(span.scope);
+        }
+    }
+
+    out <<"{\"traceEvents\":[";
+    bool first = true;
+    for (std::size_t idx = 0; idx < scopes.size(); ++idx) {
+        out <<(first ? "\n" : ",\n");
+        first = false;
+        out <<"{\"ph\":\"M\",\"name\":\"thread_name\",\"pid\":1,\"tid\":" <<idx + 1
+            <<",\"args\":{\"name\":";
+        writeJSONString(out, scopes[idx]);
+        out <<"}}";
+    }
+    for (const auto & span : spanList) {
+        const auto tid = std::find(scopes.begin(), scopes.end(), span.scope) - scopes.begin() + 1;
+        out <<(first ? "\n" : ",\n");
+        first = false;
+        out <<"{\"ph\":\"X\",\"cat\":\"startup\",\"name\":";
+        writeJSONString(out, span.name);
+        out <<",\"pid\":1,\"tid\":" <<tid
+            <<",\"ts\":" <<toMicroseconds(span.start - origin)
+            <<",\"dur\":" <<toMicroseconds(span.end - span.start) <<'}';
+    }
+    out <<"\n]}\n";
+}
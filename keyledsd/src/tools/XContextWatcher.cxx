@@ -25,6 +25,8 @@ LOGGING("context-watcher");
 
 using keyleds::tools::xlib::XContextWatcher;
 static constexpr char activeWindowAtom[] = "_NET_ACTIVE_WINDOW";
+static constexpr char netNameAtom[] = "_NET_WM_NAME";
+static constexpr char nameAtom[] = "WM_NAME";
 
 /****************************************************************************/
 
@@ -33,13 +35,19 @@ XContextWatcher::XContextWatcher(xlib::Display & display)
    m_displayReg(m_display.registerHandler(PropertyNotify, std::bind(
                 &XContextWatcher::handleEvent, this, std::placeholders::_1)))
 {
+    // Intern all atoms events are matched against at once, rather than on first event
+    display.loadAtoms({ activeWindowAtom, netNameAtom, nameAtom, "UTF8_STRING" });
+
     // Setup active window watch
     XSetWindowAttributes attributes;
     attributes.event_mask = PropertyChangeMask;
     display.root().changeAttributes(CWEventMask, attributes);
 
+    // Initial context is needed right away, so this waits for replies
     m_activeWindow = display.getActiveWindow();
-    onActiveWindowChanged(m_activeWindow.get(), false);
+    onActiveWindowChanged(m_activeWindow.get(), true);
+    if (m_activeWindow != nullptr && !m_activeWindow->update()) { m_activeWindow = nullptr; }
+    setContext(m_activeWindow.get());
 }
 
 XContextWatcher::~XContextWatcher()
@@ -51,62 +59,67 @@ void XContextWatcher::handleEvent(const XEvent & event)
 {
     switch (event.type) {
     case PropertyNotify:
-        // Handle a change of active window
+        // Handle a change of active window, superseding any query in flight
         if (event.xproperty.atom == m_display.atom(activeWindowAtom)) {
-            auto active = m_display.getActiveWindow();
-            if ((active == nullptr) != (m_activeWindow == nullptr) ||
-                (active != nullptr && active->handle() != m_activeWindow->handle())) {
-                // Event must fire before the property is updated
-                onActiveWindowChanged(active.get(), false);
-                m_activeWindow = std::move(active);
-            }
+            m_activeRequest.reset();
+            m_activeRequest.emplace(m_display.requestActiveWindow());
         }
 
         // If we have an active window, see whether this is an update of its title
         if (m_activeWindow != nullptr && (
-                event.xproperty.atom == m_display.atom("_NET_WM_NAME") ||
-                event.xproperty.atom == m_display.atom("WM_NAME"))) {
-
-            // As events are asynchronous, the window might have been destroyed by
-            // the time the handler runs. Catch errors to prevent a crash.
-            xlib::ErrorCatcher errors;
+                event.xproperty.atom == m_display.atom(netNameAtom) ||
+                event.xproperty.atom == m_display.atom(nameAtom))) {
+            m_activeWindow->requestUpdate();
+        }
+        break;
+    }
+}
 
-            setContext(m_activeWindow.get());
+void XContextWatcher::processReplies()
+{
+    if (m_activeRequest && m_activeRequest->poll()) {
+        auto active = m_display.activeWindow(*m_activeRequest);
+        m_activeRequest.reset();
+        if ((active == nullptr) != (m_activeWindow == nullptr) ||
+            (active != nullptr && active->handle() != m_activeWindow->handle())) {
+            // Event must fire before the property is updated
+            onActiveWindowChanged(active.get(), false);
+            m_activeWindow = std::move(active);
+        }
+    }
 
-            errors.synchronize(m_display);
-            if (errors) {
-                DEBUG("PropertNotify - _NET_WM_NAME changed had ", errors.errors().size(), " errors");
+    if (m_activeWindow != nullptr && m_activeWindow->updatePending()) {
+        // As events are asynchronous, the window might have been destroyed by
+        // the time requests reach the server. Properties of a dead window fail to load.
+        const auto loaded = m_activeWindow->pollUpdate();
+        if (loaded) {
+            if (!*loaded) {
+                DEBUG("window ", m_activeWindow->handle(), " is gone");
                 m_activeWindow = nullptr;
             }
+            setContext(m_activeWindow.get());
         }
-        break;
     }
+    m_display.flush();
 }
 
 void XContextWatcher::onActiveWindowChanged(xlib::Window * window, bool silent)
 {
     // As events are asynchronous, either window (or both!) might have been
-    // destroyed by the time the handler runs. Catch errors to prevent a crash.
-    xlib::ErrorCatcher errors;
-
-    if (m_activeWindow != nullptr) {
-        XSetWindowAttributes attributes;
-        attributes.event_mask = NoEventMask;
-        m_activeWindow->changeAttributes(CWEventMask, attributes);
-    }
-
-    if (window != nullptr) {
-        XSetWindowAttributes attributes;
-        attributes.event_mask = PropertyChangeMask;
-        window->changeAttributes(CWEventMask, attributes);
-    }
-
-    if (!silent) { setContext(window); }
-
-    errors.synchronize(m_display);
-    if (errors) {
-        DEBUG("onActiveWindowChanged, ignoring ", errors.errors().size(), " errors");
+    // destroyed by the time the handler runs. Event mask errors are discarded,
+    // and properties of a dead window fail to load, so no round trip is needed
+    // just to catch errors.
+    if (m_activeWindow != nullptr) { m_activeWindow->setEventMask(NoEventMask); }
+    if (window != nullptr) { window->setEventMask(PropertyChangeMask); }
+
+    if (!silent) {
+        if (window != nullptr) {
+            window->requestUpdate();    // context is set once replies are in
+        } else {
+            setContext(nullptr);
+        }
     }
+    m_display.flush();
 }
 
 void XContextWatcher::setContext(xlib::Window * window)
@@ -99,14 +99,10 @@ void XInputWatcher::handleEvent(const XEvent & event)
         DEBUG("key ", data->detail - MIN_KEYCODE, " ",
               event.xcookie.evtype == XI_RawKeyPress ? "pressed" : "released",
               " on device ", data->deviceid);
-        auto it = std::find_if(
-            m_devices.begin(), m_devices.end(),
-            [&](const auto & device) { return device.handle() == data->deviceid; }
-        );
-        if (it != m_devices.end()) {
-            keyEventReceived.emit(it->devNode(), data->detail - MIN_KEYCODE,
-                                  event.xcookie.evtype == XI_RawKeyPress);
-        }
+        // Only enabled keyboards have raw events selected, no need to check
+        keyEventReceived.emit(data->deviceid, data->detail - MIN_KEYCODE,
+                              event.xcookie.evtype == XI_RawKeyPress,
+                              m_serverTime.map(static_cast<std::uint32_t>(data->time)));
         } break;
     }
 }
@@ -132,7 +128,8 @@ void XInputWatcher::onInputEnabled(int deviceId, int use)
               errors.errors().size(), " errors");
     } else {
         INFO("xinput keyboard ", deviceId, " enabled for device ", device.devNode());
-        m_devices.emplace_back(std::move(device));
+        const auto & added = m_devices.emplace_back(std::move(device));
+        inputEnabled.emit(deviceId, added.devNode());
     }
 }
 
@@ -149,6 +146,7 @@ void XInputWatcher::onInputDisabled(int deviceId, int use)
     if (it != m_devices.end() - 1) { *it = std::move(m_devices.back()); }
     m_devices.pop_back();
     INFO("xinput keyboard ", deviceId, " disabled");
+    inputDisabled.emit(deviceId);
 
     errors.synchronize(m_display);
     if (errors) {
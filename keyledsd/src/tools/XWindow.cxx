@@ -20,12 +20,17 @@
 #include <algorithm>
 #include <cassert>
 #include <cstddef>
+#include <cstdlib>
 #include <cstring>
 #include <limits>
+#include <optional>
 #include <sstream>
 #include <stdexcept>
+#include <xcb/xcb.h>
+#include <xcb/xcbext.h>
 #define Bool int
 #include <X11/Xatom.h>
+#include <X11/Xlib-xcb.h>
 #include <X11/extensions/XInput2.h>
 #undef Bool
 
@@ -35,6 +40,7 @@ namespace xlib = keyleds::tools::xlib;
 
 using xlib::Device;
 using xlib::ErrorCatcher;
+using xlib::PropertyRequest;
 using xlib::X11Display;
 
 static constexpr char activeWindowAtom[] = "_NET_ACTIVE_WINDOW";
@@ -42,6 +48,9 @@ static constexpr char nameAtom[] = "_NET_WM_NAME";
 static constexpr char deviceNodeAtom[] = "Device Node";
 static constexpr char utf8Atom[] = "UTF8_STRING";
 
+/// XCB replies are malloc'ed, this owns them until they are freed
+template <typename T> using xcb_reply_ptr = std::unique_ptr<T, decltype(&std::free)>;
+
 /****************************************************************************/
 
 struct xlib::Display::HandlerInfo
@@ -55,6 +64,7 @@ struct xlib::Display::HandlerInfo
 
 xlib::Display::Display(const std::string & name)
  : m_display(openDisplay(name)),
+   m_connection(XGetXCBConnection(m_display.get())),
    m_name(DisplayString(m_display.get())),
    m_root(*this, DefaultRootWindow(m_display.get())),
    m_nextSubscription(1)
@@ -73,22 +83,58 @@ int xlib::Display::connection() const
 
 Atom xlib::Display::atom(const std::string & name) const
 {
-    const auto it = std::find_if(m_atomCache.cbegin(), m_atomCache.cend(),
-                                 [&name](const auto & entry) { return entry.first == name; });
-    if (it != m_atomCache.cend()) { return it->second; }
+    const auto it = m_atomCache.find(name);
+    if (it != m_atomCache.end()) { return it->second; }
 
     // Not in cache, run the query
-    Atom atom = XInternAtom(m_display.get(), name.c_str(), True);
-    m_atomCache.emplace_back(name, atom);
-    return atom;
+    loadAtoms({ name });
+    return m_atomCache.find(name)->second;
+}
+
+void xlib::Display::loadAtoms(const std::vector<std::string> & names) const
+{
+    // Send all requests before waiting for any reply
+    std::vector<xcb_intern_atom_cookie_t> cookies;
+    cookies.reserve(names.size());
+    for (const auto & name : names) {
+        cookies.push_back(xcb_intern_atom(m_connection, 1,
+                                          static_cast<uint16_t>(name.size()), name.c_str()));
+    }
+    for (std::size_t idx = 0; idx < names.size(); ++idx) {
+        auto reply = xcb_reply_ptr<xcb_intern_atom_reply_t>(
+            xcb_intern_atom_reply(m_connection, cookies[idx], nullptr), std::free
+        );
+        m_atomCache[names[idx]] = reply ? Atom(reply->atom) : Atom(None);
+    }
+}
+
+void xlib::Display::flush()
+{
+    xcb_flush(m_connection);
 }
 
 std::unique_ptr<xlib::Window> xlib::Display::getActiveWindow()
 {
-    std::string data = m_root.getProperty(atom(activeWindowAtom), XA_WINDOW);
-    ::Window handle;
-    memcpy(&handle, data.data(), sizeof(handle));
-    if (handle == 0) { return nullptr; }
+    if (atom(activeWindowAtom) == None) { return nullptr; }
+    auto request = requestActiveWindow();
+    return activeWindow(request);
+}
+
+PropertyRequest xlib::Display::requestActiveWindow()
+{
+    // Without window manager support, atom is None and the request fails
+    return PropertyRequest(*this, m_root.handle(), atom(activeWindowAtom), XA_WINDOW);
+}
+
+std::unique_ptr<xlib::Window> xlib::Display::activeWindow(PropertyRequest & request)
+{
+    const auto & data = request.value();
+
+    // Unlike Xlib, XCB does not widen 32-bit items to long
+    xcb_window_t handle = XCB_WINDOW_NONE;
+    if (data.size() < sizeof(handle)) { return nullptr; }
+    std::memcpy(&handle, data.data(), sizeof(handle));
+    if (handle == XCB_WINDOW_NONE) { return nullptr; }
     return std::make_unique<Window>(*this, handle);
 }
 
@@ -152,6 +198,84 @@ xlib::Display::subscription::~subscription()
 
 /****************************************************************************/
 
+/// Logs and frees an error returned along a reply, telling whether there was one
+static bool checkError(xcb_generic_error_t * error)
+{
+    if (error == nullptr) { return false; }
+    DEBUG("GetProperty failed with error ", int(error->error_code));
+    std::free(error);
+    return true;
+}
+
+PropertyRequest::PropertyRequest(const Display & display, ::Window window, Atom atom, Atom type)
+ : m_connection(display.xcbConnection()),
+   m_sequence(xcb_get_property(m_connection, 0, static_cast<xcb_window_t>(window),
+                               static_cast<xcb_atom_t>(atom), static_cast<xcb_atom_t>(type),
+                               0, std::numeric_limits<uint32_t>::max() / 4).sequence),
+   m_type(type)
+{}
+
+PropertyRequest::PropertyRequest(PropertyRequest && other) noexcept
+ : m_connection(other.m_connection),
+   m_sequence(other.m_sequence),
+   m_type(other.m_type),
+   m_pending(other.m_pending),
+   m_failed(other.m_failed),
+   m_value(std::move(other.m_value))
+{
+    other.m_pending = false;
+}
+
+PropertyRequest::~PropertyRequest()
+{
+    if (m_pending) { xcb_discard_reply(m_connection, m_sequence); }
+}
+
+const std::string & PropertyRequest::value()
+{
+    if (m_pending) { wait(); }
+    return m_value;
+}
+
+bool PropertyRequest::failed()
+{
+    if (m_pending) { wait(); }
+    return m_failed;
+}
+
+bool PropertyRequest::poll()
+{
+    if (!m_pending) { return true; }
+
+    void * reply = nullptr;
+    xcb_generic_error_t * error = nullptr;
+    if (xcb_poll_for_reply(m_connection, m_sequence, &reply, &error) == 0) { return false; }
+    store(reply, checkError(error));
+    return true;
+}
+
+void PropertyRequest::wait()
+{
+    xcb_generic_error_t * error = nullptr;
+    auto * reply = xcb_get_property_reply(m_connection, xcb_get_property_cookie_t{m_sequence}, &error);
+    store(reply, checkError(error));
+}
+
+void PropertyRequest::store(void * data, bool failed)
+{
+    m_pending = false;
+    m_failed = failed;
+    auto reply = xcb_reply_ptr<xcb_get_property_reply_t>(
+        static_cast<xcb_get_property_reply_t *>(data), std::free
+    );
+    if (reply == nullptr || reply->type != m_type || reply->format == 0) { return; }
+
+    m_value.assign(static_cast<const char *>(xcb_get_property_value(reply.get())),
+                   static_cast<std::size_t>(xcb_get_property_value_length(reply.get())));
+}
+
+/****************************************************************************/
+
 xlib::Window::Window(Display & display, handle_type window)
  : m_display(display), m_window(window)
 {}
@@ -164,67 +288,88 @@ void xlib::Window::changeAttributes(unsigned long mask, const XSetWindowAttribut
                             const_cast<XSetWindowAttributes*>(&attrs));
 }
 
-std::string xlib::Window::name() const
+void xlib::Window::setEventMask(std::uint32_t mask)
 {
-    std::string name = getProperty(
-        m_display.atom(nameAtom),
-        m_display.atom(utf8Atom)
+    const std::uint32_t values[] = { mask };
+    auto cookie = xcb_change_window_attributes_checked(
+        m_display.xcbConnection(), static_cast<xcb_window_t>(m_window), XCB_CW_EVENT_MASK, values
     );
-    if (name.empty()) {
-        name = getProperty(XA_WM_NAME, XA_STRING);
-    }
-    return name;
+    // Only checked requests can have their errors discarded
+    xcb_discard_reply(m_display.xcbConnection(), cookie.sequence);
 }
 
-std::string xlib::Window::iconName() const
+bool xlib::Window::update()
 {
-    return getProperty(XA_WM_ICON_NAME, XA_STRING);
+    requestUpdate();
+    return finishUpdate();
 }
 
-std::string xlib::Window::getProperty(Atom atom, Atom type) const
+void xlib::Window::requestUpdate()
 {
-    Atom actualType;
-    int actualFormat;
-    unsigned long nItems, bytesAfter;
-    unsigned char * value;
-    if (XGetWindowProperty(m_display.handle(), m_window, atom,
-                           0, std::numeric_limits<long>::max() / 4,
-                           False, type,
-                           &actualType, &actualFormat,
-                           &nItems, &bytesAfter, &value) != Success ||
-        actualType != type ||
-        actualFormat == 0) {
-        return std::string();
+    // Send all requests before waiting for any reply
+    m_netNameRequest.reset();
+    m_classRequest.reset();
+    const auto netNameAtom = m_display.atom(nameAtom);
+    if (netNameAtom != None) {
+        m_netNameRequest.emplace(m_display, m_window, netNameAtom, m_display.atom(utf8Atom));
     }
+    m_nameRequest.emplace(m_display, m_window, XA_WM_NAME, XA_STRING);
+    if (!m_classLoaded) { m_classRequest.emplace(m_display, m_window, XA_WM_CLASS, XA_STRING); }
+}
 
-    // Wrap value in a unique_ptr in case something throws after that point
-    auto valptr = std::unique_ptr<unsigned char, int(*)(void*)>(value, XFree);
-
-    std::size_t itemBytes;
-    switch (actualFormat) {
-        // Yes, those numbers are historical values and map to those types
-        case 8: itemBytes = sizeof(char); break;
-        case 16: itemBytes = sizeof(short); break;
-        case 32: itemBytes = sizeof(long); break;
-        default: throw std::logic_error("Invalid actualFormat returned by XGetWindowProperty");
+std::optional<bool> xlib::Window::pollUpdate()
+{
+    assert(updatePending());
+    // Replies arrive in request order, stop at the first one missing
+    if ((m_netNameRequest && !m_netNameRequest->poll()) || !m_nameRequest->poll() ||
+        (m_classRequest && !m_classRequest->poll())) {
+        return std::nullopt;
     }
-    return std::string(reinterpret_cast<char *>(valptr.get()), nItems * itemBytes);
+    return finishUpdate();
 }
 
-void xlib::Window::loadClass() const
+bool xlib::Window::finishUpdate()
 {
-    // The actual property is made of two strings with a NUL char in the middle
-    m_className = getProperty(XA_WM_CLASS, XA_STRING);
-    auto sep = m_className.find('\0');
-    if (sep != std::string::npos) {
-        m_instanceName = m_className.substr(0, sep);
-        m_className.erase(0, sep + 1);
-        sep = m_className.find('\0');
+    assert(updatePending());
+    auto netName = std::move(m_netNameRequest);
+    auto name = std::move(*m_nameRequest);
+    auto wmClass = std::move(m_classRequest);
+    m_netNameRequest.reset();
+    m_nameRequest.reset();
+    m_classRequest.reset();
+
+    if (name.failed()) { return false; }    // remaining replies are discarded
+
+    m_name = netName ? netName->value() : std::string();
+    if (m_name.empty()) { m_name = name.value(); }
+
+    if (wmClass) {
+        // The actual property is made of two strings with a NUL char in the middle
+        m_className = wmClass->value();
+        m_instanceName.clear();
+        auto sep = m_className.find('\0');
         if (sep != std::string::npos) {
-            m_className.erase(sep);
+            m_instanceName = m_className.substr(0, sep);
+            m_className.erase(0, sep + 1);
+            sep = m_className.find('\0');
+            if (sep != std::string::npos) {
+                m_className.erase(sep);
+            }
         }
+        m_classLoaded = true;
     }
-    m_classLoaded = true;
+    return true;
+}
+
+std::string xlib::Window::iconName() const
+{
+    return getProperty(XA_WM_ICON_NAME, XA_STRING);
+}
+
+std::string xlib::Window::getProperty(Atom atom, Atom type) const
+{
+    auto request = PropertyRequest(m_display, m_window, atom, type);
+    return request.value();
 }
 
 /****************************************************************************/
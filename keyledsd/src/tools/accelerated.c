@@ -85,3 +85,139 @@ KEYLEDSD_EXPORT void multiply(uint8_t * restrict dst, const uint8_t * restrict s
 KEYLEDSD_EXPORT void multiply(uint8_t * restrict dst, const uint8_t * restrict src, size_t length)
     { multiply_plain(dst, src, length); }
 #endif
+
+/****************************************************************************/
+/* scale */
+
+#ifdef HAVE_BUILTIN_CPU_SUPPORTS
+static USED void (*resolve_scale(void))(uint8_t * restrict dst, const uint8_t * restrict factor, size_t length)
+{
+#  if defined __GNUC__ && !defined __clang__
+    __builtin_cpu_init();
+#  endif
+#  ifdef KEYLEDSD_USE_AVX2
+    if (__builtin_cpu_supports("avx2")) { return scale_avx2; }
+#  endif
+#  ifdef KEYLEDSD_USE_SSE2
+    if (__builtin_cpu_supports("sse2")) { return scale_sse2; }
+#  endif
+    return scale_plain;
+}
+
+#  ifdef HAVE_IFUNC_ATTRIBUTE
+KEYLEDSD_EXPORT void scale(uint8_t * restrict dst, const uint8_t * restrict factor, size_t length)
+    __attribute__((ifunc("resolve_scale")));
+#  else
+static void (*resolved_scale)(uint8_t * restrict dst, const uint8_t * restrict factor, size_t length);
+KEYLEDSD_EXPORT void scale(uint8_t * restrict dst, const uint8_t * restrict factor, size_t length)
+{
+    if (resolved_scale == 0) { resolved_scale = resolve_scale(); }
+    (*resolved_scale)(dst, factor, length);
+}
+#  endif
+#else
+KEYLEDSD_EXPORT void scale(uint8_t * restrict dst, const uint8_t * restrict factor, size_t length)
+    { scale_plain(dst, factor, length); }
+#endif
+
+/****************************************************************************/
+/* fill_masked */
+
+#ifdef HAVE_BUILTIN_CPU_SUPPORTS
+static USED void (*resolve_fill_masked(void))(uint8_t * restrict dst, const uint8_t * restrict color, const uint64_t * restrict mask, size_t length)
+{
+#  if defined __GNUC__ && !defined __clang__
+    __builtin_cpu_init();
+#  endif
+#  ifdef KEYLEDSD_USE_AVX2
+    if (__builtin_cpu_supports("avx2")) { return fill_masked_avx2; }
+#  endif
+#  ifdef KEYLEDSD_USE_SSE2
+    if (__builtin_cpu_supports("sse2")) { return fill_masked_sse2; }
+#  endif
+    return fill_masked_plain;
+}
+
+#  ifdef HAVE_IFUNC_ATTRIBUTE
+KEYLEDSD_EXPORT void fill_masked(uint8_t * restrict dst, const uint8_t * restrict color, const uint64_t * restrict mask, size_t length)
+    __attribute__((ifunc("resolve_fill_masked")));
+#  else
+static void (*resolved_fill_masked)(uint8_t * restrict dst, const uint8_t * restrict color, const uint64_t * restrict mask, size_t length);
+KEYLEDSD_EXPORT void fill_masked(uint8_t * restrict dst, const uint8_t * restrict color, const uint64_t * restrict mask, size_t length)
+{
+    if (resolved_fill_masked == 0) { resolved_fill_masked = resolve_fill_masked(); }
+    (*resolved_fill_masked)(dst, color, mask, length);
+}
+#  endif
+#else
+KEYLEDSD_EXPORT void fill_masked(uint8_t * restrict dst, const uint8_t * restrict color, const uint64_t * restrict mask, size_t length)
+    { fill_masked_plain(dst, color, mask, length); }
+#endif
+
+/****************************************************************************/
+/* copy_masked */
+
+#ifdef HAVE_BUILTIN_CPU_SUPPORTS
+static USED void (*resolve_copy_masked(void))(uint8_t * restrict dst, const uint8_t * restrict src, const uint64_t * restrict mask, size_t length)
+{
+#  if defined __GNUC__ && !defined __clang__
+    __builtin_cpu_init();
+#  endif
+#  ifdef KEYLEDSD_USE_AVX2
+    if (__builtin_cpu_supports("avx2")) { return copy_masked_avx2; }
+#  endif
+#  ifdef KEYLEDSD_USE_SSE2
+    if (__builtin_cpu_supports("sse2")) { return copy_masked_sse2; }
+#  endif
+    return copy_masked_plain;
+}
+
+#  ifdef HAVE_IFUNC_ATTRIBUTE
+KEYLEDSD_EXPORT void copy_masked(uint8_t * restrict dst, const uint8_t * restrict src, const uint64_t * restrict mask, size_t length)
+    __attribute__((ifunc("resolve_copy_masked")));
+#  else
+static void (*resolved_copy_masked)(uint8_t * restrict dst, const uint8_t * restrict src, const uint64_t * restrict mask, size_t length);
+KEYLEDSD_EXPORT void copy_masked(uint8_t * restrict dst, const uint8_t * restrict src, const uint64_t * restrict mask, size_t length)
+{
+    if (resolved_copy_masked == 0) { resolved_copy_masked = resolve_copy_masked(); }
+    (*resolved_copy_masked)(dst, src, mask, length);
+}
+#  endif
+#else
+KEYLEDSD_EXPORT void copy_masked(uint8_t * restrict dst, const uint8_t * restrict src, const uint64_t * restrict mask, size_t length)
+    { copy_masked_plain(dst, src, mask, length); }
+#endif
+
+/****************************************************************************/
+/* blend_masked */
+
+#ifdef HAVE_BUILTIN_CPU_SUPPORTS
+static USED void (*resolve_blend_masked(void))(uint8_t * restrict dst, const uint8_t * restrict src, const uint64_t * restrict mask, size_t length)
+{
+#  if defined __GNUC__ && !defined __clang__
+    __builtin_cpu_init();
+#  endif
+#  ifdef KEYLEDSD_USE_AVX2
+    if (__builtin_cpu_supports("avx2")) { return blend_masked_avx2; }
+#  endif
+#  ifdef KEYLEDSD_USE_SSE2
+    if (__builtin_cpu_supports("sse2")) { return blend_masked_sse2; }
+#  endif
+    return blend_masked_plain;
+}
+
+#  ifdef HAVE_IFUNC_ATTRIBUTE
+KEYLEDSD_EXPORT void blend_masked(uint8_t * restrict dst, const uint8_t * restrict src, const uint64_t * restrict mask, size_t length)
+    __attribute__((ifunc("resolve_blend_masked")));
+#  else
+static void (*resolved_blend_masked)(uint8_t * restrict dst, const uint8_t * restrict src, const uint64_t * restrict mask, size_t length);
+KEYLEDSD_EXPORT void blend_masked(uint8_t * restrict dst, const uint8_t * restrict src, const uint64_t * restrict mask, size_t length)
+{
+    if (resolved_blend_masked == 0) { resolved_blend_masked = resolve_blend_masked(); }
+    (*resolved_blend_masked)(dst, src, mask, length);
+}
+#  endif
+#else
+KEYLEDSD_EXPORT void blend_masked(uint8_t * restrict dst, const uint8_t * restrict src, const uint64_t * restrict mask, size_t length)
+    { blend_masked_plain(dst, src, mask, length); }
+#endif
@@ -16,11 +16,48 @@
  */
 #include <assert.h>
 #include <stdint.h>
+#include <string.h>
 #include <immintrin.h>
 #include "keyledsd/tools/accelerated.h"
 #include "config.h"
 
 
+/// Blends 8 entries of src onto 8 entries of dst, returning the result
+static inline __m256i blend_vector(__m256i packed_dst, __m256i packed_src)
+{
+    const __m256i zero = _mm256_setzero_si256();
+    const __m256i one = _mm256_set1_epi16(1);
+    const __m256i max = _mm256_set1_epi16(256);
+
+    __m256i dst0 = _mm256_unpacklo_epi8(packed_dst, zero); /* A3B3G3R3A2B2G2R2A1B1G1R1A0B0G0R0 */
+    __m256i dst1 = _mm256_unpackhi_epi8(packed_dst, zero); /* A7B7G7R7A6B6G6R6A5B5G5R5A4B4G4R4 */
+    __m256i src0 = _mm256_unpacklo_epi8(packed_src, zero); /* A3B3G3R3A2B2G2R2A1B1G1R1A0B0G0R0 */
+    __m256i src1 = _mm256_unpackhi_epi8(packed_src, zero); /* A7B7G7R7A6B6G6R6A5B5G5R5A4B4G4R4 */
+
+    __m256i alpha0 = _mm256_shufflelo_epi16(_mm256_shufflehi_epi16(src0, 0xff), 0xff);
+    alpha0 = _mm256_add_epi16(alpha0, _mm256_add_epi16(_mm256_cmpeq_epi16(alpha0, zero), one));
+    __m256i alpha1 = _mm256_shufflelo_epi16(_mm256_shufflehi_epi16(src1, 0xff), 0xff);
+    alpha1 = _mm256_add_epi16(alpha1, _mm256_add_epi16(_mm256_cmpeq_epi16(alpha1, zero), one));
+
+
+    __m256i weighted_dst0 = _mm256_mullo_epi16(dst0, _mm256_sub_epi16(max, alpha0));
+    __m256i weighted_dst1 = _mm256_mullo_epi16(dst1, _mm256_sub_epi16(max, alpha1));
+    __m256i weighted_src0 = _mm256_mullo_epi16(src0, alpha0);
+    __m256i weighted_src1 = _mm256_mullo_epi16(src1, alpha1);
+
+    __m256i final_dst0 = _mm256_srli_epi16(_mm256_add_epi16(weighted_dst0, weighted_src0), 8);
+    __m256i final_dst1 = _mm256_srli_epi16(_mm256_add_epi16(weighted_dst1, weighted_src1), 8);
+
+    return _mm256_packus_epi16(final_dst0, final_dst1);
+}
+
+/// Expands 8 mask bits into a vector with all bits of selected entries set
+static inline __m256i expand_mask(unsigned bits)
+{
+    const __m256i lanes = _mm256_setr_epi32(0x01, 0x02, 0x04, 0x08, 0x10, 0x20, 0x40, 0x80);
+    return _mm256_cmpeq_epi32(_mm256_and_si256(_mm256_set1_epi32((int)bits), lanes), lanes);
+}
+
 KEYLEDSD_EXPORT void blend_avx2(uint8_t * restrict dst, const uint8_t * restrict src, size_t length)
 {
     assert((uintptr_t)dst % 32 == 0);   // AVX2 requires 32-bytes aligned data
@@ -33,9 +70,29 @@ KEYLEDSD_EXPORT void blend_avx2(uint8_t * restrict dst, const uint8_t * restrict
     __m256i * restrict dstv = (__m256i *)__builtin_assume_aligned(dst, 32);
     const __m256i * restrict srcv = (const __m256i *)__builtin_assume_aligned(src, 32);
 
+    length /= 8;
+
+    do {
+        _mm256_store_si256(dstv, blend_vector(_mm256_load_si256(dstv), _mm256_load_si256(srcv)));
+        srcv += 1;
+        dstv += 1;
+    } while (--length > 0);
+}
+
+KEYLEDSD_EXPORT void multiply_avx2(uint8_t * restrict dst, const uint8_t * restrict src, size_t length)
+{
+    assert((uintptr_t)dst % 32 == 0);   // AVX2 requires 32-bytes aligned data
+    assert((uintptr_t)src % 32 == 0);   // AVX2 requires 32-bytes aligned data
+    assert(length != 0);                // allows inverting loop condition, makes gcc generate
+                                        // better loop code
+    assert(length % 8 == 0);            // we'll process entries 8 by 8 and don't want to be
+                                        // slowed by boundary checks
+
+    __m256i * restrict dstv = (__m256i *)__builtin_assume_aligned(dst, 32);
+    const __m256i * restrict srcv = (const __m256i *)__builtin_assume_aligned(src, 32);
+
     const __m256i zero = _mm256_setzero_si256();
     const __m256i one = _mm256_set1_epi16(1);
-    const __m256i max = _mm256_set1_epi16(256);
 
     length /= 8;
 
@@ -48,60 +105,108 @@ KEYLEDSD_EXPORT void blend_avx2(uint8_t * restrict dst, const uint8_t * restrict
         __m256i src0 = _mm256_unpacklo_epi8(packed_src, zero); /* A3B3G3R3A2B2G2R2A1B1G1R1A0B0G0R0 */
         __m256i src1 = _mm256_unpackhi_epi8(packed_src, zero); /* A7B7G7R7A6B6G6R6A5B5G5R5A4B4G4R4 */
 
-        __m256i alpha0 = _mm256_shufflelo_epi16(_mm256_shufflehi_epi16(src0, 0xff), 0xff);
-        alpha0 = _mm256_add_epi16(alpha0, _mm256_add_epi16(_mm256_cmpeq_epi16(alpha0, zero), one));
-        __m256i alpha1 = _mm256_shufflelo_epi16(_mm256_shufflehi_epi16(src1, 0xff), 0xff);
-        alpha1 = _mm256_add_epi16(alpha1, _mm256_add_epi16(_mm256_cmpeq_epi16(alpha1, zero), one));
-
-
-        __m256i weighted_dst0 = _mm256_mullo_epi16(dst0, _mm256_sub_epi16(max, alpha0));
-        __m256i weighted_dst1 = _mm256_mullo_epi16(dst1, _mm256_sub_epi16(max, alpha1));
-        __m256i weighted_src0 = _mm256_mullo_epi16(src0, alpha0);
-        __m256i weighted_src1 = _mm256_mullo_epi16(src1, alpha1);
+        dst0 = _mm256_mullo_epi16(src0, _mm256_add_epi16(dst0, one));
+        dst1 = _mm256_mullo_epi16(src1, _mm256_add_epi16(dst1, one));
 
-        __m256i final_dst0 = _mm256_srli_epi16(_mm256_add_epi16(weighted_dst0, weighted_src0), 8);
-        __m256i final_dst1 = _mm256_srli_epi16(_mm256_add_epi16(weighted_dst1, weighted_src1), 8);
+        dst0 = _mm256_srli_epi16(dst0, 8);
+        dst1 = _mm256_srli_epi16(dst1, 8);
 
-        _mm256_store_si256(dstv, _mm256_packus_epi16(final_dst0, final_dst1));
+        _mm256_store_si256(dstv, _mm256_packus_epi16(dst0, dst1));
         srcv += 1;
         dstv += 1;
     } while (--length > 0);
 }
 
-KEYLEDSD_EXPORT void multiply_avx2(uint8_t * restrict dst, const uint8_t * restrict src, size_t length)
+KEYLEDSD_EXPORT void scale_avx2(uint8_t * restrict dst, const uint8_t * restrict factor, size_t length)
 {
     assert((uintptr_t)dst % 32 == 0);   // AVX2 requires 32-bytes aligned data
-    assert((uintptr_t)src % 32 == 0);   // AVX2 requires 32-bytes aligned data
     assert(length != 0);                // allows inverting loop condition, makes gcc generate
                                         // better loop code
     assert(length % 8 == 0);            // we'll process entries 8 by 8 and don't want to be
                                         // slowed by boundary checks
 
     __m256i * restrict dstv = (__m256i *)__builtin_assume_aligned(dst, 32);
-    const __m256i * restrict srcv = (const __m256i *)__builtin_assume_aligned(src, 32);
 
     const __m256i zero = _mm256_setzero_si256();
     const __m256i one = _mm256_set1_epi16(1);
 
+    int32_t packed_factor;
+    memcpy(&packed_factor, factor, sizeof(packed_factor));
+    const __m256i factors = _mm256_add_epi16(               /* A B G R A B G R (per lane) */
+        _mm256_unpacklo_epi8(_mm256_set1_epi32(packed_factor), zero), one
+    );
+
     length /= 8;
 
     do {
         __m256i packed_dst = _mm256_load_si256(dstv);
-        __m256i packed_src = _mm256_load_si256(srcv);
 
         __m256i dst0 = _mm256_unpacklo_epi8(packed_dst, zero); /* A3B3G3R3A2B2G2R2A1B1G1R1A0B0G0R0 */
         __m256i dst1 = _mm256_unpackhi_epi8(packed_dst, zero); /* A7B7G7R7A6B6G6R6A5B5G5R5A4B4G4R4 */
-        __m256i src0 = _mm256_unpacklo_epi8(packed_src, zero); /* A3B3G3R3A2B2G2R2A1B1G1R1A0B0G0R0 */
-        __m256i src1 = _mm256_unpackhi_epi8(packed_src, zero); /* A7B7G7R7A6B6G6R6A5B5G5R5A4B4G4R4 */
 
-        dst0 = _mm256_mullo_epi16(src0, _mm256_add_epi16(dst0, one));
-        dst1 = _mm256_mullo_epi16(src1, _mm256_add_epi16(dst1, one));
-
-        dst0 = _mm256_srli_epi16(dst0, 8);
-        dst1 = _mm256_srli_epi16(dst1, 8);
+        dst0 = _mm256_srli_epi16(_mm256_mullo_epi16(dst0, factors), 8);
+        dst1 = _mm256_srli_epi16(_mm256_mullo_epi16(dst1, factors), 8);
 
         _mm256_store_si256(dstv, _mm256_packus_epi16(dst0, dst1));
-        srcv += 1;
         dstv += 1;
     } while (--length > 0);
 }
+
+KEYLEDSD_EXPORT void fill_masked_avx2(uint8_t * restrict dst, const uint8_t * restrict color,
+                                      const uint64_t * restrict mask, size_t length)
+{
+    assert((uintptr_t)dst % 32 == 0);   // AVX2 requires 32-bytes aligned data
+    assert(length % 8 == 0);            // we'll process entries 8 by 8 and don't want to be
+                                        // slowed by boundary checks
+
+    int * restrict dsti = (int *)__builtin_assume_aligned(dst, 32);
+
+    int32_t packed_color;
+    memcpy(&packed_color, color, sizeof(packed_color));
+    const __m256i colors = _mm256_set1_epi32(packed_color);
+
+    for (size_t idx = 0; idx < length; idx += 8) {
+        const unsigned bits = (unsigned)(mask[idx / 64] >> (idx % 64)) & 0xff;
+        if (bits == 0) { continue; }
+        _mm256_maskstore_epi32(dsti + idx, expand_mask(bits), colors);
+    }
+}
+
+KEYLEDSD_EXPORT void copy_masked_avx2(uint8_t * restrict dst, const uint8_t * restrict src,
+                                      const uint64_t * restrict mask, size_t length)
+{
+    assert((uintptr_t)dst % 32 == 0);   // AVX2 requires 32-bytes aligned data
+    assert((uintptr_t)src % 32 == 0);   // AVX2 requires 32-bytes aligned data
+    assert(length % 8 == 0);            // we'll process entries 8 by 8 and don't want to be
+                                        // slowed by boundary checks
+
+    int * restrict dsti = (int *)__builtin_assume_aligned(dst, 32);
+    const __m256i * restrict srcv = (const __m256i *)__builtin_assume_aligned(src, 32);
+
+    for (size_t idx = 0; idx < length; idx += 8) {
+        const unsigned bits = (unsigned)(mask[idx / 64] >> (idx % 64)) & 0xff;
+        if (bits == 0) { continue; }
+        _mm256_maskstore_epi32(dsti + idx, expand_mask(bits), _mm256_load_si256(srcv + idx / 8));
+    }
+}
+
+KEYLEDSD_EXPORT void blend_masked_avx2(uint8_t * restrict dst, const uint8_t * restrict src,
+                                       const uint64_t * restrict mask, size_t length)
+{
+    assert((uintptr_t)dst % 32 == 0);   // AVX2 requires 32-bytes aligned data
+    assert((uintptr_t)src % 32 == 0);   // AVX2 requires 32-bytes aligned data
+    assert(length % 8 == 0);            // we'll process entries 8 by 8 and don't want to be
+                                        // slowed by boundary checks
+
+    __m256i * restrict dstv = (__m256i *)__builtin_assume_aligned(dst, 32);
+    const __m256i * restrict srcv = (const __m256i *)__builtin_assume_aligned(src, 32);
+
+    for (size_t idx = 0; idx < length; idx += 8, dstv += 1, srcv += 1) {
+        const unsigned bits = (unsigned)(mask[idx / 64] >> (idx % 64)) & 0xff;
+        if (bits == 0) { continue; }
+        const __m256i packed_dst = _mm256_load_si256(dstv);
+        const __m256i blended = blend_vector(packed_dst, _mm256_load_si256(srcv));
+        _mm256_store_si256(dstv, bits == 0xff ? blended
+                                 : _mm256_blendv_epi8(packed_dst, blended, expand_mask(bits)));
+    }
+}
@@ -16,6 +16,7 @@
  */
 #include <assert.h>
 #include <stdint.h>
+#include <string.h>
 #include "keyledsd/tools/accelerated.h"
 #include "config.h"
 
@@ -59,3 +60,63 @@ KEYLEDSD_EXPORT void multiply_plain(uint8_t * restrict a, const uint8_t * restri
         b += 4;
     } while (--length > 0);
 }
+
+KEYLEDSD_EXPORT void scale_plain(uint8_t * restrict a, const uint8_t * restrict factor, size_t length)
+{
+    assert((uintptr_t)a % 8 == 0);    // Not a requirement, but lets compiler optimize stuff
+    assert(length != 0);              // allows inverting loop condition
+
+    a = (uint8_t * restrict)__builtin_assume_aligned(a, 8);
+
+    const uint16_t f0 = (uint16_t)factor[0] + 1;
+    const uint16_t f1 = (uint16_t)factor[1] + 1;
+    const uint16_t f2 = (uint16_t)factor[2] + 1;
+    const uint16_t f3 = (uint16_t)factor[3] + 1;
+
+    do {
+        a[0] = ((uint16_t)a[0] * f0) / 256;
+        a[1] = ((uint16_t)a[1] * f1) / 256;
+        a[2] = ((uint16_t)a[2] * f2) / 256;
+        a[3] = ((uint16_t)a[3] * f3) / 256;
+        a += 4;
+    } while (--length > 0);
+}
+
+KEYLEDSD_EXPORT void fill_masked_plain(uint8_t * restrict a, const uint8_t * restrict color,
+                                       const uint64_t * restrict mask, size_t length)
+{
+    for (size_t base = 0; base < length; base += 64) {
+        for (uint64_t word = mask[base / 64]; word != 0; word &= word - 1) {
+            memcpy(a + 4 * (base + (size_t)__builtin_ctzll(word)), color, 4);
+        }
+    }
+}
+
+KEYLEDSD_EXPORT void copy_masked_plain(uint8_t * restrict a, const uint8_t * restrict b,
+                                       const uint64_t * restrict mask, size_t length)
+{
+    for (size_t base = 0; base < length; base += 64) {
+        for (uint64_t word = mask[base / 64]; word != 0; word &= word - 1) {
+            const size_t offset = 4 * (base + (size_t)__builtin_ctzll(word));
+            memcpy(a + offset, b + offset, 4);
+        }
+    }
+}
+
+KEYLEDSD_EXPORT void blend_masked_plain(uint8_t * restrict a, const uint8_t * restrict b,
+                                        const uint64_t * restrict mask, size_t length)
+{
+    for (size_t base = 0; base < length; base += 64) {
+        for (uint64_t word = mask[base / 64]; word != 0; word &= word - 1) {
+            const size_t offset = 4 * (base + (size_t)__builtin_ctzll(word));
+            uint8_t * restrict dst = a + offset;
+            const uint8_t * restrict src = b + offset;
+            uint16_t alpha = src[3];
+            if (alpha != 0) { alpha += 1; }
+            dst[0] = ((uint16_t)dst[0] * ((uint16_t)256 - alpha) + (uint16_t)src[0] * alpha) / 256;
+            dst[1] = ((uint16_t)dst[1] * ((uint16_t)256 - alpha) + (uint16_t)src[1] * alpha) / 256;
+            dst[2] = ((uint16_t)dst[2] * ((uint16_t)256 - alpha) + (uint16_t)src[2] * alpha) / 256;
+            dst[3] = ((uint16_t)dst[3] * ((uint16_t)256 - alpha) + (uint16_t)src[3] * alpha) / 256;
+        }
+    }
+}
@@ -16,11 +16,49 @@
  */
 #include <assert.h>
 #include <stdint.h>
+#include <string.h>
 #include <emmintrin.h>
 #include "keyledsd/tools/accelerated.h"
 #include "config.h"
 
 
+/// Blends 4 entries of src onto 4 entries of dst, returning the result
+static inline __m128i blend_vector(__m128i packed_dst, __m128i packed_src)
+{
+    const __m128i zero = _mm_setzero_si128();
+    const __m128i one = _mm_set1_epi16(1);
+    const __m128i max = _mm_set1_epi16(256);
+
+    __m128i dst0 = _mm_unpacklo_epi8(packed_dst, zero); /* A1B1G1R1A0B0G0R0 */
+    __m128i dst1 = _mm_unpackhi_epi8(packed_dst, zero); /* A3B3G3R3A2B2G2R2 */
+    __m128i src0 = _mm_unpacklo_epi8(packed_src, zero); /* A1B1G1R1A0B0G0R0 */
+    __m128i src1 = _mm_unpackhi_epi8(packed_src, zero); /* A3B3G3R3A2B2G2R2 */
+
+    __m128i alpha0 = _mm_shufflelo_epi16(_mm_shufflehi_epi16(src0, 0xff), 0xff);
+    alpha0 = _mm_add_epi16(alpha0, _mm_add_epi16(_mm_cmpeq_epi16(alpha0, zero), one));
+    __m128i alpha1 = _mm_shufflelo_epi16(_mm_shufflehi_epi16(src1, 0xff), 0xff);
+    alpha1 = _mm_add_epi16(alpha1, _mm_add_epi16(_mm_cmpeq_epi16(alpha1, zero), one));
+
+
+    __m128i weighted_dst0 = _mm_mullo_epi16(dst0, _mm_sub_epi16(max, alpha0));
+    __m128i weighted_dst1 = _mm_mullo_epi16(dst1, _mm_sub_epi16(max, alpha1));
+    __m128i weighted_src0 = _mm_mullo_epi16(src0, alpha0);
+    __m128i weighted_src1 = _mm_mullo_epi16(src1, alpha1);
+
+    __m128i final_dst0 = _mm_srli_epi16(_mm_add_epi16(weighted_dst0, weighted_src0), 8);
+    __m128i final_dst1 = _mm_srli_epi16(_mm_add_epi16(weighted_dst1, weighted_src1), 8);
+
+    return _mm_packus_epi16(final_dst0, final_dst1);
+}
+
+/// Picks entries from b where 4 mask bits are set, from a elsewhere
+static inline __m128i select_masked(__m128i a, __m128i b, unsigned bits)
+{
+    const __m128i lanes = _mm_setr_epi32(0x1, 0x2, 0x4, 0x8);
+    const __m128i mask = _mm_cmpeq_epi32(_mm_and_si128(_mm_set1_epi32((int)bits), lanes), lanes);
+    return _mm_or_si128(_mm_and_si128(mask, b), _mm_andnot_si128(mask, a));
+}
+
 KEYLEDSD_EXPORT void blend_sse2(uint8_t * restrict dst, const uint8_t * restrict src, size_t length)
 {
     assert((uintptr_t)dst % 16 == 0);   // SSE2 requires 16-bytes aligned data
@@ -33,9 +71,29 @@ KEYLEDSD_EXPORT void blend_sse2(uint8_t * restrict dst, const uint8_t * restrict
     __m128i * restrict dstv = (__m128i *)__builtin_assume_aligned(dst, 16);
     const __m128i * restrict srcv = (const __m128i *)__builtin_assume_aligned(src, 16);
 
+    length /= 4;
+
+    do {
+        _mm_store_si128(dstv, blend_vector(_mm_load_si128(dstv), _mm_load_si128(srcv)));
+        srcv += 1;
+        dstv += 1;
+    } while (--length > 0);
+}
+
+KEYLEDSD_EXPORT void multiply_sse2(uint8_t * restrict dst, const uint8_t * restrict src, size_t length)
+{
+    assert((uintptr_t)dst % 16 == 0);   // SSE2 requires 16-bytes aligned data
+    assert((uintptr_t)src % 16 == 0);   // SSE2 requires 16-bytes aligned data
+    assert(length != 0);                // allows inverting loop condition, makes gcc generate
+                                        // better loop code
+    assert(length % 4 == 0);            // we'll process entries 4 by 4 and don't want to be
+                                        // slowed by boundary checks
+
+    __m128i * restrict dstv = (__m128i *)__builtin_assume_aligned(dst, 16);
+    const __m128i * restrict srcv = (const __m128i *)__builtin_assume_aligned(src, 16);
+
     const __m128i zero = _mm_setzero_si128();
     const __m128i one = _mm_set1_epi16(1);
-    const __m128i max = _mm_set1_epi16(256);
 
     length /= 4;
 
@@ -48,60 +106,109 @@ KEYLEDSD_EXPORT void blend_sse2(uint8_t * restrict dst, const uint8_t * restrict
         __m128i src0 = _mm_unpacklo_epi8(packed_src, zero); /* A1B1G1R1A0B0G0R0 */
         __m128i src1 = _mm_unpackhi_epi8(packed_src, zero); /* A3B3G3R3A2B2G2R2 */
 
-        __m128i alpha0 = _mm_shufflelo_epi16(_mm_shufflehi_epi16(src0, 0xff), 0xff);
-        alpha0 = _mm_add_epi16(alpha0, _mm_add_epi16(_mm_cmpeq_epi16(alpha0, zero), one));
-        __m128i alpha1 = _mm_shufflelo_epi16(_mm_shufflehi_epi16(src1, 0xff), 0xff);
-        alpha1 = _mm_add_epi16(alpha1, _mm_add_epi16(_mm_cmpeq_epi16(alpha1, zero), one));
-
-
-        __m128i weighted_dst0 = _mm_mullo_epi16(dst0, _mm_sub_epi16(max, alpha0));
-        __m128i weighted_dst1 = _mm_mullo_epi16(dst1, _mm_sub_epi16(max, alpha1));
-        __m128i weighted_src0 = _mm_mullo_epi16(src0, alpha0);
-        __m128i weighted_src1 = _mm_mullo_epi16(src1, alpha1);
+        dst0 = _mm_mullo_epi16(src0, _mm_add_epi16(dst0, one));
+        dst1 = _mm_mullo_epi16(src1, _mm_add_epi16(dst1, one));
 
-        __m128i final_dst0 = _mm_srli_epi16(_mm_add_epi16(weighted_dst0, weighted_src0), 8);
-        __m128i final_dst1 = _mm_srli_epi16(_mm_add_epi16(weighted_dst1, weighted_src1), 8);
+        dst0 = _mm_srli_epi16(dst0, 8);
+        dst1 = _mm_srli_epi16(dst1, 8);
 
-        _mm_store_si128(dstv, _mm_packus_epi16(final_dst0, final_dst1));
+        _mm_store_si128(dstv, _mm_packus_epi16(dst0, dst1));
         srcv += 1;
         dstv += 1;
     } while (--length > 0);
 }
 
-KEYLEDSD_EXPORT void multiply_sse2(uint8_t * restrict dst, const uint8_t * restrict src, size_t length)
+KEYLEDSD_EXPORT void scale_sse2(uint8_t * restrict dst, const uint8_t * restrict factor, size_t length)
 {
     assert((uintptr_t)dst % 16 == 0);   // SSE2 requires 16-bytes aligned data
-    assert((uintptr_t)src % 16 == 0);   // SSE2 requires 16-bytes aligned data
     assert(length != 0);                // allows inverting loop condition, makes gcc generate
                                         // better loop code
     assert(length % 4 == 0);            // we'll process entries 4 by 4 and don't want to be
                                         // slowed by boundary checks
 
     __m128i * restrict dstv = (__m128i *)__builtin_assume_aligned(dst, 16);
-    const __m128i * restrict srcv = (const __m128i *)__builtin_assume_aligned(src, 16);
 
     const __m128i zero = _mm_setzero_si128();
     const __m128i one = _mm_set1_epi16(1);
 
+    int32_t packed_factor;
+    memcpy(&packed_factor, factor, sizeof(packed_factor));
+    const __m128i factors = _mm_add_epi16(                  /* A B G R A B G R */
+        _mm_unpacklo_epi8(_mm_set1_epi32(packed_factor), zero), one
+    );
+
     length /= 4;
 
     do {
         __m128i packed_dst = _mm_load_si128(dstv);
-        __m128i packed_src = _mm_load_si128(srcv);
 
         __m128i dst0 = _mm_unpacklo_epi8(packed_dst, zero); /* A1B1G1R1A0B0G0R0 */
         __m128i dst1 = _mm_unpackhi_epi8(packed_dst, zero); /* A3B3G3R3A2B2G2R2 */
-        __m128i src0 = _mm_unpacklo_epi8(packed_src, zero); /* A1B1G1R1A0B0G0R0 */
-        __m128i src1 = _mm_unpackhi_epi8(packed_src, zero); /* A3B3G3R3A2B2G2R2 */
 
-        dst0 = _mm_mullo_epi16(src0, _mm_add_epi16(dst0, one));
-        dst1 = _mm_mullo_epi16(src1, _mm_add_epi16(dst1, one));
-
-        dst0 = _mm_srli_epi16(dst0, 8);
-        dst1 = _mm_srli_epi16(dst1, 8);
+        dst0 = _mm_srli_epi16(_mm_mullo_epi16(dst0, factors), 8);
+        dst1 = _mm_srli_epi16(_mm_mullo_epi16(dst1, factors), 8);
 
         _mm_store_si128(dstv, _mm_packus_epi16(dst0, dst1));
-        srcv += 1;
         dstv += 1;
     } while (--length > 0);
 }
+
+KEYLEDSD_EXPORT void fill_masked_sse2(uint8_t * restrict dst, const uint8_t * restrict color,
+                                      const uint64_t * restrict mask, size_t length)
+{
+    assert((uintptr_t)dst % 16 == 0);   // SSE2 requires 16-bytes aligned data
+    assert(length % 4 == 0);            // we'll process entries 4 by 4 and don't want to be
+                                        // slowed by boundary checks
+
+    __m128i * restrict dstv = (__m128i *)__builtin_assume_aligned(dst, 16);
+
+    int32_t packed_color;
+    memcpy(&packed_color, color, sizeof(packed_color));
+    const __m128i colors = _mm_set1_epi32(packed_color);
+
+    for (size_t idx = 0; idx < length; idx += 4, dstv += 1) {
+        const unsigned bits = (unsigned)(mask[idx / 64] >> (idx % 64)) & 0xf;
+        if (bits == 0) { continue; }
+        _mm_store_si128(dstv, bits == 0xf ? colors
+                              : select_masked(_mm_load_si128(dstv), colors, bits));
+    }
+}
+
+KEYLEDSD_EXPORT void copy_masked_sse2(uint8_t * restrict dst, const uint8_t * restrict src,
+                                      const uint64_t * restrict mask, size_t length)
+{
+    assert((uintptr_t)dst % 16 == 0);   // SSE2 requires 16-bytes aligned data
+    assert((uintptr_t)src % 16 == 0);   // SSE2 requires 16-bytes aligned data
+    assert(length % 4 == 0);            // we'll process entries 4 by 4 and don't want to be
+                                        // slowed by boundary checks
+
+    __m128i * restrict dstv = (__m128i *)__builtin_assume_aligned(dst, 16);
+    const __m128i * restrict srcv = (const __m128i *)__builtin_assume_aligned(src, 16);
+
+    for (size_t idx = 0; idx < length; idx += 4, dstv += 1, srcv += 1) {
+        const unsigned bits = (unsigned)(mask[idx / 64] >> (idx % 64)) & 0xf;
+        if (bits == 0) { continue; }
+        _mm_store_si128(dstv, bits == 0xf ? _mm_load_si128(srcv)
+                              : select_masked(_mm_load_si128(dstv), _mm_load_si128(srcv), bits));
+    }
+}
+
+KEYLEDSD_EXPORT void blend_masked_sse2(uint8_t * restrict dst, const uint8_t * restrict src,
+                                       const uint64_t * restrict mask, size_t length)
+{
+    assert((uintptr_t)dst % 16 == 0);   // SSE2 requires 16-bytes aligned data
+    assert((uintptr_t)src % 16 == 0);   // SSE2 requires 16-bytes aligned data
+    assert(length % 4 == 0);            // we'll process entries 4 by 4 and don't want to be
+                                        // slowed by boundary checks
+
+    __m128i * restrict dstv = (__m128i *)__builtin_assume_aligned(dst, 16);
+    const __m128i * restrict srcv = (const __m128i *)__builtin_assume_aligned(src, 16);
+
+    for (size_t idx = 0; idx < length; idx += 4, dstv += 1, srcv += 1) {
+        const unsigned bits = (unsigned)(mask[idx / 64] >> (idx % 64)) & 0xf;
+        if (bits == 0) { continue; }
+        const __m128i packed_dst = _mm_load_si128(dstv);
+        const __m128i blended = blend_vector(packed_dst, _mm_load_si128(srcv));
+        _mm_store_si128(dstv, bits == 0xf ? blended : select_masked(packed_dst, blended, bits));
+    }
+}
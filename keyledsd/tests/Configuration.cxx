@@ -0,0 +1,162 @@
+/* Keyleds -- Gaming keyboard tool
+ * Copyright (C) 2017 Julien Hartmann, juli1.hartmann@gmail.com
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+#include "keyledsd/service/Configuration.h"
+
+#include <gtest/gtest.h>
+#include <optional>
+#include <sstream>
+#include <string>
+#include <vector>
+
+using keyleds::service::Configuration;
+using match_list = std::vector<std::optional<std::size_t>>;
+
+
+static const char baseConfig[] =
+    "colors:\n"
+    "    night: 000040\n"
+    "groups:\n"
+    "    arrows: [left, right, up, down]\n"
+    "effects:\n"
+    "    standard:\n"
+    "        groups:\n"
+    "            special: [enter, tab]\n"
+    "        plugins:\n"
+    "            - effect: fill\n"
+    "              color: night\n"
+    "            - effect: wave\n"
+    "              period: 5000\n"
+    "            - effect: breathe\n"
+    "              color: green\n"
+    "profiles:\n"
+    "    game:\n"
+    "        lookup: { class: game }\n"
+    "        effect: standard\n";
+
+static Configuration parse(const std::string & text)
+{
+    std::istringstream stream(text);
+    return Configuration::parse(stream);
+}
+
+static std::string replace(std::string text, const std::string & from, const std::string & to)
+{
+    auto pos = text.find(from);
+    EXPECT_NE(std::string::npos, pos);
+    if (pos != std::string::npos) { text.replace(pos, from.size(), to); }
+    return text;
+}
+
+static match_list matchFirstGroup(const Configuration & from, const Configuration & to)
+{
+    return keyleds::service::matchEffects(from.effectGroups.at(0), to.effectGroups.at(0));
+}
+
+/****************************************************************************/
+
+TEST(ConfigurationReloadTest, identical) {
+    const auto before = parse(baseConfig);
+    const auto after = parse(baseConfig);
+
+    EXPECT_TRUE(keyleds::service::sameEffectEnvironment(before, after));
+    EXPECT_EQ((match_list{0, 1, 2}), matchFirstGroup(before, after));
+}
+
+TEST(ConfigurationReloadTest, effectChanged) {
+    const auto before = parse(baseConfig);
+    const auto after = parse(replace(baseConfig, "period: 5000", "period: 8000"));
+
+    EXPECT_TRUE(keyleds::service::sameEffectEnvironment(before, after));
+    EXPECT_EQ((match_list{0, std::nullopt, 2}), matchFirstGroup(before, after));
+}
+
+TEST(ConfigurationReloadTest, effectAdded) {
+    const auto before = parse(baseConfig);
+    const auto after = parse(replace(baseConfig, "            - effect: wave\n",
+                                     "            - effect: stars\n"
+                                     "            - effect: wave\n"));
+
+    EXPECT_EQ((match_list{0, std::nullopt, 1, 2}), matchFirstGroup(before, after));
+}
+
+TEST(ConfigurationReloadTest, effectRemoved) {
+    const auto before = parse(baseConfig);
+    const auto after = parse(replace(baseConfig, "            - effect: wave\n"
+                                                 "              period: 5000\n", ""));
+
+    EXPECT_EQ((match_list{0, 2}), matchFirstGroup(before, after));
+}
+
+TEST(ConfigurationReloadTest, effectsReordered) {
+    const auto before = parse(baseConfig);
+    const auto after = parse(replace(baseConfig,
+        "            - effect: fill\n"
+        "              color: night\n"
+        "            - effect: wave\n"
+        "              period: 5000\n",
+        "            - effect: wave\n"
+        "              period: 5000\n"
+        "            - effect: fill\n"
+        "              color: night\n"));
+
+    EXPECT_EQ((match_list{1, 0, 2}), matchFirstGroup(before, after));
+}
+
+TEST(ConfigurationReloadTest, duplicateEffects) {
+    const auto before = parse(baseConfig);
+    const auto after = parse(replace(baseConfig, "            - effect: wave\n"
+                                                 "              period: 5000\n"
+                                                 "            - effect: breathe\n"
+                                                 "              color: green\n",
+                                                 "            - effect: fill\n"
+                                                 "              color: night\n"));
+
+    // second fill is a distinct instance, it must not take over the first one
+    EXPECT_EQ((match_list{0, std::nullopt}), matchFirstGroup(before, after));
+}
+
+TEST(ConfigurationReloadTest, groupKeysChanged) {
+    const auto before = parse(baseConfig);
+    const auto after = parse(replace(baseConfig, "special: [enter, tab]", "special: [enter]"));
+
+    EXPECT_TRUE(keyleds::service::sameEffectEnvironment(before, after));
+    EXPECT_EQ((match_list{std::nullopt, std::nullopt, std::nullopt}),
+              matchFirstGroup(before, after));
+}
+
+TEST(ConfigurationReloadTest, globalKeysChanged) {
+    const auto before = parse(baseConfig);
+    const auto after = parse(replace(baseConfig, "arrows: [left, right, up, down]",
+                                     "arrows: [left, right]"));
+
+    EXPECT_FALSE(keyleds::service::sameEffectEnvironment(before, after));
+}
+
+TEST(ConfigurationReloadTest, colorsChanged) {
+    const auto before = parse(baseConfig);
+    const auto after = parse(replace(baseConfig, "night: 000040", "night: 000060"));
+
+    EXPECT_FALSE(keyleds::service::sameEffectEnvironment(before, after));
+}
+
+TEST(ConfigurationReloadTest, profileChanged) {
+    const auto before = parse(baseConfig);
+    const auto after = parse(replace(baseConfig, "class: game", "class: other"));
+
+    EXPECT_TRUE(keyleds::service::sameEffectEnvironment(before, after));
+    EXPECT_EQ((match_list{0, 1, 2}), matchFirstGroup(before, after));
+}
@@ -0,0 +1,90 @@
+/* Keyleds -- Gaming keyboard tool
+ * Copyright (C) 2017 Julien Hartmann, juli1.hartmann@gmail.com
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+#include "keyledsd/service/Context.h"
+
+#include <gtest/gtest.h>
+
+using keyleds::service::Context;
+using string_map = Context::string_map;
+
+
+TEST(ContextTest, intern) {
+    auto classKey = Context::intern("class");
+    auto titleKey = Context::intern("title");
+    EXPECT_NE(classKey, titleKey);
+    EXPECT_EQ(classKey, Context::intern("class"));
+    EXPECT_EQ("class", Context::keyName(classKey));
+    EXPECT_EQ("title", Context::keyName(titleKey));
+}
+
+TEST(ContextTest, merge) {
+    auto classKey = Context::intern("class");
+    auto titleKey = Context::intern("title");
+    auto context = Context();
+
+    auto changed = context.merge({{"class", "xterm"}, {"title", "shell"}});
+    EXPECT_EQ(2u, context.size());
+    EXPECT_EQ((Context::key_list{std::min(classKey, titleKey), std::max(classKey, titleKey)}), changed);
+    EXPECT_EQ("xterm", context[classKey]);
+    EXPECT_EQ("shell", context[titleKey]);
+
+    changed = context.merge({{"class", "xterm"}, {"title", "vim"}});   // update one
+    EXPECT_EQ((Context::key_list{titleKey}), changed);
+    EXPECT_EQ("vim", context[titleKey]);
+
+    changed = context.merge({{"class", "xterm"}});                      // same value
+    EXPECT_TRUE(changed.empty());
+
+    changed = context.merge({{"title", ""}, {"missing", ""}});          // erase
+    EXPECT_EQ((Context::key_list{titleKey}), changed);
+    EXPECT_EQ(nullptr, context.find(titleKey));
+    EXPECT_EQ("", context[titleKey]);
+    EXPECT_EQ((string_map{{"class", "xterm"}}), context.toMap());
+}
+
+TEST(ContextTest, toMapOrder) {
+    auto context = Context({{"title", "shell"}, {"class", "xterm"}});
+    context.merge({{"id", "1"}, {"title", "vim"}});     // update keeps position
+    EXPECT_EQ((string_map{{"title", "vim"}, {"class", "xterm"}, {"id", "1"}}), context.toMap());
+
+    context.merge({{"title", ""}});
+    context.merge({{"title", "shell"}});                // re-added key goes last
+    EXPECT_EQ((string_map{{"class", "xterm"}, {"id", "1"}, {"title", "shell"}}), context.toMap());
+}
+
+TEST(ContextTest, compare) {
+    auto context1 = Context({{"class", "xterm"}, {"title", "shell"}});
+    auto context2 = Context({{"title", "shell"}, {"class", "xterm"}});
+    auto context3 = Context({{"class", "shell"}, {"title", "xterm"}});
+    EXPECT_EQ(context1, context2);                  // order does not matter
+    EXPECT_EQ(context1.hash(), context2.hash());
+    EXPECT_NE(context1, context3);                  // values are bound to keys
+    EXPECT_NE(context1.hash(), context3.hash());
+
+    context2.merge({{"title", "vim"}});
+    EXPECT_NE(context1, context2);
+    context2.merge({{"title", "shell"}});           // hash is maintained incrementally
+    EXPECT_EQ(context1, context2);
+    EXPECT_EQ(context1.hash(), context2.hash());
+}
+
+TEST(ContextTest, intersects) {
+    using keyleds::service::intersects;
+    EXPECT_TRUE(intersects({1, 3, 5}, {2, 3}));
+    EXPECT_FALSE(intersects({1, 3, 5}, {0, 2, 4, 6}));
+    EXPECT_FALSE(intersects({}, {1}));
+}
@@ -0,0 +1,112 @@
+/* Keyleds -- Gaming keyboard tool
+ * Copyright (C) 2017 Julien Hartmann, juli1.hartmann@gmail.com
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+#include "keyledsd/service/DeviceManager_util.h"
+
+#include <gtest/gtest.h>
+#include <memory>
+#include <optional>
+#include <string>
+#include <vector>
+
+using keyleds::service::carryOverEffects;
+
+namespace {
+    /// Stands in for detail::LoadedEffect
+    struct FakeEffect final
+    {
+        std::size_t                     index;
+        std::unique_ptr<std::string>    effect;
+    };
+}
+
+using match_list = std::vector<std::optional<std::size_t>>;
+
+static std::vector<FakeEffect> makeEffects(std::vector<std::string> names)
+{
+    std::vector<FakeEffect> result;
+    for (std::size_t idx = 0; idx < names.size(); ++idx) {
+        result.push_back({idx, std::make_unique<std::string>(std::move(names[idx]))});
+    }
+    return result;
+}
+
+class CarryOverEffectsTest : public ::testing::Test
+{
+protected:
+    std::vector<FakeEffect> run(std::vector<FakeEffect> & previous, const match_list & matches)
+    {
+        return carryOverEffects(
+            previous, matches,
+            [this](FakeEffect & effect) { kept.push_back(*effect.effect); },
+            [](std::size_t idx) {
+                return std::make_optional(FakeEffect{idx, std::make_unique<std::string>("new")});
+            });
+    }
+
+    static void check(const std::vector<FakeEffect> & effects, const std::vector<std::string> & names)
+    {
+        ASSERT_EQ(names.size(), effects.size());
+        for (std::size_t idx = 0; idx < names.size(); ++idx) {
+            ASSERT_TRUE(effects[idx].effect);
+            EXPECT_EQ(names[idx], *effects[idx].effect);
+            EXPECT_EQ(idx, effects[idx].index);
+        }
+    }
+
+    std::vector<std::string> kept;
+};
+
+TEST_F(CarryOverEffectsTest, inserted) {
+    // [A, B] => [D, A, B]
+    auto previous = makeEffects({"A", "B"});
+    auto result = run(previous, {std::nullopt, 0, 1});
+    check(result, {"new", "A", "B"});
+    EXPECT_EQ((std::vector<std::string>{"A", "B"}), kept);
+}
+
+TEST_F(CarryOverEffectsTest, removed) {
+    // [A, B, C] => [A, C]
+    auto previous = makeEffects({"A", "B", "C"});
+    auto result = run(previous, {0, 2});
+    check(result, {"A", "C"});
+    ASSERT_TRUE(previous[1].effect);    // dropped effect is left for its owner to destroy
+    EXPECT_EQ("B", *previous[1].effect);
+}
+
+TEST_F(CarryOverEffectsTest, reordered) {
+    // [A, B, C] => [C, A, B]
+    auto previous = makeEffects({"A", "B", "C"});
+    auto result = run(previous, {2, 0, 1});
+    check(result, {"C", "A", "B"});
+    EXPECT_EQ((std::vector<std::string>{"C", "A", "B"}), kept);
+}
+
+TEST_F(CarryOverEffectsTest, missingEntry) {
+    // Effect at index 1 failed to load in previous configuration, list has a gap
+    auto previous = makeEffects({"A", "C"});
+    previous[1].index = 2;
+    auto result = run(previous, {2, 1, 0});
+    check(result, {"C", "new", "A"});
+}
+
+TEST_F(CarryOverEffectsTest, emptiedEntry) {
+    // Entries already moved from are never picked up again
+    auto previous = makeEffects({"A", "B"});
+    previous[0].effect.reset();
+    auto result = run(previous, {0, 1});
+    check(result, {"new", "B"});
+}
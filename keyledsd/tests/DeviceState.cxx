@@ -0,0 +1,81 @@
+/* Keyleds -- Gaming keyboard tool
+ * Copyright (C) 2017 Julien Hartmann, juli1.hartmann@gmail.com
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+#include "keyledsd/service/DeviceState.h"
+
+#include "config.h"
+#include <cstdlib>
+#include <gtest/gtest.h>
+#include <unistd.h>
+
+using keyleds::RenderTarget;
+using keyleds::RGBAColor;
+
+
+static RenderTarget makeState(RenderTarget::size_type size)
+{
+    auto state = RenderTarget(size);
+    for (RenderTarget::size_type idx = 0; idx < size; ++idx) {
+        const auto value = static_cast<RGBAColor::channel_type>(idx);
+        state[idx] = RGBAColor(value, static_cast<RGBAColor::channel_type>(255 - value), 7, 255);
+    }
+    return state;
+}
+
+TEST(DeviceStateTest, roundTrip) {
+    const auto state = makeState(109);
+    const auto data = keyleds::service::encodeDeviceState(state);
+
+    const auto decoded = keyleds::service::decodeDeviceState(data, state.size());
+    ASSERT_TRUE(decoded);
+    ASSERT_EQ(state.size(), decoded->size());
+    for (RenderTarget::size_type idx = 0; idx < state.size(); ++idx) {
+        EXPECT_EQ(state[idx], (*decoded)[idx]);
+    }
+}
+
+TEST(DeviceStateTest, rejectsInvalid) {
+    const auto data = keyleds::service::encodeDeviceState(makeState(12));
+
+    EXPECT_FALSE(keyleds::service::decodeDeviceState(data, 13));                  // layout changed
+    EXPECT_FALSE(keyleds::service::decodeDeviceState(data.substr(0, 20), 12));   // truncated
+    EXPECT_FALSE(keyleds::service::decodeDeviceState("", 0));
+
+    auto corrupt = data;
+    corrupt[0] = 'X';
+    EXPECT_FALSE(keyleds::service::decodeDeviceState(corrupt, 12));
+}
+
+TEST(DeviceStateTest, persists) {
+    char dir[] = "/tmp/keyledsd-test-XXXXXX";
+    ASSERT_NE(nullptr, ::mkdtemp(dir));
+    ::setenv("XDG_CACHE_HOME", dir, 1);
+
+    const auto state = makeState(20);
+    EXPECT_FALSE(keyleds::service::loadDeviceState("1234ABCD", state.size()));
+    keyleds::service::saveDeviceState("1234ABCD", state);
+
+    const auto loaded = keyleds::service::loadDeviceState("1234ABCD", state.size());
+    ASSERT_TRUE(loaded);
+    EXPECT_EQ(state[19], (*loaded)[19]);
+    EXPECT_FALSE(keyleds::service::loadDeviceState("1234ABCD", 21));
+
+    const auto base = std::string(dir) + "/" KEYLEDSD_DATA_PREFIX;
+    EXPECT_EQ(0, ::unlink((base + "/devices/1234ABCD.state").c_str()));
+    ::rmdir((base + "/devices").c_str());
+    ::rmdir(base.c_str());
+    ::rmdir(dir);
+}
@@ -0,0 +1,130 @@
+/* Keyleds -- Gaming keyboard tool
+ * Copyright (C) 2017 Julien Hartmann, juli1.hartmann@gmail.com
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+#include "keyledsd/tools/EvdevReader.h"
+
+#include <cstdio>
+#include <fcntl.h>
+#include <gtest/gtest.h>
+#include <linux/input.h>
+#include <unistd.h>
+#include <utility>
+#include <vector>
+
+using keyleds::tools::EvdevReader;
+
+using event_list = std::vector<std::pair<int, bool>>;
+
+static input_event makeEvent(unsigned type, unsigned code, int value, long usec = 0)
+{
+    auto event = input_event{};
+    event.input_event_sec = usec / 1000000;
+    event.input_event_usec = usec % 1000000;
+    event.type = static_cast<decltype(event.type)>(type);
+    event.code = static_cast<decltype(event.code)>(code);
+    event.value = value;
+    return event;
+}
+
+static void record(EvdevReader & reader, event_list & events)
+{
+    reader.keyEventReceived.connect([&events](int key, bool press, EvdevReader::time_point) {
+        events.emplace_back(key, press);
+    });
+}
+
+
+TEST(EvdevReaderTest, recordedFile) {
+    const input_event recording[] = {
+        makeEvent(EV_MSC, MSC_SCAN, 0x70004),
+        makeEvent(EV_KEY, KEY_A, 1),
+        makeEvent(EV_SYN, SYN_REPORT, 0),
+        makeEvent(EV_KEY, KEY_A, 2),            // auto-repeat
+        makeEvent(EV_SYN, SYN_REPORT, 0),
+        makeEvent(EV_KEY, KEY_LEFTSHIFT, 1),
+        makeEvent(EV_KEY, KEY_A, 0),
+        makeEvent(EV_SYN, SYN_DROPPED, 0),
+        makeEvent(EV_KEY, KEY_LEFTSHIFT, 0),
+        makeEvent(EV_SYN, SYN_REPORT, 0),
+    };
+    std::FILE * file = std::tmpfile();
+    ASSERT_NE(nullptr, file);
+    ASSERT_EQ(std::size(recording), std::fwrite(recording, sizeof(recording[0]),
+                                                std::size(recording), file));
+    std::fflush(file);
+
+    auto reader = EvdevReader(::open(("/proc/self/fd/" + std::to_string(fileno(file))).c_str(),
+                                     O_RDONLY | O_CLOEXEC));
+    std::fclose(file);
+    ASSERT_LE(0, reader.fd());
+
+    auto events = event_list();
+    record(reader, events);
+    EXPECT_TRUE(reader.readAll());              // short read, more may come
+    EXPECT_FALSE(reader.readAll());             // end of file
+
+    EXPECT_EQ((event_list{
+        {KEY_A, true}, {KEY_LEFTSHIFT, true}, {KEY_A, false}, {KEY_LEFTSHIFT, false}
+    }), events);
+}
+
+TEST(EvdevReaderTest, timestamps) {
+    int fds[2];
+    ASSERT_EQ(0, ::pipe2(fds, O_NONBLOCK | O_CLOEXEC));
+    auto reader = EvdevReader(fds[0]);
+
+    const input_event recording[] = {
+        makeEvent(EV_KEY, KEY_A, 1, 12000500),
+        makeEvent(EV_KEY, KEY_A, 0, 12999999),
+    };
+    ASSERT_EQ(static_cast<ssize_t>(sizeof(recording)), ::write(fds[1], recording, sizeof(recording)));
+    ::close(fds[1]);
+
+    auto times = std::vector<EvdevReader::time_point>();
+    reader.keyEventReceived.connect([&times](int, bool, EvdevReader::time_point time) {
+        times.push_back(time);
+    });
+    EXPECT_TRUE(reader.readAll());
+
+    using std::chrono::microseconds;
+    ASSERT_EQ(2u, times.size());
+    EXPECT_EQ(microseconds(12000500), times[0].time_since_epoch());
+    EXPECT_EQ(microseconds(12999999), times[1].time_since_epoch());
+}
+
+TEST(EvdevReaderTest, batchedPipe) {
+    int fds[2];
+    ASSERT_EQ(0, ::pipe2(fds, O_NONBLOCK | O_CLOEXEC));
+    auto reader = EvdevReader(fds[0]);
+
+    // More than one batch worth of events, so readAll has to loop
+    constexpr int count = 3 * EvdevReader::batchSize + 5;
+    for (int idx = 0; idx < count; ++idx) {
+        const auto event = makeEvent(EV_KEY, static_cast<unsigned>(KEY_1 + idx % 10), idx % 2 == 0);
+        ASSERT_EQ(static_cast<ssize_t>(sizeof(event)), ::write(fds[1], &event, sizeof(event)));
+    }
+
+    auto events = event_list();
+    record(reader, events);
+    EXPECT_TRUE(reader.readAll());
+    ASSERT_EQ(static_cast<std::size_t>(count), events.size());
+    EXPECT_EQ(std::make_pair(KEY_1, true), events.front());
+    EXPECT_EQ(std::make_pair(KEY_1 + (count - 1) % 10, (count - 1) % 2 == 0), events.back());
+
+    EXPECT_TRUE(reader.readAll());              // drained, but writer still open
+    ::close(fds[1]);
+    EXPECT_FALSE(reader.readAll());             // writer gone
+}
@@ -0,0 +1,151 @@
+/* Keyleds -- Gaming keyboard tool
+ * Copyright (C) 2017 Julien Hartmann, juli1.hartmann@gmail.com
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+#include "keyledsd/service/IdleMonitor.h"
+
+#include "keyledsd/tools/Event.h"
+#include <algorithm>
+#include <gtest/gtest.h>
+#include <string>
+#include <vector>
+
+using keyleds::service::IdleMonitor;
+using namespace std::literals::chrono_literals;
+
+/// Stands in for a device watcher, emitting device paths instead of udev
+/// descriptions, which cannot be built without actual devices.
+struct FakeDeviceWatcher final
+{
+    keyleds::tools::Callback<const std::string &> deviceAdded;
+    keyleds::tools::Callback<const std::string &> deviceRemoved;
+};
+
+/// Feeds an IdleMonitor from watcher events the way Service does: only devices
+/// that could be opened count, and removing a device never opened is ignored.
+class FakeService final
+{
+public:
+    FakeService(FakeDeviceWatcher & watcher, IdleMonitor & monitor,
+                const IdleMonitor::clock::time_point & now)
+     : m_monitor(monitor), m_now(now)
+    {
+        watcher.deviceAdded.connect([this](const std::string & path) { onDeviceAdded(path); });
+        watcher.deviceRemoved.connect([this](const std::string & path) { onDeviceRemoved(path); });
+    }
+
+    std::vector<std::string>    unsupported;    ///< devices that fail to open
+
+private:
+    void onDeviceAdded(const std::string & path)
+    {
+        if (std::find(unsupported.begin(), unsupported.end(), path) != unsupported.end()) {
+            return;
+        }
+        m_devices.push_back(path);
+        m_monitor.deviceAdded();
+    }
+
+    void onDeviceRemoved(const std::string & path)
+    {
+        auto it = std::find(m_devices.begin(), m_devices.end(), path);
+        if (it == m_devices.end()) { return; }
+        m_devices.erase(it);
+        m_monitor.deviceRemoved(m_now);
+    }
+
+private:
+    IdleMonitor &                           m_monitor;
+    const IdleMonitor::clock::time_point &  m_now;
+    std::vector<std::string>                m_devices;
+};
+
+class IdleMonitorTest : public ::testing::Test
+{
+protected:
+    void SetUp() override
+    {
+        monitor.setTimeout(300s, now);
+    }
+
+    IdleMonitor::clock::time_point  now = IdleMonitor::clock::time_point(1000s);
+    IdleMonitor                     monitor{now};
+    FakeDeviceWatcher               watcher;
+    FakeService                     service{watcher, monitor, now};
+};
+
+
+TEST_F(IdleMonitorTest, startsIdle) {
+    ASSERT_TRUE(monitor.deadline());
+    EXPECT_EQ(now + 300s, *monitor.deadline());
+    EXPECT_FALSE(monitor.expired(now + 299s));
+    EXPECT_TRUE(monitor.expired(now + 300s));
+}
+
+TEST_F(IdleMonitorTest, devicesKeepAlive) {
+    watcher.deviceAdded.emit("/dev/hidraw0");
+    watcher.deviceAdded.emit("/dev/hidraw1");
+    EXPECT_FALSE(monitor.deadline());
+    EXPECT_FALSE(monitor.expired(now + 3600s));
+
+    now += 3600s;
+    watcher.deviceRemoved.emit("/dev/hidraw0");
+    EXPECT_FALSE(monitor.deadline());
+
+    now += 10s;
+    watcher.deviceRemoved.emit("/dev/hidraw1");
+    ASSERT_TRUE(monitor.deadline());
+    EXPECT_EQ(now + 300s, *monitor.deadline());
+
+    // Device comes back before timeout
+    watcher.deviceAdded.emit("/dev/hidraw1");
+    EXPECT_FALSE(monitor.expired(now + 300s));
+}
+
+TEST_F(IdleMonitorTest, activation) {
+    // Started on demand: the device that triggered activation shows up
+    // during initial enumeration, before the first timer check
+    now += 1s;
+    watcher.deviceAdded.emit("/dev/hidraw0");
+    EXPECT_FALSE(monitor.expired(now + 300s));
+
+    // Unplugged, service exits once the delay has passed
+    now += 60s;
+    watcher.deviceRemoved.emit("/dev/hidraw0");
+    EXPECT_FALSE(monitor.expired(now + 299s));
+    EXPECT_TRUE(monitor.expired(now + 300s));
+}
+
+TEST_F(IdleMonitorTest, activationByUnsupportedDevice) {
+    // Triggering device cannot be opened, service must not stay around for it
+    service.unsupported.push_back("/dev/hidraw0");
+    watcher.deviceAdded.emit("/dev/hidraw0");
+    EXPECT_TRUE(monitor.expired(now + 300s));
+
+    // Its removal does not count either
+    now += 10s;
+    watcher.deviceRemoved.emit("/dev/hidraw0");
+    EXPECT_EQ(0u, monitor.devices());
+    EXPECT_EQ(now - 10s + 300s, *monitor.deadline());
+}
+
+TEST_F(IdleMonitorTest, disabled) {
+    monitor.setTimeout(0s, now);
+    EXPECT_FALSE(monitor.deadline());
+    EXPECT_FALSE(monitor.expired(now + 3600s));
+
+    monitor.setTimeout(5s, now + 60s);
+    EXPECT_EQ(now + 65s, *monitor.deadline());
+}
@@ -17,10 +17,13 @@
 #include "keyledsd/KeyDatabase.h"
 
 #include <gtest/gtest.h>
+#include <algorithm>
 #include <cmath>
+#include <cstdint>
 #include <numeric>
 #include <string>
 #include <type_traits>
+#include <vector>
 
 using keyleds::KeyDatabase;
 using namespace std::literals::string_literals;
@@ -92,6 +95,17 @@ TEST_F(KeyDatabaseTest, iterator) {
     EXPECT_EQ(m_db.begin() + 3, it);
 }
 
+TEST_F(KeyDatabaseTest, memoryUsage) {
+    EXPECT_EQ(0u, KeyDatabase().memoryUsage());
+    EXPECT_GE(m_db.memoryUsage(), NKEYS * sizeof(KeyDatabase::Key));
+
+    auto longNames = KeyDatabase({
+        {0, 10, std::string(100, 'A'), {10, 10, 20, 20}},
+        {1, 11, std::string(100, 'B'), {80, 80, 90, 90}}
+    });
+    EXPECT_GE(longNames.memoryUsage(), 2 * (sizeof(KeyDatabase::Key) + 100));
+}
+
 TEST_F(KeyDatabaseTest, findKeyCode) {
     EXPECT_EQ(m_db.begin() + 1, m_db.findKeyCode(11));
     EXPECT_EQ(m_db.end(), m_db.findKeyCode(42));
@@ -103,6 +117,55 @@ TEST_F(KeyDatabaseTest, findName) {
     EXPECT_EQ(m_db.end(), m_db.findName("foobar"));
 }
 
+TEST_F(KeyDatabaseTest, findEmpty) {
+    const auto empty = KeyDatabase();
+    EXPECT_EQ(empty.end(), empty.findKeyCode(10));
+    EXPECT_EQ(empty.end(), empty.findName("TOPLEFT"));
+}
+
+TEST_F(KeyDatabaseTest, findUnusualKeyCodes) {
+    const auto db = KeyDatabase({
+        {0, -1, "NEGATIVE"s,   {0, 0, 1, 1}},
+        {1, 0x2ff, "LAST"s,    {0, 0, 1, 1}},
+        {2, 0x1000, "LARGE"s,  {0, 0, 1, 1}},
+        {3, 5, "FIRST"s,       {0, 0, 1, 1}},
+        {4, 5, "SECOND"s,      {0, 0, 1, 1}},
+        {5, 6, "FIRST"s,       {0, 0, 1, 1}},
+    });
+    EXPECT_EQ(db.begin() + 0, db.findKeyCode(-1));
+    EXPECT_EQ(db.begin() + 1, db.findKeyCode(0x2ff));
+    EXPECT_EQ(db.begin() + 2, db.findKeyCode(0x1000));
+    EXPECT_EQ(db.end(), db.findKeyCode(0x1001));
+    EXPECT_EQ(db.end(), db.findKeyCode(4));
+
+    // Duplicates resolve to first key, as a linear scan would
+    EXPECT_EQ(db.begin() + 3, db.findKeyCode(5));
+    EXPECT_EQ(db.begin() + 3, db.findName("FIRST"));
+}
+
+TEST_F(KeyDatabaseTest, findMatchesScan) {
+    // Enough keys for hash collisions to happen
+    std::vector<KeyDatabase::Key> keys;
+    for (unsigned idx = 0; idx < 300; ++idx) {
+        keys.push_back({idx, int(idx * 3 % 500), "KEY_"s + std::to_string(idx * 7), {0, 0, 1, 1}});
+    }
+    const auto db = KeyDatabase(keys);
+    const auto copy = db;
+
+    for (const auto & key : keys) {
+        EXPECT_EQ(db.begin() + key.index, db.findKeyCode(key.keyCode));
+        EXPECT_EQ(db.begin() + key.index, db.findName(key.name.c_str()));
+        EXPECT_EQ(copy.begin() + key.index, copy.findName(key.name.c_str()));
+    }
+    for (int code = 0; code < 500; ++code) {
+        auto expected = std::find_if(db.begin(), db.end(),
+                                     [code](const auto & key) { return key.keyCode == code; });
+        EXPECT_EQ(expected, db.findKeyCode(code));
+    }
+    EXPECT_EQ(db.end(), db.findName("KEY_1"));
+    EXPECT_EQ(db.end(), db.findName("KEY_"));
+}
+
 TEST_F(KeyDatabaseTest, distance) {
     EXPECT_EQ((KeyDatabase::Rect{10, 10, 90, 90}), m_db.bounds());
     EXPECT_EQ(0, m_db.distance(m_db[0], m_db[0]));
@@ -121,6 +184,123 @@ TEST_F(KeyDatabaseTest, angle) {
     EXPECT_DOUBLE_EQ(std::atan(-4.0/3.0), m_db.angle(m_db[0], m_db[4]));
 }
 
+/// Returns indices of keys in a group, in group order
+static std::vector<unsigned> indices(const KeyDatabase::KeyGroup & group)
+{
+    std::vector<unsigned> result;
+    for (const auto & key : group) { result.push_back(key.index); }
+    return result;
+}
+
+TEST_F(KeyDatabaseTest, keysInRadius) {
+    EXPECT_EQ((std::vector<unsigned>{0}), indices(m_db.keysInRadius(15, 15, 0)));
+    EXPECT_EQ((std::vector<unsigned>{0, 4}), indices(m_db.keysInRadius(15, 15, 50)));
+    EXPECT_EQ((std::vector<unsigned>{0, 2, 3, 4}), indices(m_db.keysInRadius(15, 15, 70)));
+    EXPECT_EQ((std::vector<unsigned>{}), indices(m_db.keysInRadius(500, 500, 10)));
+    EXPECT_EQ(NKEYS, m_db.keysInRadius(0, 0, 1000).size());
+}
+
+TEST_F(KeyDatabaseTest, nearestKeys) {
+    EXPECT_EQ((std::vector<unsigned>{4}), indices(m_db.nearestKeys(45, 55, 1)));
+    EXPECT_EQ((std::vector<unsigned>{1, 4}), indices(m_db.nearestKeys(80, 80, 2)));
+    EXPECT_EQ((std::vector<unsigned>{1, 4, 2, 3, 0}), indices(m_db.nearestKeys(1000, 1000, 10)));
+    EXPECT_TRUE(m_db.nearestKeys(45, 55, 0).empty());
+}
+
+TEST_F(KeyDatabaseTest, keysOnLine) {
+    EXPECT_EQ((std::vector<unsigned>{0, 4, 1}), indices(m_db.keysOnLine(15, 15, 85, 85)));
+    EXPECT_EQ((std::vector<unsigned>{1, 4, 0}), indices(m_db.keysOnLine(85, 85, 15, 15)));
+    EXPECT_EQ((std::vector<unsigned>{0, 2}), indices(m_db.keysOnLine(0, 15, 100, 15)));
+    EXPECT_EQ((std::vector<unsigned>{}), indices(m_db.keysOnLine(0, 35, 100, 35)));
+}
+
+TEST_F(KeyDatabaseTest, keysOnRay) {
+    EXPECT_EQ((std::vector<unsigned>{0, 2}), indices(m_db.keysOnRay(15, 15, 0.0)));
+    EXPECT_EQ((std::vector<unsigned>{1, 2}), indices(m_db.keysOnRay(85, 85, PI/2.0)));
+    EXPECT_EQ((std::vector<unsigned>{0, 4, 1}), indices(m_db.keysOnRay(15, 15, -PI/4.0)));
+}
+
+TEST_F(KeyDatabaseTest, spatialMatchesScan) {
+    // Irregular layout with keys of various sizes, like an LED strip around a keyboard
+    std::vector<KeyDatabase::Key> keys;
+    for (unsigned idx = 0; idx < 1000; ++idx) {
+        const auto x = (idx * 37) % 997, y = (idx * 91) % 331;
+        const auto size = 5 + idx % 30;
+        keys.push_back({idx, int(idx), "K"s + std::to_string(idx), {x, y, x + size, y + size / 2}});
+    }
+    const auto db = KeyDatabase(keys);
+
+    auto scanRadius = [&](unsigned x, unsigned y, unsigned radius) {
+        std::vector<unsigned> result;
+        for (const auto & key : db) {
+            const double dx = double((key.position.x0 + key.position.x1) / 2) - double(x);
+            const double dy = double((key.position.y0 + key.position.y1) / 2) - double(y);
+            if (dx * dx + dy * dy <= double(radius) * double(radius)) { result.push_back(key.index); }
+        }
+        return result;
+    };
+    for (unsigned idx = 0; idx < 50; ++idx) {
+        const auto x = (idx * 53) % 1000, y = (idx * 29) % 340, radius = idx * 7 % 120;
+        EXPECT_EQ(scanRadius(x, y, radius), indices(db.keysInRadius(x, y, radius)));
+
+        std::vector<std::pair<double, unsigned>> sorted;
+        for (const auto & key : db) {
+            const double dx = double((key.position.x0 + key.position.x1) / 2) - double(x);
+            const double dy = double((key.position.y0 + key.position.y1) / 2) - double(y);
+            sorted.emplace_back(dx * dx + dy * dy, key.index);
+        }
+        std::sort(sorted.begin(), sorted.end());
+        std::vector<unsigned> nearest;
+        for (unsigned rank = 0; rank < 8; ++rank) { nearest.push_back(sorted[rank].second); }
+        EXPECT_EQ(nearest, indices(db.nearestKeys(x, y, 8)));
+
+        std::vector<unsigned> crossed;
+        for (const auto & key : db) {
+            // Horizontal line at y crosses keys spanning y
+            if (key.position.y0 <= y && y <= key.position.y1) { crossed.push_back(key.index); }
+        }
+        auto onLine = indices(db.keysOnLine(0, y, 2000, y));
+        std::sort(onLine.begin(), onLine.end());
+        EXPECT_EQ(crossed, onLine);
+    }
+}
+
+TEST_F(KeyDatabaseTest, geometry) {
+    const auto & geometry = m_db.geometry();
+    const auto width = KeyDatabase::Geometry::simdWidth;
+    for (const auto * array : { &geometry.x, &geometry.y, &geometry.width, &geometry.height }) {
+        EXPECT_EQ(width, array->size());
+        EXPECT_EQ(0u, reinterpret_cast<std::uintptr_t>(array->data()) % 32);
+    }
+    EXPECT_EQ(width, geometry.block.size());
+
+    // Bounds are 10..90 on both axes
+    EXPECT_FLOAT_EQ(0.0625f, geometry.x[0]);
+    EXPECT_FLOAT_EQ(0.0625f, geometry.y[0]);
+    EXPECT_FLOAT_EQ(0.9375f, geometry.x[1]);
+    EXPECT_FLOAT_EQ(0.9375f, geometry.y[1]);
+    EXPECT_FLOAT_EQ(0.4375f, geometry.x[4]);
+    EXPECT_FLOAT_EQ(0.5625f, geometry.y[4]);
+    EXPECT_FLOAT_EQ(0.125f, geometry.width[4]);
+    EXPECT_FLOAT_EQ(0.125f, geometry.height[4]);
+    for (auto idx = NKEYS; idx < width; ++idx) {
+        EXPECT_EQ(0.0f, geometry.x[idx]);
+        EXPECT_EQ(0.0f, geometry.width[idx]);
+    }
+
+    auto copy = m_db;
+    EXPECT_EQ(geometry.x, copy.geometry().x);
+    EXPECT_EQ(0u, reinterpret_cast<std::uintptr_t>(copy.geometry().x.data()) % 32);
+
+    const auto blocks = KeyDatabase({
+        {0, 10, "A"s, {0, 0, 10, 10}, 0},
+        {1, 11, "B"s, {10, 0, 20, 10}, 2}
+    });
+    EXPECT_EQ(0u, blocks.geometry().block[0]);
+    EXPECT_EQ(2u, blocks.geometry().block[1]);
+    EXPECT_TRUE(KeyDatabase().geometry().x.empty());
+}
+
 
 class KeyGroupTest : public KeyDatabaseTest {
 protected:
@@ -224,3 +404,62 @@ TEST_F(KeyGroupTest, pushpop) {
     copy.pop_back();
     EXPECT_EQ(copy, m_db.makeGroup("test", std::vector{"BOTTOMRIGHT"s, "BOTTOMLEFT"s}));
 }
+
+
+class KeySetTest : public KeyGroupTest {
+protected:
+    using KeySet = KeyDatabase::KeySet;
+};
+
+TEST_F(KeySetTest, construct) {
+    auto empty = KeySet(NKEYS);
+    EXPECT_EQ(NKEYS, empty.size());
+    EXPECT_EQ(0, empty.count());
+    EXPECT_TRUE(empty.empty());
+
+    auto set = KeySet(NKEYS, bottom);
+    EXPECT_EQ(2, set.count());
+    EXPECT_FALSE(set.empty());
+    EXPECT_TRUE(set.contains(1));
+    EXPECT_TRUE(set.contains(m_db[3]));
+    EXPECT_FALSE(set.contains(0));
+    EXPECT_FALSE(set.contains(NKEYS));          // out of range is never contained
+
+    set.insert(m_db[0]);
+    set.erase(1);
+    EXPECT_EQ(m_db.makeGroup("", std::vector{"TOPLEFT"s, "BOTTOMLEFT"s}), set.group(m_db));
+    set.clear();
+    EXPECT_TRUE(set.empty());
+}
+
+TEST_F(KeySetTest, algebra) {
+    const auto left = KeySet(NKEYS, m_db.makeGroup("", std::vector{"TOPLEFT"s, "BOTTOMLEFT"s}));
+    const auto low = KeySet(NKEYS, bottom);
+
+    EXPECT_EQ(KeySet(NKEYS, m_db.makeGroup("", std::vector{"BOTTOMLEFT"s})), left & low);
+    EXPECT_EQ(3, (left | low).count());
+    EXPECT_EQ(KeySet(NKEYS, m_db.makeGroup("", std::vector{"TOPLEFT"s})), left - low);
+    EXPECT_EQ((left | low) - (left & low), left ^ low);
+
+    const auto others = ~(left | low);
+    EXPECT_EQ(2, others.count());
+    EXPECT_TRUE(others.contains(2));
+    EXPECT_TRUE(others.contains(4));
+    EXPECT_EQ(NKEYS, (~KeySet(NKEYS)).count());         // bits past size stay clear
+
+    std::vector<unsigned> visited;
+    (left | low).forEach([&](auto idx) { visited.push_back(idx); });
+    EXPECT_EQ((std::vector<unsigned>{0, 1, 3}), visited);
+}
+
+TEST_F(KeySetTest, largeSet) {
+    auto set = KeySet(200);
+    for (unsigned idx = 0; idx < 200; idx += 3) { set.insert(idx); }
+    EXPECT_EQ(4, set.words());
+    EXPECT_EQ(67, set.count());
+    EXPECT_TRUE(set.contains(63));
+    EXPECT_TRUE(set.contains(129));
+    EXPECT_FALSE(set.contains(130));
+    EXPECT_EQ(200 - 67, (~set).count());
+    EXPECT_TRUE((set & ~set).empty());
+}
@@ -0,0 +1,130 @@
+/* Keyleds -- Gaming keyboard tool
+ * Copyright (C) 2017 Julien Hartmann, juli1.hartmann@gmail.com
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+#include "keyledsd/KeyDatabase.h"
+
+#include <benchmark/benchmark.h>
+#include <string>
+#include <vector>
+
+using keyleds::KeyDatabase;
+
+
+/// Builds key list named and coded like a keyboard, laid out in rows of 64 keys
+static std::vector<KeyDatabase::Key> makeKeys(unsigned count)
+{
+    std::vector<KeyDatabase::Key> keys;
+    keys.reserve(count);
+    for (unsigned idx = 0; idx < count; ++idx) {
+        const auto x = (idx % 64) * 20, y = (idx / 64) * 20;
+        keys.push_back({idx, int(idx + 1), "KEY_" + std::to_string(idx), {x, y, x + 18, y + 18}});
+    }
+    return keys;
+}
+
+static KeyDatabase makeDatabase(unsigned count) { return KeyDatabase(makeKeys(count)); }
+
+static void BM_findKeyCode(benchmark::State & state)
+{
+    const auto count = unsigned(state.range(0));
+    const auto db = makeDatabase(count);
+
+    int keyCode = 1;
+    for (auto _ : state) {
+        benchmark::DoNotOptimize(db.findKeyCode(keyCode));
+        keyCode = keyCode % int(count) + 1;
+    }
+    state.SetItemsProcessed(int64_t(state.iterations()));
+}
+BENCHMARK(BM_findKeyCode)->RangeMultiplier(2)->Range(16, 512);
+
+static void BM_findName(benchmark::State & state)
+{
+    const auto count = unsigned(state.range(0));
+    const auto db = makeDatabase(count);
+
+    std::vector<std::string> names;
+    for (const auto & key : db) { names.push_back(key.name); }
+
+    std::size_t idx = 0;
+    for (auto _ : state) {
+        benchmark::DoNotOptimize(db.findName(names[idx].c_str()));
+        idx = (idx + 1) % names.size();
+    }
+    state.SetItemsProcessed(int64_t(state.iterations()));
+}
+BENCHMARK(BM_findName)->RangeMultiplier(2)->Range(16, 512);
+
+static void BM_construct(benchmark::State & state)
+{
+    const auto keys = makeKeys(unsigned(state.range(0)));
+    for (auto _ : state) {
+        auto db = KeyDatabase(keys);
+        benchmark::DoNotOptimize(db.size());
+    }
+    state.SetComplexityN(state.range(0));
+}
+BENCHMARK(BM_construct)->RangeMultiplier(4)->Range(16, 16<<10)->Complexity();
+
+static void BM_keysInRadius(benchmark::State & state)
+{
+    const auto count = unsigned(state.range(0));
+    const auto db = makeDatabase(count);
+    const auto bounds = db.bounds();
+
+    unsigned step = 0;
+    for (auto _ : state) {
+        auto group = db.keysInRadius((step * 37) % bounds.x1, (step * 17) % (bounds.y1 + 1), 50);
+        benchmark::DoNotOptimize(group.size());
+        ++step;
+    }
+    state.SetComplexityN(state.range(0));
+}
+BENCHMARK(BM_keysInRadius)->RangeMultiplier(4)->Range(16, 16<<10)->Complexity();
+
+static void BM_nearestKeys(benchmark::State & state)
+{
+    const auto count = unsigned(state.range(0));
+    const auto db = makeDatabase(count);
+    const auto bounds = db.bounds();
+
+    unsigned step = 0;
+    for (auto _ : state) {
+        auto group = db.nearestKeys((step * 37) % bounds.x1, (step * 17) % (bounds.y1 + 1), 8);
+        benchmark::DoNotOptimize(group.size());
+        ++step;
+    }
+    state.SetComplexityN(state.range(0));
+}
+BENCHMARK(BM_nearestKeys)->RangeMultiplier(4)->Range(16, 16<<10)->Complexity();
+
+static void BM_keysOnRay(benchmark::State & state)
+{
+    const auto count = unsigned(state.range(0));
+    const auto db = makeDatabase(count);
+    const auto bounds = db.bounds();
+
+    unsigned step = 0;
+    for (auto _ : state) {
+        auto group = db.keysOnRay(bounds.x1 / 2, bounds.y1 / 2, 0.1 * step);
+        benchmark::DoNotOptimize(group.size());
+        ++step;
+    }
+    state.SetComplexityN(state.range(0));
+}
+BENCHMARK(BM_keysOnRay)->RangeMultiplier(4)->Range(16, 16<<10)->Complexity();
+
+BENCHMARK_MAIN();
@@ -0,0 +1,69 @@
+/* Keyleds -- Gaming keyboard tool
+ * Copyright (C) 2017 Julien Hartmann, juli1.hartmann@gmail.com
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+#include "keyledsd/service/KeyEventRouter.h"
+
+#include <gtest/gtest.h>
+
+using keyleds::service::KeyEventRouter;
+
+struct Target final { int value; };
+
+
+TEST(KeyEventRouterTest, inputFirst) {
+    auto router = KeyEventRouter<Target>();
+    auto target1 = Target{1}, target2 = Target{2};
+
+    router.addInput(3, "/dev/input/event3");
+    router.addInput(7, "/dev/input/event7");
+    router.addInput(8, "/dev/input/event8");
+    EXPECT_EQ(nullptr, router.route(3));
+
+    router.addTarget(target1, {"/dev/input/event3", "/dev/input/event8"});
+    router.addTarget(target2, {"/dev/input/event7"});
+    EXPECT_EQ(&target1, router.route(3));
+    EXPECT_EQ(&target2, router.route(7));
+    EXPECT_EQ(&target1, router.route(8));
+    EXPECT_EQ(nullptr, router.route(4));        // unknown input
+    EXPECT_EQ(nullptr, router.route(100));      // out of table
+    EXPECT_EQ(nullptr, router.route(-1));
+
+    router.removeTarget(target1);
+    EXPECT_EQ(nullptr, router.route(3));
+    EXPECT_EQ(&target2, router.route(7));
+    EXPECT_EQ(nullptr, router.route(8));
+}
+
+TEST(KeyEventRouterTest, targetFirst) {
+    auto router = KeyEventRouter<Target>();
+    auto target = Target{1};
+
+    router.addTarget(target, {"/dev/input/event3"});
+    EXPECT_EQ(nullptr, router.route(3));
+
+    router.addInput(3, "/dev/input/event3");
+    router.addInput(4, "/dev/input/event4");
+    EXPECT_EQ(&target, router.route(3));
+    EXPECT_EQ(nullptr, router.route(4));
+
+    router.removeInput(3);
+    EXPECT_EQ(nullptr, router.route(3));
+
+    router.addInput(3, "/dev/input/event4");    // identifier reused for another device
+    EXPECT_EQ(nullptr, router.route(3));
+    router.addInput(5, "/dev/input/event3");
+    EXPECT_EQ(&target, router.route(5));
+}
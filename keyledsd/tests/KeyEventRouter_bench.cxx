@@ -0,0 +1,98 @@
+/* Keyleds -- Gaming keyboard tool
+ * Copyright (C) 2017 Julien Hartmann, juli1.hartmann@gmail.com
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+#include "keyledsd/service/KeyEventRouter.h"
+
+#include <algorithm>
+#include <benchmark/benchmark.h>
+#include <string>
+#include <utility>
+#include <vector>
+
+using keyleds::service::KeyEventRouter;
+
+/// Stands for a DeviceManager, with the few inputs a keyboard exposes
+struct Target final
+{
+    std::vector<std::string>    eventDevices;
+    unsigned                    events = 0;
+
+    void handleKeyEvent(int key, bool) { events += unsigned(key); }
+};
+
+/// Typical setup: a few keyboards among a dozen Xinput slave keyboards
+struct Setup final
+{
+    static constexpr int inputCount = 12;
+    static constexpr int targetCount = 3;
+
+    std::vector<std::pair<int, std::string>>    inputs;
+    std::vector<Target>                         targets;
+
+    Setup()
+    {
+        for (int idx = 0; idx < inputCount; ++idx) {
+            inputs.emplace_back(idx + 6, "/dev/input/event" + std::to_string(idx));
+        }
+        for (int idx = 0; idx < targetCount; ++idx) {
+            targets.push_back({{"/dev/input/event" + std::to_string(inputCount - 1 - 2 * idx),
+                                "/dev/input/event" + std::to_string(inputCount - 2 - 2 * idx)}});
+        }
+    }
+    int eventSource(unsigned serial) const { return inputs[inputCount - 1 - serial % 6].first; }
+};
+
+
+/// Previous behavior: look up Xinput device, then compare device nodes of all managers
+static void BM_lookup(benchmark::State & state)
+{
+    auto setup = Setup();
+    unsigned serial = 0;
+    for (auto _ : state) {
+        const auto deviceId = setup.eventSource(serial++);
+        auto it = std::find_if(setup.inputs.begin(), setup.inputs.end(),
+                               [&](const auto & input) { return input.first == deviceId; });
+        if (it == setup.inputs.end()) { continue; }
+        const auto & devNode = it->second;
+        for (auto & target : setup.targets) {
+            const auto & evDevs = target.eventDevices;
+            if (std::find(evDevs.begin(), evDevs.end(), devNode) != evDevs.end()) {
+                target.handleKeyEvent(1, true);
+                break;
+            }
+        }
+    }
+    benchmark::DoNotOptimize(setup.targets.front().events);
+}
+BENCHMARK(BM_lookup);
+
+static void BM_route(benchmark::State & state)
+{
+    auto setup = Setup();
+    auto router = KeyEventRouter<Target>();
+    for (const auto & input : setup.inputs) { router.addInput(input.first, input.second); }
+    for (auto & target : setup.targets) { router.addTarget(target, target.eventDevices); }
+
+    unsigned serial = 0;
+    for (auto _ : state) {
+        auto * target = router.route(setup.eventSource(serial++));
+        if (target != nullptr) { target->handleKeyEvent(1, true); }
+    }
+    benchmark::DoNotOptimize(setup.targets.front().events);
+}
+BENCHMARK(BM_route);
+
+BENCHMARK_MAIN();
@@ -0,0 +1,107 @@
+/* Keyleds -- Gaming keyboard tool
+ * Copyright (C) 2017 Julien Hartmann, juli1.hartmann@gmail.com
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+#include "keyledsd/device/LayoutDescription.h"
+
+#include "config.h"
+#include <cstdlib>
+#include <dirent.h>
+#include <fstream>
+#include <gtest/gtest.h>
+#include <string>
+#include <sys/stat.h>
+#include <unistd.h>
+
+using keyleds::device::LayoutDescription;
+namespace detail = keyleds::device::detail;
+
+
+TEST(LayoutDescriptionTest, builtinCoversShippedFiles) {
+    auto count = std::size_t(0);
+    auto * dir = opendir(KEYLEDSD_LAYOUTS_DIR);
+    ASSERT_NE(nullptr, dir);
+    while (const auto * entry = readdir(dir)) {
+        const auto name = std::string(entry->d_name);
+        if (name.size() > 5 && name.compare(name.size() - 5, 5, ".yaml") == 0) {
+            EXPECT_TRUE(LayoutDescription::builtin(name)) <<name;
+            ++count;
+        }
+    }
+    closedir(dir);
+    EXPECT_EQ(count, detail::builtinLayoutCount);
+}
+
+TEST(LayoutDescriptionTest, builtinMatchesParsed) {
+    for (std::size_t idx = 0; idx < detail::builtinLayoutCount; ++idx) {
+        const auto file = std::string(detail::builtinLayouts[idx].file);
+        SCOPED_TRACE(file);
+
+        auto stream = std::ifstream(KEYLEDSD_LAYOUTS_DIR "/" + file, std::ios::binary);
+        ASSERT_TRUE(stream);
+        const auto parsed = LayoutDescription::parse(stream);
+        const auto builtin = LayoutDescription::builtin(file);
+        ASSERT_TRUE(builtin);
+
+        EXPECT_EQ(parsed.name, builtin->name);
+        ASSERT_EQ(parsed.keys.size(), builtin->keys.size());
+        for (std::size_t kidx = 0; kidx < parsed.keys.size(); ++kidx) {
+            const auto & expected = parsed.keys[kidx];
+            const auto & actual = builtin->keys[kidx];
+            EXPECT_EQ(expected.block, actual.block);
+            EXPECT_EQ(expected.code, actual.code);
+            EXPECT_EQ(expected.position.x0, actual.position.x0);
+            EXPECT_EQ(expected.position.y0, actual.position.y0);
+            EXPECT_EQ(expected.position.x1, actual.position.x1);
+            EXPECT_EQ(expected.position.y1, actual.position.y1);
+            EXPECT_EQ(expected.name, actual.name);
+        }
+        EXPECT_EQ(parsed.spurious, builtin->spurious);
+    }
+}
+
+TEST(LayoutDescriptionTest, overrideFromDataDirs) {
+    char homeTemplate[] = "/tmp/keyledsd-test-XXXXXX";
+    char dataTemplate[] = "/tmp/keyledsd-test-XXXXXX";
+    const auto home = std::string(mkdtemp(homeTemplate));
+    const auto data = std::string(mkdtemp(dataTemplate));
+    const auto file = std::string(detail::builtinLayouts[0].file);
+
+    // Override lives in a system data directory, not the user's
+    const auto prefixDir = data + "/" KEYLEDSD_DATA_PREFIX;
+    const auto layoutDir = prefixDir + "/layouts";
+    ASSERT_EQ(0, mkdir(prefixDir.c_str(), 0700));
+    ASSERT_EQ(0, mkdir(layoutDir.c_str(), 0700));
+    {
+        auto out = std::ofstream(layoutDir + "/" + file);
+        out <<"layout: override\nkeyboards:\n"
+              "  - keys:\n      - {code: 0x04, x: 1, y: 1, width: 10, height: 10, glyph: 'A'}\n";
+    }
+
+    setenv("XDG_DATA_HOME", home.c_str(), 1);
+    setenv("XDG_DATA_DIRS", (home + ":" + data).c_str(), 1);
+
+    const auto layout = LayoutDescription::loadOverride(file);
+    EXPECT_FALSE(LayoutDescription::loadOverride("does-not-exist.yaml"));
+
+    unlink((layoutDir + "/" + file).c_str());
+    rmdir(layoutDir.c_str());
+    rmdir(prefixDir.c_str());
+    rmdir(data.c_str());
+    rmdir(home.c_str());
+
+    ASSERT_TRUE(layout);
+    EXPECT_EQ("override", layout->name);
+}
@@ -0,0 +1,50 @@
+/* Keyleds -- Gaming keyboard tool
+ * Copyright (C) 2017 Julien Hartmann, juli1.hartmann@gmail.com
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+#include "keyledsd/device/LayoutDescription.h"
+
+#include <benchmark/benchmark.h>
+#include <fstream>
+#include <string>
+
+using keyleds::device::LayoutDescription;
+
+// A full-size keyboard, with game keys and spurious entries
+static const std::string layoutFile = "c32b00000000_0002.yaml";
+
+
+/// Previous behavior: read and parse the shipped file on every device open
+static void BM_parseLayout(benchmark::State & state)
+{
+    for (auto _ : state) {
+        auto file = std::ifstream(KEYLEDSD_LAYOUTS_DIR "/" + layoutFile, std::ios::binary);
+        auto layout = LayoutDescription::parse(file);
+        benchmark::DoNotOptimize(layout);
+    }
+}
+BENCHMARK(BM_parseLayout);
+
+/// Layout compiled into the binary at build time
+static void BM_builtinLayout(benchmark::State & state)
+{
+    for (auto _ : state) {
+        auto layout = LayoutDescription::builtin(layoutFile);
+        benchmark::DoNotOptimize(layout);
+    }
+}
+BENCHMARK(BM_builtinLayout);
+
+BENCHMARK_MAIN();
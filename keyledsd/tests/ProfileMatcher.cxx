@@ -0,0 +1,207 @@
+/* Keyleds -- Gaming keyboard tool
+ * Copyright (C) 2017 Julien Hartmann, juli1.hartmann@gmail.com
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+#include "keyledsd/service/ProfileMatcher.h"
+
+#include <algorithm>
+#include <gtest/gtest.h>
+#include <regex>
+#include <string>
+#include <vector>
+
+using keyleds::service::Configuration;
+using keyleds::service::Context;
+using keyleds::service::ProfileMatcher;
+using string_map = Context::string_map;
+using Kind = Configuration::Profile::Lookup::Entry::Kind;
+
+
+class ProfileMatcherTest : public ::testing::Test
+{
+protected:
+    void SetUp() override
+    {
+        for (const auto * name : {"base", "browser", "editor", "terminal", "overlay"}) {
+            m_config.effectGroups.push_back({name, {}, {}});
+        }
+        addProfile("__default__", {}, {"base"});
+        addProfile("__overlay__", {}, {"overlay"});
+        addProfile("firefox", {{"class", "firefox"}}, {"browser"});
+        addProfile("browsers", {{"class", "(fire|water)fox"}}, {"browser"});
+        addProfile("vim", {{"class", "xterm"}, {"title", ".*VIM"}}, {"editor"});
+        addProfile("ssh", {{"title", "ssh .*"}}, {"terminal"});
+        addProfile("work", {{"title", ".*project.*"}}, {"editor", "terminal"});
+        addProfile("other", {{"class", "xterm"}}, {"terminal"}, {"other-device"});
+        addProfile("any", {{"title", "any.thing"}}, {"base"});
+    }
+
+    void addProfile(std::string name, string_map lookup, std::vector<std::string> groups,
+                    std::vector<std::string> devices = {})
+    {
+        auto profile = Configuration::Profile();
+        profile.name = std::move(name);
+        profile.lookup = Configuration::Profile::Lookup(std::move(lookup));
+        profile.devices = std::move(devices);
+        profile.effectGroups = std::move(groups);
+        m_config.profiles.push_back(std::move(profile));
+    }
+
+    /// Previous behavior: evaluate every profile's lookup, last one wins
+    ProfileMatcher::Result scan(const string_map & context) const
+    {
+        const Configuration::Profile * profile = nullptr, * defaultProfile = nullptr,
+                                     * overlayProfile = nullptr;
+        for (const auto & entry : m_config.profiles) {
+            const auto & devices = entry.devices;
+            if (!devices.empty() && std::find(devices.begin(), devices.end(), m_device) == devices.end()) {
+                continue;
+            }
+            if (entry.name == "__default__") {
+                defaultProfile = &entry;
+            } else if (entry.name == "__overlay__") {
+                overlayProfile = &entry;
+            } else if (entry.lookup.match(context)) {
+                profile = &entry;
+            }
+        }
+        if (!profile) { profile = defaultProfile; }
+        if (!profile) { return {}; }
+
+        auto result = ProfileMatcher::Result{profile, {}};
+        for (const auto * selected : {profile, overlayProfile}) {
+            if (!selected) { continue; }
+            for (const auto & name : selected->effectGroups) {
+                auto it = std::find_if(m_config.effectGroups.begin(), m_config.effectGroups.end(),
+                                       [&name](const auto & group) { return group.name == name; });
+                result.effectGroups.push_back(&*it);
+            }
+        }
+        return result;
+    }
+
+    Configuration   m_config;
+    std::string     m_device = "device";
+};
+
+
+TEST_F(ProfileMatcherTest, classifyPattern) {
+    auto kindOf = [](const char * pattern) {
+        return Configuration::Profile::Lookup(string_map{{"key", pattern}}).entries().front().kind;
+    };
+    EXPECT_EQ(Kind::Exact, kindOf("firefox"));
+    EXPECT_EQ(Kind::Exact, kindOf(""));
+    EXPECT_EQ(Kind::Prefix, kindOf("ssh .*"));
+    EXPECT_EQ(Kind::Suffix, kindOf(".*VIM"));
+    EXPECT_EQ(Kind::Contains, kindOf(".*project.*"));
+    EXPECT_EQ(Kind::Regex, kindOf("(fire|water)fox"));
+    EXPECT_EQ(Kind::Regex, kindOf("any.thing"));
+    EXPECT_EQ(Kind::Regex, kindOf(".*a+.*"));
+    EXPECT_EQ(Kind::Regex, kindOf("^firefox$"));
+}
+
+TEST_F(ProfileMatcherTest, literalMatchesRegex) {
+    const char * patterns[] = { "firefox", "ssh .*", ".*VIM", ".*project.*", ".*", "" };
+    const char * inputs[] = {
+        "firefox", "firefox2", "ssh host", "ssh", "xssh host", "main.c - VIM", "VIM", "VIMx",
+        "my project", "project", "proj", "",
+        "firefox\n", "ssh host\nx", "ssh\r host", "main.c\n - VIM", "a\r\nVIM",
+        "my\nproject", "project\n", "\n",
+    };
+    for (const auto * pattern : patterns) {
+        const auto lookup = Configuration::Profile::Lookup(string_map{{"key", pattern}});
+        const auto & entry = lookup.entries().front();
+        ASSERT_NE(Kind::Regex, entry.kind) << pattern;
+        const auto regex = std::regex(pattern);
+        for (const auto * input : inputs) {
+            EXPECT_EQ(std::regex_match(input, regex), entry.matches(input))
+                << "pattern '" << pattern << "', input '" << input << "'";
+        }
+    }
+}
+
+TEST_F(ProfileMatcherTest, sameAsScan) {
+    const string_map contexts[] = {
+        {},
+        {{"class", "firefox"}, {"title", "Mozilla Firefox"}},
+        {{"class", "waterfox"}, {"title", "Waterfox"}},
+        {{"class", "firefoxes"}, {"title", "Firefox"}},
+        {{"class", "xterm"}, {"title", "main.c - VIM"}},
+        {{"class", "xterm"}, {"title", "ssh host"}},
+        {{"class", "xterm"}, {"title", "bash"}},
+        {{"class", "urxvt"}, {"title", "main.c - VIM"}},
+        {{"class", "xterm"}, {"title", "ssh project - VIM"}},
+        {{"class", "emacs"}, {"title", "my project"}},
+        {{"class", "emacs"}, {"title", "anything"}},
+        {{"class", "emacs"}, {"title", "any thing"}},
+        {{"title", "ssh host"}},
+    };
+    for (const auto & device : {"device", "other-device"}) {
+        m_device = device;
+        auto matcher = ProfileMatcher(m_config, m_device);
+        for (const auto & values : contexts) {
+            const auto expected = scan(values);
+            const auto & result = matcher.match(Context(values));
+            const auto * name = expected.profile ? expected.profile->name.c_str() : "none";
+            EXPECT_EQ(expected.profile, result.profile) << device << ": expected " << name;
+            EXPECT_EQ(expected.effectGroups, result.effectGroups) << device << ": expected " << name;
+        }
+    }
+}
+
+TEST_F(ProfileMatcherTest, multipleKeys) {
+    auto matcher = ProfileMatcher(m_config, m_device);
+    auto profileName = [&matcher](const string_map & values) {
+        return matcher.match(Context(values)).profile->name;
+    };
+    // Profile "vim" needs both class and title to match
+    EXPECT_EQ("vim", profileName({{"class", "xterm"}, {"title", "main.c - VIM"}}));
+    EXPECT_EQ("__default__", profileName({{"class", "xterm"}, {"title", "main.c"}}));
+    EXPECT_EQ("__default__", profileName({{"class", "urxvt"}, {"title", "main.c - VIM"}}));
+    EXPECT_EQ("__default__", profileName({{"title", "main.c - VIM"}}));
+
+    EXPECT_TRUE(matcher.dependsOn({Context::intern("class")}));
+    EXPECT_TRUE(matcher.dependsOn({Context::intern("title")}));
+    EXPECT_FALSE(matcher.dependsOn({Context::intern("instance")}));
+}
+
+TEST_F(ProfileMatcherTest, contextChange) {
+    auto matcher = ProfileMatcher(m_config, m_device);
+    auto context = Context({{"class", "firefox"}, {"title", "Mozilla Firefox"}});
+    EXPECT_EQ("browsers", matcher.match(context).profile->name);
+
+    // Same context object, changed in place: cached result must not be reused
+    context.merge({{"class", "xterm"}, {"title", "ssh host"}});
+    EXPECT_EQ("ssh", matcher.match(context).profile->name);
+    context.merge({{"title", "bash"}});
+    EXPECT_EQ("__default__", matcher.match(context).profile->name);
+
+    // Going back gives the first result again
+    context.merge({{"class", "firefox"}, {"title", "Mozilla Firefox"}});
+    EXPECT_EQ("browsers", matcher.match(context).profile->name);
+}
+
+TEST_F(ProfileMatcherTest, cacheEviction) {
+    auto matcher = ProfileMatcher(m_config, m_device);
+    const auto ssh = Context(string_map{{"title", "ssh host"}});
+    EXPECT_EQ("ssh", matcher.match(ssh).profile->name);
+
+    // Overflow the cache with distinct contexts
+    for (std::size_t idx = 0; idx <= 2 * ProfileMatcher::maxCachedContexts; ++idx) {
+        const auto title = "file" + std::to_string(idx) + " - VIM";
+        EXPECT_EQ("vim", matcher.match(Context(string_map{{"class", "xterm"}, {"title", title}})).profile->name);
+    }
+    EXPECT_EQ("ssh", matcher.match(ssh).profile->name);
+}
@@ -0,0 +1,112 @@
+/* Keyleds -- Gaming keyboard tool
+ * Copyright (C) 2017 Julien Hartmann, juli1.hartmann@gmail.com
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+#include "keyledsd/service/ProfileMatcher.h"
+
+#include <benchmark/benchmark.h>
+#include <string>
+#include <utility>
+#include <vector>
+
+using keyleds::service::Configuration;
+using keyleds::service::Context;
+using keyleds::service::ProfileMatcher;
+using string_map = std::vector<std::pair<std::string, std::string>>;
+
+
+/// Builds configuration with count profiles. Most match a window class exactly,
+/// one in eight matches a title pattern, like a configuration would.
+static Configuration makeConfiguration(unsigned count)
+{
+    Configuration config;
+    config.effectGroups.push_back({"effect", {}, {}});
+    for (unsigned idx = 0; idx < count; ++idx) {
+        auto profile = Configuration::Profile();
+        profile.name = "profile" + std::to_string(idx);
+        if (idx % 8 == 0) {
+            profile.lookup = Configuration::Profile::Lookup({{"title", ".*project" + std::to_string(idx) + ".*"}});
+        } else {
+            profile.lookup = Configuration::Profile::Lookup({{"class", "app" + std::to_string(idx)}});
+        }
+        profile.effectGroups = {"effect"};
+        config.profiles.push_back(std::move(profile));
+    }
+    return config;
+}
+
+static string_map makeContext(unsigned idx)
+{
+    return {{"class", "app" + std::to_string(idx)},
+            {"title", "editing file" + std::to_string(idx) + ".txt"}};
+}
+
+/// Previous behavior: evaluate every profile's lookup
+static void BM_scan(benchmark::State & state)
+{
+    const auto count = unsigned(state.range(0));
+    const auto config = makeConfiguration(count);
+
+    unsigned idx = 0;
+    for (auto _ : state) {
+        auto context = makeContext(idx);
+        const Configuration::Profile * result = nullptr;
+        for (const auto & profile : config.profiles) {
+            if (profile.lookup.match(context)) { result = &profile; }
+        }
+        benchmark::DoNotOptimize(result);
+        idx = (idx + 1) % count;
+    }
+}
+BENCHMARK(BM_scan)->RangeMultiplier(4)->Range(16, 1024);
+
+/// Every context is new, so the cache never hits
+static void BM_match(benchmark::State & state)
+{
+    const auto count = unsigned(state.range(0));
+    const auto config = makeConfiguration(count);
+    auto matcher = ProfileMatcher(config, "device");
+
+    Context context;
+    unsigned idx = 0, serial = 0;
+    for (auto _ : state) {
+        auto values = makeContext(idx);
+        values.emplace_back("serial", std::to_string(serial++));
+        context.merge(values);
+        benchmark::DoNotOptimize(matcher.match(context).profile);
+        idx = (idx + 1) % count;
+    }
+}
+BENCHMARK(BM_match)->RangeMultiplier(4)->Range(16, 1024);
+
+/// Switching back and forth between a few windows
+static void BM_matchCached(benchmark::State & state)
+{
+    const auto count = unsigned(state.range(0));
+    const auto config = makeConfiguration(count);
+    auto matcher = ProfileMatcher(config, "device");
+
+    std::vector<Context> contexts;
+    for (unsigned idx = 0; idx < 8; ++idx) { contexts.emplace_back(makeContext(idx)); }
+
+    unsigned idx = 0;
+    for (auto _ : state) {
+        benchmark::DoNotOptimize(matcher.match(contexts[idx]).profile);
+        idx = (idx + 1) % 8;
+    }
+}
+BENCHMARK(BM_matchCached)->RangeMultiplier(4)->Range(16, 1024);
+
+BENCHMARK_MAIN();
@@ -16,10 +16,12 @@
  */
 #include "keyledsd/RenderTarget.h"
 
+#include "keyledsd/KeyDatabase.h"
 #include "keyledsd/tools/accelerated.h"
 #include <gtest/gtest.h>
 #include <type_traits>
 
+using keyleds::KeyDatabase;
 using keyleds::RenderTarget;
 using keyleds::RGBColor;
 using keyleds::RGBAColor;
@@ -177,3 +179,43 @@ TYPED_TEST(RenderTargetAccelerationTest, multiply) {
     EXPECT_TRUE(std::all_of(target.begin(), target.end(),
                 [](auto item) { return item == RGBAColor{0xff, 0x80, 0x00, 0x3f}; }));
 }
+
+TYPED_TEST(RenderTargetAccelerationTest, scale) {
+    auto target = RenderTarget(TestFixture::size);
+    std::fill(target.begin(), target.end(), RGBAColor{0xff, 0x80, 0x00, 0xff});
+    keyleds::scale<typename TestFixture::architecture>(target, RGBAColor{0xff, 0xff, 0xff, 0x7f});
+    EXPECT_EQ(RGBAColor(0xff, 0x80, 0x00, 0x7f), target[0]);
+    EXPECT_TRUE(std::all_of(target.begin(), target.end(),
+                [](auto item) { return item == RGBAColor{0xff, 0x80, 0x00, 0x7f}; }));
+    keyleds::scale<typename TestFixture::architecture>(target, RGBAColor{0x7f, 0x00, 0xff, 0xff});
+    EXPECT_EQ(RGBAColor(0x7f, 0x00, 0x00, 0x7f), target[0]);
+    EXPECT_TRUE(std::all_of(target.begin(), target.end(),
+                [](auto item) { return item == RGBAColor{0x7f, 0x00, 0x00, 0x7f}; }));
+}
+
+TYPED_TEST(RenderTargetAccelerationTest, masked) {
+    const auto red = RGBAColor{0xff, 0, 0, 0xff};
+    auto keys = KeyDatabase::KeySet(TestFixture::size);
+    for (unsigned idx = 0; idx < TestFixture::size; idx += 3) { keys.insert(idx); }
+    keys.insert(64);                                // whole vector set at some point
+    for (unsigned idx = 65; idx < 72; ++idx) { keys.insert(idx); }
+
+    auto target = RenderTarget(TestFixture::size);
+    auto expectMasked = [&](RGBAColor inside, RGBAColor outside) {
+        for (unsigned idx = 0; idx < TestFixture::size; ++idx) {
+            EXPECT_EQ(keys.contains(idx) ? inside : outside, target[idx]) << "at index " << idx;
+        }
+    };
+
+    std::fill(target.begin(), target.end(), TestFixture::black);
+    keyleds::fill<typename TestFixture::architecture>(target, red, keys);
+    expectMasked(red, TestFixture::black);
+
+    std::fill(target.begin(), target.end(), TestFixture::black);
+    keyleds::copy<typename TestFixture::architecture>(target, TestFixture::opaqueWhite, keys);
+    expectMasked(RGBAColor{0xff, 0xff, 0xff, 0xff}, TestFixture::black);
+
+    std::fill(target.begin(), target.end(), TestFixture::black);
+    keyleds::blend<typename TestFixture::architecture>(target, TestFixture::translucentWhite, keys);
+    expectMasked(RGBAColor{0x7f, 0x7f, 0x7f, 0xbf}, TestFixture::black);
+}
@@ -16,9 +16,11 @@
  */
 #include "keyledsd/RenderTarget.h"
 
+#include "keyledsd/KeyDatabase.h"
 #include "keyledsd/tools/accelerated.h"
 #include <benchmark/benchmark.h>
 
+using keyleds::KeyDatabase;
 using keyleds::RenderTarget;
 using keyleds::RGBColor;
 using keyleds::RGBAColor;
@@ -55,4 +57,85 @@ BENCHMARK_TEMPLATE(BM_multiply, architecture::plain)->RangeMultiplier(2)->Range(
 BENCHMARK_TEMPLATE(BM_multiply, architecture::sse2)->RangeMultiplier(2)->Range(32, 2<<16);
 BENCHMARK_TEMPLATE(BM_multiply, architecture::avx2)->RangeMultiplier(2)->Range(32, 2<<16);
 
+template <typename Architecture> static void BM_scale(benchmark::State & state)
+{
+    auto target = RenderTarget(RenderTarget::size_type(state.range(0)));
+    std::fill(target.begin(), target.end(), RGBAColor{255, 255, 255, 255});
+
+    for (auto _ : state) {
+        keyleds::scale<Architecture>(target, RGBAColor{255, 255, 255, 254});
+    }
+}
+BENCHMARK_TEMPLATE(BM_scale, architecture::plain)->RangeMultiplier(2)->Range(32, 2<<16);
+BENCHMARK_TEMPLATE(BM_scale, architecture::sse2)->RangeMultiplier(2)->Range(32, 2<<16);
+BENCHMARK_TEMPLATE(BM_scale, architecture::avx2)->RangeMultiplier(2)->Range(32, 2<<16);
+
+// Idiom scripts use without scale: fill a buffer with the factor, then multiply
+template <typename Architecture> static void BM_scale_fill_multiply(benchmark::State & state)
+{
+    auto target = RenderTarget(RenderTarget::size_type(state.range(0)));
+    auto source = RenderTarget(RenderTarget::size_type(state.range(0)));
+    std::fill(target.begin(), target.end(), RGBAColor{255, 255, 255, 255});
+
+    for (auto _ : state) {
+        std::fill(source.begin(), source.end(), RGBAColor{255, 255, 255, 254});
+        keyleds::multiply<Architecture>(target, source);
+    }
+}
+BENCHMARK_TEMPLATE(BM_scale_fill_multiply, architecture::plain)->RangeMultiplier(2)->Range(32, 2<<16);
+BENCHMARK_TEMPLATE(BM_scale_fill_multiply, architecture::sse2)->RangeMultiplier(2)->Range(32, 2<<16);
+BENCHMARK_TEMPLATE(BM_scale_fill_multiply, architecture::avx2)->RangeMultiplier(2)->Range(32, 2<<16);
+
+// Masked operations on a set holding one key out of four
+static KeyDatabase::KeySet makeSparseSet(RenderTarget::size_type size)
+{
+    auto keys = KeyDatabase::KeySet(size);
+    for (RenderTarget::size_type idx = 0; idx < size; idx += 4) { keys.insert(unsigned(idx)); }
+    return keys;
+}
+
+template <typename Architecture> static void BM_fill_masked(benchmark::State & state)
+{
+    auto target = RenderTarget(RenderTarget::size_type(state.range(0)));
+    auto keys = makeSparseSet(target.size());
+
+    for (auto _ : state) {
+        keyleds::fill<Architecture>(target, RGBAColor{255, 0, 0, 255}, keys);
+        benchmark::ClobberMemory();
+    }
+}
+BENCHMARK_TEMPLATE(BM_fill_masked, architecture::plain)->RangeMultiplier(2)->Range(32, 2<<16);
+BENCHMARK_TEMPLATE(BM_fill_masked, architecture::sse2)->RangeMultiplier(2)->Range(32, 2<<16);
+BENCHMARK_TEMPLATE(BM_fill_masked, architecture::avx2)->RangeMultiplier(2)->Range(32, 2<<16);
+
+// Idiom effects use without masks: an indexed loop over a KeyGroup
+static void BM_fill_indexed(benchmark::State & state)
+{
+    auto target = RenderTarget(RenderTarget::size_type(state.range(0)));
+    std::vector<RenderTarget::size_type> indices;
+    for (RenderTarget::size_type idx = 0; idx < target.size(); idx += 4) { indices.push_back(idx); }
+
+    for (auto _ : state) {
+        for (auto idx : indices) { target[idx] = RGBAColor{255, 0, 0, 255}; }
+        benchmark::ClobberMemory();
+    }
+}
+BENCHMARK(BM_fill_indexed)->RangeMultiplier(2)->Range(32, 2<<16);
+
+template <typename Architecture> static void BM_blend_masked(benchmark::State & state)
+{
+    auto target = RenderTarget(RenderTarget::size_type(state.range(0)));
+    auto source = RenderTarget(RenderTarget::size_type(state.range(0)));
+    std::fill(target.begin(), target.end(), RGBAColor{0, 0, 0, 255});
+    std::fill(source.begin(), source.end(), RGBAColor{255, 255, 255, 32});
+    auto keys = makeSparseSet(target.size());
+
+    for (auto _ : state) {
+        keyleds::blend<Architecture>(target, source, keys);
+    }
+}
+BENCHMARK_TEMPLATE(BM_blend_masked, architecture::plain)->RangeMultiplier(2)->Range(32, 2<<16);
+BENCHMARK_TEMPLATE(BM_blend_masked, architecture::sse2)->RangeMultiplier(2)->Range(32, 2<<16);
+BENCHMARK_TEMPLATE(BM_blend_masked, architecture::avx2)->RangeMultiplier(2)->Range(32, 2<<16);
+
 BENCHMARK_MAIN();
@@ -0,0 +1,85 @@
+/* Keyleds -- Gaming keyboard tool
+ * Copyright (C) 2017 Julien Hartmann, juli1.hartmann@gmail.com
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+#include "keyledsd/tools/StartupTrace.h"
+
+#include <gtest/gtest.h>
+#include <sstream>
+#include <thread>
+
+using keyleds::tools::StartupTrace;
+
+
+TEST(StartupTraceTest, disabled) {
+    auto & trace = StartupTrace::instance();
+    trace.start();
+    trace.stop();
+    {
+        auto phase = trace.phase("keyledsd", "configuration");
+        trace.begin("/dev/hidraw0", "first frame");
+    }
+    EXPECT_TRUE(trace.spans().empty());
+    EXPECT_EQ(0u, trace.pending());
+}
+
+TEST(StartupTraceTest, phases) {
+    auto & trace = StartupTrace::instance();
+    trace.start();
+    {
+        auto phase = trace.phase("keyledsd", "configuration");
+    }
+    trace.begin("/dev/hidraw0", "first frame");
+    {
+        auto phase = trace.phase("/dev/hidraw0", "open");
+    }
+    EXPECT_EQ(1u, trace.pending());
+
+    std::thread([&trace] { trace.end("/dev/hidraw0", "first frame"); }).join();
+    trace.end("/dev/hidraw0", "first frame");       // already ended, ignored
+    EXPECT_EQ(0u, trace.pending());
+    trace.stop();
+
+    const auto spans = trace.spans();
+    ASSERT_EQ(3u, spans.size());
+    EXPECT_EQ("configuration", spans[0].name);
+    EXPECT_EQ("first frame", spans[1].name);
+    EXPECT_EQ("open", spans[2].name);
+    for (const auto & span : spans) { EXPECT_LE(span.start, span.end); }
+    EXPECT_LE(spans[1].start, spans[2].start);
+    EXPECT_GE(spans[1].end, spans[2].end);
+}
+
+TEST(StartupTraceTest, output) {
+    auto & trace = StartupTrace::instance();
+    trace.start();
+    const auto now = StartupTrace::clock::now();
+    trace.record("keyledsd", "udev scan", now, now + std::chrono::milliseconds(3));
+    trace.record("/dev/\"odd\"", "open", now, now + std::chrono::microseconds(1500));
+    trace.stop();
+
+    std::ostringstream summary;
+    trace.writeSummary(summary);
+    EXPECT_NE(std::string::npos, summary.str().find("udev scan"));
+    EXPECT_NE(std::string::npos, summary.str().find("    3.0ms  keyledsd"));
+    EXPECT_NE(std::string::npos, summary.str().find("    1.5ms  /dev/\"odd\""));
+
+    std::ostringstream json;
+    trace.writeTrace(json);
+    EXPECT_EQ(0u, json.str().find("{\"traceEvents\":["));
+    EXPECT_NE(std::string::npos, json.str().find("\"name\":\"/dev/\\\"odd\\\"\""));
+    EXPECT_NE(std::string::npos, json.str().find("\"dur\":1500"));
+    EXPECT_NE(std::string::npos, json.str().find("\"dur\":3000"));
+}
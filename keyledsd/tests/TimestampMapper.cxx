@@ -0,0 +1,51 @@
+/* Keyleds -- Gaming keyboard tool
+ * Copyright (C) 2017 Julien Hartmann, juli1.hartmann@gmail.com
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+#include "keyledsd/tools/TimestampMapper.h"
+
+#include <gtest/gtest.h>
+
+using keyleds::tools::TimestampMapper;
+using std::chrono::milliseconds;
+
+static TimestampMapper::clock::time_point at(long ms)
+{
+    return TimestampMapper::clock::time_point(milliseconds(ms));
+}
+
+
+TEST(TimestampMapperTest, lowestLatencyWins) {
+    auto mapper = TimestampMapper();
+
+    // First event arrives 5ms late, we cannot know it yet
+    EXPECT_EQ(at(100005), mapper.map(1000, at(100005)));
+    // Next one arrives faster: offset is refined
+    EXPECT_EQ(at(101000), mapper.map(2000, at(101000)));
+    // Late delivery does not shift the estimate
+    EXPECT_EQ(at(102000), mapper.map(3000, at(102040)));
+}
+
+TEST(TimestampMapperTest, resync) {
+    auto mapper = TimestampMapper();
+
+    EXPECT_EQ(at(100000), mapper.map(4294967000u, at(100000)));
+    // Server time wraps around: offset jumps forward and gets reset
+    EXPECT_EQ(at(100400), mapper.map(104, at(100400)));
+    EXPECT_EQ(at(100500), mapper.map(204, at(100510)));
+
+    mapper.reset();
+    EXPECT_EQ(at(100510), mapper.map(204, at(100510)));
+}
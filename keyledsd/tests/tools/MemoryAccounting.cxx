@@ -0,0 +1,95 @@
+/* Keyleds -- Gaming keyboard tool
+ * Copyright (C) 2017 Julien Hartmann, juli1.hartmann@gmail.com
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+#include "keyledsd/tools/MemoryAccounting.h"
+#include "keyledsd/RenderTarget.h"
+#include <algorithm>
+#include <gtest/gtest.h>
+#include <optional>
+
+using keyleds::tools::memory::Counter;
+using keyleds::tools::memory::Usage;
+
+static std::optional<Usage> find(const char * name)
+{
+    auto usage = keyleds::tools::memory::usage();
+    auto it = std::find_if(usage.begin(), usage.end(),
+                           [name](const auto & entry) { return entry.name == name; });
+    if (it == usage.end()) { return std::nullopt; }
+    return *it;
+}
+
+TEST(MemoryAccountingTest, counter) {
+    auto counter = Counter("test-counter");
+    counter.allocated(100);
+    counter.allocated(50);
+    counter.resized(50, 80);
+    counter.released(100);
+
+    EXPECT_EQ(80u, counter.bytes());
+    EXPECT_EQ(180u, counter.peak());
+    EXPECT_EQ(1u, counter.blocks());
+}
+
+TEST(MemoryAccountingTest, registry) {
+    EXPECT_FALSE(find("test-registry"));
+    {
+        auto first = Counter("test-registry");
+        auto second = Counter("test-registry");
+        first.allocated(10);
+        second.allocated(20);
+
+        auto usage = find("test-registry");
+        ASSERT_TRUE(usage);
+        EXPECT_EQ(30u, usage->bytes);
+        EXPECT_EQ(30u, usage->peak);
+        EXPECT_EQ(2u, usage->blocks);
+
+        // Peaks at different times are not added together
+        first.allocated(50);
+        first.released(50);
+        second.allocated(40);
+        second.released(40);
+        usage = find("test-registry");
+        ASSERT_TRUE(usage);
+        EXPECT_EQ(30u, usage->bytes);
+        EXPECT_EQ(60u, usage->peak);
+
+        auto all = keyleds::tools::memory::usage();
+        EXPECT_TRUE(std::is_sorted(all.begin(), all.end(), [](const auto & lhs, const auto & rhs) {
+            return lhs.name < rhs.name;
+        }));
+    }
+    EXPECT_FALSE(find("test-registry"));
+}
+
+TEST(MemoryAccountingTest, renderTarget) {
+    const auto before = find("render-targets");
+    ASSERT_TRUE(before);
+    {
+        auto target = keyleds::RenderTarget(20);
+        auto moved = std::move(target);
+
+        auto during = find("render-targets");
+        ASSERT_TRUE(during);
+        EXPECT_EQ(before->bytes + moved.capacity() * sizeof(keyleds::RGBAColor), during->bytes);
+        EXPECT_EQ(before->blocks + 1, during->blocks);
+    }
+    const auto after = find("render-targets");
+    ASSERT_TRUE(after);
+    EXPECT_EQ(before->bytes, after->bytes);
+    EXPECT_EQ(before->blocks, after->blocks);
+}